@@ -0,0 +1,65 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the additive oscillator for one voice with 1 to MAX_PARTIALS harmonics, and prints the
+ * average time per 64 frame block as JSON.
+ *
+ * The host build compiles this twice: synth_additive_benchmark with the inverse FFT, and
+ * synth_additive_benchmark_oscillator_bank with ADDITIVE_USE_OSCILLATOR_BANK set to 1. Where
+ * the two curves cross is the partial count above which the FFT is cheaper. The FFT runs once a
+ * hop, so a single block can take up to ADDITIVE_HOP_SIZE / 64 times the average.
+ */
+
+#include <cstdio>
+#include <vector>
+#include "additive_oscillator.h"
+#include "audio_common.h"
+#include "benchmark_timer.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kPartialCounts[] = {1, 4, 8, 16, 32, 64, 128, MAX_PARTIALS};
+
+// Low enough that every harmonic is below Nyquist
+constexpr float kFrequency = 55.0f;
+
+int main() {
+
+  const int num_lanes = SIMD_WIDTH;
+  std::vector<float> pitch_modulation(num_lanes * MAX_BLOCK_FRAMES, 1.0f);
+  std::vector<float> left(num_lanes * MAX_BLOCK_FRAMES), right(left.size());
+
+  printf("{\"oscillatorBank\":%s,\"blockFrames\":%d,\"additive\":[",
+         ADDITIVE_USE_OSCILLATOR_BANK ? "true" : "false", MAX_BLOCK_FRAMES);
+  for (size_t c = 0; c < sizeof(kPartialCounts) / sizeof(kPartialCounts[0]); c++){
+    int partial_count = kPartialCounts[c];
+    AdditiveOscillator oscillator(kFrameRate);
+    oscillator.setPartialCount(partial_count);
+    for (int p = 0; p < partial_count; p++) oscillator.setPartial(p, p + 1, 1.0f / (p + 1));
+    oscillator.setFrequency(0, kFrequency);
+    oscillator.resetVoice(0);
+
+    double ns = timeRender([&]() {
+      oscillator.render(0, pitch_modulation.data(), left.data(), right.data(), num_lanes,
+                        MAX_BLOCK_FRAMES);
+    }, 1, MAX_BLOCK_FRAMES);
+
+    printf("%s{\"partials\":%d,\"usPerBlock\":%.2f,\"nsPerPartialFrame\":%.3f}",
+           (c > 0) ? "," : "", partial_count, ns * MAX_BLOCK_FRAMES * 1e-3, ns / partial_count);
+  }
+  printf("]}\n");
+  return 0;
+}
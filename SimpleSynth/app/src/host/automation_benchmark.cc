@@ -0,0 +1,102 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times 1 to 256 automation lanes filling a block each, and prints the time per parameter per
+ * frame as JSON, for lanes following a curve, lanes holding a single value and lanes with no
+ * breakpoints, which is what a parameter that isn't automated costs.
+ *
+ * Each curve has a breakpoint every few hundred frames, cycling through the curve types, so some
+ * blocks cross a segment boundary. The timeline loops every kLoopFrames, which also times the
+ * cursor being sent back to the start.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "audio_common.h"
+#include "automation_lane.h"
+#include "benchmark_timer.h"
+
+constexpr int kLaneCounts[] = {1, 16, 64, 256};
+constexpr int kLoopFrames = 4096;
+constexpr CurveType kCurves[] = {CURVE_TYPE_LINEAR, CURVE_TYPE_EXPONENTIAL, CURVE_TYPE_BEZIER,
+                                 CURVE_TYPE_HOLD};
+
+enum LaneKind {
+  LANE_KIND_CURVE,
+  LANE_KIND_HELD,
+  LANE_KIND_EMPTY
+};
+
+// Breakpoints a few hundred frames apart, spaced differently for each lane
+static std::vector<Breakpoint> makeCurve(int lane) {
+
+  std::vector<Breakpoint> breakpoints;
+  const int spacing = 200 + (lane * 37) % 300;
+  for (int i = 0; i * spacing < kLoopFrames; i++){
+    CurveType curve = kCurves[(lane + i) % (sizeof(kCurves) / sizeof(kCurves[0]))];
+    float value = (i & 1) ? 0.25f : 0.75f;
+    breakpoints.push_back({(int64_t) i * spacing, value, curve, 2.0f, 0.9f});
+  }
+  breakpoints.push_back({kLoopFrames, 0.5f, CURVE_TYPE_LINEAR, 0, 0});
+  return breakpoints;
+}
+
+int main() {
+
+  const char *kind_names[] = {"curve", "held", "empty"};
+  bool is_finite = true;
+
+  printf("{\"blockFrames\":%d,\"automation\":[", MAX_BLOCK_FRAMES);
+  bool is_first = true;
+  for (int num_lanes : kLaneCounts){
+    for (int kind = LANE_KIND_CURVE; kind <= LANE_KIND_EMPTY; kind++){
+
+      std::unique_ptr<AutomationLane[]> lanes(new AutomationLane[num_lanes]);
+      for (int l = 0; l < num_lanes; l++){
+        if (kind == LANE_KIND_CURVE){
+          std::vector<Breakpoint> breakpoints = makeCurve(l);
+          lanes[l].setBreakpoints(breakpoints.data(), (int) breakpoints.size());
+        } else if (kind == LANE_KIND_HELD){
+          Breakpoint breakpoint = {0, 0.5f, CURVE_TYPE_LINEAR, 0, 0};
+          lanes[l].setBreakpoints(&breakpoint, 1);
+        }
+      }
+
+      std::vector<float> buffers(num_lanes * MAX_BLOCK_FRAMES, 0.0f);
+      int64_t frame = 0;
+      double ns = timeRender([&]() {
+        for (int l = 0; l < num_lanes; l++){
+          lanes[l].process(frame, buffers.data() + l * MAX_BLOCK_FRAMES, MAX_BLOCK_FRAMES);
+        }
+        frame = (frame + MAX_BLOCK_FRAMES) % kLoopFrames;
+      }, num_lanes, MAX_BLOCK_FRAMES);
+      for (float value : buffers){
+        if (!std::isfinite(value)) is_finite = false;
+      }
+
+      printf("%s{\"parameters\":%d,\"lanes\":\"%s\",\"nsPerParameterFrame\":%.3f,"
+             "\"usPerBlock\":%.3f}",
+             is_first ? "" : ",", num_lanes, kind_names[kind], ns,
+             ns * num_lanes * MAX_BLOCK_FRAMES / 1000.0);
+      is_first = false;
+    }
+  }
+  printf("],\"finite\":%s}\n", is_finite ? "true" : "false");
+  return is_finite ? 0 : 1;
+}
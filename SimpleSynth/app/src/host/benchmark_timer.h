@@ -0,0 +1,54 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_BENCHMARK_TIMER_H
+#define SIMPLESYNTH_BENCHMARK_TIMER_H
+
+#include <chrono>
+#include <stdint.h>
+
+#define BENCHMARK_REPEATS 3
+#define BENCHMARK_SECONDS_PER_RUN 0.1
+#define BENCHMARK_CALLS_PER_CHECK 64
+
+/**
+ * Call render over and over until BENCHMARK_SECONDS_PER_RUN has passed, BENCHMARK_REPEATS
+ * times, and keep the fastest run so that other load on the machine counts as little as possible.
+ *
+ * @param num_items how many voices, partials or samples each call renders per frame
+ * @param num_frames_per_call how many frames each call renders
+ * @return the time per item per frame in nanoseconds
+ */
+template <typename Render>
+double timeRender(Render render, int num_items, int num_frames_per_call) {
+
+  double best_ns = 0;
+  for (int repeat = 0; repeat < BENCHMARK_REPEATS; repeat++){
+    int64_t frames = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    while (elapsed.count() < BENCHMARK_SECONDS_PER_RUN){
+      for (int call = 0; call < BENCHMARK_CALLS_PER_CHECK; call++) render();
+      frames += (int64_t) BENCHMARK_CALLS_PER_CHECK * num_frames_per_call;
+      elapsed = std::chrono::steady_clock::now() - start;
+    }
+    double ns = elapsed.count() * 1e9 / ((double) frames * num_items);
+    if (repeat == 0 || ns < best_ns) best_ns = ns;
+  }
+  return best_ns;
+}
+
+#endif //SIMPLESYNTH_BENCHMARK_TIMER_H
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the PolyBLEP / PolyBLAMP oscillators with wavetables of the same waveforms, and prints
+ * the aliasing, speed and table memory of each as JSON.
+ *
+ * The wavetables are imported from naive single cycle WAVs written to a temporary directory, so
+ * their mip levels are what the app would make from the same waveforms. Aliasing is everything in
+ * the spectrum of a high note which isn't near a harmonic, relative to the harmonics, with the
+ * naive waveform for reference. The note is a whole number of cycles per analysis window, but a
+ * prime number of bins, so no alias lands on a harmonic.
+ */
+
+#include <dirent.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "classic_oscillator.h"
+#include "fft.h"
+#include "wavetable.h"
+#include "wavetable_oscillator.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kAnalysisFrames = 4096;
+constexpr int kNoteBin = 227;  // 2660 Hz
+constexpr int kSettleFrames = 1024;
+constexpr int kWindowHalfWidth = 4;  // main lobe of the Blackman-Harris window, in bins
+constexpr int kSpeedVoices = 16;
+
+constexpr Waveform kWaveforms[] = {WAVEFORM_SAW, WAVEFORM_PULSE, WAVEFORM_TRIANGLE};
+constexpr const char *kWaveformNames[] = {"saw", "pulse", "triangle"};
+
+static float naiveSample(Waveform waveform, float phase) {
+  switch (waveform){
+    case WAVEFORM_SAW:
+      return 2.0f * phase - 1.0f;
+    case WAVEFORM_PULSE:
+      return (phase < 0.5f) ? 1.0f : -1.0f;
+    case WAVEFORM_TRIANGLE:
+      return 1.0f - 4.0f * fabsf(phase - 0.5f);
+  }
+  return 0;
+}
+
+static void writeLittleEndian(FILE *file, uint32_t value, int num_bytes) {
+  for (int i = 0; i < num_bytes; i++) fputc((value >> (8 * i)) & 0xFF, file);
+}
+
+// A mono 32 bit float WAV
+static bool writeWav(const std::string &path, const std::vector<float> &samples) {
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) return false;
+  uint32_t data_bytes = (uint32_t) (samples.size() * sizeof(float));
+  fwrite("RIFF", 1, 4, file);
+  writeLittleEndian(file, 36 + data_bytes, 4);
+  fwrite("WAVEfmt ", 1, 8, file);
+  writeLittleEndian(file, 16, 4);
+  writeLittleEndian(file, 3, 2);  // float
+  writeLittleEndian(file, 1, 2);
+  writeLittleEndian(file, kFrameRate, 4);
+  writeLittleEndian(file, kFrameRate * sizeof(float), 4);
+  writeLittleEndian(file, sizeof(float), 2);
+  writeLittleEndian(file, 32, 2);
+  fwrite("data", 1, 4, file);
+  writeLittleEndian(file, data_bytes, 4);
+  bool is_written = fwrite(samples.data(), sizeof(float), samples.size(), file) == samples.size();
+  return fclose(file) == 0 && is_written;
+}
+
+static void removeDirectory(const std::string &path) {
+
+  DIR *directory = opendir(path.c_str());
+  if (directory == nullptr) return;
+  while (struct dirent *entry = readdir(directory)){
+    std::string name = entry->d_name;
+    if (name != "." && name != "..") unlink((path + "/" + name).c_str());
+  }
+  closedir(directory);
+  rmdir(path.c_str());
+}
+
+/**
+ * Power away from the harmonics relative to the power near them, for a note on kNoteBin.
+ * @return the ratio in dB
+ */
+static float measureAliasing(const std::vector<float> &samples) {
+
+  static Fft fft(kAnalysisFrames);
+  std::vector<float> real(kAnalysisFrames), imaginary(kAnalysisFrames, 0.0f);
+  for (int i = 0; i < kAnalysisFrames; i++){
+    double x = 2.0 * M_PI * i / kAnalysisFrames;
+    double window = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+    real[i] = (float) (samples[i] * window);
+  }
+  fft.forward(real.data(), imaginary.data());
+
+  double harmonic_power = 0;
+  double alias_power = 0;
+  for (int bin = kWindowHalfWidth + 1; bin < kAnalysisFrames / 2; bin++){
+    double power = (double) real[bin] * real[bin] + (double) imaginary[bin] * imaginary[bin];
+    int harmonic = (bin + kNoteBin / 2) / kNoteBin;
+    if (abs(bin - harmonic * kNoteBin) <= kWindowHalfWidth){
+      harmonic_power += power;
+    } else {
+      alias_power += power;
+    }
+  }
+  return (float) (10.0 * log10((alias_power + 1e-30) / harmonic_power));
+}
+
+int main() {
+
+  char directory_template[] = "classic_benchmark_XXXXXX";
+  if (mkdtemp(directory_template) == nullptr){
+    fprintf(stderr, "Unable to make a temporary directory\n");
+    return 1;
+  }
+  const std::string directory = directory_template;
+
+  const float note_frequency = (float) kNoteBin * kFrameRate / kAnalysisFrames;
+  const int num_lanes = roundUpToSimdWidth(kSpeedVoices);
+  std::vector<float> pitch_modulation(num_lanes * MAX_BLOCK_FRAMES, 1.0f);
+  std::vector<float> pulse_width_modulation(num_lanes * MAX_BLOCK_FRAMES, 0.0f);
+  std::vector<float> left(num_lanes * MAX_BLOCK_FRAMES), right(left.size());
+  const int total_frames = kSettleFrames + kAnalysisFrames;
+  bool is_loaded = true;
+
+  printf("{\"noteHz\":%.1f,\"wavetableBytesPerCycle\":%d,\"waveforms\":[", note_frequency,
+         (int) (WAVETABLE_LEVELS * WAVETABLE_STRIDE * sizeof(float)));
+  for (size_t w = 0; w < sizeof(kWaveforms) / sizeof(kWaveforms[0]); w++){
+    Waveform waveform = kWaveforms[w];
+
+    std::vector<float> cycle(WAVETABLE_SIZE);
+    for (int i = 0; i < WAVETABLE_SIZE; i++){
+      cycle[i] = naiveSample(waveform, (float) i / WAVETABLE_SIZE);
+    }
+    std::string wav_path = directory + "/" + kWaveformNames[w] + ".wav";
+    std::unique_ptr<Wavetable> table;
+    if (writeWav(wav_path, cycle)) table = Wavetable::load(wav_path, directory, 0);
+    if (!table){
+      is_loaded = false;
+      break;
+    }
+
+    ClassicOscillator classic(kFrameRate);
+    classic.setWaveform(waveform);
+    WavetableOscillator wavetable(kFrameRate);
+    wavetable.setTable(std::move(table));
+
+    // One voice for the aliasing, rendered into lane 0
+    std::vector<float> naive_output, classic_output, wavetable_output;
+    classic.setFrequency(0, note_frequency);
+    classic.setVoiceLevel(0, 1.0f);
+    wavetable.setFrequency(0, note_frequency);
+    wavetable.setVoiceLevel(0, 1.0f);
+    float phase = 0;
+    for (int frame = 0; frame < total_frames; frame += MAX_BLOCK_FRAMES){
+      std::fill(left.begin(), left.end(), 0.0f);
+      classic.render(pitch_modulation.data(), pulse_width_modulation.data(), left.data(),
+                     right.data(), num_lanes, MAX_BLOCK_FRAMES);
+      for (int i = 0; i < MAX_BLOCK_FRAMES; i++) classic_output.push_back(left[i * num_lanes]);
+
+      std::fill(left.begin(), left.end(), 0.0f);
+      wavetable.render(pitch_modulation.data(), left.data(), right.data(), num_lanes,
+                       MAX_BLOCK_FRAMES);
+      for (int i = 0; i < MAX_BLOCK_FRAMES; i++) wavetable_output.push_back(left[i * num_lanes]);
+
+      for (int i = 0; i < MAX_BLOCK_FRAMES; i++){
+        naive_output.push_back(naiveSample(waveform, phase));
+        phase += note_frequency / kFrameRate;
+        phase -= (phase >= 1.0f) ? 1.0f : 0.0f;
+      }
+    }
+    auto analyze = [](const std::vector<float> &output) {
+      return measureAliasing(std::vector<float>(output.begin() + kSettleFrames, output.end()));
+    };
+
+    // A chord of voices for the speed, as the synth plays them
+    for (int v = 0; v < kSpeedVoices; v++){
+      float frequency = 110.0f * powf(2.0f, v / 4.0f);
+      classic.setFrequency(v, frequency);
+      classic.setVoiceLevel(v, 1.0f);
+      wavetable.setFrequency(v, frequency);
+      wavetable.setVoiceLevel(v, 1.0f);
+    }
+    double classic_ns = timeRender([&]() {
+      classic.render(pitch_modulation.data(), pulse_width_modulation.data(), left.data(),
+                     right.data(), num_lanes, MAX_BLOCK_FRAMES);
+    }, kSpeedVoices, MAX_BLOCK_FRAMES);
+    double wavetable_ns = timeRender([&]() {
+      wavetable.render(pitch_modulation.data(), left.data(), right.data(), num_lanes,
+                       MAX_BLOCK_FRAMES);
+    }, kSpeedVoices, MAX_BLOCK_FRAMES);
+
+    printf("%s{\"waveform\":\"%s\",\"naiveAliasingDb\":%.1f,\"classicAliasingDb\":%.1f,"
+           "\"wavetableAliasingDb\":%.1f,\"classicNsPerVoiceFrame\":%.2f,"
+           "\"wavetableNsPerVoiceFrame\":%.2f}",
+           (w > 0) ? "," : "", kWaveformNames[w], analyze(naive_output),
+           analyze(classic_output), analyze(wavetable_output), classic_ns, wavetable_ns);
+  }
+  printf("]}\n");
+
+  removeDirectory(directory);
+  if (!is_loaded) fprintf(stderr, "Unable to make the wavetables\n");
+  return is_loaded ? 0 : 1;
+}
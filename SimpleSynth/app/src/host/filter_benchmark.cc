@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the state variable filter for 1 to MAX_VOICES voices with its coefficients evaluated once
+ * per block, at control rate and every frame, and prints the time per voice per frame as JSON.
+ *
+ * The cutoff sweeps over the block and the resonance is near self oscillation, so every point
+ * gives different coefficients. Returns 1 if the filter's output isn't finite, which is what a
+ * filter that can't take audio rate modulation would do.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "modulation_matrix.h"
+#include "state_variable_filter.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kVoiceCounts[] = {1, 4, 8, 16, MAX_VOICES};
+constexpr int kIntervals[] = {MAX_BLOCK_FRAMES, CONTROL_RATE_DIVIDER, 1};
+constexpr const char *kRateNames[] = {"block", "control", "audio"};
+constexpr float kResonance = 0.95f;
+constexpr int kInputBlocks = 64;  // a 4096 frame sweep
+
+// A cutoff sweep from 200Hz to 8kHz and back, different for each voice
+static float cutoffAt(int voice, int frame) {
+  float phase = (float) ((frame + voice * 97) % 4096) / 4096;
+  return 200.0f * powf(40.0f, 1.0f - fabsf(2.0f * phase - 1.0f));
+}
+
+int main() {
+
+  std::vector<float> audio(MAX_VOICES * MAX_BLOCK_FRAMES);
+  bool is_finite = true;
+
+  printf("{\"blockFrames\":%d,\"filter\":[", MAX_BLOCK_FRAMES);
+  bool is_first = true;
+  for (int num_voices : kVoiceCounts){
+    int num_lanes = roundUpToSimdWidth(num_voices);
+    int block_samples = num_lanes * MAX_BLOCK_FRAMES;
+    for (size_t r = 0; r < sizeof(kIntervals) / sizeof(kIntervals[0]); r++){
+      int interval = kIntervals[r];
+      int block_points = num_lanes * (MAX_BLOCK_FRAMES / interval + 1);
+
+      // The input and the sweep are made up front for a few blocks, and the filter cycles
+      // through them, so only a copy of the input is timed along with it
+      std::vector<float> input(kInputBlocks * block_samples);
+      std::vector<float> cutoff_points(kInputBlocks * block_points);
+      std::vector<float> resonance_points(block_points, kResonance);
+      uint32_t noise_state = 1;
+      for (float &sample : input){
+        noise_state = noise_state * 1664525u + 1013904223u;
+        sample = (float) (noise_state >> 8) / (1 << 23) - 1.0f;
+      }
+      for (int b = 0; b < kInputBlocks; b++){
+        for (int p = 0; p * interval <= MAX_BLOCK_FRAMES; p++){
+          for (int v = 0; v < num_lanes; v++){
+            cutoff_points[b * block_points + p * num_lanes + v] =
+                cutoffAt(v, b * MAX_BLOCK_FRAMES + p * interval);
+          }
+        }
+      }
+
+      StateVariableFilter filter(kFrameRate);
+      int block = 0;
+      double ns = timeRender([&]() {
+        std::copy(input.begin() + block * block_samples,
+                  input.begin() + (block + 1) * block_samples, audio.begin());
+        filter.process(audio.data(), cutoff_points.data() + block * block_points,
+                       resonance_points.data(), interval, num_lanes, MAX_BLOCK_FRAMES);
+        block = (block + 1) % kInputBlocks;
+      }, num_voices, MAX_BLOCK_FRAMES);
+      for (int i = 0; i < block_samples; i++){
+        if (!std::isfinite(audio[i])) is_finite = false;
+      }
+
+      printf("%s{\"voices\":%d,\"rate\":\"%s\",\"interval\":%d,\"nsPerVoiceFrame\":%.3f}",
+             is_first ? "" : ",", num_voices, kRateNames[r], interval, ns);
+      is_first = false;
+    }
+  }
+  printf("],\"finite\":%s}\n", is_finite ? "true" : "false");
+  return is_finite ? 0 : 1;
+}
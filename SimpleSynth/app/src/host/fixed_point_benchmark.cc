@@ -0,0 +1,84 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the synth's fixed point render path with the float one, as the app's fixed point
+ * benchmark does, and prints the SINAD of a single A4 and the time per voice per frame of a
+ * chord of sine voices for each as JSON.
+ *
+ * The fixed point path has no filter, modulation or automation, so the float path runs with its
+ * filter bypassed and nothing routed, leaving the oscillators and the mix to compare.
+ */
+
+#include <cstdio>
+#include <vector>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "sinad.h"
+#include "synthesizer.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kChannelCount = 2;
+constexpr int kFirstNote = 69;
+constexpr float kA4Frequency = 440.0f;
+constexpr int kQualityFrames = kFrameRate;
+constexpr int kSettleFrames = kFrameRate / 10;
+constexpr int kVoiceCounts[] = {1, 4, SYNTH_POLYPHONY};
+
+static void startNotes(Synthesizer *synth, bool is_fixed_point, int num_notes) {
+  synth->setVoiceType(VOICE_TYPE_SINE);
+  synth->setFixedPointEnabled(is_fixed_point);
+  synth->setFilterEnabled(false);
+  for (int i = 0; i < num_notes; i++){
+    const uint8_t note_on[] = {MIDI_NOTE_ON, (uint8_t) (kFirstNote + i), 127};
+    synth->sendMidi(note_on, sizeof(note_on), 0);
+  }
+}
+
+int main() {
+
+  std::vector<int16_t> buffer(MAX_BLOCK_FRAMES * kChannelCount);
+  const char *path_names[] = {"float", "fixedPoint"};
+
+  printf("{\"blockFrames\":%d,\"paths\":[", MAX_BLOCK_FRAMES);
+  for (int is_fixed_point = 0; is_fixed_point < 2; is_fixed_point++){
+    Synthesizer quality_synth(kChannelCount, kFrameRate);
+    startNotes(&quality_synth, is_fixed_point, 1);
+    std::vector<int16_t> capture(kQualityFrames);
+    for (int frame = 0; frame < kQualityFrames; frame += MAX_BLOCK_FRAMES){
+      quality_synth.render((int) buffer.size(), buffer.data());
+      for (int i = 0; i < MAX_BLOCK_FRAMES && frame + i < kQualityFrames; i++){
+        capture[frame + i] = buffer[i * kChannelCount];
+      }
+    }
+    float sinad = measureSineSinad(capture.data() + kSettleFrames, kQualityFrames - kSettleFrames,
+                                   kA4Frequency, kFrameRate);
+
+    printf("%s{\"path\":\"%s\",\"sinadDb\":%.1f,\"speed\":[", (is_fixed_point > 0) ? "," : "",
+           path_names[is_fixed_point], sinad);
+    for (size_t c = 0; c < sizeof(kVoiceCounts) / sizeof(kVoiceCounts[0]); c++){
+      Synthesizer synth(kChannelCount, kFrameRate);
+      startNotes(&synth, is_fixed_point, kVoiceCounts[c]);
+      double ns = timeRender([&]() {
+        synth.render((int) buffer.size(), buffer.data());
+      }, kVoiceCounts[c], MAX_BLOCK_FRAMES);
+      printf("%s{\"voices\":%d,\"nsPerVoiceFrame\":%.2f}", (c > 0) ? "," : "", kVoiceCounts[c], ns);
+    }
+    printf("]}");
+  }
+  printf("]}\n");
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the FM voice bank for every algorithm at up to MAX_VOICES voices, and prints the time per
+ * voice per frame and the load of a 64 frame block as JSON. Every operator is at full level and
+ * the feedback is on, so all of them are rendered.
+ */
+
+#include <math.h>
+#include <cstdio>
+#include <vector>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "fm_voice.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kVoiceCounts[] = {8, 16, MAX_VOICES};
+constexpr float kOperatorRatios[NUM_FM_OPERATORS] = {1.0f, 2.0f, 3.0f, 0.5f};
+
+int main() {
+
+  std::vector<float> pitch_modulation(MAX_VOICES * MAX_BLOCK_FRAMES, 1.0f);
+  std::vector<float> left(MAX_VOICES * MAX_BLOCK_FRAMES), right(left.size());
+  const double block_ns = (double) MAX_BLOCK_FRAMES * NANOS_IN_SECOND / kFrameRate;
+
+  printf("{\"blockFrames\":%d,\"fm\":[", MAX_BLOCK_FRAMES);
+  bool is_first = true;
+  for (int algorithm = 0; algorithm < NUM_FM_ALGORITHMS; algorithm++){
+    for (int num_voices : kVoiceCounts){
+      FmVoice fm(kFrameRate);
+      fm.setAlgorithm(algorithm);
+      fm.setFeedback(0.5f);
+      for (int op = 0; op < NUM_FM_OPERATORS; op++){
+        fm.setOperatorRatio(op, kOperatorRatios[op]);
+        fm.setOperatorLevel(op, 1.0f);
+      }
+      for (int v = 0; v < num_voices; v++){
+        fm.setFrequency(v, 110.0f * powf(2.0f, v / 12.0f));
+        fm.setVoiceLevel(v, 1.0f);
+        fm.resetVoice(v);
+      }
+      int num_lanes = roundUpToSimdWidth(num_voices);
+      double ns = timeRender([&]() {
+        fm.render(pitch_modulation.data(), left.data(), right.data(), num_lanes,
+                  MAX_BLOCK_FRAMES);
+      }, num_voices, MAX_BLOCK_FRAMES);
+
+      printf("%s{\"algorithm\":%d,\"voices\":%d,\"nsPerVoiceFrame\":%.3f,\"usPerBlock\":%.2f,"
+             "\"load\":%.4f}",
+             is_first ? "" : ",", algorithm, num_voices, ns,
+             ns * num_voices * MAX_BLOCK_FRAMES * 1e-3,
+             ns * num_voices * MAX_BLOCK_FRAMES / block_ns);
+      is_first = false;
+    }
+  }
+  printf("]}\n");
+  return 0;
+}
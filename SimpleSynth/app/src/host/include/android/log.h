@@ -0,0 +1,41 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for the NDK's logging API, messages go to stderr.
+ */
+
+#ifndef SIMPLESYNTH_HOST_ANDROID_LOG_H
+#define SIMPLESYNTH_HOST_ANDROID_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum {
+  ANDROID_LOG_VERBOSE = 2,
+  ANDROID_LOG_DEBUG,
+  ANDROID_LOG_INFO,
+  ANDROID_LOG_WARN,
+  ANDROID_LOG_ERROR,
+  ANDROID_LOG_FATAL,
+};
+
+// Only warnings and errors are shown, the rest would drown out the results
+#define __android_log_print(priority, tag, ...) \
+    ((priority) >= ANDROID_LOG_WARN ? \
+     (fprintf(stderr, "%s: ", tag), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr)) : 0)
+
+#endif //SIMPLESYNTH_HOST_ANDROID_LOG_H
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Floods the MIDI input path with bursts and measures how long events take to get through, then
+ * prints the results as JSON. Returns 1 if any check fails.
+ *
+ * The queue test pushes bursts of up to twice the queue's capacity from one thread while another
+ * drains it once a buffer period, as the audio thread does, and checks that every event which
+ * was accepted arrives exactly once and in order.
+ *
+ * The synth test renders in real time on its own thread. Between bursts of notes it sends a
+ * single probe note into silence and finds the frame where the probe becomes audible. Events
+ * are played a buffer period after they arrive, so that frame should be exactly one buffer
+ * period after the probe's timestamp, whatever the phase of the callback.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "audio_common.h"
+#include "midi_event_queue.h"
+#include "synthesizer.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kChannelCount = 2;
+constexpr int kFramesPerBuffer = 192;
+constexpr int64_t kBufferPeriodNs = (int64_t) kFramesPerBuffer * NANOS_IN_SECOND / kFrameRate;
+
+constexpr int kQueueBurstSizes[] = {16, 128, 512, MIDI_EVENT_QUEUE_CAPACITY,
+                                    2 * MIDI_EVENT_QUEUE_CAPACITY};
+constexpr int kQueueBurstCount = 250;
+constexpr int kQueueBurstGapMs = 2;
+
+constexpr int kProbeCount = 50;
+constexpr int kSynthBurstMessages = 256;
+constexpr int kSilenceMs = 100;
+constexpr int kProbeTimeoutMs = 100;
+
+// For the time between reading the clock and the synth reading it
+constexpr int64_t kLatencyToleranceNs = NANOS_IN_SECOND / kFrameRate + 50000;
+
+struct Statistics {
+  std::vector<int64_t> values;
+
+  double meanMs() const {
+    double sum = 0;
+    for (int64_t value : values) sum += value;
+    return values.empty() ? 0 : sum / values.size() * 1e-6;
+  }
+
+  double percentileMs(double fraction) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1, (size_t) (fraction * values.size()));
+    return values[index] * 1e-6;
+  }
+};
+
+// The sequence number of an event is carried in its data bytes, 14 bits of it
+static MidiMessage sequenceMessage(uint32_t sequence) {
+  MidiMessage message = {MIDI_NOTE_ON, (uint8_t) (sequence & 0x7F),
+                         (uint8_t) ((sequence >> 7) & 0x7F)};
+  return message;
+}
+
+static uint32_t messageSequence(const MidiMessage &message) {
+  return message.data_1 | (message.data_2 << 7);
+}
+
+static bool testQueueBursts() {
+
+  std::unique_ptr<MidiEventQueue> queue(new MidiEventQueue());
+  std::atomic<bool> is_producing{true};
+  int pushed = 0;
+  int rejected = 0;
+  int received = 0;
+  int out_of_order = 0;
+  Statistics latency;
+
+  std::thread consumer([&]() {
+    uint32_t expected = 0;
+    auto next_period = std::chrono::steady_clock::now();
+    bool is_last_pass = false;
+    while (!is_last_pass) {
+      is_last_pass = !is_producing.load(std::memory_order_acquire);
+      MidiEvent event;
+      int64_t now = get_time();
+      while (queue->peek(&event)) {
+        if (messageSequence(event.message) != (expected & 0x3FFF)) out_of_order++;
+        expected = messageSequence(event.message) + 1;
+        latency.values.push_back(now - event.timestamp_ns);
+        received++;
+        queue->pop();
+      }
+      next_period += std::chrono::nanoseconds(kBufferPeriodNs);
+      std::this_thread::sleep_until(next_period);
+    }
+  });
+
+  uint32_t sequence = 0;
+  for (int burst = 0; burst < kQueueBurstCount; burst++) {
+    int size = kQueueBurstSizes[burst % (sizeof(kQueueBurstSizes) / sizeof(kQueueBurstSizes[0]))];
+    for (int i = 0; i < size; i++) {
+      MidiEvent event = {get_time(), sequenceMessage(sequence)};
+      if (queue->push(event)) {
+        sequence++;
+        pushed++;
+      } else {
+        rejected++;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(kQueueBurstGapMs));
+  }
+  is_producing.store(false, std::memory_order_release);
+  consumer.join();
+
+  bool is_passed = received == pushed && out_of_order == 0;
+  printf("\"queue\":{\"pushed\":%d,\"rejected\":%d,\"received\":%d,\"outOfOrder\":%d,"
+         "\"meanLatencyMs\":%.3f,\"p99LatencyMs\":%.3f,\"maxLatencyMs\":%.3f,\"passed\":%s}",
+         pushed, rejected, received, out_of_order, latency.meanMs(), latency.percentileMs(0.99),
+         latency.percentileMs(1.0), is_passed ? "true" : "false");
+  return is_passed;
+}
+
+static bool testSynthLatency() {
+
+  Synthesizer synth(kChannelCount, kFrameRate);
+  synth.setVolume(100);
+  std::atomic<int64_t> probe_timestamp{0};
+  std::atomic<int64_t> silent_render_time{0};  // of the last buffer, if it was silent
+  std::atomic<bool> is_running{true};
+  Statistics latency;
+  std::vector<double> render_us;
+
+  std::thread audio([&]() {
+    std::vector<int16_t> buffer(kFramesPerBuffer * kChannelCount);
+    auto next_period = std::chrono::steady_clock::now();
+    int64_t previous_render_time = 0;
+    while (is_running.load(std::memory_order_acquire)) {
+      int64_t render_time = get_time();
+      auto render_start = std::chrono::steady_clock::now();
+      synth.render((int) buffer.size(), buffer.data());
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - render_start;
+      render_us.push_back(elapsed.count() * 1e6);
+      bool is_silent = std::all_of(buffer.begin(), buffer.end(),
+                                   [](int16_t sample) { return sample == 0; });
+      silent_render_time.store(is_silent ? render_time : 0, std::memory_order_release);
+
+      // Frame f of the buffer is heard f frames after the callback started. The probe is only
+      // read after rendering, since the synth may have picked it up before it was set.
+      int64_t probe = probe_timestamp.load(std::memory_order_acquire);
+      for (int f = 0; probe != 0 && f < kFramesPerBuffer; f++) {
+        if (buffer[f * kChannelCount] == 0) continue;
+
+        // The oscillator starts at a zero crossing, so the note may have started a frame
+        // earlier, which can be the last frame of the previous buffer
+        int64_t heard = render_time + (int64_t) f * NANOS_IN_SECOND / kFrameRate - probe;
+        int64_t started = (f > 0) ?
+            render_time + (int64_t) (f - 1) * NANOS_IN_SECOND / kFrameRate - probe :
+            previous_render_time + (int64_t) (kFramesPerBuffer - 1) * NANOS_IN_SECOND / kFrameRate -
+            probe;
+        bool is_started_closer = llabs(started - kBufferPeriodNs) < llabs(heard - kBufferPeriodNs);
+        latency.values.push_back(is_started_closer ? started : heard);
+        probe_timestamp.store(0, std::memory_order_release);
+        break;
+      }
+      previous_render_time = render_time;
+      next_period += std::chrono::nanoseconds(kBufferPeriodNs);
+      std::this_thread::sleep_until(next_period);
+    }
+  });
+
+  int missed_probes = 0;
+  int unsilenced_bursts = 0;
+  uint32_t random = 1;
+  for (int probe = 0; probe < kProbeCount; probe++) {
+    // A burst of notes on every channel, with running status, then silence
+    std::vector<uint8_t> burst;
+    for (int i = 0; i < kSynthBurstMessages; i += 2) {
+      random = random * 1664525u + 1013904223u;
+      uint8_t channel = (uint8_t) ((random >> 8) & 0x0F);
+      uint8_t note = (uint8_t) (36 + ((random >> 16) % 48));
+      burst.insert(burst.end(), {(uint8_t) (MIDI_NOTE_ON | channel), note, 100, note, 0});
+    }
+    for (uint8_t channel = 0; channel < 16; channel++) {
+      burst.insert(burst.end(), {(uint8_t) (MIDI_CONTROL_CHANGE | channel),
+                                 MIDI_CC_ALL_SOUND_OFF, 0});
+    }
+    int64_t burst_time = get_time();
+    synth.sendMidi(burst.data(), (int) burst.size(), burst_time);
+
+    // Wait until a buffer rendered after the burst's has come out silent
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kSilenceMs);
+    while (silent_render_time.load(std::memory_order_acquire) <= burst_time + kBufferPeriodNs &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (silent_render_time.load(std::memory_order_acquire) <= burst_time + kBufferPeriodNs) {
+      unsilenced_bursts++;
+      continue;
+    }
+
+    const uint8_t note_on[] = {MIDI_NOTE_ON, 69, 127};
+    const uint8_t note_off[] = {MIDI_NOTE_OFF, 69, 0};
+    int64_t timestamp = get_time();
+    probe_timestamp.store(timestamp, std::memory_order_release);
+    synth.sendMidi(note_on, sizeof(note_on), timestamp);
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kProbeTimeoutMs);
+    while (probe_timestamp.load(std::memory_order_acquire) != 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (probe_timestamp.exchange(0) != 0) missed_probes++;
+    synth.sendMidi(note_off, sizeof(note_off), get_time());
+  }
+  is_running.store(false, std::memory_order_release);
+  audio.join();
+
+  // A callback which runs late plays its events late too, so only early probes and a median
+  // away from one buffer period are failures
+  int early_probes = 0;
+  for (int64_t value : latency.values) {
+    if (value < kBufferPeriodNs - kLatencyToleranceNs) early_probes++;
+  }
+  double median_ms = latency.percentileMs(0.5);
+  bool is_passed = missed_probes == 0 && unsilenced_bursts == 0 && early_probes == 0 &&
+                   median_ms * 1e6 <= kBufferPeriodNs + kLatencyToleranceNs;
+  std::sort(render_us.begin(), render_us.end());
+  printf("\"synth\":{\"bufferMs\":%.3f,\"probes\":%d,\"unsilencedBursts\":%d,"
+         "\"missedProbes\":%d,\"earlyProbes\":%d,"
+         "\"minLatencyMs\":%.3f,\"medianLatencyMs\":%.3f,\"maxLatencyMs\":%.3f,"
+         "\"medianRenderUs\":%.1f,\"maxRenderUs\":%.1f,\"passed\":%s}",
+         kBufferPeriodNs * 1e-6, kProbeCount, unsilenced_bursts, missed_probes, early_probes,
+         latency.percentileMs(0.0), median_ms, latency.percentileMs(1.0),
+         render_us.empty() ? 0 : render_us[render_us.size() / 2],
+         render_us.empty() ? 0 : render_us.back(), is_passed ? "true" : "false");
+  return is_passed;
+}
+
+int main() {
+
+  printf("{");
+  bool is_queue_passed = testQueueBursts();
+  printf(",");
+  bool is_synth_passed = testSynthLatency();
+  printf("}\n");
+  return (is_queue_passed && is_synth_passed) ? 0 : 1;
+}
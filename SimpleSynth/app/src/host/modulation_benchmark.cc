@@ -0,0 +1,114 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the modulation matrix with no routes, as for a static patch, and with every route in use,
+ * and prints the time per voice per frame of each as JSON.
+ *
+ * The static patch is timed with its destinations resolved as the synth resolves them, which
+ * makes them all constant so nothing is evaluated, and again forced to control rate, which is what
+ * it cost before constant destinations were skipped. The modulated patch is timed at block,
+ * control and audio rate.
+ *
+ * The host build compiles this twice: synth_modulation_benchmark with the usual
+ * CONTROL_RATE_DIVIDER, and synth_modulation_benchmark_audio_rate with it set to 1, so that
+ * comparing the two shows what the control rate split saves.
+ */
+
+#include <cstdio>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "modulation_matrix.h"
+#include "parameter_rate.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kVoiceCounts[] = {4, 16, MAX_VOICES};
+
+// Every source to every destination it makes sense for, with both LFOs running
+static void setHeavyModulation(ModulationMatrix *matrix) {
+  matrix->setLfoShape(1, LFO_SHAPE_TRIANGLE);
+  matrix->setLfoRate(1, 0.3f);
+  matrix->setRoute(0, MOD_SOURCE_LFO_1, MOD_DEST_PITCH, 0.2f);
+  matrix->setRoute(1, MOD_SOURCE_LFO_2, MOD_DEST_CUTOFF, 2.0f);
+  matrix->setRoute(2, MOD_SOURCE_LFO_1, MOD_DEST_AMPLITUDE, 0.3f);
+  matrix->setRoute(3, MOD_SOURCE_LFO_2, MOD_DEST_PULSE_WIDTH, 0.2f);
+  matrix->setRoute(4, MOD_SOURCE_PRESSURE, MOD_DEST_CUTOFF, 1.0f);
+  matrix->setRoute(5, MOD_SOURCE_PRESSURE, MOD_DEST_AMPLITUDE, 0.5f);
+  matrix->setRoute(6, MOD_SOURCE_TIMBRE, MOD_DEST_RESONANCE, 0.5f);
+  matrix->setRoute(7, MOD_SOURCE_TIMBRE, MOD_DEST_PITCH, 0.1f);
+}
+
+// Every destination at one rate
+static void setRates(ParameterRate rate, ParameterRate *rates) {
+  for (int d = 0; d < NUM_MOD_DESTINATIONS; d++) rates[d] = rate;
+}
+
+// The rates the synth would pass with the default declared rates
+static void resolveRates(const ModulationMatrix &matrix, ParameterRate *rates) {
+  ParameterRates declared;
+  for (int d = 0; d < NUM_MOD_DESTINATIONS; d++){
+    ModulationDestination destination = (ModulationDestination) d;
+    rates[d] = declared.resolve(getDestinationParameter(destination),
+                                matrix.isChanging(destination));
+  }
+}
+
+int main() {
+
+  printf("{\"controlRateDivider\":%d,\"blockFrames\":%d,\"matrix\":[",
+         CONTROL_RATE_DIVIDER, MAX_BLOCK_FRAMES);
+  for (size_t c = 0; c < sizeof(kVoiceCounts) / sizeof(kVoiceCounts[0]); c++){
+    int num_lanes = roundUpToSimdWidth(kVoiceCounts[c]);
+    ParameterRate rates[NUM_MOD_DESTINATIONS];
+
+    // The first block evaluates everything once, after that the static patch is constant
+    ModulationMatrix static_matrix(kFrameRate);
+    double static_ns = timeRender([&]() {
+      resolveRates(static_matrix, rates);
+      static_matrix.process(rates, num_lanes, MAX_BLOCK_FRAMES);
+    }, num_lanes, MAX_BLOCK_FRAMES);
+
+    ModulationMatrix evaluated_matrix(kFrameRate);
+    setRates(PARAMETER_RATE_CONTROL, rates);
+    double evaluated_ns = timeRender([&]() {
+      evaluated_matrix.process(rates, num_lanes, MAX_BLOCK_FRAMES);
+    }, num_lanes, MAX_BLOCK_FRAMES);
+
+    printf("%s{\"voices\":%d,\"staticNsPerVoiceFrame\":%.3f,"
+           "\"staticEvaluatedNsPerVoiceFrame\":%.3f",
+           (c > 0) ? "," : "", num_lanes, static_ns, evaluated_ns);
+
+    const ParameterRate modulated_rates[] = {PARAMETER_RATE_BLOCK, PARAMETER_RATE_CONTROL,
+                                             PARAMETER_RATE_AUDIO};
+    const char *rate_names[] = {"Block", "Control", "Audio"};
+    for (int r = 0; r < 3; r++){
+      ModulationMatrix modulated_matrix(kFrameRate);
+      setHeavyModulation(&modulated_matrix);
+      for (int v = 0; v < num_lanes; v++){
+        modulated_matrix.setExpression(v, EXPRESSION_PRESSURE, 0.5f);
+        modulated_matrix.setExpression(v, EXPRESSION_TIMBRE, 0.5f);
+      }
+      setRates(modulated_rates[r], rates);
+      double modulated_ns = timeRender([&]() {
+        modulated_matrix.process(rates, num_lanes, MAX_BLOCK_FRAMES);
+      }, num_lanes, MAX_BLOCK_FRAMES);
+      printf(",\"modulated%sNsPerVoiceFrame\":%.3f", rate_names[r], modulated_ns);
+    }
+    printf("}");
+  }
+  printf("]}\n");
+  return 0;
+}
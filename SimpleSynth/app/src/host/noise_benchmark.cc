@@ -0,0 +1,89 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times each noise color in samples per nanosecond, next to rand() scaled to the same range, and
+ * prints the results as JSON.
+ *
+ * Also checks that a seeded generator gives the same samples however the calls split them into
+ * blocks, and returns 1 if it doesn't.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "noise_generator.h"
+
+constexpr int kFrameRate = 48000;
+constexpr uint32_t kSeed = 12345;
+constexpr int kCheckFrames = 48000;
+constexpr NoiseColor kColors[] = {NOISE_COLOR_WHITE, NOISE_COLOR_PINK, NOISE_COLOR_BROWN};
+constexpr const char *kColorNames[] = {"white", "pink", "brown"};
+
+// Generate in blocks of every size from 1 to MAX_BLOCK_FRAMES in turn
+static std::vector<float> generateInUnevenBlocks(NoiseColor color, int num_frames) {
+
+  NoiseGenerator noise(kFrameRate, kSeed);
+  noise.setColor(color);
+  std::vector<float> output(num_frames);
+  int block_frames = 1;
+  for (int frame = 0; frame < num_frames; ){
+    int count = std::min(block_frames, num_frames - frame);
+    noise.generate(output.data() + frame, count);
+    frame += count;
+    block_frames = (block_frames % MAX_BLOCK_FRAMES) + 1;
+  }
+  return output;
+}
+
+int main() {
+
+  std::vector<float> buffer(MAX_BLOCK_FRAMES);
+  bool is_deterministic = true;
+
+  printf("{\"blockFrames\":%d,\"noise\":[", MAX_BLOCK_FRAMES);
+  for (size_t c = 0; c < sizeof(kColors) / sizeof(kColors[0]); c++){
+    NoiseGenerator noise(kFrameRate, kSeed);
+    noise.setColor(kColors[c]);
+    double ns = timeRender([&]() {
+      noise.generate(buffer.data(), MAX_BLOCK_FRAMES);
+    }, 1, MAX_BLOCK_FRAMES);
+
+    NoiseGenerator whole(kFrameRate, kSeed);
+    whole.setColor(kColors[c]);
+    std::vector<float> expected(kCheckFrames);
+    for (int frame = 0; frame < kCheckFrames; frame += MAX_BLOCK_FRAMES){
+      whole.generate(expected.data() + frame, std::min(MAX_BLOCK_FRAMES, kCheckFrames - frame));
+    }
+    bool is_matched = generateInUnevenBlocks(kColors[c], kCheckFrames) == expected;
+    if (!is_matched) is_deterministic = false;
+
+    printf("%s{\"color\":\"%s\",\"samplesPerNs\":%.3f,\"deterministic\":%s}",
+           (c > 0) ? "," : "", kColorNames[c], 1.0 / ns, is_matched ? "true" : "false");
+  }
+
+  srand(kSeed);
+  double rand_ns = timeRender([&]() {
+    for (int i = 0; i < MAX_BLOCK_FRAMES; i++){
+      buffer[i] = rand() * (2.0f / RAND_MAX) - 1.0f;
+    }
+  }, 1, MAX_BLOCK_FRAMES);
+  printf(",{\"color\":\"rand\",\"samplesPerNs\":%.3f}]}\n", 1.0 / rand_ns);
+  return is_deterministic ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for trace.cc. There is no ATrace off Android, so sections are ignored.
+ */
+
+#include "trace.h"
+
+bool Trace::is_tracing_supported_ = false;
+
+void Trace::beginSection(const char *sectionName) {
+  (void) sectionName;
+}
+
+void Trace::endSection() {
+}
+
+void Trace::initialize() {
+}
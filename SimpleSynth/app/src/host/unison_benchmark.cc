@@ -0,0 +1,85 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the unison oscillator for every sub-oscillator count with a chord of notes, and prints
+ * the cost curve as JSON. For each count it gives the time per sub-oscillator per frame of the
+ * oscillator alone, and the time the whole synth takes to render a block as a fraction of the
+ * block's duration, which is the load on the audio thread.
+ */
+
+#include <math.h>
+#include <cstdio>
+#include <vector>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "synthesizer.h"
+#include "unison_oscillator.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kChannelCount = 2;
+constexpr int kNumNotes = 8;
+constexpr int kChordNotes[kNumNotes] = {48, 52, 55, 59, 60, 64, 67, 71};
+constexpr float kDetuneSemitones = 0.3f;
+constexpr float kStereoSpread = 1.0f;
+
+int main() {
+
+  const int num_lanes = roundUpToSimdWidth(kNumNotes);
+  std::vector<float> pitch_modulation(num_lanes * MAX_BLOCK_FRAMES, 1.0f);
+  std::vector<float> left(num_lanes * MAX_BLOCK_FRAMES), right(left.size());
+  std::vector<int16_t> synth_buffer(MAX_BLOCK_FRAMES * kChannelCount);
+  const double block_ns = (double) MAX_BLOCK_FRAMES * NANOS_IN_SECOND / kFrameRate;
+
+  printf("{\"notes\":%d,\"blockFrames\":%d,\"unison\":[", kNumNotes, MAX_BLOCK_FRAMES);
+  for (int count = 1; count <= MAX_UNISON_VOICES; count++){
+    UnisonOscillator oscillator(kFrameRate);
+    oscillator.setVoiceCount(count);
+    oscillator.setDetune(kDetuneSemitones);
+    oscillator.setStereoSpread(kStereoSpread);
+    for (int v = 0; v < kNumNotes; v++){
+      oscillator.setFrequency(v, 440.0f * powf(2.0f, (kChordNotes[v] - 69) / 12.0f));
+      oscillator.resetVoice(v);
+    }
+    double oscillator_ns = timeRender([&]() {
+      for (int v = 0; v < kNumNotes; v++){
+        oscillator.render(v, pitch_modulation.data(), left.data(), right.data(), num_lanes,
+                          MAX_BLOCK_FRAMES);
+      }
+    }, kNumNotes * count, MAX_BLOCK_FRAMES);
+
+    Synthesizer synth(kChannelCount, kFrameRate);
+    synth.setVolume(100);
+    synth.setVoiceType(VOICE_TYPE_UNISON_SAW);
+    synth.setUnisonVoices(count);
+    synth.setUnisonDetune(kDetuneSemitones);
+    synth.setUnisonSpread(kStereoSpread);
+    for (int v = 0; v < kNumNotes; v++){
+      const uint8_t note_on[] = {MIDI_NOTE_ON, (uint8_t) kChordNotes[v], 100};
+      synth.sendMidi(note_on, sizeof(note_on), 0);
+    }
+    double synth_ns = timeRender([&]() {
+      synth.render((int) synth_buffer.size(), synth_buffer.data());
+    }, 1, MAX_BLOCK_FRAMES);
+
+    printf("%s{\"subOscillators\":%d,\"oscillatorNsPerSubOscillatorFrame\":%.3f,"
+           "\"synthUsPerBlock\":%.2f,\"synthLoad\":%.4f}",
+           (count > 1) ? "," : "", count, oscillator_ns,
+           synth_ns * MAX_BLOCK_FRAMES * 1e-3, synth_ns * MAX_BLOCK_FRAMES / block_ns);
+  }
+  printf("]}\n");
+  return 0;
+}
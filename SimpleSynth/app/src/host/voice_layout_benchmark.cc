@@ -0,0 +1,164 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the synth's lane indexed voice state with the array of Voice structs it replaced, and
+ * prints the time per voice per frame of each as JSON.
+ *
+ * Both render sine voices into the same lane interleaved buffers with the same fastSine and
+ * pitch modulation, so only the layout differs. The struct layout goes voice by voice, skipping
+ * inactive ones, the lane layout goes frame by frame across SIMD_WIDTH voices at a time. The
+ * whole synth is timed too, rendering the same number of sine voices, for scale.
+ *
+ * Returns 1 if the two layouts don't render the same samples, the timings are only reported.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "audio_common.h"
+#include "benchmark_timer.h"
+#include "synthesizer.h"
+
+constexpr int kFrameRate = 48000;
+constexpr int kChannelCount = 2;
+constexpr int kBlockFrames = MAX_BLOCK_FRAMES;
+constexpr int kVoiceCounts[] = {1, 4, 8, 16, MAX_VOICES};
+
+// The layout before the voice state was split into lanes
+struct Voice {
+  bool is_active;
+  int channel;
+  int note;
+  float velocity;
+  uint32_t start_order;
+  float phase;
+  float phase_increment;
+};
+
+struct StructVoices {
+  Voice voices[MAX_VOICES];
+
+  void render(const float *pitch_modulation, float *left, float *right, int num_lanes,
+              int num_frames) {
+    for (int v = 0; v < MAX_VOICES; v++){
+      Voice &voice = voices[v];
+      if (!voice.is_active) continue;
+      for (int i = 0; i < num_frames; i++){
+        int index = i * num_lanes + v;
+        float value = fastSine(voice.phase);
+        left[index] = value;
+        right[index] = value;
+
+        float phase = voice.phase + voice.phase_increment * pitch_modulation[index];
+        voice.phase = (phase >= 1.0f) ? phase - 1.0f : phase;
+      }
+    }
+  }
+};
+
+// The layout in Synthesizer, with the same loop as its sine voices
+struct LaneVoices {
+  float phases[MAX_VOICES];
+  float phase_increments[MAX_VOICES];
+
+  void render(const float *pitch_modulation, float *left, float *right, int num_lanes,
+              int num_frames) {
+    for (int i = 0; i < num_frames; i++){
+      for (int v = 0; v < num_lanes; v++){
+        int index = i * num_lanes + v;
+        float value = fastSine(phases[v]);
+        left[index] = value;
+        right[index] = value;
+
+        float phase = phases[v] + phase_increments[v] * pitch_modulation[index];
+        phases[v] = (phase >= 1.0f) ? phase - 1.0f : phase;
+      }
+    }
+  }
+};
+
+int main() {
+
+  std::vector<float> pitch_modulation(kBlockFrames * MAX_VOICES);
+  for (size_t i = 0; i < pitch_modulation.size(); i++){
+    pitch_modulation[i] = 1.0f + 0.01f * (float) ((i * 7) % 13) / 13;
+  }
+  std::vector<float> struct_left(kBlockFrames * MAX_VOICES), struct_right(struct_left.size());
+  std::vector<float> lane_left(struct_left.size()), lane_right(struct_left.size());
+  std::vector<int16_t> synth_buffer(kBlockFrames * kChannelCount);
+
+  bool is_matched = true;
+  printf("{\"blockFrames\":%d,\"layouts\":[", kBlockFrames);
+  for (size_t c = 0; c < sizeof(kVoiceCounts) / sizeof(kVoiceCounts[0]); c++){
+    int num_voices = kVoiceCounts[c];
+    int num_lanes = roundUpToSimdWidth(num_voices);
+
+    // Voices in the lowest lanes, as the synth allocates them
+    StructVoices struct_voices = {};
+    LaneVoices lane_voices = {};
+    for (int v = 0; v < num_voices; v++){
+      float increment = 440.0f * powf(2.0f, v / 12.0f) / kFrameRate;
+      struct_voices.voices[v].is_active = true;
+      struct_voices.voices[v].velocity = 1.0f;
+      struct_voices.voices[v].phase_increment = increment;
+      lane_voices.phase_increments[v] = increment;
+    }
+
+    std::fill(struct_left.begin(), struct_left.end(), 0.0f);
+    std::fill(lane_left.begin(), lane_left.end(), 0.0f);
+    for (int block = 0; block < 100; block++){
+      struct_voices.render(pitch_modulation.data(), struct_left.data(), struct_right.data(),
+                           num_lanes, kBlockFrames);
+      lane_voices.render(pitch_modulation.data(), lane_left.data(), lane_right.data(),
+                         num_lanes, kBlockFrames);
+    }
+    for (int i = 0; i < kBlockFrames; i++){
+      for (int v = 0; v < num_voices; v++){
+        if (struct_left[i * num_lanes + v] != lane_left[i * num_lanes + v]) is_matched = false;
+      }
+    }
+
+    double struct_ns = timeRender([&]() {
+      struct_voices.render(pitch_modulation.data(), struct_left.data(), struct_right.data(),
+                           num_lanes, kBlockFrames);
+    }, num_voices, kBlockFrames);
+    double lane_ns = timeRender([&]() {
+      lane_voices.render(pitch_modulation.data(), lane_left.data(), lane_right.data(),
+                         num_lanes, kBlockFrames);
+    }, num_voices, kBlockFrames);
+
+    // The synth steals the oldest voice past its polyphony
+    Synthesizer synth(kChannelCount, kFrameRate);
+    synth.setVolume(100);
+    int num_synth_voices = std::min(num_voices, SYNTH_POLYPHONY);
+    for (int v = 0; v < num_synth_voices; v++){
+      const uint8_t note_on[] = {MIDI_NOTE_ON, (uint8_t) (48 + v), 100};
+      synth.sendMidi(note_on, sizeof(note_on), 0);
+    }
+    double synth_ns = timeRender([&]() {
+      synth.render((int) synth_buffer.size(), synth_buffer.data());
+    }, num_synth_voices, kBlockFrames);
+
+    printf("%s{\"voices\":%d,\"structNsPerVoiceFrame\":%.2f,\"laneNsPerVoiceFrame\":%.2f,"
+           "\"speedup\":%.2f,\"synthVoices\":%d,\"synthNsPerVoiceFrame\":%.2f}",
+           (c > 0) ? "," : "", num_voices, struct_ns, lane_ns,
+           (lane_ns > 0) ? struct_ns / lane_ns : 0, num_synth_voices, synth_ns);
+  }
+  printf("],\"matched\":%s}\n", is_matched ? "true" : "false");
+  return is_matched ? 0 : 1;
+}
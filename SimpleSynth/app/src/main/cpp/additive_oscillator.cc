@@ -0,0 +1,228 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "additive_oscillator.h"
+
+#define TWO_PI_F 6.2831853f
+#define DEFAULT_PARTIAL_COUNT 64
+
+// 4 term Blackman-Harris, its sidelobes are low enough that everything outside the main lobe can
+// be left out of the kernel
+static const float kWindowCoefficients[4] = {0.35875f, 0.48829f, 0.14128f, 0.01168f};
+
+// The window centred on n = 0
+static float window(int n) {
+  float x = TWO_PI_F * n / ADDITIVE_FFT_SIZE;
+  return kWindowCoefficients[0] + kWindowCoefficients[1] * cosf(x) +
+         kWindowCoefficients[2] * cosf(2 * x) + kWindowCoefficients[3] * cosf(3 * x);
+}
+
+AdditiveOscillator::AdditiveOscillator(int frame_rate) :
+    frame_rate_(frame_rate),
+    fft_(ADDITIVE_FFT_SIZE) {
+
+  // The spectrum of the window at fractional bin offsets across its main lobe. The last entry is
+  // repeated so that the interpolation in synthesizeFrame can read one past the end.
+  for (int i = 0; i < ADDITIVE_KERNEL_SIZE; i++) {
+    float offset = (float) i / ADDITIVE_KERNEL_OVERSAMPLING - ADDITIVE_KERNEL_HALF_WIDTH;
+    double sum = 0;
+    for (int n = -ADDITIVE_FFT_SIZE / 2; n < ADDITIVE_FFT_SIZE / 2; n++) {
+      sum += window(n) * cos(2.0 * M_PI * offset * n / ADDITIVE_FFT_SIZE);
+    }
+    kernel_[i] = (float) sum;
+  }
+  kernel_[ADDITIVE_KERNEL_SIZE] = kernel_[ADDITIVE_KERNEL_SIZE - 1];
+
+  // Divide the window out of the centre half of the frame and replace it with a triangle. Frames
+  // are ADDITIVE_HOP_SIZE apart so the triangles overlap-add to 1.
+  const int quarter = ADDITIVE_FFT_SIZE / 4;
+  for (int j = 0; j < ADDITIVE_FFT_SIZE / 2; j++) {
+    int n = j - quarter;
+    float triangle = 1.0f - fabsf((float) n) / quarter;
+    post_window_[j] = triangle / window(n);
+  }
+
+  // Default to a sawtooth spectrum
+  for (int p = 0; p < MAX_PARTIALS; p++) {
+    partial_ratios_[p] = p + 1.0f;
+    partial_amplitudes_[p] = 0.5f / (p + 1.0f);
+  }
+  partial_count_ = DEFAULT_PARTIAL_COUNT;
+
+  for (int v = 0; v < MAX_VOICES; v++) {
+    frequencies_[v] = 0;
+    resetVoice(v);
+  }
+}
+
+void AdditiveOscillator::setPartialCount(int partial_count) {
+  if (partial_count < 0) partial_count = 0;
+  if (partial_count > MAX_PARTIALS) partial_count = MAX_PARTIALS;
+  partial_count_ = partial_count;
+}
+
+void AdditiveOscillator::setPartial(int index, float ratio, float amplitude) {
+  if (index < 0 || index >= MAX_PARTIALS) return;
+  partial_ratios_[index] = ratio;
+  partial_amplitudes_[index] = amplitude;
+}
+
+void AdditiveOscillator::setFrequency(int lane, float frequency_hz) {
+  frequencies_[lane] = frequency_hz;
+}
+
+void AdditiveOscillator::resetVoice(int lane) {
+
+  // Start every partial in sine phase. In cosine phase the partials of a harmonic spectrum all
+  // peak together at the start of each cycle.
+  for (int p = 0; p < MAX_PARTIALS; p++) phases_[lane][p] = 0.75f;
+  memset(overlap_buffers_[lane], 0, sizeof(overlap_buffers_[lane]));
+
+  // Start with the hop used up, so the first frame rendered synthesizes a new one. It fades in
+  // over the rising half of its triangle.
+  read_indexes_[lane] = ADDITIVE_HOP_SIZE;
+}
+
+void AdditiveOscillator::render(int lane,
+                                const float *pitch_modulation,
+                                float *left_buffer,
+                                float *right_buffer,
+                                int num_lanes,
+                                int num_frames) {
+
+  assert(lane < num_lanes && num_lanes <= MAX_VOICES && num_frames <= MAX_BLOCK_FRAMES);
+
+#if ADDITIVE_USE_OSCILLATOR_BANK
+  renderOscillatorBank(lane, pitch_modulation[lane], bank_buffer_, num_frames);
+  for (int i = 0; i < num_frames; i++) {
+    int index = i * num_lanes + lane;
+    left_buffer[index] += bank_buffer_[i];
+    right_buffer[index] += bank_buffer_[i];
+  }
+#else
+  float *overlap_buffer = overlap_buffers_[lane];
+  int read_index = read_indexes_[lane];
+
+  for (int i = 0; i < num_frames; i++) {
+    int index = i * num_lanes + lane;
+    if (read_index == ADDITIVE_HOP_SIZE) {
+      synthesizeFrame(lane, pitch_modulation[index]);
+      read_index = 0;
+    }
+    float value = overlap_buffer[read_index++];
+    left_buffer[index] += value;
+    right_buffer[index] += value;
+  }
+  read_indexes_[lane] = read_index;
+#endif
+}
+
+void AdditiveOscillator::synthesizeFrame(int lane, float pitch) {
+
+  const int size = ADDITIVE_FFT_SIZE;
+  const float frequency = frequencies_[lane] * pitch;
+  const float bins_per_hz = (float) size / frame_rate_;
+  const float max_bin = size / 2 - ADDITIVE_KERNEL_HALF_WIDTH;
+  const float hop_seconds = (float) ADDITIVE_HOP_SIZE / frame_rate_;
+  float *phases = phases_[lane];
+
+  memset(real_, 0, sizeof(real_));
+  memset(imaginary_, 0, sizeof(imaginary_));
+
+  for (int p = 0; p < partial_count_; p++) {
+
+    float partial_frequency = frequency * partial_ratios_[p];
+    float amplitude = partial_amplitudes_[p];
+    float bin = partial_frequency * bins_per_hz;
+    float phase = phases[p];
+
+    float advance = partial_frequency * hop_seconds;
+    phases[p] = phase + advance - floorf(phase + advance);
+
+    // Partials which would alias are left out rather than folded back
+    if (amplitude == 0 || bin <= 0 || bin >= max_bin) continue;
+
+    float real = amplitude * cosf(TWO_PI_F * phase);
+    float imaginary = amplitude * sinf(TWO_PI_F * phase);
+
+    int first_bin = (int) bin - ADDITIVE_KERNEL_HALF_WIDTH + 1;
+    for (int j = 0; j < 2 * ADDITIVE_KERNEL_HALF_WIDTH; j++) {
+      int k = first_bin + j;
+      float position = (k - bin + ADDITIVE_KERNEL_HALF_WIDTH) * ADDITIVE_KERNEL_OVERSAMPLING;
+      int i = (int) position;
+      float gain = kernel_[i] + (position - i) * (kernel_[i + 1] - kernel_[i]);
+
+      // Bins below 0 wrap around to the negative frequencies, which is still correct since only
+      // the real part of the frame is used
+      int wrapped = k & (size - 1);
+      real_[wrapped] += gain * real;
+      imaginary_[wrapped] += gain * imaginary;
+    }
+  }
+
+  fft_.inverse(real_, imaginary_);
+
+  // Shift out the hop which has just been played and add the centre half of the new frame
+  float *overlap_buffer = overlap_buffers_[lane];
+  const int half = size / 2;
+  memmove(overlap_buffer, overlap_buffer + ADDITIVE_HOP_SIZE,
+          sizeof(float) * (half - ADDITIVE_HOP_SIZE));
+  memset(overlap_buffer + half - ADDITIVE_HOP_SIZE, 0, sizeof(float) * ADDITIVE_HOP_SIZE);
+  for (int j = 0; j < half; j++) {
+    int n = (j - size / 4) & (size - 1);
+    overlap_buffer[j] += real_[n] * post_window_[j];
+  }
+}
+
+/**
+ * The reference implementation, one recursive oscillator per partial. The oscillators are
+ * restarted from the stored phases on every block.
+ */
+void AdditiveOscillator::renderOscillatorBank(int lane, float pitch, float *output,
+                                              int num_frames) {
+
+  const float frequency = frequencies_[lane] * pitch;
+  const float nyquist = frame_rate_ * 0.5f;
+  float *phases = phases_[lane];
+
+  memset(output, 0, sizeof(float) * num_frames);
+
+  for (int p = 0; p < partial_count_; p++) {
+
+    float partial_frequency = frequency * partial_ratios_[p];
+    float amplitude = partial_amplitudes_[p];
+    float increment = partial_frequency / frame_rate_;
+    float phase = phases[p];
+
+    float advance = increment * num_frames;
+    phases[p] = phase + advance - floorf(phase + advance);
+    if (amplitude == 0 || partial_frequency <= 0 || partial_frequency >= nyquist) continue;
+
+    float rotation_real = cosf(TWO_PI_F * increment);
+    float rotation_imaginary = sinf(TWO_PI_F * increment);
+    float real = amplitude * cosf(TWO_PI_F * phase);
+    float imaginary = amplitude * sinf(TWO_PI_F * phase);
+    for (int i = 0; i < num_frames; i++) {
+      output[i] += real;
+      float next_real = real * rotation_real - imaginary * rotation_imaginary;
+      imaginary = real * rotation_imaginary + imaginary * rotation_real;
+      real = next_real;
+    }
+  }
+}
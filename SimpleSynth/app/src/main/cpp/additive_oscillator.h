@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_ADDITIVE_OSCILLATOR_H
+#define SIMPLESYNTH_ADDITIVE_OSCILLATOR_H
+
+#include "audio_common.h"
+#include "fft.h"
+
+#define MAX_PARTIALS 256
+
+#define ADDITIVE_FFT_SIZE 512
+#define ADDITIVE_HOP_SIZE (ADDITIVE_FFT_SIZE / 4)
+
+// Each partial is drawn into this many bins either side of its frequency
+#define ADDITIVE_KERNEL_HALF_WIDTH 4
+#define ADDITIVE_KERNEL_OVERSAMPLING 32
+#define ADDITIVE_KERNEL_SIZE (2 * ADDITIVE_KERNEL_HALF_WIDTH * ADDITIVE_KERNEL_OVERSAMPLING + 1)
+
+// Setting this to 1 renders the partials with a bank of recursive oscillators instead of the
+// inverse FFT, which is useful for comparing the cost of the two approaches, see
+// synth_additive_benchmark in the host build
+#ifndef ADDITIVE_USE_OSCILLATOR_BANK
+#define ADDITIVE_USE_OSCILLATOR_BANK 0
+#endif
+
+/**
+ * An additive oscillator for sounds with hundreds of partials, such as pads.
+ *
+ * Rather than running an oscillator per partial, every partial is drawn into a spectrum as the
+ * main lobe of a Blackman-Harris window, centred on its frequency, and the spectrum is turned
+ * into a frame of audio with a single inverse FFT. The window is then divided out of the centre
+ * half of the frame and replaced by a triangle, and the frames are overlap-added every
+ * ADDITIVE_HOP_SIZE frames. Each partial costs a few bins per hop instead of a few operations per
+ * frame, so beyond a few dozen partials the cost is dominated by the FFT size rather than by the
+ * number of partials.
+ *
+ * Partial frequencies and amplitudes are updated once per hop.
+ */
+class AdditiveOscillator {
+
+public:
+  AdditiveOscillator(int frame_rate);
+
+  void setPartialCount(int partial_count);
+
+  /**
+   * @param index the partial, from 0 to MAX_PARTIALS - 1
+   * @param ratio frequency of the partial as a multiple of the voice frequency
+   * @param amplitude linear amplitude of the partial
+   */
+  void setPartial(int index, float ratio, float amplitude);
+
+  void setFrequency(int lane, float frequency_hz);
+
+  void resetVoice(int lane);
+
+  /**
+   * Render a block for one voice, adding it to that voice's lane in the output buffers. The
+   * buffers use the lane layout described in audio_common.h.
+   *
+   * @param lane the voice to render
+   * @param pitch_modulation frequency multiplier for each voice and frame, read once per hop
+   */
+  void render(int lane,
+              const float *pitch_modulation,
+              float *left_buffer,
+              float *right_buffer,
+              int num_lanes,
+              int num_frames);
+
+private:
+  void synthesizeFrame(int lane, float pitch);
+  void renderOscillatorBank(int lane, float pitch, float *output, int num_frames);
+
+  int frame_rate_;
+  Fft fft_;
+
+  int partial_count_ = 0;
+  float partial_ratios_[MAX_PARTIALS];
+  float partial_amplitudes_[MAX_PARTIALS];
+
+  float frequencies_[MAX_VOICES];
+
+  // Phase of each partial in cycles, at the centre of the next frame
+  float phases_[MAX_VOICES][MAX_PARTIALS];
+
+  // Overlap-add output. The first ADDITIVE_HOP_SIZE frames are complete, read_indexes_ is how
+  // far through them the voice has got.
+  float overlap_buffers_[MAX_VOICES][ADDITIVE_FFT_SIZE / 2];
+  int read_indexes_[MAX_VOICES];
+
+  float kernel_[ADDITIVE_KERNEL_SIZE + 1];
+  float post_window_[ADDITIVE_FFT_SIZE / 2];
+  float real_[ADDITIVE_FFT_SIZE];
+  float imaginary_[ADDITIVE_FFT_SIZE];
+  float bank_buffer_[MAX_BLOCK_FRAMES];
+};
+
+#endif //SIMPLESYNTH_ADDITIVE_OSCILLATOR_H
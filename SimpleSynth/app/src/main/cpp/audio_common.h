@@ -27,6 +27,32 @@
     (void) (x);\
     } while (0)
 
+// Voices are rendered in blocks of at most MAX_BLOCK_FRAMES. Per voice buffers are laid out frame
+// by frame, with one lane per voice: buffer[frame * num_lanes + lane]. The number of lanes is
+// always rounded up to SIMD_WIDTH so that the inner loops over lanes vectorize without a
+// scalar tail, the padding lanes are simply rendered and then ignored.
+#define MAX_VOICES 32
+#define SIMD_WIDTH 4
+#define MAX_BLOCK_FRAMES 64
+
+inline int roundUpToSimdWidth(int num_voices) {
+  return (num_voices + SIMD_WIDTH - 1) & ~(SIMD_WIDTH - 1);
+}
+
+/**
+ * sin(2 pi phase) for a phase in cycles from 0 to 1. Plain arithmetic, unlike sinf, so loops
+ * across voices vectorize. The phase is folded onto a quarter cycle either side of 0 and a
+ * Taylor series to x^9 is used there, which is accurate to about 4e-6.
+ */
+inline float fastSine(float phase) {
+  float t = phase - ((phase >= 0.5f) ? 1.0f : 0.0f);
+  t = (t > 0.25f) ? 0.5f - t : t;
+  t = (t < -0.25f) ? -0.5f - t : t;
+  float x = t * 6.2831853f;
+  float x2 = x * x;
+  return x * (1.0f + x2 * (-1.0f / 6 + x2 * (1.0f / 120 + x2 * (-1.0f / 5040 + x2 / 362880))));
+}
+
 struct AudioStreamFormat {
   uint32_t   frame_rate;
   uint32_t   frames_per_buffer;
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "automation_lane.h"
+
+#define SNAPSHOT_INDEX_MASK 3
+#define SNAPSHOT_IS_NEW 4
+
+// Below this curvature an exponential segment is drawn as a straight line
+#define MIN_CURVATURE 1e-3f
+
+AutomationLane::AutomationLane() :
+    middle_index_(2) {
+
+  for (int i = 0; i < 3; i++) snapshots_[i].count = 0;
+}
+
+void AutomationLane::setBreakpoints(const Breakpoint *breakpoints, int count) {
+
+  if (count < 0) count = 0;
+  if (count > MAX_BREAKPOINTS) count = MAX_BREAKPOINTS;
+
+  Snapshot &snapshot = snapshots_[back_index_];
+  std::copy(breakpoints, breakpoints + count, snapshot.breakpoints);
+  std::stable_sort(snapshot.breakpoints, snapshot.breakpoints + count,
+                   [](const Breakpoint &a, const Breakpoint &b) { return a.frame < b.frame; });
+  snapshot.count = count;
+
+  // Publish the new curve and take back whichever copy was in the middle
+  back_index_ = middle_index_.exchange(back_index_ | SNAPSHOT_IS_NEW, std::memory_order_acq_rel)
+                & SNAPSHOT_INDEX_MASK;
+}
+
+bool AutomationLane::process(int64_t start_frame, float *buffer, int num_frames) {
+
+  if (middle_index_.load(std::memory_order_relaxed) & SNAPSHOT_IS_NEW) {
+    front_index_ = middle_index_.exchange(front_index_, std::memory_order_acq_rel)
+                   & SNAPSHOT_INDEX_MASK;
+    cursor_ = 0;
+  }
+
+  const Snapshot &snapshot = snapshots_[front_index_];
+  const Breakpoint *breakpoints = snapshot.breakpoints;
+  const int count = snapshot.count;
+  if (count == 0) return false;
+
+  // The timeline only moves backwards if the position is reset, start the search again
+  if (cursor_ >= count || breakpoints[cursor_].frame > start_frame) cursor_ = 0;
+
+  int64_t frame = start_frame;
+  int offset = 0;
+  while (offset < num_frames) {
+
+    // Move on to the segment which contains this frame
+    while (cursor_ + 1 < count && breakpoints[cursor_ + 1].frame <= frame) cursor_++;
+
+    const Breakpoint &start = breakpoints[cursor_];
+    int run_frames = num_frames - offset;
+
+    if (frame < start.frame || cursor_ + 1 == count) {
+      // Before the first breakpoint or after the last one the value is held
+      if (frame < start.frame && start.frame - frame < run_frames) {
+        run_frames = (int) (start.frame - frame);
+      }
+      std::fill(buffer + offset, buffer + offset + run_frames, start.value);
+    } else {
+      const Breakpoint &end = breakpoints[cursor_ + 1];
+      if (end.frame - frame < run_frames) run_frames = (int) (end.frame - frame);
+      fillSegment(start, end, frame, buffer + offset, run_frames);
+    }
+
+    offset += run_frames;
+    frame += run_frames;
+  }
+  return true;
+}
+
+/**
+ * Fill part of a block with one segment of the curve. The segment runs from start.frame to
+ * end.frame and the part to fill starts at frame.
+ */
+void AutomationLane::fillSegment(const Breakpoint &start, const Breakpoint &end, int64_t frame,
+                                 float *buffer, int num_frames) {
+
+  const float v0 = start.value;
+  const float v1 = end.value;
+  const float dx = 1.0f / (float) (end.frame - start.frame);
+  const float x0 = (float) (frame - start.frame) * dx;
+
+  CurveType curve = start.curve;
+  if (curve == CURVE_TYPE_EXPONENTIAL && fabsf(start.control_1) < MIN_CURVATURE) {
+    curve = CURVE_TYPE_LINEAR;
+  }
+
+  switch (curve) {
+    case CURVE_TYPE_HOLD:
+      std::fill(buffer, buffer + num_frames, v0);
+      break;
+
+    case CURVE_TYPE_LINEAR: {
+      float slope = (v1 - v0) * dx;
+      float base = v0 + (v1 - v0) * x0;
+      for (int i = 0; i < num_frames; i++) buffer[i] = base + slope * i;
+      break;
+    }
+
+    case CURVE_TYPE_EXPONENTIAL: {
+      // v = v0 + (v1 - v0) * (e^(c x) - 1) / (e^c - 1). The exponential is advanced by
+      // multiplying, with SIMD_WIDTH interleaved recurrences so the loop still vectorizes. It is
+      // restarted from expf on every call, which stops rounding errors building up.
+      float curvature = start.control_1;
+      float scale = (v1 - v0) / expm1f(curvature);
+      float offset = v0 - scale;
+      float step = expf(curvature * dx);
+      float step_simd = powf(step, SIMD_WIDTH);
+      float exponentials[SIMD_WIDTH];
+      exponentials[0] = expf(curvature * x0);
+      for (int k = 1; k < SIMD_WIDTH; k++) exponentials[k] = exponentials[k - 1] * step;
+
+      int i = 0;
+      for (; i + SIMD_WIDTH <= num_frames; i += SIMD_WIDTH) {
+        for (int k = 0; k < SIMD_WIDTH; k++) {
+          buffer[i + k] = offset + scale * exponentials[k];
+          exponentials[k] *= step_simd;
+        }
+      }
+      for (int k = 0; i < num_frames; i++, k++) buffer[i] = offset + scale * exponentials[k];
+      break;
+    }
+
+    case CURVE_TYPE_BEZIER: {
+      // Cubic bezier in x, expanded to a polynomial and evaluated with Horner's method
+      float c1 = start.control_1;
+      float c2 = start.control_2;
+      float a = v1 - v0 + 3.0f * (c1 - c2);
+      float b = 3.0f * (v0 - 2.0f * c1 + c2);
+      float c = 3.0f * (c1 - v0);
+      for (int i = 0; i < num_frames; i++) {
+        float x = x0 + dx * i;
+        buffer[i] = ((a * x + b) * x + c) * x + v0;
+      }
+      break;
+    }
+  }
+}
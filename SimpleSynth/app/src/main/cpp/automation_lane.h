@@ -0,0 +1,93 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_AUTOMATION_LANE_H
+#define SIMPLESYNTH_AUTOMATION_LANE_H
+
+#include <atomic>
+#include "audio_common.h"
+
+#define MAX_BREAKPOINTS 64
+
+// The shape of the segment which starts at a breakpoint
+enum CurveType {
+  CURVE_TYPE_LINEAR,
+  CURVE_TYPE_EXPONENTIAL,  // control_1 is the curvature, positive bends the curve down
+  CURVE_TYPE_BEZIER,       // control_1 and control_2 are the values of the inner control points
+  CURVE_TYPE_HOLD          // stays at the breakpoint value until the next breakpoint
+};
+
+struct Breakpoint {
+  int64_t frame;
+  float value;
+  CurveType curve;
+  float control_1;
+  float control_2;
+};
+
+/**
+ * A sample accurate automation curve for a single parameter, made of breakpoints joined by
+ * linear, exponential, bezier or hold segments.
+ *
+ * The audio thread keeps a cursor on the current segment and only moves it forward as time
+ * passes, so finding the segment costs nothing in the usual case. Each block is filled segment by
+ * segment with loops the compiler can vectorize, the exponential segments use a multiplicative
+ * recurrence rather than calling expf per frame.
+ *
+ * The breakpoints can be replaced from the UI thread at any time. The lane holds three copies:
+ * the UI writes into its own copy and swaps it with the shared middle one, and the audio thread
+ * picks up the middle copy at the start of the next block if it has changed. Neither thread
+ * waits for the other.
+ */
+class AutomationLane {
+
+public:
+  AutomationLane();
+
+  /**
+   * Replace the curve, must only be called from one (non audio) thread. The breakpoints are
+   * sorted by frame. Passing no breakpoints turns the automation off.
+   */
+  void setBreakpoints(const Breakpoint *breakpoints, int count);
+
+  /**
+   * Fill a buffer with the value of the curve for each frame. Before the first breakpoint the
+   * value is the first breakpoint's, after the last it is the last breakpoint's.
+   *
+   * @param start_frame the position of the first frame of the block on the curve's timeline
+   * @return false if the lane has no breakpoints, in which case the buffer is left untouched
+   */
+  bool process(int64_t start_frame, float *buffer, int num_frames);
+
+private:
+  struct Snapshot {
+    Breakpoint breakpoints[MAX_BREAKPOINTS];
+    int count;
+  };
+
+  void fillSegment(const Breakpoint &start, const Breakpoint &end, int64_t frame,
+                   float *buffer, int num_frames);
+
+  Snapshot snapshots_[3];
+  int back_index_ = 0;               // written by the UI thread
+  int front_index_ = 1;              // read by the audio thread
+  std::atomic<int> middle_index_;    // swapped between them, with a flag set when it is new
+
+  // Index of the breakpoint at the start of the current segment
+  int cursor_ = 0;
+};
+
+#endif //SIMPLESYNTH_AUTOMATION_LANE_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include "classic_oscillator.h"
+
+// The corrections assume the discontinuities are at least two samples apart
+#define MAX_PHASE_INCREMENT 0.25f
+#define MIN_PHASE_INCREMENT 1e-6f
+#define MIN_PULSE_WIDTH 0.02f
+#define MAX_PULSE_WIDTH 0.98f
+
+/**
+ * PolyBLEP residual for a falling step of 2 at phase 0, with t the phase from 0 to 1 and dt the
+ * phase increment. Zero unless t is within one sample of the step.
+ */
+static inline float polyBlep(float t, float dt, float inverse_dt) {
+  float after = t * inverse_dt;
+  float before = (t - 1.0f) * inverse_dt;
+  float residual = (t < dt) ? (after + after - after * after - 1.0f) : 0.0f;
+  residual += (t > 1.0f - dt) ? (before * before + before + before + 1.0f) : 0.0f;
+  return residual;
+}
+
+/**
+ * PolyBLAMP residual for a corner at phase 0 where the slope increases by 1 per sample. This is
+ * the integral of the PolyBLEP residual, (1 - |x|)^3 / 6 with x the distance in samples.
+ */
+static inline float polyBlamp(float t, float dt, float inverse_dt) {
+  float after = 1.0f - t * inverse_dt;
+  float before = 1.0f + (t - 1.0f) * inverse_dt;
+  float residual = (t < dt) ? after * after * after : 0.0f;
+  residual += (t > 1.0f - dt) ? before * before * before : 0.0f;
+  return residual * (1.0f / 6.0f);
+}
+
+ClassicOscillator::ClassicOscillator(int frame_rate) :
+    frame_rate_(frame_rate) {
+
+  for (int v = 0; v < MAX_VOICES; v++) {
+    phase_increments_[v] = 0;
+    voice_levels_[v] = 0;
+    resetVoice(v);
+  }
+}
+
+void ClassicOscillator::setWaveform(Waveform waveform) {
+  waveform_ = waveform;
+}
+
+void ClassicOscillator::setPulseWidth(float pulse_width) {
+  pulse_width_ = pulse_width;
+}
+
+void ClassicOscillator::setFrequency(int lane, float frequency_hz) {
+  phase_increments_[lane] = frequency_hz / frame_rate_;
+}
+
+void ClassicOscillator::setVoiceLevel(int lane, float level) {
+  voice_levels_[lane] = level;
+}
+
+void ClassicOscillator::resetVoice(int lane) {
+  phases_[lane] = 0;
+}
+
+void ClassicOscillator::render(const float *pitch_modulation,
+                               const float *pulse_width_modulation,
+                               float *left_buffer,
+                               float *right_buffer,
+                               int num_lanes,
+                               int num_frames) {
+
+  assert(num_lanes <= MAX_VOICES && num_frames <= MAX_BLOCK_FRAMES);
+
+  const Waveform waveform = waveform_;
+  const float pulse_width = pulse_width_;
+
+  for (int i = 0; i < num_frames; i++) {
+
+    const int offset = i * num_lanes;
+    const float *pitch = pitch_modulation + offset;
+    float *left = left_buffer + offset;
+    float *right = right_buffer + offset;
+
+    // The waveform is chosen outside the lane loops so that each loop is branch free
+    switch (waveform) {
+      case WAVEFORM_SAW:
+        for (int v = 0; v < num_lanes; v++) {
+          float dt = fminf(fmaxf(phase_increments_[v] * pitch[v], MIN_PHASE_INCREMENT),
+                           MAX_PHASE_INCREMENT);
+          float t = phases_[v] + dt;
+          t -= (t >= 1.0f) ? 1.0f : 0.0f;
+          phases_[v] = t;
+
+          float value = (t + t - 1.0f - polyBlep(t, dt, 1.0f / dt)) * voice_levels_[v];
+          left[v] += value;
+          right[v] += value;
+        }
+        break;
+
+      case WAVEFORM_PULSE: {
+        const float *width_modulation = pulse_width_modulation + offset;
+        for (int v = 0; v < num_lanes; v++) {
+          float dt = fminf(fmaxf(phase_increments_[v] * pitch[v], MIN_PHASE_INCREMENT),
+                           MAX_PHASE_INCREMENT);
+          float inverse_dt = 1.0f / dt;
+          float t = phases_[v] + dt;
+          t -= (t >= 1.0f) ? 1.0f : 0.0f;
+          phases_[v] = t;
+
+          // A rising step at phase 0 and a falling one at the pulse width
+          float width = fminf(fmaxf(pulse_width + width_modulation[v], MIN_PULSE_WIDTH),
+                              MAX_PULSE_WIDTH);
+          float t2 = t - width;
+          t2 += (t2 < 0.0f) ? 1.0f : 0.0f;
+          float naive = (t < width) ? 1.0f : -1.0f;
+
+          float value = (naive + polyBlep(t, dt, inverse_dt) - polyBlep(t2, dt, inverse_dt))
+                        * voice_levels_[v];
+          left[v] += value;
+          right[v] += value;
+        }
+        break;
+      }
+
+      case WAVEFORM_TRIANGLE:
+        for (int v = 0; v < num_lanes; v++) {
+          float dt = fminf(fmaxf(phase_increments_[v] * pitch[v], MIN_PHASE_INCREMENT),
+                           MAX_PHASE_INCREMENT);
+          float inverse_dt = 1.0f / dt;
+          float t = phases_[v] + dt;
+          t -= (t >= 1.0f) ? 1.0f : 0.0f;
+          phases_[v] = t;
+
+          // The slope is 4 per cycle, so it changes by 8 * dt per sample at each corner: upwards
+          // at phase 0 and downwards at phase 0.5
+          float t2 = t - 0.5f;
+          t2 += (t2 < 0.0f) ? 1.0f : 0.0f;
+          float naive = 1.0f - 4.0f * fabsf(t - 0.5f);
+          float correction = 8.0f * dt *
+                             (polyBlamp(t, dt, inverse_dt) - polyBlamp(t2, dt, inverse_dt));
+
+          float value = (naive + correction) * voice_levels_[v];
+          left[v] += value;
+          right[v] += value;
+        }
+        break;
+    }
+  }
+}
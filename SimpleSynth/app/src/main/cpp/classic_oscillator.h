@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_CLASSIC_OSCILLATOR_H
+#define SIMPLESYNTH_CLASSIC_OSCILLATOR_H
+
+#include "audio_common.h"
+
+enum Waveform {
+  WAVEFORM_SAW,
+  WAVEFORM_PULSE,
+  WAVEFORM_TRIANGLE
+};
+
+/**
+ * Band limited saw, pulse and triangle oscillators for every voice.
+ *
+ * Rather than storing a band limited table per waveform, the naive waveform is computed directly
+ * and the samples either side of each discontinuity are corrected with a polynomial residual:
+ * PolyBLEP for the jumps in the saw and pulse, and PolyBLAMP for the corners of the triangle.
+ * The residuals are computed for every sample and masked off away from the discontinuities, so
+ * the inner loops have no data dependent branches.
+ *
+ * Like the filter, all voices are processed together with the inner loop running across voice
+ * lanes, so the phase advance and the corrections run SIMD_WIDTH voices at a time.
+ */
+class ClassicOscillator {
+
+public:
+  ClassicOscillator(int frame_rate);
+
+  void setWaveform(Waveform waveform);
+
+  // Fraction of the cycle the pulse is high for, from 0 to 1
+  void setPulseWidth(float pulse_width);
+
+  void setFrequency(int lane, float frequency_hz);
+
+  // Gain of a voice, 0 silences it
+  void setVoiceLevel(int lane, float level);
+
+  void resetVoice(int lane);
+
+  /**
+   * Render a block for every voice, adding it to the output buffers. All buffers use the lane
+   * layout described in audio_common.h.
+   *
+   * @param pitch_modulation frequency multiplier for each voice and frame
+   * @param pulse_width_modulation amount added to the pulse width for each voice and frame
+   */
+  void render(const float *pitch_modulation,
+              const float *pulse_width_modulation,
+              float *left_buffer,
+              float *right_buffer,
+              int num_lanes,
+              int num_frames);
+
+private:
+  int frame_rate_;
+  Waveform waveform_ = WAVEFORM_SAW;
+  float pulse_width_ = 0.5f;
+
+  float phase_increments_[MAX_VOICES];
+  float voice_levels_[MAX_VOICES];
+  float phases_[MAX_VOICES];
+};
+
+#endif //SIMPLESYNTH_CLASSIC_OSCILLATOR_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include "fft.h"
+
+Fft::Fft(int size) :
+    size_(size) {
+
+  assert(size >= 2 && size <= MAX_FFT_SIZE && (size & (size - 1)) == 0);
+
+  int bits = 0;
+  while ((1 << bits) < size) bits++;
+
+  for (int i = 0; i < size; i++) {
+    int reversed = 0;
+    for (int b = 0; b < bits; b++) {
+      if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+    }
+    bit_reversal_[i] = reversed;
+  }
+
+  for (int i = 0; i < size / 2; i++) {
+    double angle = 2.0 * M_PI * i / size;
+    cos_table_[i] = (float) cos(angle);
+    sin_table_[i] = (float) sin(angle);
+  }
+}
+
+void Fft::forward(float *real, float *imaginary) const {
+  transform(real, imaginary, -1.0f);
+}
+
+void Fft::inverse(float *real, float *imaginary) const {
+  transform(real, imaginary, 1.0f);
+  float scale = 1.0f / size_;
+  for (int i = 0; i < size_; i++) {
+    real[i] *= scale;
+    imaginary[i] *= scale;
+  }
+}
+
+void Fft::transform(float *real, float *imaginary, float direction) const {
+
+  for (int i = 0; i < size_; i++) {
+    int j = bit_reversal_[i];
+    if (j > i) {
+      float temp_real = real[i];
+      float temp_imaginary = imaginary[i];
+      real[i] = real[j];
+      imaginary[i] = imaginary[j];
+      real[j] = temp_real;
+      imaginary[j] = temp_imaginary;
+    }
+  }
+
+  for (int length = 2; length <= size_; length <<= 1) {
+    int half_length = length >> 1;
+    int table_stride = size_ / length;
+    for (int start = 0; start < size_; start += length) {
+      for (int k = 0; k < half_length; k++) {
+        float w_real = cos_table_[k * table_stride];
+        float w_imaginary = direction * sin_table_[k * table_stride];
+        int even = start + k;
+        int odd = even + half_length;
+        float odd_real = real[odd] * w_real - imaginary[odd] * w_imaginary;
+        float odd_imaginary = real[odd] * w_imaginary + imaginary[odd] * w_real;
+        real[odd] = real[even] - odd_real;
+        imaginary[odd] = imaginary[even] - odd_imaginary;
+        real[even] += odd_real;
+        imaginary[even] += odd_imaginary;
+      }
+    }
+  }
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_FFT_H
+#define SIMPLESYNTH_FFT_H
+
+#define MAX_FFT_SIZE 4096
+
+/**
+ * An in-place radix-2 complex FFT. The twiddle factors and bit reversal table are computed in the
+ * constructor so that forward and inverse don't call any trig functions.
+ */
+class Fft {
+
+public:
+  // size must be a power of 2, no larger than MAX_FFT_SIZE
+  Fft(int size);
+
+  int getSize() const { return size_; }
+
+  void forward(float *real, float *imaginary) const;
+
+  // The inverse is scaled by 1/size so that inverse(forward(x)) == x
+  void inverse(float *real, float *imaginary) const;
+
+private:
+  void transform(float *real, float *imaginary, float direction) const;
+
+  int size_;
+  int bit_reversal_[MAX_FFT_SIZE];
+
+  // Only the first half of the unit circle is needed, the stage loops stride through it
+  float cos_table_[MAX_FFT_SIZE / 2];
+  float sin_table_[MAX_FFT_SIZE / 2];
+};
+
+#endif //SIMPLESYNTH_FFT_H
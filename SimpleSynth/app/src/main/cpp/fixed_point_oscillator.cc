@@ -0,0 +1,181 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fixed_point_oscillator.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FIXED_POINT_USE_NEON 1
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define FIXED_POINT_USE_SSSE3 1
+#endif
+
+// sin(pi/2 * x) / 2 for x from -1 to 1 is x * (C1 + x^2 * (C3 + x^2 * (C5 + x^2 * C7))), with the
+// coefficients in Q15. They are a least squares fit, accurate to about 1e-6 before rounding.
+#define SINE_C1 25736
+#define SINE_C3 -10582
+#define SINE_C5 1301
+#define SINE_C7 -71
+#define QUARTER_CYCLE 16384
+
+#define PHASE_SCALE 4294967296.0
+
+FixedPointOscillator::FixedPointOscillator(int frame_rate) :
+    frame_rate_(frame_rate) {
+
+  for (int v = 0; v < MAX_VOICES; v++) {
+    phases_[v] = 0;
+    phase_increments_[v] = 0;
+  }
+}
+
+void FixedPointOscillator::setFrequency(int lane, float frequency_hz) {
+  phase_increments_[lane] = (uint32_t) ((double) frequency_hz / frame_rate_ * PHASE_SCALE);
+}
+
+void FixedPointOscillator::resetVoice(int lane) {
+  phases_[lane] = 0;
+}
+
+#if FIXED_POINT_USE_NEON
+
+static void renderVoice(uint32_t phase, uint32_t increment, int16_t gain, int16_t *mix,
+                        int num_vectors) {
+
+  const uint32_t first_phases[4] = {phase, phase + increment, phase + 2 * increment,
+                                    phase + 3 * increment};
+  uint32x4_t phases_low = vld1q_u32(first_phases);
+  uint32x4_t phases_high = vaddq_u32(phases_low, vdupq_n_u32(4 * increment));
+  const uint32x4_t step = vdupq_n_u32(FIXED_POINT_VECTOR_FRAMES * increment);
+
+  for (int n = 0; n < num_vectors; n++) {
+    // The top 16 bits as a signed value, so -0.5 to 0.5 of a cycle
+    int16x8_t t = vcombine_s16(vshrn_n_s32(vreinterpretq_s32_u32(phases_low), 16),
+                               vshrn_n_s32(vreinterpretq_s32_u32(phases_high), 16));
+
+    // Fold onto -0.25 to 0.25 of a cycle. -32768 - t wraps to the right answer on both sides.
+    int16x8_t folded = vsubq_s16(vdupq_n_s16(INT16_MIN), t);
+    uint16x8_t is_outside = vorrq_u16(vcgtq_s16(t, vdupq_n_s16(QUARTER_CYCLE)),
+                                      vcltq_s16(t, vdupq_n_s16(-QUARTER_CYCLE)));
+    t = vbslq_s16(is_outside, folded, t);
+
+    int16x8_t x = vqshlq_n_s16(t, 1);
+    int16x8_t x2 = vqrdmulhq_s16(x, x);
+    int16x8_t p = vqaddq_s16(vqrdmulhq_n_s16(x2, SINE_C7), vdupq_n_s16(SINE_C5));
+    p = vqaddq_s16(vqrdmulhq_s16(p, x2), vdupq_n_s16(SINE_C3));
+    p = vqaddq_s16(vqrdmulhq_s16(p, x2), vdupq_n_s16(SINE_C1));
+    int16x8_t sine = vqshlq_n_s16(vqrdmulhq_s16(p, x), 1);
+
+    int16x8_t output = vqaddq_s16(vld1q_s16(mix), vqrdmulhq_n_s16(sine, gain));
+    vst1q_s16(mix, output);
+    mix += FIXED_POINT_VECTOR_FRAMES;
+
+    phases_low = vaddq_u32(phases_low, step);
+    phases_high = vaddq_u32(phases_high, step);
+  }
+}
+
+#elif FIXED_POINT_USE_SSSE3
+
+static void renderVoice(uint32_t phase, uint32_t increment, int16_t gain, int16_t *mix,
+                        int num_vectors) {
+
+  __m128i phases_low = _mm_set_epi32((int32_t) (phase + 3 * increment),
+                                     (int32_t) (phase + 2 * increment),
+                                     (int32_t) (phase + increment),
+                                     (int32_t) phase);
+  __m128i phases_high = _mm_add_epi32(phases_low, _mm_set1_epi32((int32_t) (4 * increment)));
+  const __m128i step = _mm_set1_epi32((int32_t) (FIXED_POINT_VECTOR_FRAMES * increment));
+  const __m128i gains = _mm_set1_epi16(gain);
+
+  for (int n = 0; n < num_vectors; n++) {
+    // The top 16 bits as a signed value, so -0.5 to 0.5 of a cycle. They always fit, so the
+    // saturating pack is exact.
+    __m128i t = _mm_packs_epi32(_mm_srai_epi32(phases_low, 16), _mm_srai_epi32(phases_high, 16));
+
+    // Fold onto -0.25 to 0.25 of a cycle. -32768 - t wraps to the right answer on both sides.
+    __m128i folded = _mm_sub_epi16(_mm_set1_epi16(INT16_MIN), t);
+    __m128i is_outside = _mm_or_si128(_mm_cmpgt_epi16(t, _mm_set1_epi16(QUARTER_CYCLE)),
+                                      _mm_cmplt_epi16(t, _mm_set1_epi16(-QUARTER_CYCLE)));
+    t = _mm_or_si128(_mm_and_si128(is_outside, folded), _mm_andnot_si128(is_outside, t));
+
+    __m128i x = _mm_adds_epi16(t, t);
+    __m128i x2 = _mm_mulhrs_epi16(x, x);
+    __m128i p = _mm_adds_epi16(_mm_mulhrs_epi16(x2, _mm_set1_epi16(SINE_C7)),
+                               _mm_set1_epi16(SINE_C5));
+    p = _mm_adds_epi16(_mm_mulhrs_epi16(p, x2), _mm_set1_epi16(SINE_C3));
+    p = _mm_adds_epi16(_mm_mulhrs_epi16(p, x2), _mm_set1_epi16(SINE_C1));
+    __m128i half_sine = _mm_mulhrs_epi16(p, x);
+    __m128i sine = _mm_adds_epi16(half_sine, half_sine);
+
+    __m128i *mix_vector = (__m128i *) mix;
+    _mm_storeu_si128(mix_vector,
+                     _mm_adds_epi16(_mm_loadu_si128(mix_vector), _mm_mulhrs_epi16(sine, gains)));
+    mix += FIXED_POINT_VECTOR_FRAMES;
+
+    phases_low = _mm_add_epi32(phases_low, step);
+    phases_high = _mm_add_epi32(phases_high, step);
+  }
+}
+
+#else
+
+static inline int16_t saturate(int32_t value) {
+  if (value > INT16_MAX) return INT16_MAX;
+  if (value < INT16_MIN) return INT16_MIN;
+  return (int16_t) value;
+}
+
+// Q15 multiply with rounding, as vqrdmulh and pmulhrsw do it
+static inline int16_t multiply(int16_t a, int16_t b) {
+  return saturate(((int32_t) a * b + (1 << 14)) >> 15);
+}
+
+static void renderVoice(uint32_t phase, uint32_t increment, int16_t gain, int16_t *mix,
+                        int num_vectors) {
+
+  for (int i = 0; i < num_vectors * FIXED_POINT_VECTOR_FRAMES; i++) {
+    int16_t t = (int16_t) (phase >> 16);
+    if (t > QUARTER_CYCLE || t < -QUARTER_CYCLE) t = (int16_t) (INT16_MIN - t);
+
+    int16_t x = saturate(2 * t);
+    int16_t x2 = multiply(x, x);
+    int16_t p = saturate(multiply(x2, SINE_C7) + SINE_C5);
+    p = saturate(multiply(p, x2) + SINE_C3);
+    p = saturate(multiply(p, x2) + SINE_C1);
+    int16_t sine = saturate(2 * multiply(p, x));
+
+    mix[i] = saturate(mix[i] + multiply(sine, gain));
+    phase += increment;
+  }
+}
+
+#endif
+
+void FixedPointOscillator::render(const int *voices,
+                                  int num_voices,
+                                  const int16_t *gains,
+                                  int16_t *mix,
+                                  int num_frames) {
+
+  int num_vectors = roundUpToFixedPointVector(num_frames) / FIXED_POINT_VECTOR_FRAMES;
+  for (int i = 0; i < num_voices; i++) {
+    int v = voices[i];
+    renderVoice(phases_[v], phase_increments_[v], gains[v], mix, num_vectors);
+    phases_[v] += phase_increments_[v] * (uint32_t) num_frames;
+  }
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_FIXED_POINT_OSCILLATOR_H
+#define SIMPLESYNTH_FIXED_POINT_OSCILLATOR_H
+
+#include <stdint.h>
+#include "audio_common.h"
+
+// Frames computed per vector, a block of any length is padded up to a multiple of this
+#define FIXED_POINT_VECTOR_FRAMES 8
+
+inline int roundUpToFixedPointVector(int num_frames) {
+  return (num_frames + FIXED_POINT_VECTOR_FRAMES - 1) & ~(FIXED_POINT_VECTOR_FRAMES - 1);
+}
+
+/**
+ * Sine voices computed entirely in integer arithmetic, for devices whose float SIMD is weak.
+ *
+ * Phases are unsigned 32 bit accumulators which wrap once per cycle, so frequency resolution is
+ * the same as the float path. The top 16 bits of the phase are folded onto a quarter cycle and a
+ * 7th order polynomial is evaluated in Q15. The voice gain and the mix use saturating Q15
+ * arithmetic, so a loud chord clips rather than wraps, just like the int16 output of the float
+ * path.
+ *
+ * Each voice is rendered FIXED_POINT_VECTOR_FRAMES frames at a time, using NEON or SSSE3
+ * saturating intrinsics where available and portable C otherwise.
+ */
+class FixedPointOscillator {
+
+public:
+  FixedPointOscillator(int frame_rate);
+
+  void setFrequency(int lane, float frequency_hz);
+
+  void resetVoice(int lane);
+
+  /**
+   * Render some voices and add them into a mono Q15 mix, with saturation.
+   *
+   * @param voices the lanes of the voices to render
+   * @param gains Q15 gain for each lane
+   * @param mix Q15 buffer with room for roundUpToFixedPointVector(num_frames) frames, the frames
+   * past num_frames are overwritten with junk
+   */
+  void render(const int *voices,
+              int num_voices,
+              const int16_t *gains,
+              int16_t *mix,
+              int num_frames);
+
+private:
+  int frame_rate_;
+  uint32_t phases_[MAX_VOICES];
+  uint32_t phase_increments_[MAX_VOICES];
+};
+
+#endif //SIMPLESYNTH_FIXED_POINT_OSCILLATOR_H
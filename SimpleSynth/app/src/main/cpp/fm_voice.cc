@@ -0,0 +1,173 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include "fm_voice.h"
+
+#define TWO_PI_F 6.2831853f
+
+// Phase offset in cycles produced by a modulator at full level, roughly a modulation index of 4π
+#define MAX_MODULATION_CYCLES 2.0f
+
+// Phase offset in cycles produced by full feedback, any more than this turns into noise
+#define MAX_FEEDBACK_CYCLES 0.25f
+
+// Bit masks, bit n set means operator n
+struct FmAlgorithm {
+  int modulators[NUM_FM_OPERATORS];
+  int carriers;
+};
+
+static const FmAlgorithm kAlgorithms[NUM_FM_ALGORITHMS] = {
+    {{0x2, 0x4, 0x8, 0x0}, 0x1},  // 3 > 2 > 1 > 0
+    {{0x2, 0xC, 0x0, 0x0}, 0x1},  // (2 + 3) > 1 > 0
+    {{0xA, 0x4, 0x0, 0x0}, 0x1},  // (2 > 1) + 3 > 0
+    {{0x6, 0x0, 0x8, 0x0}, 0x1},  // (3 > 2) + 1 > 0
+    {{0x2, 0x0, 0x8, 0x0}, 0x5},  // 1 > 0, 3 > 2
+    {{0x8, 0x8, 0x8, 0x0}, 0x7},  // 3 > (0, 1, 2)
+    {{0x0, 0x0, 0x8, 0x0}, 0x7},  // 3 > 2, 1, 0
+    {{0x0, 0x0, 0x0, 0x0}, 0xF},  // 0, 1, 2, 3
+};
+
+FmVoice::FmVoice(int frame_rate) :
+    frame_rate_(frame_rate) {
+
+  for (int i = 0; i <= SINE_TABLE_SIZE; i++) {
+    sine_table_[i] = sinf(TWO_PI_F * i / SINE_TABLE_SIZE);
+  }
+  for (int op = 0; op < NUM_FM_OPERATORS; op++) {
+    operator_ratios_[op] = 1.0f;
+    operator_levels_[op] = (op == 0) ? 1.0f : 0.0f;
+  }
+  for (int v = 0; v < MAX_VOICES; v++) {
+    phase_increments_[v] = 0;
+    voice_levels_[v] = 0;
+    resetVoice(v);
+  }
+}
+
+void FmVoice::setAlgorithm(int algorithm) {
+  if (algorithm >= 0 && algorithm < NUM_FM_ALGORITHMS) algorithm_ = algorithm;
+}
+
+void FmVoice::setFeedback(float feedback) {
+  feedback_ = fminf(fmaxf(feedback, 0.0f), 1.0f);
+}
+
+void FmVoice::setOperatorRatio(int op, float ratio) {
+  if (op >= 0 && op < NUM_FM_OPERATORS) operator_ratios_[op] = fmaxf(ratio, 0.0f);
+}
+
+void FmVoice::setOperatorLevel(int op, float level) {
+  if (op >= 0 && op < NUM_FM_OPERATORS) operator_levels_[op] = fminf(fmaxf(level, 0.0f), 1.0f);
+}
+
+void FmVoice::setFrequency(int lane, float frequency_hz) {
+  phase_increments_[lane] = frequency_hz / frame_rate_;
+}
+
+void FmVoice::setVoiceLevel(int lane, float level) {
+  voice_levels_[lane] = level;
+}
+
+void FmVoice::resetVoice(int lane) {
+
+  for (int op = 0; op < NUM_FM_OPERATORS; op++) {
+    phases_[op][lane] = 0;
+    outputs_[op][lane] = 0;
+  }
+  feedback_history_[lane] = 0;
+}
+
+void FmVoice::render(const float *pitch_modulation,
+                     float *left_buffer,
+                     float *right_buffer,
+                     int num_lanes,
+                     int num_frames) {
+
+  assert(num_lanes <= MAX_VOICES && num_frames <= MAX_BLOCK_FRAMES);
+
+  // Read the settings once per block so that a change from the UI applies to a whole block
+  const FmAlgorithm &algorithm = kAlgorithms[algorithm_];
+  const float feedback_scale = feedback_ * MAX_FEEDBACK_CYCLES * 0.5f;
+  float ratios[NUM_FM_OPERATORS];
+  float modulation_scales[NUM_FM_OPERATORS];
+  float carrier_gains[NUM_FM_OPERATORS];
+  int num_carriers = 0;
+  for (int op = 0; op < NUM_FM_OPERATORS; op++) {
+    if (algorithm.carriers & (1 << op)) num_carriers++;
+  }
+  for (int op = 0; op < NUM_FM_OPERATORS; op++) {
+    float level = operator_levels_[op];
+    ratios[op] = operator_ratios_[op];
+    modulation_scales[op] = level * MAX_MODULATION_CYCLES;
+    // Carriers are scaled so that all the algorithms sound about equally loud
+    carrier_gains[op] = (algorithm.carriers & (1 << op)) ? level / num_carriers : 0.0f;
+  }
+
+  for (int i = 0; i < num_frames; i++) {
+
+    const float *pitch = pitch_modulation + i * num_lanes;
+
+    for (int op = NUM_FM_OPERATORS - 1; op >= 0; op--) {
+
+      // Sum the modulators of this operator, already scaled to a phase offset in cycles
+      if (op == NUM_FM_OPERATORS - 1) {
+        for (int v = 0; v < num_lanes; v++) {
+          float previous = outputs_[op][v];
+          modulation_[v] = (previous + feedback_history_[v]) * feedback_scale;
+          feedback_history_[v] = previous;
+        }
+      } else {
+        for (int v = 0; v < num_lanes; v++) modulation_[v] = 0;
+      }
+      for (int m = op + 1; m < NUM_FM_OPERATORS; m++) {
+        if (!(algorithm.modulators[op] & (1 << m))) continue;
+        for (int v = 0; v < num_lanes; v++) {
+          modulation_[v] += outputs_[m][v] * modulation_scales[m];
+        }
+      }
+
+      float *phases = phases_[op];
+      float *outputs = outputs_[op];
+      const float ratio = ratios[op];
+      for (int v = 0; v < num_lanes; v++) {
+        float x = (phases[v] + modulation_[v]) * SINE_TABLE_SIZE;
+        float floor_x = floorf(x);
+        float fraction = x - floor_x;
+        int index = ((int) floor_x) & (SINE_TABLE_SIZE - 1);
+        float a = sine_table_[index];
+        outputs[v] = a + fraction * (sine_table_[index + 1] - a);
+
+        float phase = phases[v] + phase_increments_[v] * ratio * pitch[v];
+        phases[v] = phase - floorf(phase);
+      }
+    }
+
+    float *left = left_buffer + i * num_lanes;
+    float *right = right_buffer + i * num_lanes;
+    for (int op = 0; op < NUM_FM_OPERATORS; op++) {
+      if (!(algorithm.carriers & (1 << op))) continue;
+      const float gain = carrier_gains[op];
+      for (int v = 0; v < num_lanes; v++) {
+        float value = outputs_[op][v] * gain * voice_levels_[v];
+        left[v] += value;
+        right[v] += value;
+      }
+    }
+  }
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_FM_VOICE_H
+#define SIMPLESYNTH_FM_VOICE_H
+
+#include "audio_common.h"
+
+#define NUM_FM_OPERATORS 4
+#define NUM_FM_ALGORITHMS 8
+#define SINE_TABLE_BITS 10
+#define SINE_TABLE_SIZE (1 << SINE_TABLE_BITS)
+
+/**
+ * A 4 operator FM (phase modulation) voice bank with the 8 classic 4 operator algorithms.
+ *
+ * Operators are numbered from 0 and an operator is only ever modulated by operators with a higher
+ * number, so rendering them from the highest to the lowest always has the modulators ready.
+ * Operator 3 can modulate itself through the feedback control.
+ *
+ * The operator state is stored as one array per operator indexed by voice lane, so each operator
+ * is rendered for every voice in a single loop across lanes. The sine is read from a table with
+ * linear interpolation.
+ *
+ * The carrier frequency comes from setFrequency, which the synth drives from its wave frequency,
+ * and the output goes through the synth's volume like every other voice type.
+ */
+class FmVoice {
+
+public:
+  FmVoice(int frame_rate);
+
+  // Algorithm from 0 (all operators in series) to NUM_FM_ALGORITHMS - 1 (all carriers)
+  void setAlgorithm(int algorithm);
+
+  // Self modulation of operator 3 from 0 to 1
+  void setFeedback(float feedback);
+
+  // Operator frequency as a multiple of the voice frequency
+  void setOperatorRatio(int op, float ratio);
+
+  // Output level of an operator from 0 to 1. For a modulator this sets the modulation index.
+  void setOperatorLevel(int op, float level);
+
+  void setFrequency(int lane, float frequency_hz);
+
+  // Gain of a voice, 0 silences it
+  void setVoiceLevel(int lane, float level);
+
+  // Restart the operators of a voice, so that each note starts from the same phase
+  void resetVoice(int lane);
+
+  /**
+   * Render a block for every voice, adding it to the output buffers. The buffers use the lane
+   * layout described in audio_common.h.
+   *
+   * @param pitch_modulation frequency multiplier for each voice and frame
+   */
+  void render(const float *pitch_modulation,
+              float *left_buffer,
+              float *right_buffer,
+              int num_lanes,
+              int num_frames);
+
+private:
+  int frame_rate_;
+  int algorithm_ = 0;
+  float feedback_ = 0;
+  float operator_ratios_[NUM_FM_OPERATORS];
+  float operator_levels_[NUM_FM_OPERATORS];
+
+  float phase_increments_[MAX_VOICES];
+  float voice_levels_[MAX_VOICES];
+
+  // Operator state, one array per operator. Phases are in cycles from 0 to 1.
+  float phases_[NUM_FM_OPERATORS][MAX_VOICES];
+  float outputs_[NUM_FM_OPERATORS][MAX_VOICES];
+
+  // The last two outputs of operator 3, averaged for the feedback path
+  float feedback_history_[MAX_VOICES];
+
+  float modulation_[MAX_VOICES];
+
+  // One extra entry so that the interpolation never has to wrap
+  float sine_table_[SINE_TABLE_SIZE + 1];
+};
+
+#endif //SIMPLESYNTH_FM_VOICE_H
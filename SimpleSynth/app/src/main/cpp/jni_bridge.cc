@@ -20,6 +20,8 @@
 #include "audio_player.h"
 #include "synthesizer.h"
 #include "load_stabilizer.h"
+#include "midi_file_player.h"
+#include "sinad.h"
 #include "android_log.h"
 
 // OpenSL ES interfaces
@@ -29,10 +31,17 @@ static SLObjectItf sl_output_mix_object_itf = nullptr;
 
 static LoadStabilizer *load_stabilizer;
 static Synthesizer *synth;
+static MidiFilePlayer *midi_file_player;
 static AudioPlayer *player;
 static int api_level;
 
 #define NUM_AUDIO_CHANNELS 2 // 1 = mono, 2 = stereo
+#define BENCHMARK_FRAMES_PER_BUFFER 192
+#define BENCHMARK_QUALITY_SECONDS 1
+#define BENCHMARK_SETTLE_SECONDS 0.1
+#define BENCHMARK_SPEED_SECONDS 10
+#define BENCHMARK_FIRST_NOTE 69
+#define BENCHMARK_A4_FREQUENCY 440.0f
 
 extern "C" {
 
@@ -97,7 +106,8 @@ JNIEXPORT jobject JNICALL Java_com_example_simplesynth_MainActivity_native_1crea
   synth = new Synthesizer(format.num_audio_channels, format.frame_rate);
 
   int64_t callback_period_ns = ((int64_t)format.frames_per_buffer * NANOS_IN_SECOND) / format.frame_rate;
-  load_stabilizer = new LoadStabilizer(synth, callback_period_ns);
+  midi_file_player = new MidiFilePlayer(synth, format.num_audio_channels, format.frame_rate);
+  load_stabilizer = new LoadStabilizer(midi_file_player, callback_period_ns);
 
   player = new AudioPlayer(sl_engine_engine_itf,
                            sl_output_mix_object_itf,
@@ -136,6 +146,185 @@ JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1noteOff
   synth->noteOff();
 }
 
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1sendMidi(
+    JNIEnv *env,
+    jclass clazz,
+    jbyteArray data,
+    jint offset,
+    jint count,
+    jlong timestamp){
+
+  // The arguments match MidiReceiver.onSend, whose timestamps use System.nanoTime()
+  if (data == nullptr || offset < 0 || count <= 0 || offset + count > env->GetArrayLength(data)){
+    return;
+  }
+  jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+  synth->sendMidi((const uint8_t *) bytes + offset, (int) count,
+                  (timestamp > 0) ? (int64_t) timestamp : get_time());
+  env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+}
+
+JNIEXPORT jboolean JNICALL Java_com_example_simplesynth_MainActivity_native_1loadMidiFile(
+    JNIEnv *env,
+    jclass clazz,
+    jbyteArray data){
+
+  if (data == nullptr) return JNI_FALSE;
+  jsize size = env->GetArrayLength(data);
+  jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+  bool is_loaded = midi_file_player->load((const uint8_t *) bytes, (size_t) size);
+  env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+  return (jboolean) is_loaded;
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1playMidiFile(
+    JNIEnv *env,
+    jclass clazz){
+  midi_file_player->play();
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1stopMidiFile(
+    JNIEnv *env,
+    jclass clazz){
+  midi_file_player->stop();
+}
+
+/**
+ * Render a MIDI file offline, as fast as possible, on a separate synth. Returns how many times
+ * faster than real-time the render ran, or 0 if the file couldn't be loaded.
+ */
+JNIEXPORT jfloat JNICALL Java_com_example_simplesynth_MainActivity_native_1benchmarkMidiFile(
+    JNIEnv *env,
+    jclass clazz,
+    jbyteArray data,
+    jint frame_rate,
+    jint voice_type){
+
+  if (data == nullptr) return 0;
+  Synthesizer *offline_synth = new Synthesizer(NUM_AUDIO_CHANNELS, (int) frame_rate);
+  offline_synth->setVoiceType((VoiceType) voice_type);
+  MidiFilePlayer *offline_player =
+      new MidiFilePlayer(offline_synth, NUM_AUDIO_CHANNELS, (int) frame_rate);
+
+  jsize size = env->GetArrayLength(data);
+  jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+  bool is_loaded = offline_player->load((const uint8_t *) bytes, (size_t) size);
+  env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+
+  float speed = 0;
+  if (is_loaded){
+    int16_t buffer[BENCHMARK_FRAMES_PER_BUFFER * NUM_AUDIO_CHANNELS];
+    int64_t frames_rendered = 0;
+    offline_player->play();
+    int64_t start_time = get_time();
+    while (offline_player->isPlaying()){
+      offline_player->render(BENCHMARK_FRAMES_PER_BUFFER * NUM_AUDIO_CHANNELS, buffer);
+      frames_rendered += BENCHMARK_FRAMES_PER_BUFFER;
+    }
+    int64_t elapsed_ns = get_time() - start_time;
+    float audio_seconds = (float) frames_rendered / frame_rate;
+    speed = (elapsed_ns > 0) ? audio_seconds * NANOS_IN_SECOND / elapsed_ns : 0;
+    LOGI("Rendered %.1f seconds of MIDI file in %.1f ms, %.1fx real-time",
+         audio_seconds, elapsed_ns / 1e6, speed);
+  }
+
+  delete offline_player;
+  delete offline_synth;
+  return speed;
+}
+
+/**
+ * Play notes from A4 upwards with sine voices on a new synth, optionally keeping the first
+ * channel of the output. Returns how long the render took.
+ */
+static int64_t renderSineBenchmark(int frame_rate,
+                                   bool is_fixed_point,
+                                   int num_notes,
+                                   int num_buffers,
+                                   int16_t *capture){
+
+  Synthesizer *offline_synth = new Synthesizer(NUM_AUDIO_CHANNELS, frame_rate);
+  offline_synth->setVoiceType(VOICE_TYPE_SINE);
+  offline_synth->setFixedPointEnabled(is_fixed_point);
+
+  // The fixed point path has no filter, so the float one runs without it too
+  offline_synth->setFilterEnabled(false);
+  for (int i = 0; i < num_notes; i++){
+    MidiMessage message = {MIDI_NOTE_ON, (uint8_t) (BENCHMARK_FIRST_NOTE + i), 127};
+    offline_synth->scheduleMidi(message, 0);
+  }
+
+  int16_t buffer[BENCHMARK_FRAMES_PER_BUFFER * NUM_AUDIO_CHANNELS];
+  int64_t start_time = get_time();
+  for (int b = 0; b < num_buffers; b++){
+    offline_synth->render(BENCHMARK_FRAMES_PER_BUFFER * NUM_AUDIO_CHANNELS, buffer);
+    if (capture != nullptr){
+      for (int i = 0; i < BENCHMARK_FRAMES_PER_BUFFER; i++){
+        capture[b * BENCHMARK_FRAMES_PER_BUFFER + i] = buffer[i * NUM_AUDIO_CHANNELS];
+      }
+    }
+  }
+  int64_t elapsed_ns = get_time() - start_time;
+
+  delete offline_synth;
+  return elapsed_ns;
+}
+
+/**
+ * Compare the fixed point render path with the float one, both without a filter. Quality is the
+ * SINAD of a single A4, speed is how many times faster than real-time a full chord of sine voices
+ * renders. Returns the fixed point speed divided by the float speed, the rest is logged.
+ */
+JNIEXPORT jfloat JNICALL Java_com_example_simplesynth_MainActivity_native_1benchmarkFixedPoint(
+    JNIEnv *env,
+    jclass clazz,
+    jint frame_rate){
+
+  int quality_buffers = BENCHMARK_QUALITY_SECONDS * frame_rate / BENCHMARK_FRAMES_PER_BUFFER;
+  int settle_frames = (int) (BENCHMARK_SETTLE_SECONDS * frame_rate);
+  int speed_buffers = BENCHMARK_SPEED_SECONDS * frame_rate / BENCHMARK_FRAMES_PER_BUFFER;
+  int quality_frames = quality_buffers * BENCHMARK_FRAMES_PER_BUFFER;
+  int16_t *capture = new int16_t[quality_frames];
+
+  float speeds[2];
+  for (int is_fixed_point = 0; is_fixed_point < 2; is_fixed_point++){
+    renderSineBenchmark((int) frame_rate, is_fixed_point, 1, quality_buffers, capture);
+    float sinad = measureSineSinad(capture + settle_frames, quality_frames - settle_frames,
+                                   BENCHMARK_A4_FREQUENCY, (int) frame_rate);
+
+    int64_t elapsed_ns = renderSineBenchmark((int) frame_rate, is_fixed_point, SYNTH_POLYPHONY,
+                                             speed_buffers, nullptr);
+    speeds[is_fixed_point] = (elapsed_ns > 0) ?
+        (float) BENCHMARK_SPEED_SECONDS * NANOS_IN_SECOND / elapsed_ns : 0;
+    LOGI("%s path: SINAD %.1f dB, %d voices %.1fx real-time",
+         is_fixed_point ? "Fixed point" : "Float", sinad, SYNTH_POLYPHONY, speeds[is_fixed_point]);
+  }
+
+  delete[] capture;
+  return (speeds[0] > 0) ? speeds[1] / speeds[0] : 0;
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setFixedPointEnabled(
+    JNIEnv *env,
+    jclass clazz,
+    jboolean is_enabled){
+  synth->setFixedPointEnabled(is_enabled);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setMpeEnabled(
+    JNIEnv *env,
+    jclass clazz,
+    jboolean is_enabled){
+  synth->setMpeEnabled(is_enabled);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setMpePitchBendRange(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat semitones){
+  synth->setMpePitchBendRange((float) semitones);
+}
+
 JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setWorkCycles(
     JNIEnv *env,
     jclass clazz,
@@ -151,4 +340,227 @@ Java_com_example_simplesynth_MainActivity_native_1setLoadStabilizationEnabled(
   load_stabilizer->setStabilizationEnabled((bool) is_enabled);
 }
 
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setVoiceType(
+    JNIEnv *env,
+    jclass clazz,
+    jint voice_type){
+  synth->setVoiceType((VoiceType) voice_type);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setUnisonVoices(
+    JNIEnv *env,
+    jclass clazz,
+    jint voice_count){
+  synth->setUnisonVoices((int) voice_count);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setUnisonDetune(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat semitones){
+  synth->setUnisonDetune((float) semitones);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setUnisonSpread(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat spread){
+  synth->setUnisonSpread((float) spread);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setFmAlgorithm(
+    JNIEnv *env,
+    jclass clazz,
+    jint algorithm){
+  synth->setFmAlgorithm((int) algorithm);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setFmFeedback(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat feedback){
+  synth->setFmFeedback((float) feedback);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setFmOperator(
+    JNIEnv *env,
+    jclass clazz,
+    jint op,
+    jfloat ratio,
+    jfloat level){
+  synth->setFmOperator((int) op, (float) ratio, (float) level);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setAdditivePartialCount(
+    JNIEnv *env,
+    jclass clazz,
+    jint partial_count){
+  synth->setAdditivePartialCount((int) partial_count);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setAdditivePartial(
+    JNIEnv *env,
+    jclass clazz,
+    jint index,
+    jfloat ratio,
+    jfloat amplitude){
+  synth->setAdditivePartial((int) index, (float) ratio, (float) amplitude);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setNoiseColor(
+    JNIEnv *env,
+    jclass clazz,
+    jint color){
+  synth->setNoiseColor((NoiseColor) color);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setWaveform(
+    JNIEnv *env,
+    jclass clazz,
+    jint waveform){
+  synth->setWaveform((Waveform) waveform);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setPulseWidth(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat pulse_width){
+  synth->setPulseWidth((float) pulse_width);
+}
+
+/**
+ * Start loading a wavetable for the wavetable voices from a WAV file, see
+ * Synthesizer::loadWavetable. Returns false if a load is already in progress.
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_simplesynth_MainActivity_native_1loadWavetable(
+    JNIEnv *env,
+    jclass clazz,
+    jstring j_wav_path,
+    jstring j_cache_dir,
+    jint cycle_length){
+
+  if (j_wav_path == nullptr || j_cache_dir == nullptr) return JNI_FALSE;
+  const char *wav_path = env->GetStringUTFChars(j_wav_path, nullptr);
+  const char *cache_dir = env->GetStringUTFChars(j_cache_dir, nullptr);
+  bool is_started = synth->loadWavetable(wav_path, cache_dir, (int) cycle_length);
+  env->ReleaseStringUTFChars(j_wav_path, wav_path);
+  env->ReleaseStringUTFChars(j_cache_dir, cache_dir);
+  return (jboolean) is_started;
+}
+
+JNIEXPORT jint JNICALL Java_com_example_simplesynth_MainActivity_native_1getWavetableLoadState(
+    JNIEnv *env,
+    jclass clazz){
+  return (jint) synth->getWavetableLoadState();
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setWavetablePosition(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat position){
+  synth->setWavetablePosition((float) position);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setFilterCutoff(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat cutoff_hz){
+  synth->setFilterCutoff((float) cutoff_hz);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setFilterResonance(
+    JNIEnv *env,
+    jclass clazz,
+    jfloat resonance){
+  synth->setFilterResonance((float) resonance);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setFilterMode(
+    JNIEnv *env,
+    jclass clazz,
+    jint mode){
+  synth->setFilterMode((FilterMode) mode);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setParameterRate(
+    JNIEnv *env,
+    jclass clazz,
+    jint parameter,
+    jint rate){
+  synth->setParameterRate((SynthParameter) parameter, (ParameterRate) rate);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setLfoRate(
+    JNIEnv *env,
+    jclass clazz,
+    jint lfo,
+    jfloat rate_hz){
+  synth->setLfoRate((int) lfo, (float) rate_hz);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setLfoShape(
+    JNIEnv *env,
+    jclass clazz,
+    jint lfo,
+    jint shape){
+  synth->setLfoShape((int) lfo, (LfoShape) shape);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setModulationRoute(
+    JNIEnv *env,
+    jclass clazz,
+    jint slot,
+    jint source,
+    jint destination,
+    jfloat depth){
+  synth->setModulationRoute((int) slot,
+                            (ModulationSource) source,
+                            (ModulationDestination) destination,
+                            (float) depth);
+}
+
+JNIEXPORT void JNICALL Java_com_example_simplesynth_MainActivity_native_1setAutomation(
+    JNIEnv *env,
+    jclass clazz,
+    jint target,
+    jlongArray frames,
+    jfloatArray values,
+    jintArray curves,
+    jfloatArray controls_1,
+    jfloatArray controls_2){
+
+  // Passing null arrays clears the automation
+  Breakpoint breakpoints[MAX_BREAKPOINTS];
+  int count = 0;
+  if (frames != nullptr && values != nullptr && curves != nullptr &&
+      controls_1 != nullptr && controls_2 != nullptr){
+    count = env->GetArrayLength(frames);
+    if (count > MAX_BREAKPOINTS) count = MAX_BREAKPOINTS;
+    if (env->GetArrayLength(values) < count || env->GetArrayLength(curves) < count ||
+        env->GetArrayLength(controls_1) < count || env->GetArrayLength(controls_2) < count){
+      return;
+    }
+
+    jlong frame_values[MAX_BREAKPOINTS];
+    jfloat point_values[MAX_BREAKPOINTS];
+    jint curve_values[MAX_BREAKPOINTS];
+    jfloat control_1_values[MAX_BREAKPOINTS];
+    jfloat control_2_values[MAX_BREAKPOINTS];
+    env->GetLongArrayRegion(frames, 0, count, frame_values);
+    env->GetFloatArrayRegion(values, 0, count, point_values);
+    env->GetIntArrayRegion(curves, 0, count, curve_values);
+    env->GetFloatArrayRegion(controls_1, 0, count, control_1_values);
+    env->GetFloatArrayRegion(controls_2, 0, count, control_2_values);
+
+    for (int i = 0; i < count; i++){
+      breakpoints[i].frame = (int64_t) frame_values[i];
+      breakpoints[i].value = (float) point_values[i];
+      breakpoints[i].curve = (CurveType) curve_values[i];
+      breakpoints[i].control_1 = (float) control_1_values[i];
+      breakpoints[i].control_2 = (float) control_2_values[i];
+    }
+  }
+  synth->setAutomation((AutomationTarget) target, breakpoints, count);
+}
+
 } // end extern "C"
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_MIDI_EVENT_QUEUE_H
+#define SIMPLESYNTH_MIDI_EVENT_QUEUE_H
+
+#include <atomic>
+#include "midi_parser.h"
+
+// Must be a power of two
+#define MIDI_EVENT_QUEUE_CAPACITY 1024
+
+struct MidiEvent {
+  int64_t timestamp_ns;  // CLOCK_MONOTONIC, the same clock as get_time()
+  MidiMessage message;
+};
+
+/**
+ * A fixed size single producer, single consumer queue which passes MIDI events to the audio
+ * thread without locks or allocation. Events are stored by value in a ring buffer and the read
+ * and write indexes only ever increase, wrapping around the capacity when they are used.
+ */
+class MidiEventQueue {
+
+public:
+  // Producer side. Returns false if the queue is full, in which case the event is dropped.
+  bool push(const MidiEvent &event) {
+    uint32_t write_index = write_index_.load(std::memory_order_relaxed);
+    if (write_index - read_index_.load(std::memory_order_acquire) == MIDI_EVENT_QUEUE_CAPACITY) {
+      return false;
+    }
+    events_[write_index & (MIDI_EVENT_QUEUE_CAPACITY - 1)] = event;
+    write_index_.store(write_index + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Look at the oldest event without removing it.
+  bool peek(MidiEvent *event) const {
+    uint32_t read_index = read_index_.load(std::memory_order_relaxed);
+    if (read_index == write_index_.load(std::memory_order_acquire)) return false;
+    *event = events_[read_index & (MIDI_EVENT_QUEUE_CAPACITY - 1)];
+    return true;
+  }
+
+  // Consumer side. Remove the event returned by the last peek.
+  void pop() {
+    read_index_.store(read_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+private:
+  MidiEvent events_[MIDI_EVENT_QUEUE_CAPACITY];
+  std::atomic<uint32_t> write_index_ {0};
+  std::atomic<uint32_t> read_index_ {0};
+};
+
+#endif //SIMPLESYNTH_MIDI_EVENT_QUEUE_H
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "midi_file.h"
+#include "android_log.h"
+
+#define MIDI_META_EVENT 0xFF
+#define MIDI_META_END_OF_TRACK 0x2F
+#define MIDI_META_SET_TEMPO 0x51
+#define DEFAULT_MICROSECONDS_PER_QUARTER_NOTE 500000
+#define CHUNK_HEADER_SIZE 8
+
+static uint32_t readBigEndian(const uint8_t *data, int num_bytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < num_bytes; i++) value = (value << 8) | data[i];
+  return value;
+}
+
+/**
+ * Read a variable length quantity at data[*position], advancing the position past it.
+ *
+ * @return false if the quantity runs past the end of the data or is longer than four bytes
+ */
+static bool readVariableLength(const uint8_t *data, size_t size, size_t *position,
+                               uint32_t *value) {
+  *value = 0;
+  for (int i = 0; i < 4; i++) {
+    if (*position >= size) return false;
+    uint8_t byte = data[(*position)++];
+    *value = (*value << 7) | (byte & 0x7F);
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+/**
+ * The division is either ticks per quarter note, or with the top bit set, a SMPTE frame rate of
+ * 24, 25, 29 (for 29.97) or 30, stored negated in the top byte, and ticks per SMPTE frame.
+ */
+static bool isDivisionValid(int division) {
+  if (!(division & 0x8000)) return division != 0;
+  int smpte_rate = -(int8_t) (division >> 8);
+  return (division & 0xFF) != 0 &&
+         (smpte_rate == 24 || smpte_rate == 25 || smpte_rate == 29 || smpte_rate == 30);
+}
+
+bool MidiFile::load(const uint8_t *data, size_t size, int frame_rate) {
+
+  clear();
+
+  if (size < CHUNK_HEADER_SIZE + 6 || memcmp(data, "MThd", 4) != 0) {
+    LOGE("Not a standard MIDI file");
+    return false;
+  }
+  uint32_t header_length = readBigEndian(data + 4, 4);
+  if (header_length < 6 || header_length > size - CHUNK_HEADER_SIZE) {
+    LOGE("Malformed MIDI file header");
+    return false;
+  }
+  int format = (int) readBigEndian(data + 8, 2);
+  int num_tracks = (int) readBigEndian(data + 10, 2);
+  int division = (int) readBigEndian(data + 12, 2);
+  if (format > 1 || !isDivisionValid(division)) {
+    LOGE("Unsupported MIDI file, format %d, division %d", format, division);
+    return false;
+  }
+
+  // Unknown chunk types are skipped, as the specification requires
+  size_t position = CHUNK_HEADER_SIZE + header_length;
+  int tracks_read = 0;
+  while (tracks_read < num_tracks && size - position >= CHUNK_HEADER_SIZE) {
+    uint32_t chunk_length = readBigEndian(data + position + 4, 4);
+    if (chunk_length > size - position - CHUNK_HEADER_SIZE) {
+      LOGE("MIDI file chunk runs past the end of the file");
+      clear();
+      return false;
+    }
+    if (memcmp(data + position, "MTrk", 4) == 0) {
+      if (!parseTrack(data + position + CHUNK_HEADER_SIZE, chunk_length)) {
+        LOGE("Malformed MIDI file track %d", tracks_read);
+        clear();
+        return false;
+      }
+      tracks_read++;
+    }
+    position += CHUNK_HEADER_SIZE + chunk_length;
+  }
+
+  convertTicksToFrames(division, frame_rate);
+  return true;
+}
+
+bool MidiFile::parseTrack(const uint8_t *data, size_t size) {
+
+  size_t position = 0;
+  int64_t tick = 0;
+  uint8_t running_status = 0;
+
+  while (position < size) {
+    uint32_t delta;
+    if (!readVariableLength(data, size, &position, &delta)) return false;
+    tick += delta;
+    if (position >= size) return false;
+
+    uint8_t status = data[position];
+    if (status & 0x80) {
+      position++;
+    } else if (running_status != 0) {
+      status = running_status;
+    } else {
+      return false;
+    }
+
+    if (status == MIDI_META_EVENT) {
+      if (position >= size) return false;
+      uint8_t type = data[position++];
+      uint32_t length;
+      if (!readVariableLength(data, size, &position, &length)) return false;
+      if (length > size - position) return false;
+      if (type == MIDI_META_SET_TEMPO && length == 3) {
+        tempo_changes_.push_back({tick, (int) readBigEndian(data + position, 3)});
+      }
+      position += length;
+      running_status = 0;
+      if (type == MIDI_META_END_OF_TRACK) break;
+
+    } else if (status == MIDI_SYSEX_START || status == MIDI_SYSEX_END) {
+      uint32_t length;
+      if (!readVariableLength(data, size, &position, &length)) return false;
+      if (length > size - position) return false;
+      position += length;
+      running_status = 0;
+
+    } else if (status < MIDI_SYSEX_START) {
+      uint8_t type = (uint8_t) (status & 0xF0);
+      int num_data_bytes = (type == MIDI_PROGRAM_CHANGE || type == MIDI_CHANNEL_PRESSURE) ? 1 : 2;
+      if (size - position < (size_t) num_data_bytes) return false;
+      MidiMessage message = {status, data[position], 0};
+      if (num_data_bytes == 2) message.data_2 = data[position + 1];
+      position += num_data_bytes;
+      running_status = status;
+      track_events_.push_back({tick, message});
+
+    } else {
+      // System common and realtime messages aren't allowed in a file
+      return false;
+    }
+  }
+
+  length_ticks_ = std::max(length_ticks_, tick);
+  return true;
+}
+
+/**
+ * Merge the tracks into one time ordered list and convert ticks to frames. Events at the same
+ * tick keep their file order, so a note off followed by a note on for the same note still
+ * retriggers it.
+ */
+void MidiFile::convertTicksToFrames(int division, int frame_rate) {
+
+  std::stable_sort(track_events_.begin(), track_events_.end(),
+                   [](const TrackEvent &a, const TrackEvent &b) { return a.tick < b.tick; });
+  std::stable_sort(tempo_changes_.begin(), tempo_changes_.end(),
+                   [](const TempoChange &a, const TempoChange &b) { return a.tick < b.tick; });
+
+  // With SMPTE timing the tick length is fixed and tempo changes are ignored. The frame rate is
+  // stored negated in the top byte, with 29 meaning 29.97 frames per second.
+  bool is_smpte = (division & 0x8000) != 0;
+  double smpte_frames_per_tick = 0;
+  if (is_smpte) {
+    int smpte_rate = -(int8_t) (division >> 8);
+    double smpte_fps = (smpte_rate == 29) ? 30000.0 / 1001.0 : smpte_rate;
+    smpte_frames_per_tick = frame_rate / (smpte_fps * (division & 0xFF));
+  }
+
+  // Walk the tempo map alongside the events, keeping the frame at which the current tempo began
+  size_t tempo_index = 0;
+  int64_t segment_tick = 0;
+  double segment_frame = 0;
+  double frames_per_tick = is_smpte ? smpte_frames_per_tick :
+      (double) DEFAULT_MICROSECONDS_PER_QUARTER_NOTE * frame_rate / (1e6 * division);
+
+  auto tickToFrame = [&](int64_t tick) {
+    while (!is_smpte && tempo_index < tempo_changes_.size() &&
+           tempo_changes_[tempo_index].tick <= tick) {
+      const TempoChange &change = tempo_changes_[tempo_index++];
+      segment_frame += (change.tick - segment_tick) * frames_per_tick;
+      segment_tick = change.tick;
+      frames_per_tick =
+          (double) change.microseconds_per_quarter_note * frame_rate / (1e6 * division);
+    }
+    return (int64_t) (segment_frame + (tick - segment_tick) * frames_per_tick + 0.5);
+  };
+
+  events_.resize(track_events_.size());
+  for (size_t i = 0; i < track_events_.size(); i++) {
+    events_[i].frame = tickToFrame(track_events_[i].tick);
+    events_[i].message = track_events_[i].message;
+  }
+  length_frames_ = tickToFrame(length_ticks_);
+
+  track_events_.clear();
+  track_events_.shrink_to_fit();
+  tempo_changes_.clear();
+}
+
+void MidiFile::clear() {
+  track_events_.clear();
+  tempo_changes_.clear();
+  length_ticks_ = 0;
+  events_.clear();
+  length_frames_ = 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_MIDI_FILE_H
+#define SIMPLESYNTH_MIDI_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "midi_parser.h"
+
+struct MidiFileEvent {
+  int64_t frame;
+  MidiMessage message;
+};
+
+/**
+ * A Standard MIDI File (format 0 or 1) flattened for playback. Loading merges the channel
+ * messages from every track into a single array sorted by time, and converts their times from
+ * ticks to frames using the file's tempo map, so playing the file back is just a walk along the
+ * array. System exclusive and meta events other than tempo changes are dropped.
+ */
+class MidiFile {
+
+public:
+  /**
+   * Parse a file. Allocates, so must not be called from the audio thread.
+   *
+   * @return false if the file is malformed, in which case the file is left empty
+   */
+  bool load(const uint8_t *data, size_t size, int frame_rate);
+
+  const std::vector<MidiFileEvent> &getEvents() const { return events_; }
+
+  // The frame at which the last track ends
+  int64_t getLengthFrames() const { return length_frames_; }
+
+private:
+  struct TrackEvent {
+    int64_t tick;
+    MidiMessage message;
+  };
+
+  struct TempoChange {
+    int64_t tick;
+    int microseconds_per_quarter_note;
+  };
+
+  bool parseTrack(const uint8_t *data, size_t size);
+  void convertTicksToFrames(int division, int frame_rate);
+  void clear();
+
+  std::vector<TrackEvent> track_events_;
+  std::vector<TempoChange> tempo_changes_;
+  int64_t length_ticks_ = 0;
+
+  std::vector<MidiFileEvent> events_;
+  int64_t length_frames_ = 0;
+};
+
+#endif //SIMPLESYNTH_MIDI_FILE_H
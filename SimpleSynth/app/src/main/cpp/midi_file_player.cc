@@ -0,0 +1,115 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi_file_player.h"
+#include "trace.h"
+
+MidiFilePlayer::MidiFilePlayer(Synthesizer *synthesizer, int num_audio_channels, int frame_rate) :
+    synthesizer_(synthesizer),
+    num_audio_channels_(num_audio_channels),
+    frame_rate_(frame_rate) {
+}
+
+bool MidiFilePlayer::load(const uint8_t *data, size_t size) {
+  std::lock_guard<std::mutex> lock(file_lock_);
+  is_playing_.store(false, std::memory_order_release);
+  return file_.load(data, size, frame_rate_);
+}
+
+void MidiFilePlayer::play() {
+  is_restart_requested_.store(true, std::memory_order_release);
+  is_playing_.store(true, std::memory_order_release);
+}
+
+void MidiFilePlayer::stop() {
+  is_playing_.store(false, std::memory_order_release);
+}
+
+int64_t MidiFilePlayer::getLengthFrames() {
+  std::lock_guard<std::mutex> lock(file_lock_);
+  return file_.getLengthFrames();
+}
+
+int MidiFilePlayer::render(int num_samples, int16_t *audio_buffer) {
+
+  Trace::beginSection("MidiFilePlayer::render");
+
+  int frames = num_samples / num_audio_channels_;
+  int frames_rendered = 0;
+
+  std::unique_lock<std::mutex> lock(file_lock_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    synthesizer_->render(num_samples, audio_buffer);
+    Trace::endSection();
+    return frames * num_audio_channels_;
+  }
+
+  // Release the file's notes when it stops or starts again from the top
+  bool is_playing = is_playing_.load(std::memory_order_acquire);
+  bool is_restart = is_restart_requested_.exchange(false, std::memory_order_acq_rel);
+  if (was_playing_ && (!is_playing || is_restart)) {
+    MidiMessage all_notes_off = {MIDI_CONTROL_CHANGE, MIDI_CC_ALL_NOTES_OFF, 0};
+    synthesizer_->scheduleMidi(all_notes_off, 0);
+  }
+  if (is_restart) {
+    cursor_ = 0;
+    position_ = 0;
+  }
+  was_playing_ = is_playing;
+
+  // The synth can only hold so many scheduled events, so a very dense buffer is rendered in
+  // pieces, each ending where the schedule filled up
+  while (frames_rendered < frames) {
+    int span_frames = is_playing ? scheduleEvents(frames - frames_rendered)
+                                 : frames - frames_rendered;
+    synthesizer_->render(span_frames * num_audio_channels_,
+                         audio_buffer + frames_rendered * num_audio_channels_);
+    frames_rendered += span_frames;
+  }
+
+  Trace::endSection();
+  return frames * num_audio_channels_;
+}
+
+/**
+ * Schedule the events in the next num_frames of the file and advance the position.
+ *
+ * @return the number of frames covered, which is less than num_frames if the synth's schedule
+ * filled up
+ */
+int MidiFilePlayer::scheduleEvents(int num_frames) {
+
+  const std::vector<MidiFileEvent> &events = file_.getEvents();
+  int64_t end = position_ + num_frames;
+  while (cursor_ < events.size() && events[cursor_].frame < end) {
+    int offset = (int) (events[cursor_].frame - position_);
+    if (offset < 0) offset = 0;
+    if (!synthesizer_->scheduleMidi(events[cursor_].message, offset)) {
+      // Render up to this event, it is scheduled at the start of the next span. If the schedule
+      // filled up on a single frame, the rest of that frame's events are a frame late.
+      end = (offset > 0) ? events[cursor_].frame : position_ + 1;
+      break;
+    }
+    cursor_++;
+  }
+
+  int span_frames = (int) (end - position_);
+  position_ = end;
+  if (cursor_ == events.size() && position_ >= file_.getLengthFrames()) {
+    is_playing_.store(false, std::memory_order_release);
+  }
+  return span_frames;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_MIDI_FILE_PLAYER_H
+#define SIMPLESYNTH_MIDI_FILE_PLAYER_H
+
+#include <atomic>
+#include <mutex>
+#include "audio_renderer.h"
+#include "midi_file.h"
+#include "synthesizer.h"
+
+/**
+ * Plays a Standard MIDI File through a Synthesizer. It sits in front of the synth in the
+ * renderer chain: each render call schedules the file's events which fall in the buffer at their
+ * exact frame offsets, then renders the synth. Live MIDI input keeps working alongside the file.
+ *
+ * Playback only moves a cursor along the loaded event array, so it never allocates. The same
+ * player renders files offline, by calling render in a loop until isPlaying returns false, which
+ * is how dense arrangements can be benchmarked faster than real-time.
+ */
+class MidiFilePlayer : public AudioRenderer {
+
+public:
+  MidiFilePlayer(Synthesizer *synthesizer, int num_audio_channels, int frame_rate);
+
+  /**
+   * Load a file, stopping playback of the previous one. Must not be called from the audio
+   * thread. If the audio thread is rendering while the file loads the file is skipped for that
+   * buffer rather than the audio thread waiting.
+   */
+  bool load(const uint8_t *data, size_t size);
+
+  // Play the file from the start
+  void play();
+
+  void stop();
+
+  // False once the end of the file has been played
+  bool isPlaying() const { return is_playing_.load(std::memory_order_acquire); }
+
+  int64_t getLengthFrames();
+
+  virtual int render(int num_samples, int16_t *audio_buffer);
+
+private:
+  int scheduleEvents(int num_frames);
+
+  Synthesizer *synthesizer_;
+  int num_audio_channels_;
+  int frame_rate_;
+
+  MidiFile file_;
+  std::mutex file_lock_;
+  std::atomic<bool> is_playing_ {false};
+  std::atomic<bool> is_restart_requested_ {false};
+
+  // Only used on the audio thread
+  bool was_playing_ = false;
+  size_t cursor_ = 0;
+  int64_t position_ = 0;
+};
+
+#endif //SIMPLESYNTH_MIDI_FILE_PLAYER_H
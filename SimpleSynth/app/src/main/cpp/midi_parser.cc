@@ -0,0 +1,93 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "midi_parser.h"
+
+/**
+ * The number of data bytes following a status byte, or -1 for status bytes which are undefined
+ * or which this parser treats specially.
+ */
+static int dataByteCount(uint8_t status) {
+  if (status < MIDI_SYSEX_START) {
+    uint8_t type = (uint8_t) (status & 0xF0);
+    return (type == MIDI_PROGRAM_CHANGE || type == MIDI_CHANNEL_PRESSURE) ? 1 : 2;
+  }
+  switch (status) {
+    case 0xF1:  // MIDI time code quarter frame
+    case 0xF3:  // Song select
+      return 1;
+    case 0xF2:  // Song position pointer
+      return 2;
+    case 0xF6:  // Tune request
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+void MidiParser::reset() {
+  running_status_ = 0;
+  data_count_ = 0;
+  expected_data_count_ = 0;
+  is_in_sysex_ = false;
+}
+
+bool MidiParser::parse(uint8_t byte, MidiMessage *message) {
+
+  if (byte >= MIDI_REALTIME_FIRST) {
+    message->status = byte;
+    message->data_1 = 0;
+    message->data_2 = 0;
+    return true;
+  }
+
+  if (byte & 0x80) {
+    // Any other status byte ends a system exclusive message and cancels a partial message
+    is_in_sysex_ = (byte == MIDI_SYSEX_START);
+    data_count_ = 0;
+
+    int count = dataByteCount(byte);
+    if (count < 0) {
+      running_status_ = 0;
+      return false;
+    }
+    if (count == 0) {
+      running_status_ = 0;
+      message->status = byte;
+      message->data_1 = 0;
+      message->data_2 = 0;
+      return true;
+    }
+    running_status_ = byte;
+    expected_data_count_ = count;
+    return false;
+  }
+
+  // A data byte. Without a status byte to go with it, it is dropped.
+  if (is_in_sysex_ || running_status_ == 0) return false;
+
+  data_[data_count_++] = byte;
+  if (data_count_ < expected_data_count_) return false;
+
+  message->status = running_status_;
+  message->data_1 = data_[0];
+  message->data_2 = (expected_data_count_ == 2) ? data_[1] : (uint8_t) 0;
+  data_count_ = 0;
+
+  // Running status only applies to channel messages
+  if (running_status_ >= MIDI_SYSEX_START) running_status_ = 0;
+  return true;
+}
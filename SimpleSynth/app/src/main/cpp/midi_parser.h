@@ -0,0 +1,77 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_MIDI_PARSER_H
+#define SIMPLESYNTH_MIDI_PARSER_H
+
+#include <stdint.h>
+
+#define MIDI_NOTE_OFF 0x80
+#define MIDI_NOTE_ON 0x90
+#define MIDI_POLY_PRESSURE 0xA0
+#define MIDI_CONTROL_CHANGE 0xB0
+#define MIDI_PROGRAM_CHANGE 0xC0
+#define MIDI_CHANNEL_PRESSURE 0xD0
+#define MIDI_PITCH_BEND 0xE0
+#define MIDI_SYSEX_START 0xF0
+#define MIDI_SYSEX_END 0xF7
+#define MIDI_REALTIME_FIRST 0xF8
+
+#define MIDI_CC_ALL_SOUND_OFF 120
+#define MIDI_CC_ALL_NOTES_OFF 123
+
+// A complete MIDI 1.0 message, with running status already expanded. Unused data bytes are 0.
+struct MidiMessage {
+  uint8_t status;
+  uint8_t data_1;
+  uint8_t data_2;
+};
+
+inline uint8_t midiMessageType(const MidiMessage &message) {
+  return (uint8_t) (message.status & 0xF0);
+}
+
+inline int midiChannel(const MidiMessage &message) {
+  return message.status & 0x0F;
+}
+
+/**
+ * Turns a MIDI 1.0 byte stream into complete messages, one byte at a time so that messages can
+ * be split across packets in any way.
+ *
+ * Running status is supported for channel messages. System exclusive messages are skipped.
+ * Realtime messages (clock, start, stop and so on) are returned as soon as they arrive, even in
+ * the middle of another message, without disturbing it.
+ */
+class MidiParser {
+
+public:
+  void reset();
+
+  /**
+   * @return true if the byte completed a message, which is written to message
+   */
+  bool parse(uint8_t byte, MidiMessage *message);
+
+private:
+  uint8_t running_status_ = 0;
+  uint8_t data_[2];
+  int data_count_ = 0;
+  int expected_data_count_ = 0;
+  bool is_in_sysex_ = false;
+};
+
+#endif //SIMPLESYNTH_MIDI_PARSER_H
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include "modulation_matrix.h"
+
+#define TWO_PI_F 6.2831853f
+#define DEFAULT_LFO_RATE_HZ 5.0f
+#define EXPRESSION_SMOOTHING_SECONDS 0.01f
+
+// An expression this close to its target has arrived, so a held pitch bend stops being a change
+#define EXPRESSION_SETTLE_DISTANCE 1e-4f
+
+// The value each destination takes when nothing is routed to it
+static const float kNeutralValues[NUM_MOD_DESTINATIONS] = {1.0f, 1.0f, 0.0f, 1.0f, 0.0f};
+
+ModulationMatrix::ModulationMatrix(int frame_rate) :
+    frame_rate_(frame_rate) {
+
+  for (int d = 0; d < NUM_MOD_DESTINATIONS; d++) {
+    was_evaluated_[d] = false;
+    held_lanes_[d] = 0;
+  }
+  for (int slot = 0; slot < MAX_MODULATION_ROUTES; slot++) {
+    routes_[slot] = {MOD_SOURCE_LFO_1, MOD_DEST_PITCH, 0.0f};
+  }
+  for (int lfo = 0; lfo < NUM_LFOS; lfo++) {
+    lfo_rates_[lfo] = DEFAULT_LFO_RATE_HZ;
+    lfo_shapes_[lfo] = LFO_SHAPE_SINE;
+  }
+  for (int v = 0; v < MAX_VOICES; v++) {
+    resetVoice(v);
+    for (int e = 0; e < NUM_EXPRESSIONS; e++) resetExpression(v, (Expression) e, 0.0f);
+  }
+}
+
+void ModulationMatrix::setLfoRate(int lfo, float rate_hz) {
+  if (lfo >= 0 && lfo < NUM_LFOS) lfo_rates_[lfo] = rate_hz;
+}
+
+void ModulationMatrix::setLfoShape(int lfo, LfoShape shape) {
+  if (lfo >= 0 && lfo < NUM_LFOS) lfo_shapes_[lfo] = shape;
+}
+
+void ModulationMatrix::setRoute(int slot,
+                                ModulationSource source,
+                                ModulationDestination destination,
+                                float depth) {
+
+  if (slot < 0 || slot >= MAX_MODULATION_ROUTES) return;
+  if (source < 0 || source >= NUM_MOD_SOURCES) return;
+  if (destination < 0 || destination >= NUM_MOD_DESTINATIONS) return;
+
+  // Both the destination losing the route and the one gaining it need evaluating
+  is_stale_[routes_[slot].destination] = true;
+  is_stale_[destination] = true;
+  routes_[slot] = {source, destination, depth};
+}
+
+bool ModulationMatrix::isChanging(ModulationDestination destination) const {
+
+  if (is_stale_[destination]) return true;
+  for (const Route &route : routes_) {
+    if (route.destination == destination && route.depth != 0) return true;
+  }
+  if (destination == MOD_DEST_PITCH) {
+    const float *targets = expression_targets_[EXPRESSION_PITCH_BEND];
+    const float *values = expression_values_[EXPRESSION_PITCH_BEND];
+    for (int v = 0; v < MAX_VOICES; v++) {
+      if (values[v] != targets[v]) return true;
+    }
+  }
+  return false;
+}
+
+void ModulationMatrix::resetVoice(int lane) {
+
+  for (int lfo = 0; lfo < NUM_LFOS; lfo++) lfo_phases_[lfo][lane] = 0;
+  for (int d = 0; d < NUM_MOD_DESTINATIONS; d++) {
+    previous_values_[d][lane] = kNeutralValues[d];
+    control_values_[d][lane] = kNeutralValues[d];
+    is_stale_[d] = true;
+  }
+}
+
+void ModulationMatrix::process(const ParameterRate *rates, int num_lanes, int num_frames) {
+
+  assert(num_lanes <= MAX_VOICES && num_frames <= MAX_BLOCK_FRAMES);
+
+  // Constant destinations are skipped, the rest are evaluated at the fastest of their rates. The
+  // enum is ordered slowest first.
+  bool is_evaluated[NUM_MOD_DESTINATIONS];
+  bool is_changed = false;
+  ParameterRate rate = PARAMETER_RATE_CONSTANT;
+  for (int d = 0; d < NUM_MOD_DESTINATIONS; d++) {
+    is_evaluated[d] = rates[d] != PARAMETER_RATE_CONSTANT;
+    if (is_evaluated[d] != was_evaluated_[d]) is_changed = true;
+    was_evaluated_[d] = is_evaluated[d];
+    if (is_evaluated[d]) {
+      held_lanes_[d] = 0;
+      if (rates[d] > rate) rate = rates[d];
+    } else {
+      holdDestination(d, num_lanes);
+    }
+  }
+  if (rate == PARAMETER_RATE_CONSTANT) return;
+
+  // A change of rate, or of which destinations are evaluated, starts a new period here
+  int update_frames = ParameterRates::getInterval(rate, num_frames);
+  if (is_changed || rate == PARAMETER_RATE_BLOCK || update_frames != update_frames_) {
+    update_frames_ = update_frames;
+    frames_until_update_ = 0;
+  }
+
+  // At block rate the values are held rather than interpolated, so they step between blocks
+  const bool is_held = rate == PARAMETER_RATE_BLOCK;
+  int frame = 0;
+  while (frame < num_frames) {
+
+    if (frames_until_update_ == 0) {
+      for (int d = 0; d < NUM_MOD_DESTINATIONS; d++) {
+        if (!is_evaluated[d]) continue;
+        for (int v = 0; v < num_lanes; v++) previous_values_[d][v] = control_values_[d][v];
+      }
+      updateControlValues(is_evaluated, num_lanes, update_frames_);
+      frames_until_update_ = update_frames_;
+    }
+
+    int run_frames = num_frames - frame;
+    if (run_frames > frames_until_update_) run_frames = frames_until_update_;
+    int period_offset = update_frames_ - frames_until_update_;
+
+    // Interpolate from the previous control values to the current ones across the period
+    for (int d = 0; d < NUM_MOD_DESTINATIONS; d++) {
+      if (!is_evaluated[d]) continue;
+      const float *start = previous_values_[d];
+      const float *end = control_values_[d];
+      float *output = destination_buffers_[d] + frame * num_lanes;
+      for (int j = 0; j < run_frames; j++) {
+        float t = is_held ? 1.0f : (float) (period_offset + j + 1) / update_frames_;
+        for (int v = 0; v < num_lanes; v++) {
+          output[j * num_lanes + v] = start[v] + (end[v] - start[v]) * t;
+        }
+      }
+    }
+
+    frame += run_frames;
+    frames_until_update_ -= run_frames;
+  }
+}
+
+/**
+ * Fill a constant destination's buffer with the value its last update reached, for every frame a
+ * block can have. Only needed when it stops being evaluated or the lane layout changes, otherwise
+ * the buffer is left as it is.
+ */
+void ModulationMatrix::holdDestination(int destination, int num_lanes) {
+
+  if (held_lanes_[destination] == num_lanes) return;
+  const float *values = control_values_[destination];
+  float *output = destination_buffers_[destination];
+  for (int i = 0; i < MAX_BLOCK_FRAMES; i++) {
+    for (int v = 0; v < num_lanes; v++) output[i * num_lanes + v] = values[v];
+  }
+  held_lanes_[destination] = num_lanes;
+}
+
+/**
+ * Evaluate the sources, sum the routes and convert the destinations which are being evaluated.
+ * Runs once per update period so this is where any expensive maths belongs.
+ *
+ * @param num_frames how far to advance the sources, the length of the update period
+ */
+void ModulationMatrix::updateControlValues(const bool *is_evaluated,
+                                           int num_lanes,
+                                           int num_frames) {
+
+  for (int lfo = 0; lfo < NUM_LFOS; lfo++) evaluateLfo(lfo, num_lanes, num_frames);
+  updateExpressions(num_lanes, num_frames);
+
+  float sums[NUM_MOD_DESTINATIONS][MAX_VOICES] = {};
+  for (const Route &route : routes_) {
+    if (route.depth == 0 || !is_evaluated[route.destination]) continue;
+    const float *source = source_values_[route.source];
+    float *sum = sums[route.destination];
+    for (int v = 0; v < num_lanes; v++) sum[v] += route.depth * source[v];
+  }
+
+  const float *pitch_bend = expression_values_[EXPRESSION_PITCH_BEND];
+  if (is_evaluated[MOD_DEST_PITCH]) {
+    for (int v = 0; v < num_lanes; v++) {
+      control_values_[MOD_DEST_PITCH][v] =
+          exp2f((sums[MOD_DEST_PITCH][v] + pitch_bend[v]) / 12.0f);
+    }
+  }
+  if (is_evaluated[MOD_DEST_CUTOFF]) {
+    for (int v = 0; v < num_lanes; v++) {
+      control_values_[MOD_DEST_CUTOFF][v] = exp2f(sums[MOD_DEST_CUTOFF][v]);
+    }
+  }
+  if (is_evaluated[MOD_DEST_RESONANCE]) {
+    for (int v = 0; v < num_lanes; v++) {
+      control_values_[MOD_DEST_RESONANCE][v] = sums[MOD_DEST_RESONANCE][v];
+    }
+  }
+  if (is_evaluated[MOD_DEST_AMPLITUDE]) {
+    for (int v = 0; v < num_lanes; v++) {
+      control_values_[MOD_DEST_AMPLITUDE][v] = fmaxf(0.0f, 1.0f + sums[MOD_DEST_AMPLITUDE][v]);
+    }
+  }
+  if (is_evaluated[MOD_DEST_PULSE_WIDTH]) {
+    for (int v = 0; v < num_lanes; v++) {
+      control_values_[MOD_DEST_PULSE_WIDTH][v] = sums[MOD_DEST_PULSE_WIDTH][v];
+    }
+  }
+  for (int d = 0; d < NUM_MOD_DESTINATIONS; d++) {
+    if (is_evaluated[d]) is_stale_[d] = false;
+  }
+}
+
+/**
+ * Advance an LFO by one update period and store its bipolar output for each voice.
+ */
+void ModulationMatrix::evaluateLfo(int lfo, int num_lanes, int num_frames) {
+
+  float increment = lfo_rates_[lfo] * num_frames / frame_rate_;
+  float *phases = lfo_phases_[lfo];
+  float *output = source_values_[MOD_SOURCE_LFO_1 + lfo];
+
+  for (int v = 0; v < num_lanes; v++) {
+    float phase = phases[v];
+    switch (lfo_shapes_[lfo]) {
+      case LFO_SHAPE_SINE:
+        output[v] = sinf(TWO_PI_F * phase);
+        break;
+      case LFO_SHAPE_TRIANGLE:
+        output[v] = 1.0f - 4.0f * fabsf(phase - 0.5f);
+        break;
+      case LFO_SHAPE_SAW:
+        output[v] = 2.0f * phase - 1.0f;
+        break;
+      case LFO_SHAPE_SQUARE:
+        output[v] = (phase < 0.5f) ? 1.0f : -1.0f;
+        break;
+    }
+    phase += increment;
+    phases[v] = phase - floorf(phase);
+  }
+}
+
+/**
+ * Glide each expression towards its target and publish the ones which are modulation sources.
+ */
+void ModulationMatrix::updateExpressions(int num_lanes, int num_frames) {
+
+  if (num_frames != expression_smoothing_frames_) {
+    expression_smoothing_ =
+        1.0f - expf(-num_frames / (EXPRESSION_SMOOTHING_SECONDS * frame_rate_));
+    expression_smoothing_frames_ = num_frames;
+  }
+  for (int e = 0; e < NUM_EXPRESSIONS; e++) {
+    const float *targets = expression_targets_[e];
+    float *values = expression_values_[e];
+    for (int v = 0; v < num_lanes; v++) {
+      float distance = targets[v] - values[v];
+      values[v] = (fabsf(distance) <= EXPRESSION_SETTLE_DISTANCE) ?
+                  targets[v] : values[v] + distance * expression_smoothing_;
+    }
+
+    // Lanes past the last voice are silent, so they may as well arrive now rather than keep the
+    // pitch changing
+    for (int v = num_lanes; v < MAX_VOICES; v++) values[v] = targets[v];
+  }
+  for (int v = 0; v < num_lanes; v++) {
+    source_values_[MOD_SOURCE_PRESSURE][v] = expression_values_[EXPRESSION_PRESSURE][v];
+    source_values_[MOD_SOURCE_TIMBRE][v] = expression_values_[EXPRESSION_TIMBRE][v];
+  }
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_MODULATION_MATRIX_H
+#define SIMPLESYNTH_MODULATION_MATRIX_H
+
+#include "audio_common.h"
+#include "parameter_rate.h"
+
+#define NUM_LFOS 2
+#define MAX_MODULATION_ROUTES 8
+
+enum ModulationSource {
+  MOD_SOURCE_LFO_1,
+  MOD_SOURCE_LFO_2,
+  MOD_SOURCE_PRESSURE,   // per note expression, 0 to 1
+  MOD_SOURCE_TIMBRE,     // per note expression, 0 to 1
+  NUM_MOD_SOURCES
+};
+
+// Per note expression, set from MIDI (e.g. MPE) for each voice
+enum Expression {
+  EXPRESSION_PITCH_BEND,  // in semitones, added straight to the pitch
+  EXPRESSION_PRESSURE,
+  EXPRESSION_TIMBRE,
+  NUM_EXPRESSIONS
+};
+
+enum ModulationDestination {
+  MOD_DEST_PITCH,        // depth in semitones
+  MOD_DEST_CUTOFF,       // depth in octaves
+  MOD_DEST_RESONANCE,    // depth added to the resonance
+  MOD_DEST_AMPLITUDE,    // depth added to a gain of 1
+  MOD_DEST_PULSE_WIDTH,  // depth added to the pulse width
+  NUM_MOD_DESTINATIONS
+};
+
+// The parameter whose rate a destination is evaluated at
+inline SynthParameter getDestinationParameter(ModulationDestination destination) {
+  switch (destination) {
+    case MOD_DEST_CUTOFF:
+      return SYNTH_PARAMETER_CUTOFF;
+    case MOD_DEST_RESONANCE:
+      return SYNTH_PARAMETER_RESONANCE;
+    case MOD_DEST_AMPLITUDE:
+      return SYNTH_PARAMETER_AMPLITUDE;
+    case MOD_DEST_PULSE_WIDTH:
+      return SYNTH_PARAMETER_PULSE_WIDTH;
+    default:
+      return SYNTH_PARAMETER_PITCH;
+  }
+}
+
+enum LfoShape {
+  LFO_SHAPE_SINE,
+  LFO_SHAPE_TRIANGLE,
+  LFO_SHAPE_SAW,
+  LFO_SHAPE_SQUARE
+};
+
+/**
+ * LFOs and a modulation matrix which routes sources to destinations with a depth.
+ *
+ * Each block every destination is given a rate, see parameter_rate.h. A constant destination
+ * isn't evaluated, its buffer keeps the value it last had. The rest are evaluated together at the
+ * fastest of their rates: at control rate, every CONTROL_RATE_DIVIDER frames each source is
+ * evaluated for every voice, the routes are summed, and each destination is converted to the
+ * form the synth uses (e.g. semitones to a frequency ratio). Only then is the result linearly
+ * interpolated out to audio rate. The per frame cost is therefore the same however many routes
+ * are active, and the expensive conversions never run per frame. At block rate the values are
+ * evaluated once and held for the block.
+ *
+ * All the per voice state is stored as arrays indexed by voice lane, so the matrix sums across
+ * voices in its inner loops.
+ */
+class ModulationMatrix {
+
+public:
+  ModulationMatrix(int frame_rate);
+
+  void setLfoRate(int lfo, float rate_hz);
+
+  void setLfoShape(int lfo, LfoShape shape);
+
+  /**
+   * Route a source to a destination. A depth of 0 clears the route.
+   *
+   * @param slot index of the route, from 0 to MAX_MODULATION_ROUTES - 1
+   */
+  void setRoute(int slot, ModulationSource source, ModulationDestination destination, float depth);
+
+  // Restart the LFOs of a voice, so that each note starts from the same point in the LFO cycle
+  void resetVoice(int lane);
+
+  /**
+   * Set the target of a voice's expression. The value glides to the target at control rate, so
+   * coarse or bursty controller data doesn't zipper.
+   */
+  void setExpression(int lane, Expression expression, float value) {
+    expression_targets_[expression][lane] = value;
+  }
+
+  // Set an expression without gliding, for when a voice starts a new note
+  void resetExpression(int lane, Expression expression, float value) {
+    expression_targets_[expression][lane] = value;
+    expression_values_[expression][lane] = value;
+    if (expression == EXPRESSION_PITCH_BEND) is_stale_[MOD_DEST_PITCH] = true;
+  }
+
+  /**
+   * Render a block of modulation. Afterwards each destination buffer holds the modulation for
+   * every voice and frame, in the lane layout from audio_common.h. The neutral value is 1 for
+   * pitch, cutoff and amplitude, which are multipliers, and 0 for resonance and pulse width, which
+   * are added.
+   *
+   * @param rates the rate to evaluate each destination at in this block
+   */
+  void process(const ParameterRate *rates, int num_lanes, int num_frames);
+
+  /**
+   * Whether anything is moving a destination: a route, a pitch bend gliding to a new value, or a
+   * change such as a new note which it hasn't been evaluated since. If not it's constant and its
+   * buffer can be left as it is.
+   */
+  bool isChanging(ModulationDestination destination) const;
+
+  const float *getDestinationBuffer(ModulationDestination destination) const {
+    return destination_buffers_[destination];
+  }
+
+private:
+  struct Route {
+    ModulationSource source;
+    ModulationDestination destination;
+    float depth;
+  };
+
+  void updateControlValues(const bool *is_evaluated, int num_lanes, int num_frames);
+  void evaluateLfo(int lfo, int num_lanes, int num_frames);
+  void updateExpressions(int num_lanes, int num_frames);
+  void holdDestination(int destination, int num_lanes);
+
+  int frame_rate_;
+  Route routes_[MAX_MODULATION_ROUTES];
+
+  // The expression glide per update, for updates of expression_smoothing_frames_
+  float expression_smoothing_ = 0;
+  int expression_smoothing_frames_ = 0;
+
+  float lfo_rates_[NUM_LFOS];
+  LfoShape lfo_shapes_[NUM_LFOS];
+  float lfo_phases_[NUM_LFOS][MAX_VOICES];
+
+  float source_values_[NUM_MOD_SOURCES][MAX_VOICES];
+
+  float expression_targets_[NUM_EXPRESSIONS][MAX_VOICES];
+  float expression_values_[NUM_EXPRESSIONS][MAX_VOICES];
+
+  // Destination values at the start and end of the current control period
+  float previous_values_[NUM_MOD_DESTINATIONS][MAX_VOICES];
+  float control_values_[NUM_MOD_DESTINATIONS][MAX_VOICES];
+
+  float destination_buffers_[NUM_MOD_DESTINATIONS][MAX_VOICES * MAX_BLOCK_FRAMES];
+
+  // Frames per update and frames left until the next one, a control period can span two blocks
+  int update_frames_ = 0;
+  int frames_until_update_ = 0;
+
+  // Which destinations were evaluated in the last block, which need evaluating whether or not
+  // anything is moving them, and the lane count each constant one's buffer was filled for
+  bool was_evaluated_[NUM_MOD_DESTINATIONS];
+  bool is_stale_[NUM_MOD_DESTINATIONS];
+  int held_lanes_[NUM_MOD_DESTINATIONS];
+};
+
+#endif //SIMPLESYNTH_MODULATION_MATRIX_H
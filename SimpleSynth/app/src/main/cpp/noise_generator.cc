@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "noise_generator.h"
+
+#define TWO_PI_F 6.2831853f
+
+// Cutoff of the leaky integrator, below this the brown noise spectrum flattens out
+#define BROWN_CUTOFF_HZ 10.0f
+
+// Scales a signed 32 bit integer to -1..1
+#define INT32_TO_FLOAT (1.0f / 2147483648.0f)
+
+// splitmix32, used to turn one seed into well mixed, non zero states for every lane
+static uint32_t mixSeed(uint32_t x) {
+  x += 0x9E3779B9u;
+  x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+  x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+  x ^= x >> 16;
+  return (x != 0) ? x : 1;
+}
+
+NoiseGenerator::NoiseGenerator(int frame_rate, uint32_t seed) {
+
+  brown_leak_ = expf(-TWO_PI_F * BROWN_CUTOFF_HZ / frame_rate);
+
+  // Brings the integrator's output back to the same RMS level as its white input
+  brown_gain_ = sqrtf(1.0f - brown_leak_ * brown_leak_);
+  this->seed(seed);
+}
+
+void NoiseGenerator::seed(uint32_t seed) {
+
+  seedWhite(white_, seed);
+  seedWhite(pink_row_source_, ~seed);
+
+  for (int r = 0; r < NUM_PINK_ROWS; r++) pink_rows_[r] = 0;
+  pink_sum_ = 0;
+  pink_counter_ = 0;
+  brown_value_ = 0;
+}
+
+void NoiseGenerator::setColor(NoiseColor color) {
+  color_ = color;
+}
+
+void NoiseGenerator::seedWhite(WhiteSource &source, uint32_t seed) {
+  for (int k = 0; k < SIMD_WIDTH; k++) source.states[k] = mixSeed(seed + k * 0x632BE5ABu);
+  source.spare_count = 0;
+}
+
+void NoiseGenerator::step(WhiteSource &source, float *output) {
+
+  for (int k = 0; k < SIMD_WIDTH; k++) {
+    uint32_t x = source.states[k];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    source.states[k] = x;
+    output[k] = (float) (int32_t) x * INT32_TO_FLOAT;
+  }
+}
+
+void NoiseGenerator::generateWhite(WhiteSource &source, float *buffer, int num_frames) {
+
+  int i = 0;
+  while (i < num_frames && source.spare_count > 0) {
+    buffer[i++] = source.spare[SIMD_WIDTH - source.spare_count--];
+  }
+  for (; i + SIMD_WIDTH <= num_frames; i += SIMD_WIDTH) step(source, buffer + i);
+  if (i < num_frames) {
+    step(source, source.spare);
+    source.spare_count = SIMD_WIDTH;
+    while (i < num_frames) buffer[i++] = source.spare[SIMD_WIDTH - source.spare_count--];
+  }
+}
+
+void NoiseGenerator::generate(float *buffer, int num_frames) {
+
+  NoiseColor color = color_;
+  generateWhite(white_, buffer, num_frames);
+
+  if (color == NOISE_COLOR_PINK) {
+
+    // Each sample replaces one row: row 0 every other sample, row 1 every fourth and so on, so
+    // each row contributes an octave lower. The rows take their values from a second white
+    // source so that they aren't correlated with the white noise added on top.
+    const float scale = 1.0f / sqrtf(NUM_PINK_ROWS + 1.0f);
+    for (int offset = 0; offset < num_frames; offset += MAX_BLOCK_FRAMES) {
+      int chunk_frames = num_frames - offset;
+      if (chunk_frames > MAX_BLOCK_FRAMES) chunk_frames = MAX_BLOCK_FRAMES;
+      float *chunk = buffer + offset;
+      generateWhite(pink_row_source_, row_values_, chunk_frames);
+
+      for (int i = 0; i < chunk_frames; i++) {
+        pink_counter_++;
+        int row = __builtin_ctz(pink_counter_);
+        if (row < NUM_PINK_ROWS) {
+          pink_sum_ += row_values_[i] - pink_rows_[row];
+          pink_rows_[row] = row_values_[i];
+        }
+        chunk[i] = (pink_sum_ + chunk[i]) * scale;
+      }
+      // Wrap the counter once every row has been updated so that it never reaches 0
+      pink_counter_ &= (1u << NUM_PINK_ROWS) - 1;
+    }
+
+  } else if (color == NOISE_COLOR_BROWN) {
+
+    for (int i = 0; i < num_frames; i++) {
+      brown_value_ = brown_value_ * brown_leak_ + buffer[i] * brown_gain_;
+      buffer[i] = brown_value_;
+    }
+  }
+}
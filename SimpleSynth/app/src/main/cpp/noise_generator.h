@@ -0,0 +1,85 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_NOISE_GENERATOR_H
+#define SIMPLESYNTH_NOISE_GENERATOR_H
+
+#include "audio_common.h"
+
+// Each pink noise row covers an octave, so 12 rows reach down to ~12Hz at 48kHz
+#define NUM_PINK_ROWS 12
+
+enum NoiseColor {
+  NOISE_COLOR_WHITE,
+  NOISE_COLOR_PINK,
+  NOISE_COLOR_BROWN
+};
+
+/**
+ * White, pink and brown noise for voices, dither and test signals.
+ *
+ * White noise comes from SIMD_WIDTH independent xorshift32 generators which are stepped together,
+ * so each step produces SIMD_WIDTH samples with a handful of vectorizable shifts and xors rather
+ * than a call to rand(). Pink noise is made from the white noise with the Voss-McCartney
+ * algorithm, and brown noise with a leaky integrator.
+ *
+ * The output depends only on the seed and the total number of samples generated, not on how they
+ * are split into blocks, so a seeded generator always produces the same sequence.
+ */
+class NoiseGenerator {
+
+public:
+  NoiseGenerator(int frame_rate, uint32_t seed);
+
+  // Restart the sequence
+  void seed(uint32_t seed);
+
+  void setColor(NoiseColor color);
+
+  // Fill a buffer with noise. White noise is from -1 to 1, pink and brown noise have about the
+  // same RMS level so their peaks go a little further.
+  void generate(float *buffer, int num_frames);
+
+private:
+  struct WhiteSource {
+    uint32_t states[SIMD_WIDTH];
+
+    // Samples generated by the last step but not used yet
+    float spare[SIMD_WIDTH];
+    int spare_count;
+  };
+
+  static void seedWhite(WhiteSource &source, uint32_t seed);
+  static void generateWhite(WhiteSource &source, float *buffer, int num_frames);
+  static void step(WhiteSource &source, float *output);
+
+  NoiseColor color_ = NOISE_COLOR_WHITE;
+  WhiteSource white_;
+
+  // Voss-McCartney state
+  float pink_rows_[NUM_PINK_ROWS];
+  float pink_sum_ = 0;
+  uint32_t pink_counter_ = 0;
+  WhiteSource pink_row_source_;
+  float row_values_[MAX_BLOCK_FRAMES];
+
+  // Leaky integrator state
+  float brown_leak_;
+  float brown_gain_;
+  float brown_value_ = 0;
+};
+
+#endif //SIMPLESYNTH_NOISE_GENERATOR_H
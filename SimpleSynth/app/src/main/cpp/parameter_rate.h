@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_PARAMETER_RATE_H
+#define SIMPLESYNTH_PARAMETER_RATE_H
+
+// Modulation and the parameters it feeds are evaluated once every CONTROL_RATE_DIVIDER frames at
+// control rate and linearly interpolated in between. Setting this to 1 makes control rate the same
+// as audio rate, which is useful for comparing the cost of the two approaches, see
+// synth_modulation_benchmark in the host build.
+#ifndef CONTROL_RATE_DIVIDER
+#define CONTROL_RATE_DIVIDER 16
+#endif
+
+// How often a parameter, and anything derived from it such as filter coefficients, is evaluated
+enum ParameterRate {
+  PARAMETER_RATE_CONSTANT,  // nothing is changing it, so it isn't evaluated and keeps its value
+  PARAMETER_RATE_BLOCK,     // evaluated once per block and held, so it steps between blocks
+  PARAMETER_RATE_CONTROL,   // every CONTROL_RATE_DIVIDER frames, interpolated in between
+  PARAMETER_RATE_AUDIO      // every frame
+};
+
+// The parameters whose evaluation is scheduled by rate: the filter's, and the modulation
+// destinations which feed the oscillators and the mix
+enum SynthParameter {
+  SYNTH_PARAMETER_CUTOFF,
+  SYNTH_PARAMETER_RESONANCE,
+  SYNTH_PARAMETER_PITCH,
+  SYNTH_PARAMETER_AMPLITUDE,
+  SYNTH_PARAMETER_PULSE_WIDTH,
+  NUM_SYNTH_PARAMETERS
+};
+
+/**
+ * The rate each parameter is declared to need, and the rate it is actually evaluated at in each
+ * block.
+ *
+ * A parameter is only evaluated at its declared rate while something is moving it: smoothing
+ * towards a new value from the UI, automation, a modulation route or a pitch bend. Otherwise it is
+ * constant for the block. A constant modulation destination isn't evaluated at all and its buffer
+ * keeps the last value, and the work which depends on a constant filter parameter, such as the
+ * tan() in the coefficients, is done once per block rather than once per frame.
+ *
+ * The declared rates are the lowest which are audibly correct. They can be raised, e.g. to audio
+ * rate to compare the cost in systrace, or lowered to hear what happens.
+ */
+class ParameterRates {
+
+public:
+  ParameterRates() {
+    for (int p = 0; p < NUM_SYNTH_PARAMETERS; p++) rates_[p] = PARAMETER_RATE_CONTROL;
+  }
+
+  void setRate(SynthParameter parameter, ParameterRate rate) {
+    if (parameter >= 0 && parameter < NUM_SYNTH_PARAMETERS) rates_[parameter] = rate;
+  }
+
+  ParameterRate getRate(SynthParameter parameter) const { return rates_[parameter]; }
+
+  // @param is_changing whether anything is moving the parameter during the block
+  ParameterRate resolve(SynthParameter parameter, bool is_changing) const {
+    return is_changing ? rates_[parameter] : PARAMETER_RATE_CONSTANT;
+  }
+
+  // The number of frames between evaluations at a rate, within a block of num_frames
+  static int getInterval(ParameterRate rate, int num_frames) {
+    switch (rate){
+      case PARAMETER_RATE_AUDIO:
+        return 1;
+      case PARAMETER_RATE_CONTROL:
+        return CONTROL_RATE_DIVIDER;
+      default:
+        return num_frames;
+    }
+  }
+
+private:
+  ParameterRate rates_[NUM_SYNTH_PARAMETERS];
+};
+
+#endif //SIMPLESYNTH_PARAMETER_RATE_H
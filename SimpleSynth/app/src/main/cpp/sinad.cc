@@ -0,0 +1,67 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "sinad.h"
+
+static double determinant3(const double m[3][3]){
+  return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+         - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+         + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+/**
+ * A sine and cosine at the known frequency, plus DC, are fitted by least squares and everything
+ * left over counts as noise.
+ */
+float measureSineSinad(const int16_t *samples, int num_frames, float frequency_hz,
+                       int frame_rate){
+
+  // Normal equations for the fit, in the order sine, cosine, DC
+  double m[3][3] = {};
+  double r[3] = {};
+  double phase_increment = 2.0 * M_PI * frequency_hz / frame_rate;
+  for (int i = 0; i < num_frames; i++){
+    double basis[3] = {sin(phase_increment * i), cos(phase_increment * i), 1.0};
+    for (int j = 0; j < 3; j++){
+      r[j] += basis[j] * samples[i];
+      for (int k = 0; k < 3; k++) m[j][k] += basis[j] * basis[k];
+    }
+  }
+
+  // Cramer's rule
+  double determinant = determinant3(m);
+  if (determinant == 0) return 0;
+  double coefficients[3];
+  for (int c = 0; c < 3; c++){
+    double replaced[3][3];
+    for (int j = 0; j < 3; j++){
+      for (int k = 0; k < 3; k++) replaced[j][k] = (k == c) ? r[j] : m[j][k];
+    }
+    coefficients[c] = determinant3(replaced) / determinant;
+  }
+
+  double signal_power = 0;
+  double noise_power = 0;
+  for (int i = 0; i < num_frames; i++){
+    double fitted = coefficients[0] * sin(phase_increment * i)
+                    + coefficients[1] * cos(phase_increment * i);
+    double noise = samples[i] - fitted - coefficients[2];
+    signal_power += fitted * fitted;
+    noise_power += noise * noise;
+  }
+  return (noise_power > 0) ? (float) (10.0 * log10(signal_power / noise_power)) : 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_SINAD_H
+#define SIMPLESYNTH_SINAD_H
+
+#include <stdint.h>
+
+/**
+ * Signal to noise and distortion ratio of a sine wave of a known frequency.
+ * @return the ratio in dB, or 0 if it can't be measured
+ */
+float measureSineSinad(const int16_t *samples, int num_frames, float frequency_hz,
+                       int frame_rate);
+
+#endif //SIMPLESYNTH_SINAD_H
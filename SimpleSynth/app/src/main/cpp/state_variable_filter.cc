@@ -0,0 +1,159 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "state_variable_filter.h"
+
+#define MIN_CUTOFF_HZ 10.0f
+
+// Keeping the cutoff below this fraction of the frame rate keeps the tan() approximation accurate
+// (the argument stays below ~1.41 radians)
+#define MAX_CUTOFF_RATIO 0.45f
+
+// k = 1/Q. At full resonance the damping is small but never zero so the filter can't blow up.
+#define MAX_DAMPING 2.0f
+#define MIN_DAMPING 0.02f
+
+/**
+ * [5/4] Pade approximant of tan(x). Accurate to better than 0.1% for 0 <= x <= 1.41, which
+ * covers cutoffs up to MAX_CUTOFF_RATIO of the frame rate. Only uses multiplies, adds and a
+ * single divide so it vectorizes.
+ */
+static inline float fastTan(float x) {
+  float x2 = x * x;
+  float numerator = x * (945.0f + x2 * (-105.0f + x2));
+  float denominator = 945.0f + x2 * (-420.0f + x2 * 15.0f);
+  return numerator / denominator;
+}
+
+StateVariableFilter::StateVariableFilter(int frame_rate) :
+    frequency_scale_((float) M_PI / frame_rate),
+    max_cutoff_(frame_rate * MAX_CUTOFF_RATIO) {
+  reset();
+}
+
+void StateVariableFilter::reset() {
+  memset(ic1eq_, 0, sizeof(ic1eq_));
+  memset(ic2eq_, 0, sizeof(ic2eq_));
+}
+
+void StateVariableFilter::resetVoice(int lane) {
+  ic1eq_[lane] = 0;
+  ic2eq_[lane] = 0;
+}
+
+void StateVariableFilter::setMode(FilterMode mode) {
+
+  // notch = low + high, so every mode is a mix of the three basic outputs
+  low_pass_mix_ = (mode == FILTER_MODE_LOW_PASS || mode == FILTER_MODE_NOTCH) ? 1 : 0;
+  band_pass_mix_ = (mode == FILTER_MODE_BAND_PASS) ? 1 : 0;
+  high_pass_mix_ = (mode == FILTER_MODE_HIGH_PASS || mode == FILTER_MODE_NOTCH) ? 1 : 0;
+}
+
+/**
+ * Calculate the coefficients for each voice from its cutoff and resonance. This is where the
+ * expensive maths is, so it only runs at the points the cutoff and resonance are given at.
+ */
+void StateVariableFilter::calculateCoefficients(const float *cutoff,
+                                                const float *resonance,
+                                                int num_lanes,
+                                                Coefficients *coefficients) const {
+
+  for (int v = 0; v < num_lanes; v++) {
+    float fc = fminf(fmaxf(cutoff[v], MIN_CUTOFF_HZ), max_cutoff_);
+    float r = fminf(fmaxf(resonance[v], 0.0f), 1.0f);
+
+    float g = fastTan(fc * frequency_scale_);
+    float k = MAX_DAMPING - (MAX_DAMPING - MIN_DAMPING) * r;
+    float a1 = 1.0f / (1.0f + g * (g + k));
+    coefficients->k[v] = k;
+    coefficients->a1[v] = a1;
+    coefficients->a2[v] = g * a1;
+    coefficients->a3[v] = g * g * a1;
+  }
+}
+
+void StateVariableFilter::process(float *audio_buffer,
+                                  const float *cutoff_points,
+                                  const float *resonance_points,
+                                  int interval,
+                                  int num_lanes,
+                                  int num_frames) {
+
+  assert(num_lanes <= MAX_VOICES && num_lanes % SIMD_WIDTH == 0 && interval > 0);
+
+  const float low_mix = low_pass_mix_;
+  const float band_mix = band_pass_mix_;
+  const float high_mix = high_pass_mix_;
+
+  // The coefficients at the start of each segment, at its end, and their step per frame
+  Coefficients current;
+  Coefficients next;
+  Coefficients step;
+  calculateCoefficients(cutoff_points, resonance_points, num_lanes, &current);
+
+  int point = 1;
+  for (int start = 0; start < num_frames; start += interval, point++) {
+    int end = (start + interval < num_frames) ? start + interval : num_frames;
+
+    // A short final segment still reaches its point at the end of the block
+    const float step_scale = 1.0f / (end - start);
+    calculateCoefficients(cutoff_points + point * num_lanes,
+                          resonance_points + point * num_lanes,
+                          num_lanes,
+                          &next);
+    for (int v = 0; v < num_lanes; v++) {
+      step.k[v] = (next.k[v] - current.k[v]) * step_scale;
+      step.a1[v] = (next.a1[v] - current.a1[v]) * step_scale;
+      step.a2[v] = (next.a2[v] - current.a2[v]) * step_scale;
+      step.a3[v] = (next.a3[v] - current.a3[v]) * step_scale;
+    }
+
+    for (int i = start; i < end; i++) {
+      float *audio = audio_buffer + i * num_lanes;
+
+      // No branches or calls in here so the compiler can vectorize across voices
+      for (int v = 0; v < num_lanes; v++) {
+        float k = current.k[v];
+        float a1 = current.a1[v];
+        float a2 = current.a2[v];
+        float a3 = current.a3[v];
+
+        float v0 = audio[v];
+        float v3 = v0 - ic2eq_[v];
+        float v1 = a1 * ic1eq_[v] + a2 * v3;
+        float v2 = ic2eq_[v] + a2 * ic1eq_[v] + a3 * v3;
+        ic1eq_[v] = 2.0f * v1 - ic1eq_[v];
+        ic2eq_[v] = 2.0f * v2 - ic2eq_[v];
+
+        float low = v2;
+        float band = v1;
+        float high = v0 - k * v1 - v2;
+        audio[v] = low_mix * low + band_mix * band + high_mix * high;
+
+        current.k[v] = k + step.k[v];
+        current.a1[v] = a1 + step.a1[v];
+        current.a2[v] = a2 + step.a2[v];
+        current.a3[v] = a3 + step.a3[v];
+      }
+    }
+
+    // Start the next segment exactly on its point rather than wherever the steps got to
+    current = next;
+  }
+}
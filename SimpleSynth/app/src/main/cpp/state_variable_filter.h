@@ -0,0 +1,102 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_STATE_VARIABLE_FILTER_H
+#define SIMPLESYNTH_STATE_VARIABLE_FILTER_H
+
+#include "audio_common.h"
+
+enum FilterMode {
+  FILTER_MODE_LOW_PASS,
+  FILTER_MODE_BAND_PASS,
+  FILTER_MODE_HIGH_PASS,
+  FILTER_MODE_NOTCH
+};
+
+/**
+ * A bank of zero delay feedback (topology preserving transform) state variable filters, one per
+ * voice. Unlike a biquad the ZDF structure stays stable when its cutoff and resonance change on
+ * every sample, so both can be modulated at audio rate.
+ *
+ * All voices are processed together, the inner loop runs across voices so that each instruction
+ * filters SIMD_WIDTH voices at once. The coefficients are calculated using a rational
+ * approximation of tan() rather than a call to tanf(), and only at the points where the cutoff
+ * and resonance are given. In between they are linearly interpolated, which costs a few adds.
+ */
+class StateVariableFilter {
+
+public:
+  StateVariableFilter(int frame_rate);
+
+  void reset();
+
+  // Clear the state of a single voice, e.g. when its lane is reused for a new note
+  void resetVoice(int lane);
+
+  void setMode(FilterMode mode);
+
+  /**
+   * Filter a block of voice audio in place. All buffers use the lane layout described in
+   * audio_common.h, with points in place of frames for the cutoff and resonance.
+   *
+   * The cutoff and resonance are given at frames 0, interval, 2 * interval and so on, plus a
+   * final point for the end of the block. The coefficients ramp from each point to the next over
+   * interval frames, or over the rest of the block for the last. An interval of 1 evaluates them
+   * every frame, an interval of num_frames with the final point equal to the first holds them for
+   * the block.
+   *
+   * @param audio_buffer voice audio to be filtered
+   * @param cutoff_points cutoff frequency in Hz for each voice and point
+   * @param resonance_points resonance from 0 (none) to 1 (self oscillation) for each voice
+   * and point
+   * @param interval number of frames between points
+   * @param num_lanes number of voice lanes, a multiple of SIMD_WIDTH
+   * @param num_frames number of frames, at most MAX_BLOCK_FRAMES
+   */
+  void process(float *audio_buffer,
+               const float *cutoff_points,
+               const float *resonance_points,
+               int interval,
+               int num_lanes,
+               int num_frames);
+
+private:
+  struct Coefficients {
+    float k[MAX_VOICES];
+    float a1[MAX_VOICES];
+    float a2[MAX_VOICES];
+    float a3[MAX_VOICES];
+  };
+
+  void calculateCoefficients(const float *cutoff,
+                             const float *resonance,
+                             int num_lanes,
+                             Coefficients *coefficients) const;
+
+  float frequency_scale_;
+  float max_cutoff_;
+
+  // Output mix of the low, band and high pass outputs, set by the filter mode
+  float low_pass_mix_ = 1;
+  float band_pass_mix_ = 0;
+  float high_pass_mix_ = 0;
+
+  // Integrator states for each voice
+  float ic1eq_[MAX_VOICES];
+  float ic2eq_[MAX_VOICES];
+};
+
+#endif //SIMPLESYNTH_STATE_VARIABLE_FILTER_H
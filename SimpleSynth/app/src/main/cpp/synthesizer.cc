@@ -15,16 +15,65 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include "synthesizer.h"
 #include "trace.h"
+#include "android_log.h"
 
 #define DEFAULT_SINE_WAVE_FREQUENCY 440.0
-#define TWO_PI (3.14159 * 2)
+#define DEFAULT_FILTER_CUTOFF 20000.0f
+#define PARAMETER_SMOOTHING_SECONDS 0.005f
+// Once this close to its target a smoothed parameter jumps there and stops changing. Well below
+// what can be heard: a cutoff 0.01% out is under 0.002 semitones.
+#define CUTOFF_SETTLE_RATIO 1e-4f
+#define RESONANCE_SETTLE_DISTANCE 1e-5f
+#define INT16_MAX_VALUE 32767.0f
+#define NOISE_SEED 1
+#define A4_NOTE 69
+#define LEGACY_NOTE_VELOCITY 127
+#define MIDI_CC_TIMBRE 74
+#define MPE_MANAGER_CHANNEL 0
+#define DEFAULT_PITCH_BEND_RANGE 2.0f
+#define DEFAULT_MPE_PITCH_BEND_RANGE 48.0f
+#define DEFAULT_TIMBRE 0.5f
 
 Synthesizer::Synthesizer(int num_audio_channels, int frame_rate):
     num_audio_channels_(num_audio_channels),
-    frame_rate_(frame_rate){
+    frame_rate_(frame_rate),
+    unison_(frame_rate),
+    fm_(frame_rate),
+    additive_(frame_rate),
+    noise_(frame_rate, NOISE_SEED),
+    classic_(frame_rate),
+    wavetable_(frame_rate),
+    fixed_point_(frame_rate),
+    left_filter_(frame_rate),
+    right_filter_(frame_rate),
+    target_cutoff_(DEFAULT_FILTER_CUTOFF),
+    current_cutoff_(DEFAULT_FILTER_CUTOFF),
+    modulation_(frame_rate){
   setWaveFrequency(DEFAULT_SINE_WAVE_FREQUENCY);
+  parameter_smoothing_ = 1.0f - expf(-1.0f / (PARAMETER_SMOOTHING_SECONDS * frame_rate));
+  mpe_pitch_bend_range_ = DEFAULT_MPE_PITCH_BEND_RANGE;
+  for (int v = 0; v < MAX_VOICES; v++){
+    voice_is_active_[v] = false;
+    voice_channels_[v] = 0;
+    voice_notes_[v] = 0;
+    voice_velocities_[v] = 0;
+    voice_start_orders_[v] = 0;
+    voice_phases_[v] = 0;
+    voice_phase_increments_[v] = 0;
+  }
+  for (int c = 0; c < NUM_MIDI_CHANNELS; c++){
+    channel_voices_[c] = -1;
+    channel_expressions_[EXPRESSION_PITCH_BEND][c] = 0;
+    channel_expressions_[EXPRESSION_PRESSURE][c] = 0;
+    channel_expressions_[EXPRESSION_TIMBRE][c] = DEFAULT_TIMBRE;
+  }
+}
+
+Synthesizer::~Synthesizer() {
+  if (wavetable_loader_.joinable()) wavetable_loader_.join();
 }
 
 int Synthesizer::render(int num_samples, int16_t *audio_buffer) {
@@ -42,30 +91,501 @@ int Synthesizer::render(int num_samples, int16_t *audio_buffer) {
     x = x / (y * z);
   }
 
-  // render an interleaved output with the same sample value per channel
-  // For example: 6 samples of a 2 channel output stream could look like this
-  // 1,1,2,2,3,3
-
-  // Only render full frames
+  // Only render full frames, in blocks which fit the voice buffers
   int frames = num_samples / num_audio_channels_;
+  int frames_rendered = 0;
+
+  // MIDI events which arrived during the last buffer period are played at the same offset in
+  // this buffer. That adds a buffer of latency but no jitter. Later events wait for the next one.
+  int64_t window_end = get_time();
+  int64_t window_start = window_end - (int64_t) frames * NANOS_IN_SECOND / frame_rate_;
+  int scheduled_index = 0;
+
+  while (frames_rendered < frames){
+    int block_frames = frames - frames_rendered;
+    if (block_frames > MAX_BLOCK_FRAMES) block_frames = MAX_BLOCK_FRAMES;
+
+    // Handle the events due by this frame, and end the block at the next one
+    while (scheduled_index < scheduled_count_){
+      int frames_to_event = scheduled_offsets_[scheduled_index] - frames_rendered;
+      if (frames_to_event > 0){
+        if (frames_to_event < block_frames) block_frames = frames_to_event;
+        break;
+      }
+      handleMidiMessage(scheduled_messages_[scheduled_index++]);
+    }
+
+    MidiEvent event;
+    while (midi_queue_.peek(&event)){
+      int64_t offset = frames;
+      if (event.timestamp_ns < window_end){
+        offset = (event.timestamp_ns - window_start) * frame_rate_ / NANOS_IN_SECOND;
+      }
+      if (offset > frames_rendered){
+        int frames_to_event = (int) (offset - frames_rendered);
+        if (frames_to_event < block_frames) block_frames = frames_to_event;
+        break;
+      }
+      handleMidiMessage(event.message);
+      midi_queue_.pop();
+    }
+
+    renderBlock(block_frames, audio_buffer + frames_rendered * num_audio_channels_);
+    frames_rendered += block_frames;
+  }
+
+  // Events scheduled past the end of the buffer still happen, so no note is left hanging
+  while (scheduled_index < scheduled_count_){
+    handleMidiMessage(scheduled_messages_[scheduled_index++]);
+  }
+  scheduled_count_ = 0;
+
+  Trace::endSection();
+
+  return frames * num_audio_channels_;
+}
+
+void Synthesizer::renderBlock(int num_frames, int16_t *audio_buffer) {
+
+  if (fixed_point_enabled_){
+    renderFixedPointBlock(num_frames, audio_buffer);
+    return;
+  }
+
+  // One lane per voice. Voices are started in the lowest free lane, so only the lanes up to the
+  // highest active voice need rendering, padded out to a full set of SIMD lanes. Silent lanes
+  // within that range have a gain of 0.
+  int highest_lane = 0;
+  for (int i = 0; i < num_active_voices_; i++){
+    if (active_voices_[i] > highest_lane) highest_lane = active_voices_[i];
+  }
+  const int num_lanes = roundUpToSimdWidth(highest_lane + 1);
+  const bool has_active_voices = num_active_voices_ > 0;
+  for (int v = 0; v < num_lanes; v++){
+    voice_gains_[v] = voice_is_active_[v] ? voice_velocities_[v] : 0.0f;
+  }
+
+  ParameterRate modulation_rates[NUM_MOD_DESTINATIONS];
+  for (int d = 0; d < NUM_MOD_DESTINATIONS; d++){
+    ModulationDestination destination = (ModulationDestination) d;
+    modulation_rates[d] = parameter_rates_.resolve(getDestinationParameter(destination),
+                                                   modulation_.isChanging(destination));
+  }
+  modulation_.process(modulation_rates, num_lanes, num_frames);
+  const float *pitch_modulation = modulation_.getDestinationBuffer(MOD_DEST_PITCH);
+  const float *amplitude_modulation = modulation_.getDestinationBuffer(MOD_DEST_AMPLITUDE);
+  const float *pulse_width_modulation = modulation_.getDestinationBuffer(MOD_DEST_PULSE_WIDTH);
+
+  const float *automation[NUM_AUTOMATION_TARGETS];
+  for (int t = 0; t < NUM_AUTOMATION_TARGETS; t++){
+    float *buffer = automation_buffers_[t];
+    bool is_automated = automation_[t].process(automation_frame_, buffer, num_frames);
+    automation[t] = is_automated ? buffer : nullptr;
+  }
+  automation_frame_ += num_frames;
+  const float *cutoff_automation = automation[AUTOMATION_TARGET_CUTOFF];
+  const float *resonance_automation = automation[AUTOMATION_TARGET_RESONANCE];
+  const float *level_automation = automation[AUTOMATION_TARGET_LEVEL];
+
+  memset(left_buffer_, 0, sizeof(float) * num_lanes * num_frames);
+  memset(right_buffer_, 0, sizeof(float) * num_lanes * num_frames);
+  if (has_active_voices){
+    renderVoices(pitch_modulation, pulse_width_modulation, num_lanes, num_frames);
+  }
+
+  // Bypassed, the voices go straight to the mix and the cutoff and resonance stay where they are
+  if (filter_enabled_){
+    filterVoices(cutoff_automation, resonance_automation, num_lanes, num_frames);
+  }
+
+  // render an interleaved output. Even channels take the left mix and odd channels the right,
+  // a mono stream gets the sum of both.
+  // For example: 6 samples of a 2 channel output stream could look like this
+  // L1,R1,L2,R2,L3,R3
   int sample_count = 0;
+  for (int i = 0; i < num_frames; i++){
 
-  for (int i = 0; i < frames; i++){
+    float left = 0;
+    float right = 0;
+    for (int v = 0; v < num_lanes; v++){
+      int index = i * num_lanes + v;
+      float gain = amplitude_modulation[index] * voice_gains_[v];
+      left += left_buffer_[index] * gain;
+      right += right_buffer_[index] * gain;
+    }
+    if (level_automation){
+      left *= level_automation[i];
+      right *= level_automation[i];
+    }
+    if (num_audio_channels_ == 1) left = (left + right) * 0.5f;
 
-    int16_t value = (int16_t) ((is_playing_) ? sin(current_phase_) * current_volume_ : 0);
+    // A resonant filter can push the signal past the volume setting, so clip to the int16 range
+    float scaled_left = fminf(fmaxf(left * current_volume_, -INT16_MAX_VALUE), INT16_MAX_VALUE);
+    float scaled_right = fminf(fmaxf(right * current_volume_, -INT16_MAX_VALUE), INT16_MAX_VALUE);
 
     for (int j = 0; j < num_audio_channels_; j++){
-      audio_buffer[sample_count] = value;
+      audio_buffer[sample_count] = (int16_t) ((j & 1) ? scaled_right : scaled_left);
       sample_count++;
     }
+  }
+}
+
+/**
+ * Filter the voices in left_buffer_ and right_buffer_ in place, with the cutoff and resonance
+ * smoothed, automated and modulated and passed to the filters at their resolved rate.
+ */
+void Synthesizer::filterVoices(const float *cutoff_automation,
+                               const float *resonance_automation,
+                               int num_lanes,
+                               int num_frames) {
+
+  const float *cutoff_modulation = modulation_.getDestinationBuffer(MOD_DEST_CUTOFF);
+  const float *resonance_modulation = modulation_.getDestinationBuffer(MOD_DEST_RESONANCE);
 
-    if (current_phase_ > TWO_PI) current_phase_ -= TWO_PI;
-    current_phase_ += phase_increment_;
+  // Settle the smoothing, so that a parameter which has reached its target counts as constant
+  if (fabsf(target_cutoff_ - current_cutoff_) <= target_cutoff_ * CUTOFF_SETTLE_RATIO){
+    current_cutoff_ = target_cutoff_;
   }
+  if (fabsf(target_resonance_ - current_resonance_) <= RESONANCE_SETTLE_DISTANCE){
+    current_resonance_ = target_resonance_;
+  }
+  bool is_cutoff_changing = cutoff_automation || current_cutoff_ != target_cutoff_ ||
+      modulation_.isChanging(MOD_DEST_CUTOFF);
+  bool is_resonance_changing = resonance_automation || current_resonance_ != target_resonance_ ||
+      modulation_.isChanging(MOD_DEST_RESONANCE);
 
-  Trace::endSection();
+  // Both filter parameters go into each coefficient, so the faster of the two sets the interval.
+  // The enum is ordered slowest first.
+  ParameterRate cutoff_rate = parameter_rates_.resolve(SYNTH_PARAMETER_CUTOFF, is_cutoff_changing);
+  ParameterRate resonance_rate =
+      parameter_rates_.resolve(SYNTH_PARAMETER_RESONANCE, is_resonance_changing);
+  ParameterRate filter_rate = (cutoff_rate > resonance_rate) ? cutoff_rate : resonance_rate;
+  const int interval = ParameterRates::getInterval(filter_rate, num_frames);
+
+  // The cutoff and resonance still move every frame so parameter changes don't zipper, but the
+  // filters only get them at each interval
+  int num_points = 0;
+  for (int i = 0; i < num_frames; i++){
+    if (cutoff_automation){
+      current_cutoff_ = cutoff_automation[i];
+    } else {
+      current_cutoff_ += (target_cutoff_ - current_cutoff_) * parameter_smoothing_;
+    }
+    if (resonance_automation){
+      current_resonance_ = resonance_automation[i];
+    } else {
+      current_resonance_ += (target_resonance_ - current_resonance_) * parameter_smoothing_;
+    }
+    if (i % interval == 0){
+      storeFilterPoint(num_points++, i, num_lanes, cutoff_modulation, resonance_modulation);
+    }
+  }
+
+  // The point for the end of the block. At block rate the first point is held, otherwise the
+  // coefficients ramp towards the last frame's values and reach them at the start of the next
+  // block.
+  if (filter_rate >= PARAMETER_RATE_CONTROL){
+    storeFilterPoint(num_points, num_frames - 1, num_lanes, cutoff_modulation,
+                     resonance_modulation);
+  } else {
+    const int end = num_points * num_lanes;
+    memcpy(cutoff_points_ + end, cutoff_points_, sizeof(float) * num_lanes);
+    memcpy(resonance_points_ + end, resonance_points_, sizeof(float) * num_lanes);
+  }
+
+  left_filter_.process(left_buffer_, cutoff_points_, resonance_points_, interval, num_lanes,
+                       num_frames);
+  right_filter_.process(right_buffer_, cutoff_points_, resonance_points_, interval, num_lanes,
+                        num_frames);
+}
+
+void Synthesizer::renderFixedPointBlock(int num_frames, int16_t *audio_buffer) {
+
+  // Automation keeps its place so the float path picks up at the right point if switched back
+  automation_frame_ += num_frames;
+
+  // The volume is folded into each voice's gain, 10000 is about -10 dBFS in Q15
+  for (int i = 0; i < num_active_voices_; i++){
+    int v = active_voices_[i];
+    fixed_point_gains_[v] = (int16_t) (voice_velocities_[v] * current_volume_);
+  }
+  memset(fixed_point_mix_, 0, sizeof(int16_t) * roundUpToFixedPointVector(num_frames));
+  fixed_point_.render(active_voices_, num_active_voices_, fixed_point_gains_, fixed_point_mix_,
+                      num_frames);
+
+  int sample_count = 0;
+  for (int i = 0; i < num_frames; i++){
+    for (int j = 0; j < num_audio_channels_; j++){
+      audio_buffer[sample_count] = fixed_point_mix_[i];
+      sample_count++;
+    }
+  }
+}
+
+/**
+ * Store the current cutoff and resonance, modulated for each voice at a frame, as a filter point.
+ * Called as the parameters are smoothed, so they are the values at that frame.
+ */
+void Synthesizer::storeFilterPoint(int point,
+                                   int frame,
+                                   int num_lanes,
+                                   const float *cutoff_modulation,
+                                   const float *resonance_modulation){
+
+  float *cutoff = cutoff_points_ + point * num_lanes;
+  float *resonance = resonance_points_ + point * num_lanes;
+  const int index = frame * num_lanes;
+  for (int v = 0; v < num_lanes; v++){
+    cutoff[v] = current_cutoff_ * cutoff_modulation[index + v];
+    resonance[v] = current_resonance_ + resonance_modulation[index + v];
+  }
+}
+
+void Synthesizer::renderVoices(const float *pitch_modulation,
+                               const float *pulse_width_modulation,
+                               int num_lanes,
+                               int num_frames) {
+
+  // Oscillators which render one voice at a time only visit the active voices
+  if (voice_type_ == VOICE_TYPE_UNISON_SAW){
+    for (int i = 0; i < num_active_voices_; i++){
+      unison_.render(active_voices_[i], pitch_modulation, left_buffer_, right_buffer_,
+                     num_lanes, num_frames);
+    }
+    return;
+  }
+
+  if (voice_type_ == VOICE_TYPE_ADDITIVE){
+    for (int i = 0; i < num_active_voices_; i++){
+      additive_.render(active_voices_[i], pitch_modulation, left_buffer_, right_buffer_,
+                       num_lanes, num_frames);
+    }
+    return;
+  }
+
+  if (voice_type_ == VOICE_TYPE_CLASSIC){
+    classic_.render(pitch_modulation, pulse_width_modulation, left_buffer_, right_buffer_,
+                    num_lanes, num_frames);
+    return;
+  }
+
+  if (voice_type_ == VOICE_TYPE_WAVETABLE){
+    wavetable_.render(pitch_modulation, left_buffer_, right_buffer_, num_lanes, num_frames);
+    return;
+  }
+
+  if (voice_type_ == VOICE_TYPE_NOISE){
+    noise_.generate(noise_buffer_, num_frames);
+    for (int i = 0; i < num_frames; i++){
+      for (int v = 0; v < num_lanes; v++){
+        left_buffer_[i * num_lanes + v] = noise_buffer_[i];
+        right_buffer_[i * num_lanes + v] = noise_buffer_[i];
+      }
+    }
+    return;
+  }
+
+  if (voice_type_ == VOICE_TYPE_FM){
+    fm_.render(pitch_modulation, left_buffer_, right_buffer_, num_lanes, num_frames);
+    return;
+  }
+
+  // Sine voices run across lanes like the filters, SIMD_WIDTH voices per instruction
+  for (int i = 0; i < num_frames; i++){
+    for (int v = 0; v < num_lanes; v++){
+      int index = i * num_lanes + v;
+      float value = fastSine(voice_phases_[v]);
+      left_buffer_[index] = value;
+      right_buffer_[index] = value;
+
+      float phase = voice_phases_[v] + voice_phase_increments_[v] * pitch_modulation[index];
+      voice_phases_[v] = (phase >= 1.0f) ? phase - 1.0f : phase;
+    }
+  }
+}
+
+void Synthesizer::handleMidiMessage(const MidiMessage &message) {
+
+  if (message.status >= MIDI_SYSEX_START) return;
+  int channel = midiChannel(message);
+
+  switch (midiMessageType(message)){
+    case MIDI_NOTE_ON:
+      if (message.data_2 > 0){
+        startNote(channel, message.data_1, message.data_2);
+      } else {
+        stopNote(channel, message.data_1);
+      }
+      break;
+    case MIDI_NOTE_OFF:
+      stopNote(channel, message.data_1);
+      break;
+    case MIDI_POLY_PRESSURE:
+      for (int v = 0; v < SYNTH_POLYPHONY; v++){
+        if (voice_is_active_[v] && voice_channels_[v] == channel &&
+            voice_notes_[v] == message.data_1){
+          modulation_.setExpression(v, EXPRESSION_PRESSURE, message.data_2 / 127.0f);
+        }
+      }
+      break;
+    case MIDI_CHANNEL_PRESSURE:
+      setChannelExpression(channel, EXPRESSION_PRESSURE, message.data_1 / 127.0f);
+      break;
+    case MIDI_PITCH_BEND:
+      setChannelExpression(channel, EXPRESSION_PITCH_BEND,
+                           (((message.data_2 << 7) | message.data_1) - 8192) / 8192.0f);
+      break;
+    case MIDI_CONTROL_CHANGE:
+      if (message.data_1 == MIDI_CC_TIMBRE){
+        setChannelExpression(channel, EXPRESSION_TIMBRE, message.data_2 / 127.0f);
+      } else if (message.data_1 == MIDI_CC_ALL_SOUND_OFF ||
+                 message.data_1 == MIDI_CC_ALL_NOTES_OFF){
+        stopAllNotes();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Store a channel's controller value and pass it on to the voices it applies to. With MPE each
+ * member channel owns a single voice, which is found through channel_voices_ without searching.
+ * The manager channel's pitch bend applies to every voice.
+ */
+void Synthesizer::setChannelExpression(int channel, Expression expression, float value) {
 
-  return sample_count;
+  channel_expressions_[expression][channel] = value;
+
+  if (mpe_enabled_ && channel != MPE_MANAGER_CHANNEL){
+    int v = channel_voices_[channel];
+    if (v >= 0) modulation_.setExpression(v, expression, getVoiceExpression(v, expression));
+    return;
+  }
+
+  bool is_global = mpe_enabled_ && expression == EXPRESSION_PITCH_BEND;
+  for (int v = 0; v < SYNTH_POLYPHONY; v++){
+    if (voice_is_active_[v] && (is_global || voice_channels_[v] == channel)){
+      modulation_.setExpression(v, expression, getVoiceExpression(v, expression));
+    }
+  }
+}
+
+/**
+ * The value of an expression for a voice, from the state of its channel. Pitch bend is converted
+ * to semitones, and with MPE the manager channel's bend is added to the member channel's.
+ */
+float Synthesizer::getVoiceExpression(int voice_index, Expression expression) {
+
+  int channel = voice_channels_[voice_index];
+  float value = channel_expressions_[expression][channel];
+  if (expression != EXPRESSION_PITCH_BEND) return value;
+
+  if (!mpe_enabled_ || channel == MPE_MANAGER_CHANNEL) return value * DEFAULT_PITCH_BEND_RANGE;
+  float manager_bend = channel_expressions_[EXPRESSION_PITCH_BEND][MPE_MANAGER_CHANNEL];
+  return value * mpe_pitch_bend_range_ + manager_bend * DEFAULT_PITCH_BEND_RANGE;
+}
+
+void Synthesizer::startNote(int channel, int note, int velocity) {
+
+  // Retrigger a voice already playing this note, otherwise take the lowest free lane (which
+  // keeps the active lanes packed together) or the oldest voice
+  int voice_index = -1;
+  for (int i = 0; i < num_active_voices_; i++){
+    int v = active_voices_[i];
+    if (voice_channels_[v] == channel && voice_notes_[v] == note) voice_index = v;
+  }
+  if (voice_index < 0 && num_active_voices_ < SYNTH_POLYPHONY){
+    voice_index = 0;
+    while (voice_is_active_[voice_index]) voice_index++;
+  }
+  if (voice_index < 0){
+    voice_index = 0;
+    for (int v = 1; v < SYNTH_POLYPHONY; v++){
+      if (voice_start_count_ - voice_start_orders_[v] >
+          voice_start_count_ - voice_start_orders_[voice_index]){
+        voice_index = v;
+      }
+    }
+  }
+
+  // Only the first note after silence restarts the automation, later notes play over it
+  if (num_active_voices_ == 0) automation_frame_ = 0;
+
+  if (voice_is_active_[voice_index]){
+    if (channel_voices_[voice_channels_[voice_index]] == voice_index){
+      channel_voices_[voice_channels_[voice_index]] = -1;
+    }
+  } else {
+    voice_is_active_[voice_index] = true;
+    active_voice_positions_[voice_index] = num_active_voices_;
+    active_voices_[num_active_voices_++] = voice_index;
+  }
+  channel_voices_[channel] = voice_index;
+
+  float frequency = reference_frequency_ * powf(2.0f, (note - A4_NOTE) / 12.0f);
+  voice_channels_[voice_index] = channel;
+  voice_notes_[voice_index] = note;
+  voice_velocities_[voice_index] = velocity / 127.0f;
+  voice_start_orders_[voice_index] = voice_start_count_++;
+  voice_phases_[voice_index] = 0;
+  voice_phase_increments_[voice_index] = frequency / frame_rate_;
+
+  // The lane may not have been rendered since its last voice ended, so clear the filter too
+  left_filter_.resetVoice(voice_index);
+  right_filter_.resetVoice(voice_index);
+
+  unison_.setFrequency(voice_index, frequency);
+  fm_.setFrequency(voice_index, frequency);
+  additive_.setFrequency(voice_index, frequency);
+  classic_.setFrequency(voice_index, frequency);
+  wavetable_.setFrequency(voice_index, frequency);
+  fixed_point_.setFrequency(voice_index, frequency);
+  modulation_.resetVoice(voice_index);
+  for (int e = 0; e < NUM_EXPRESSIONS; e++){
+    modulation_.resetExpression(voice_index, (Expression) e,
+                                getVoiceExpression(voice_index, (Expression) e));
+  }
+  unison_.resetVoice(voice_index);
+  fm_.resetVoice(voice_index);
+  additive_.resetVoice(voice_index);
+  fm_.setVoiceLevel(voice_index, 1.0f);
+  classic_.resetVoice(voice_index);
+  classic_.setVoiceLevel(voice_index, 1.0f);
+  wavetable_.resetVoice(voice_index);
+  wavetable_.setVoiceLevel(voice_index, 1.0f);
+  fixed_point_.resetVoice(voice_index);
+}
+
+void Synthesizer::stopNote(int channel, int note) {
+  for (int i = num_active_voices_ - 1; i >= 0; i--){
+    int v = active_voices_[i];
+    if (voice_channels_[v] == channel && voice_notes_[v] == note) stopVoice(v);
+  }
+}
+
+void Synthesizer::stopAllNotes() {
+  while (num_active_voices_ > 0) stopVoice(active_voices_[num_active_voices_ - 1]);
+}
+
+/**
+ * Silence a voice and remove it from the active list, moving the last active voice into its
+ * place so the list stays packed.
+ */
+void Synthesizer::stopVoice(int voice_index) {
+
+  if (channel_voices_[voice_channels_[voice_index]] == voice_index){
+    channel_voices_[voice_channels_[voice_index]] = -1;
+  }
+  voice_is_active_[voice_index] = false;
+  fm_.setVoiceLevel(voice_index, 0.0f);
+  classic_.setVoiceLevel(voice_index, 0.0f);
+  wavetable_.setVoiceLevel(voice_index, 0.0f);
+
+  int position = active_voice_positions_[voice_index];
+  int last_voice = active_voices_[--num_active_voices_];
+  active_voices_[position] = last_voice;
+  active_voice_positions_[last_voice] = position;
 }
 
 void Synthesizer::setVolume(int volume) {
@@ -73,17 +593,172 @@ void Synthesizer::setVolume(int volume) {
 }
 
 void Synthesizer::setWaveFrequency(float wave_frequency) {
-  phase_increment_ = TWO_PI * wave_frequency / frame_rate_;
+  reference_frequency_ = wave_frequency;
 }
 
 void Synthesizer::noteOn() {
-  is_playing_ = true;
+  uint8_t message[] = {MIDI_NOTE_ON, A4_NOTE, LEGACY_NOTE_VELOCITY};
+  sendMidi(message, sizeof(message), get_time());
 }
 
 void Synthesizer::noteOff() {
-  is_playing_ = false;
+  uint8_t message[] = {MIDI_NOTE_OFF, A4_NOTE, 0};
+  sendMidi(message, sizeof(message), get_time());
+}
+
+void Synthesizer::sendMidi(const uint8_t *data, int length, int64_t timestamp_ns) {
+
+  std::lock_guard<std::mutex> lock(midi_input_lock_);
+  MidiEvent event;
+  event.timestamp_ns = timestamp_ns;
+  for (int i = 0; i < length; i++){
+    if (midi_parser_.parse(data[i], &event.message) && !midi_queue_.push(event)){
+      LOGW("MIDI event queue is full, dropping event");
+    }
+  }
+}
+
+bool Synthesizer::scheduleMidi(const MidiMessage &message, int frame_offset) {
+  if (scheduled_count_ == MAX_SCHEDULED_MIDI_EVENTS) return false;
+  scheduled_messages_[scheduled_count_] = message;
+  scheduled_offsets_[scheduled_count_] = frame_offset;
+  scheduled_count_++;
+  return true;
+}
+
+void Synthesizer::setMpeEnabled(bool is_enabled){
+  mpe_enabled_ = is_enabled;
+}
+
+void Synthesizer::setMpePitchBendRange(float semitones){
+  mpe_pitch_bend_range_ = semitones;
 }
 
 void Synthesizer::setWorkCycles(int work_cycles){
   work_cycles_ = work_cycles;
 }
+
+void Synthesizer::setFixedPointEnabled(bool is_enabled){
+  fixed_point_enabled_ = is_enabled;
+}
+
+void Synthesizer::setVoiceType(VoiceType voice_type){
+  voice_type_ = voice_type;
+}
+
+void Synthesizer::setUnisonVoices(int voice_count){
+  unison_.setVoiceCount(voice_count);
+}
+
+void Synthesizer::setUnisonDetune(float semitones){
+  unison_.setDetune(semitones);
+}
+
+void Synthesizer::setUnisonSpread(float spread){
+  unison_.setStereoSpread(spread);
+}
+
+void Synthesizer::setFmAlgorithm(int algorithm){
+  fm_.setAlgorithm(algorithm);
+}
+
+void Synthesizer::setFmFeedback(float feedback){
+  fm_.setFeedback(feedback);
+}
+
+void Synthesizer::setFmOperator(int op, float ratio, float level){
+  fm_.setOperatorRatio(op, ratio);
+  fm_.setOperatorLevel(op, level);
+}
+
+void Synthesizer::setAdditivePartialCount(int partial_count){
+  additive_.setPartialCount(partial_count);
+}
+
+void Synthesizer::setAdditivePartial(int index, float ratio, float amplitude){
+  additive_.setPartial(index, ratio, amplitude);
+}
+
+void Synthesizer::setNoiseColor(NoiseColor color){
+  noise_.setColor(color);
+}
+
+void Synthesizer::setWaveform(Waveform waveform){
+  classic_.setWaveform(waveform);
+}
+
+void Synthesizer::setPulseWidth(float pulse_width){
+  classic_.setPulseWidth(pulse_width);
+}
+
+bool Synthesizer::loadWavetable(const std::string &wav_path,
+                                const std::string &cache_dir,
+                                int cycle_length){
+
+  // Only one caller gets to start a load, the last load's thread has finished once its state
+  // isn't in progress
+  WavetableLoadState state = wavetable_load_state_.load(std::memory_order_acquire);
+  do {
+    if (state == WAVETABLE_LOAD_IN_PROGRESS) return false;
+  } while (!wavetable_load_state_.compare_exchange_weak(state, WAVETABLE_LOAD_IN_PROGRESS,
+                                                        std::memory_order_acq_rel));
+  if (wavetable_loader_.joinable()) wavetable_loader_.join();
+
+  wavetable_loader_ = std::thread([this, wav_path, cache_dir, cycle_length](){
+    std::unique_ptr<Wavetable> table = Wavetable::load(wav_path, cache_dir, cycle_length);
+    bool is_loaded = (table != nullptr);
+    if (is_loaded){
+      LOGI("Loaded wavetable %s, %d frame(s), %s", wav_path.c_str(), table->getFrameCount(),
+           table->isMapped() ? "mapped" : "in memory");
+      wavetable_.setTable(std::move(table));
+    }
+    wavetable_load_state_.store(is_loaded ? WAVETABLE_LOAD_COMPLETE : WAVETABLE_LOAD_FAILED,
+                                std::memory_order_release);
+  });
+  return true;
+}
+
+void Synthesizer::setWavetablePosition(float position){
+  wavetable_.setPosition(position);
+}
+
+void Synthesizer::setFilterCutoff(float cutoff_hz){
+  target_cutoff_ = cutoff_hz;
+}
+
+void Synthesizer::setFilterResonance(float resonance){
+  target_resonance_ = resonance;
+}
+
+void Synthesizer::setFilterEnabled(bool is_enabled){
+  filter_enabled_ = is_enabled;
+}
+
+void Synthesizer::setFilterMode(FilterMode mode){
+  left_filter_.setMode(mode);
+  right_filter_.setMode(mode);
+}
+
+void Synthesizer::setParameterRate(SynthParameter parameter, ParameterRate rate){
+  parameter_rates_.setRate(parameter, rate);
+}
+
+void Synthesizer::setLfoRate(int lfo, float rate_hz){
+  modulation_.setLfoRate(lfo, rate_hz);
+}
+
+void Synthesizer::setLfoShape(int lfo, LfoShape shape){
+  modulation_.setLfoShape(lfo, shape);
+}
+
+void Synthesizer::setModulationRoute(int slot,
+                                     ModulationSource source,
+                                     ModulationDestination destination,
+                                     float depth){
+  modulation_.setRoute(slot, source, destination, depth);
+}
+
+void Synthesizer::setAutomation(AutomationTarget target, const Breakpoint *breakpoints, int count){
+  if (target < 0 || target >= NUM_AUTOMATION_TARGETS) return;
+  automation_[target].setBreakpoints(breakpoints, count);
+}
@@ -19,36 +19,282 @@
 
 #include <stdint.h>
 #include <math.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
 #include "audio_renderer.h"
+#include "audio_common.h"
+#include "state_variable_filter.h"
+#include "modulation_matrix.h"
+#include "parameter_rate.h"
+#include "unison_oscillator.h"
+#include "fm_voice.h"
+#include "additive_oscillator.h"
+#include "noise_generator.h"
+#include "classic_oscillator.h"
+#include "fixed_point_oscillator.h"
+#include "wavetable_oscillator.h"
+#include "automation_lane.h"
+#include "midi_parser.h"
+#include "midi_event_queue.h"
 
 #define MAXIMUM_AMPLITUDE_VALUE 10000
+#define SYNTH_POLYPHONY 16
+#define NUM_MIDI_CHANNELS 16
+#define MAX_SCHEDULED_MIDI_EVENTS 256
 
+enum VoiceType {
+  VOICE_TYPE_SINE,
+  VOICE_TYPE_UNISON_SAW,
+  VOICE_TYPE_FM,
+  VOICE_TYPE_ADDITIVE,
+  VOICE_TYPE_NOISE,
+  VOICE_TYPE_CLASSIC,
+  VOICE_TYPE_WAVETABLE
+};
+
+enum WavetableLoadState {
+  WAVETABLE_LOAD_NONE,
+  WAVETABLE_LOAD_IN_PROGRESS,
+  WAVETABLE_LOAD_COMPLETE,
+  WAVETABLE_LOAD_FAILED
+};
+
+// Parameters which can follow an automation curve. The curve values are in the parameter's own
+// units: Hz for the cutoff, 0 to 1 for the level.
+enum AutomationTarget {
+  AUTOMATION_TARGET_CUTOFF,
+  AUTOMATION_TARGET_RESONANCE,
+  AUTOMATION_TARGET_LEVEL,
+  NUM_AUTOMATION_TARGETS
+};
 
 class Synthesizer : public AudioRenderer {
 
 public:
   Synthesizer(int num_audio_channels, int frame_rate);
 
+  // Waits for any wavetable load to finish
+  ~Synthesizer();
+
   virtual int render(int num_samples, int16_t *audio_buffer);
 
   void setVolume(int volume);
 
   void setWaveFrequency(float wave_frequency);
 
+  // Play and release A4 at the wave frequency, these go through the MIDI queue like any other note
   void noteOn();
 
   void noteOff();
 
+  /**
+   * Send a MIDI 1.0 byte stream to the synth, which may be split anywhere between calls. Can be
+   * called from any thread except the audio thread. Notes are played a buffer period after their
+   * timestamp so that they start at the same position in the output regardless of when the
+   * audio callback happens to run.
+   *
+   * @param timestamp_ns when the bytes arrived, on the get_time() clock
+   */
+  void sendMidi(const uint8_t *data, int length, int64_t timestamp_ns);
+
+  /**
+   * Play a message at an exact frame offset into the next call to render. Must be called from
+   * the thread which calls render, in order of offset, e.g. by a sequencer wrapping the synth.
+   *
+   * @return false if there is no room for more events before the next render
+   */
+  bool scheduleMidi(const MidiMessage &message, int frame_offset);
+
+  /**
+   * Treat MIDI input as MPE, in a lower zone where channel 1 is the manager channel. Pitch bend,
+   * channel pressure and CC 74 (timbre) on a member channel only affect the note on that channel.
+   * Pressure and timbre are the MOD_SOURCE_PRESSURE and MOD_SOURCE_TIMBRE modulation sources.
+   */
+  void setMpeEnabled(bool is_enabled);
+
+  // The pitch bend range of the MPE member channels
+  void setMpePitchBendRange(float semitones);
+
   void setWorkCycles(int work_cycles);
 
+  /**
+   * Render with integer arithmetic only: Q15 sine voices, a saturating Q15 mix and no filter,
+   * modulation or automation. For comparing against the float path on devices with slow floating
+   * point, whatever the voice type.
+   */
+  void setFixedPointEnabled(bool is_enabled);
+
+  void setVoiceType(VoiceType voice_type);
+
+  void setUnisonVoices(int voice_count);
+
+  void setUnisonDetune(float semitones);
+
+  void setUnisonSpread(float spread);
+
+  void setFmAlgorithm(int algorithm);
+
+  void setFmFeedback(float feedback);
+
+  void setFmOperator(int op, float ratio, float level);
+
+  void setAdditivePartialCount(int partial_count);
+
+  void setAdditivePartial(int index, float ratio, float amplitude);
+
+  void setNoiseColor(NoiseColor color);
+
+  void setWaveform(Waveform waveform);
+
+  void setPulseWidth(float pulse_width);
+
+  /**
+   * Start loading a wavetable from a WAV file for the wavetable voices, on a background thread.
+   * See Wavetable::load for the arguments. The current table keeps playing until the new one is
+   * ready, a load which fails leaves it in place.
+   *
+   * @return false if a load is already in progress
+   */
+  bool loadWavetable(const std::string &wav_path, const std::string &cache_dir, int cycle_length);
+
+  WavetableLoadState getWavetableLoadState() const {
+    return wavetable_load_state_.load(std::memory_order_acquire);
+  }
+
+  // From 0 for the first frame of the wavetable to 1 for the last
+  void setWavetablePosition(float position);
+
+  void setFilterCutoff(float cutoff_hz);
+
+  void setFilterResonance(float resonance);
+
+  void setFilterMode(FilterMode mode);
+
+  // Bypass the filters, e.g. to compare the float path with the fixed point one, which has none
+  void setFilterEnabled(bool is_enabled);
+
+  // Set the rate a parameter is evaluated at while it's changing, see parameter_rate.h
+  void setParameterRate(SynthParameter parameter, ParameterRate rate);
+
+  void setLfoRate(int lfo, float rate_hz);
+
+  void setLfoShape(int lfo, LfoShape shape);
+
+  void setModulationRoute(int slot,
+                          ModulationSource source,
+                          ModulationDestination destination,
+                          float depth);
+
+  void setAutomation(AutomationTarget target, const Breakpoint *breakpoints, int count);
+
 private:
+  void handleMidiMessage(const MidiMessage &message);
+  void setChannelExpression(int channel, Expression expression, float value);
+  float getVoiceExpression(int voice_index, Expression expression);
+  void startNote(int channel, int note, int velocity);
+  void stopNote(int channel, int note);
+  void stopAllNotes();
+  void stopVoice(int voice_index);
+  void renderBlock(int num_frames, int16_t *audio_buffer);
+  void renderFixedPointBlock(int num_frames, int16_t *audio_buffer);
+  void filterVoices(const float *cutoff_automation,
+                    const float *resonance_automation,
+                    int num_lanes,
+                    int num_frames);
+  void storeFilterPoint(int point,
+                        int frame,
+                        int num_lanes,
+                        const float *cutoff_modulation,
+                        const float *resonance_modulation);
+  void renderVoices(const float *pitch_modulation,
+                    const float *pulse_width_modulation,
+                    int num_lanes,
+                    int num_frames);
+
   int num_audio_channels_;
   int frame_rate_;
-  double phase_increment_;
-  double current_phase_ = 0.0;
+  float reference_frequency_;  // the frequency of A4
   int current_volume_ = MAXIMUM_AMPLITUDE_VALUE;
-  bool is_playing_ = false;
   int work_cycles_ = 0;
+  VoiceType voice_type_ = VOICE_TYPE_SINE;
+  UnisonOscillator unison_;
+  FmVoice fm_;
+  AdditiveOscillator additive_;
+  NoiseGenerator noise_;
+  ClassicOscillator classic_;
+  WavetableOscillator wavetable_;
+  std::thread wavetable_loader_;
+  std::atomic<WavetableLoadState> wavetable_load_state_ {WAVETABLE_LOAD_NONE};
+  float noise_buffer_[MAX_BLOCK_FRAMES];
+  bool fixed_point_enabled_ = false;
+  FixedPointOscillator fixed_point_;
+  int16_t fixed_point_gains_[MAX_VOICES];   // Q15
+  int16_t fixed_point_mix_[MAX_BLOCK_FRAMES];
+
+  // Voices are only started and stopped on the audio thread, as events come out of the queue.
+  // The MIDI inputs may be on different threads, so they take turns to parse and push.
+  //
+  // The voice state is stored as arrays indexed by lane, like the oscillators and filters, so
+  // that per voice loops run across SIMD_WIDTH voices at a time. The lanes of the active voices
+  // are also kept packed in active_voices_, for the work which is done one voice at a time.
+  bool voice_is_active_[MAX_VOICES];
+  int voice_channels_[MAX_VOICES];
+  int voice_notes_[MAX_VOICES];
+  float voice_velocities_[MAX_VOICES];            // 0 to 1
+  uint32_t voice_start_orders_[MAX_VOICES];       // used to steal the oldest voice
+  float voice_phases_[MAX_VOICES];                // sine voices, in cycles
+  float voice_phase_increments_[MAX_VOICES];      // cycles per frame
+  float voice_gains_[MAX_VOICES];
+  int active_voices_[SYNTH_POLYPHONY];
+  int active_voice_positions_[MAX_VOICES];        // where each active lane is in active_voices_
+  int num_active_voices_ = 0;
+  uint32_t voice_start_count_ = 0;
+  bool mpe_enabled_ = false;
+  float mpe_pitch_bend_range_;
+
+  // The last controller values on each channel, and the voice playing on each channel (or -1)
+  float channel_expressions_[NUM_EXPRESSIONS][NUM_MIDI_CHANNELS];
+  int channel_voices_[NUM_MIDI_CHANNELS];
+
+  MidiMessage scheduled_messages_[MAX_SCHEDULED_MIDI_EVENTS];
+  int scheduled_offsets_[MAX_SCHEDULED_MIDI_EVENTS];
+  int scheduled_count_ = 0;
+
+  MidiEventQueue midi_queue_;
+  MidiParser midi_parser_;
+  std::mutex midi_input_lock_;
+
+  // Filter parameters are smoothed per frame towards the values set from the UI, and passed to
+  // the filters at the rate from parameter_rates_. Voices are stereo, so there is a filter bank
+  // for each side.
+  StateVariableFilter left_filter_;
+  StateVariableFilter right_filter_;
+  bool filter_enabled_ = true;
+  float target_cutoff_;
+  float target_resonance_ = 0;
+  float current_cutoff_;
+  float current_resonance_ = 0;
+  float parameter_smoothing_;
+  ParameterRates parameter_rates_;
+
+  ModulationMatrix modulation_;
+
+  // Automation is timed in frames from the first note after all the voices were silent. An
+  // automated cutoff or resonance replaces the smoothed value set from the UI.
+  AutomationLane automation_[NUM_AUTOMATION_TARGETS];
+  float automation_buffers_[NUM_AUTOMATION_TARGETS][MAX_BLOCK_FRAMES];
+  int64_t automation_frame_ = 0;
+
+  // Per voice working buffers, see audio_common.h for the layout
+  float left_buffer_[MAX_VOICES * MAX_BLOCK_FRAMES];
+  float right_buffer_[MAX_VOICES * MAX_BLOCK_FRAMES];
+
+  // The cutoff and resonance for each voice at each point the filters evaluate them, with one
+  // extra point for the end of the block
+  float cutoff_points_[MAX_VOICES * (MAX_BLOCK_FRAMES + 1)];
+  float resonance_points_[MAX_VOICES * (MAX_BLOCK_FRAMES + 1)];
 };
 
 #endif //SIMPLESYNTH_SYNTHESIZER_H
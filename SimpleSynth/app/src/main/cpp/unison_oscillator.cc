@@ -0,0 +1,156 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include "unison_oscillator.h"
+
+#define QUARTER_PI_F 0.78539816f
+
+// PolyBLEP assumes that a discontinuity is at least two samples from the next one, which caps
+// the frequency at a quarter of the frame rate once the detune has been applied
+#define MAX_PHASE_INCREMENT 0.2f
+
+UnisonOscillator::UnisonOscillator(int frame_rate) :
+    frame_rate_(frame_rate) {
+
+  for (int v = 0; v < MAX_VOICES; v++) {
+    phase_increments_[v] = 0;
+    resetVoice(v);
+  }
+  updateTables();
+}
+
+void UnisonOscillator::setVoiceCount(int voice_count) {
+  if (voice_count < 1) voice_count = 1;
+  if (voice_count > MAX_UNISON_VOICES) voice_count = MAX_UNISON_VOICES;
+  voice_count_ = voice_count;
+}
+
+void UnisonOscillator::setDetune(float semitones) {
+  detune_ = fmaxf(semitones, 0.0f);
+}
+
+void UnisonOscillator::setStereoSpread(float spread) {
+  stereo_spread_ = fminf(fmaxf(spread, 0.0f), 1.0f);
+}
+
+void UnisonOscillator::setFrequency(int lane, float frequency_hz) {
+  phase_increments_[lane] = frequency_hz / frame_rate_;
+}
+
+void UnisonOscillator::resetVoice(int lane) {
+
+  for (int u = 0; u < MAX_UNISON_VOICES; u++) {
+    // xorshift32, the phases only need to be different from each other
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 17;
+    random_state_ ^= random_state_ << 5;
+    phases_[lane][u] = (random_state_ >> 8) * (1.0f / 16777216.0f);
+  }
+}
+
+void UnisonOscillator::updateTables() {
+
+  int voice_count = voice_count_;
+  float detune = detune_;
+  float stereo_spread = stereo_spread_;
+  if (voice_count == table_voice_count_ && detune == table_detune_ &&
+      stereo_spread == table_stereo_spread_) return;
+
+  // Equal power panning, scaled so that the loudness doesn't change with the voice count
+  float level = sqrtf(2.0f / voice_count);
+
+  for (int u = 0; u < MAX_UNISON_VOICES; u++) {
+    if (u < voice_count) {
+      // Position of the sub-oscillator from -1 to 1, the detune and the pan both follow it
+      float position = (voice_count > 1) ? (2.0f * u / (voice_count - 1) - 1.0f) : 0.0f;
+      float ratio = exp2f(detune * position / 12.0f);
+      float angle = (stereo_spread * position + 1.0f) * QUARTER_PI_F;
+      detune_ratios_[u] = ratio;
+      inverse_detune_ratios_[u] = 1.0f / ratio;
+      left_gains_[u] = cosf(angle) * level;
+      right_gains_[u] = sinf(angle) * level;
+    } else {
+      detune_ratios_[u] = 1.0f;
+      inverse_detune_ratios_[u] = 1.0f;
+      left_gains_[u] = 0;
+      right_gains_[u] = 0;
+    }
+  }
+
+  num_sub_oscillators_ = roundUpToSimdWidth(voice_count);
+  table_voice_count_ = voice_count;
+  table_detune_ = detune;
+  table_stereo_spread_ = stereo_spread;
+}
+
+void UnisonOscillator::render(int lane,
+                              const float *pitch_modulation,
+                              float *left_buffer,
+                              float *right_buffer,
+                              int num_lanes,
+                              int num_frames) {
+
+  assert(lane < num_lanes && num_lanes <= MAX_VOICES && num_frames <= MAX_BLOCK_FRAMES);
+
+  updateTables();
+
+  float *phases = phases_[lane];
+  const float max_increment = MAX_PHASE_INCREMENT / detune_ratios_[table_voice_count_ - 1];
+
+  for (int i = 0; i < num_frames; i++) {
+
+    int index = i * num_lanes + lane;
+    float voice_increment = phase_increments_[lane] * pitch_modulation[index];
+    voice_increment = fminf(fmaxf(voice_increment, 1e-6f), max_increment);
+    float inverse_increment = 1.0f / voice_increment;
+
+    float left_sums[SIMD_WIDTH] = {0};
+    float right_sums[SIMD_WIDTH] = {0};
+
+    for (int u = 0; u < num_sub_oscillators_; u += SIMD_WIDTH) {
+      for (int k = 0; k < SIMD_WIDTH; k++) {
+        float dt = voice_increment * detune_ratios_[u + k];
+        float inverse_dt = inverse_increment * inverse_detune_ratios_[u + k];
+
+        float t = phases[u + k] + dt;
+        t -= (t >= 1.0f) ? 1.0f : 0.0f;
+        phases[u + k] = t;
+
+        // PolyBLEP residuals for just after and just before the wrap, only one of which can
+        // apply since dt is less than half a cycle
+        float after = t * inverse_dt;
+        float before = (t - 1.0f) * inverse_dt;
+        float blep = (t < dt) ? (after + after - after * after - 1.0f) : 0.0f;
+        blep += (t > 1.0f - dt) ? (before * before + before + before + 1.0f) : 0.0f;
+
+        float saw = t + t - 1.0f - blep;
+        left_sums[k] += saw * left_gains_[u + k];
+        right_sums[k] += saw * right_gains_[u + k];
+      }
+    }
+
+    float left = 0;
+    float right = 0;
+    for (int k = 0; k < SIMD_WIDTH; k++) {
+      left += left_sums[k];
+      right += right_sums[k];
+    }
+    left_buffer[index] += left;
+    right_buffer[index] += right;
+  }
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_UNISON_OSCILLATOR_H
+#define SIMPLESYNTH_UNISON_OSCILLATOR_H
+
+#include "audio_common.h"
+
+#define MAX_UNISON_VOICES 16
+
+/**
+ * A unison ("supersaw") oscillator. Each note plays a stack of detuned sawtooth sub-oscillators
+ * which are spread across the stereo field.
+ *
+ * The sub-oscillators of a note are stored side by side and the inner loop runs across them, so
+ * each instruction advances SIMD_WIDTH sub-oscillators at once. The sub-oscillator count is
+ * rounded up to SIMD_WIDTH, the padding sub-oscillators have a gain of 0. The saws are band
+ * limited with PolyBLEP, the correction is computed for every sub-oscillator and masked rather
+ * than branched on so that the loop has no data dependent branches.
+ *
+ * The detune ratios and pan gains are shared by all notes. They are recalculated on the audio
+ * thread when the settings change, so the setters can be called from any thread.
+ */
+class UnisonOscillator {
+
+public:
+  UnisonOscillator(int frame_rate);
+
+  // Number of sub-oscillators per note, from 1 to MAX_UNISON_VOICES
+  void setVoiceCount(int voice_count);
+
+  // Distance in semitones from the centre pitch to the outermost sub-oscillators
+  void setDetune(float semitones);
+
+  // Stereo width from 0 (mono) to 1 (outermost sub-oscillators hard left and right)
+  void setStereoSpread(float spread);
+
+  void setFrequency(int lane, float frequency_hz);
+
+  // Start a new note on a voice. Each sub-oscillator starts from a different phase, otherwise
+  // the saws would line up and the note would start with a loud click.
+  void resetVoice(int lane);
+
+  /**
+   * Render a block for one voice, adding it to that voice's lane in the output buffers. The
+   * buffers use the lane layout described in audio_common.h.
+   *
+   * @param lane the voice to render
+   * @param pitch_modulation frequency multiplier for each voice and frame
+   */
+  void render(int lane,
+              const float *pitch_modulation,
+              float *left_buffer,
+              float *right_buffer,
+              int num_lanes,
+              int num_frames);
+
+private:
+  void updateTables();
+
+  int frame_rate_;
+
+  // Settings, written by the setters
+  int voice_count_ = 1;
+  float detune_ = 0;
+  float stereo_spread_ = 0;
+
+  // Tables built from the settings on the audio thread
+  int table_voice_count_ = 0;
+  float table_detune_ = -1;
+  float table_stereo_spread_ = -1;
+  int num_sub_oscillators_ = SIMD_WIDTH;
+  float detune_ratios_[MAX_UNISON_VOICES];
+  float inverse_detune_ratios_[MAX_UNISON_VOICES];
+  float left_gains_[MAX_UNISON_VOICES];
+  float right_gains_[MAX_UNISON_VOICES];
+
+  float phase_increments_[MAX_VOICES];
+  float phases_[MAX_VOICES][MAX_UNISON_VOICES];
+  uint32_t random_state_ = 22222;
+};
+
+#endif //SIMPLESYNTH_UNISON_OSCILLATOR_H
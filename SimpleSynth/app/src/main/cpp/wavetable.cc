@@ -0,0 +1,429 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wavetable.h"
+#include "fft.h"
+#include "android_log.h"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define RIFF_HEADER_SIZE 12
+#define CHUNK_HEADER_SIZE 8
+#define FMT_CHUNK_MIN_SIZE 16
+#define FMT_CHUNK_EXTENSIBLE_SIZE 26
+
+// Bump whenever the table layout or the way the tables are made changes, so old caches are
+// rebuilt rather than mapped
+#define WAVETABLE_CACHE_VERSION 1
+
+static const char kCacheMagic[4] = {'S', 'S', 'W', 'T'};
+
+// Starts the cache file. The tables follow it directly, so it's a multiple of the float size.
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_key;   // see getSourceKey
+  int32_t table_size;
+  int32_t level_count;
+  int32_t frame_count;
+  int32_t reserved;
+};
+
+static_assert(sizeof(CacheHeader) == 32, "The cache header layout must not change");
+
+static uint32_t readLittleEndian(const uint8_t *data, int num_bytes) {
+  uint32_t value = 0;
+  for (int i = num_bytes - 1; i >= 0; i--) value = (value << 8) | data[i];
+  return value;
+}
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *) data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+/**
+ * Identify a WAV file and the way it's to be imported without reading it, from its path, size and
+ * modification time. Replacing the file, or asking for a different cycle length, gives a new key
+ * and so a new cache.
+ */
+static bool getSourceKey(const std::string &wav_path, int cycle_length, uint64_t *key) {
+
+  struct stat status;
+  if (stat(wav_path.c_str(), &status) != 0) return false;
+
+  int64_t fields[] = {(int64_t) status.st_size,
+                      (int64_t) status.st_mtim.tv_sec,
+                      (int64_t) status.st_mtim.tv_nsec,
+                      cycle_length,
+                      WAVETABLE_CACHE_VERSION};
+  uint64_t hash = hashBytes(0xCBF29CE484222325ULL, wav_path.data(), wav_path.size());
+  *key = hashBytes(hash, fields, sizeof(fields));
+  return true;
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> *data) {
+
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) return false;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  bool is_read = size > 0;
+  if (is_read) {
+    data->resize((size_t) size);
+    is_read = fread(data->data(), 1, data->size(), file) == data->size();
+  }
+  fclose(file);
+  return is_read;
+}
+
+/**
+ * Decode a WAV file's samples to floats, mixing the channels down to mono.
+ *
+ * @return false if the file isn't a WAV or its sample format isn't supported
+ */
+static bool decodeWav(const uint8_t *data, size_t size, std::vector<float> *samples) {
+
+  if (size < RIFF_HEADER_SIZE || memcmp(data, "RIFF", 4) != 0 ||
+      memcmp(data + 8, "WAVE", 4) != 0) {
+    LOGE("Not a WAV file");
+    return false;
+  }
+
+  int format = 0;
+  int num_channels = 0;
+  int bits_per_sample = 0;
+  const uint8_t *sample_data = nullptr;
+  size_t sample_data_size = 0;
+
+  size_t position = RIFF_HEADER_SIZE;
+  // The pad byte after an odd sized chunk can take position one past the end
+  while (position + CHUNK_HEADER_SIZE <= size) {
+    const uint8_t *chunk = data + position;
+    size_t chunk_size = readLittleEndian(chunk + 4, 4);
+    size_t available = size - position - CHUNK_HEADER_SIZE;
+    if (chunk_size > available) chunk_size = available;  // a truncated file keeps what it has
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= FMT_CHUNK_MIN_SIZE) {
+      format = (int) readLittleEndian(chunk + 8, 2);
+      num_channels = (int) readLittleEndian(chunk + 10, 2);
+      bits_per_sample = (int) readLittleEndian(chunk + 22, 2);
+      if (format == WAV_FORMAT_EXTENSIBLE && chunk_size >= FMT_CHUNK_EXTENSIBLE_SIZE) {
+        // The sub format GUID starts with the format code
+        format = (int) readLittleEndian(chunk + CHUNK_HEADER_SIZE + 24, 2);
+      }
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      sample_data = chunk + CHUNK_HEADER_SIZE;
+      sample_data_size = chunk_size;
+    }
+    position += CHUNK_HEADER_SIZE + chunk_size + (chunk_size & 1);
+  }
+
+  bool is_supported = (format == WAV_FORMAT_PCM && (bits_per_sample == 16 ||
+                                                    bits_per_sample == 24 ||
+                                                    bits_per_sample == 32)) ||
+                      (format == WAV_FORMAT_FLOAT && bits_per_sample == 32);
+  if (!is_supported || num_channels < 1) {
+    LOGE("Unsupported WAV file, format %d, %d bits, %d channels", format, bits_per_sample,
+         num_channels);
+    return false;
+  }
+  if (sample_data == nullptr) {
+    LOGE("WAV file has no data");
+    return false;
+  }
+
+  const int bytes_per_sample = bits_per_sample / 8;
+  const size_t num_frames = sample_data_size / (bytes_per_sample * num_channels);
+  const float scale = 1.0f / num_channels;
+  samples->resize(num_frames);
+  for (size_t i = 0; i < num_frames; i++) {
+    float sum = 0;
+    for (int c = 0; c < num_channels; c++) {
+      const uint8_t *sample = sample_data + (i * num_channels + c) * bytes_per_sample;
+      uint32_t bits = readLittleEndian(sample, bytes_per_sample);
+      if (format == WAV_FORMAT_FLOAT) {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        sum += value;
+      } else {
+        // Shift the sample to the top of 32 bits so every width shares the scale
+        sum += (int32_t) (bits << (32 - bits_per_sample)) * (1.0f / 2147483648.0f);
+      }
+    }
+    (*samples)[i] = sum * scale;
+  }
+  return true;
+}
+
+/**
+ * The spectrum of one cycle, scaled to a table of WAVETABLE_SIZE samples. Only harmonics below
+ * the Nyquist of both the cycle and the table are kept.
+ *
+ * @param cycle_fft an FFT of the cycle length, or nullptr if the length isn't a power of 2 that
+ * the FFT supports, in which case the harmonics are found with a DFT using the cosines and sines
+ * of a cycle
+ */
+static void analyzeCycle(const float *cycle,
+                         int length,
+                         const Fft *cycle_fft,
+                         const std::vector<float> &cosines,
+                         const std::vector<float> &sines,
+                         float *real,
+                         float *imaginary,
+                         std::vector<float> *work_real,
+                         std::vector<float> *work_imaginary) {
+
+  const int num_harmonics = std::min((length + 1) / 2, WAVETABLE_SIZE / 2);
+  const float scale = (float) WAVETABLE_SIZE / length;
+
+  if (cycle_fft != nullptr) {
+    work_real->assign(cycle, cycle + length);
+    work_imaginary->assign(length, 0.0f);
+    cycle_fft->forward(work_real->data(), work_imaginary->data());
+    for (int k = 0; k < num_harmonics; k++) {
+      real[k] = (*work_real)[k] * scale;
+      imaginary[k] = (*work_imaginary)[k] * scale;
+    }
+  } else {
+    for (int k = 0; k < num_harmonics; k++) {
+      double sum_real = 0;
+      double sum_imaginary = 0;
+      int index = 0;
+      for (int n = 0; n < length; n++) {
+        sum_real += cycle[n] * cosines[index];
+        sum_imaginary -= cycle[n] * sines[index];
+        index += k;
+        if (index >= length) index -= length;
+      }
+      real[k] = (float) sum_real * scale;
+      imaginary[k] = (float) sum_imaginary * scale;
+    }
+  }
+  for (int k = num_harmonics; k < WAVETABLE_SIZE / 2; k++) {
+    real[k] = 0;
+    imaginary[k] = 0;
+  }
+}
+
+/**
+ * Make the mip-mapped tables for every frame, normalized so the loudest full bandwidth table
+ * peaks at 1.
+ */
+static void buildTables(const float *samples, int cycle_length, int frame_count,
+                        float *tables) {
+
+  Fft table_fft(WAVETABLE_SIZE);
+  std::unique_ptr<Fft> cycle_fft;
+  std::vector<float> cosines;
+  std::vector<float> sines;
+  bool is_power_of_2 = (cycle_length & (cycle_length - 1)) == 0;
+  if (is_power_of_2 && cycle_length >= 2 && cycle_length <= MAX_FFT_SIZE) {
+    cycle_fft.reset(new Fft(cycle_length));
+  } else {
+    cosines.resize(cycle_length);
+    sines.resize(cycle_length);
+    for (int n = 0; n < cycle_length; n++) {
+      cosines[n] = (float) cos(2.0 * M_PI * n / cycle_length);
+      sines[n] = (float) sin(2.0 * M_PI * n / cycle_length);
+    }
+  }
+
+  std::vector<float> harmonics_real(WAVETABLE_SIZE / 2);
+  std::vector<float> harmonics_imaginary(WAVETABLE_SIZE / 2);
+  std::vector<float> real(WAVETABLE_SIZE);
+  std::vector<float> imaginary(WAVETABLE_SIZE);
+  std::vector<float> work_real;
+  std::vector<float> work_imaginary;
+  float peak = 0;
+
+  for (int f = 0; f < frame_count; f++) {
+    analyzeCycle(samples + (size_t) f * cycle_length, cycle_length, cycle_fft.get(),
+                 cosines, sines, harmonics_real.data(), harmonics_imaginary.data(), &work_real,
+                 &work_imaginary);
+
+    for (int level = 0; level < WAVETABLE_LEVELS; level++) {
+      // The harmonics at or below the limit, and their mirror images so the table comes out real
+      const int limit = std::min((WAVETABLE_SIZE / 2) >> level, WAVETABLE_SIZE / 2 - 1);
+      std::fill(real.begin(), real.end(), 0.0f);
+      std::fill(imaginary.begin(), imaginary.end(), 0.0f);
+      for (int k = 1; k <= limit; k++) {
+        real[k] = harmonics_real[k];
+        imaginary[k] = harmonics_imaginary[k];
+        real[WAVETABLE_SIZE - k] = harmonics_real[k];
+        imaginary[WAVETABLE_SIZE - k] = -harmonics_imaginary[k];
+      }
+      table_fft.inverse(real.data(), imaginary.data());
+
+      float *table = tables + ((size_t) f * WAVETABLE_LEVELS + level) * WAVETABLE_STRIDE;
+      memcpy(table, real.data(), sizeof(float) * WAVETABLE_SIZE);
+      table[WAVETABLE_SIZE] = table[0];
+      if (level == 0) {
+        for (int i = 0; i < WAVETABLE_SIZE; i++) peak = std::max(peak, fabsf(table[i]));
+      }
+    }
+  }
+
+  if (peak > 0) {
+    const float gain = 1.0f / peak;
+    const size_t num_samples = (size_t) frame_count * WAVETABLE_LEVELS * WAVETABLE_STRIDE;
+    for (size_t i = 0; i < num_samples; i++) tables[i] *= gain;
+  }
+}
+
+/**
+ * Write the cache to a temporary file and rename it into place, so a cache is either complete or
+ * not there at all, even if the app is killed while writing it.
+ */
+static bool writeCache(const std::string &cache_path, const CacheHeader &header,
+                       const std::vector<float> &tables) {
+
+  std::string temporary_path = cache_path + ".tmp";
+  FILE *file = fopen(temporary_path.c_str(), "wb");
+  if (file == nullptr) return false;
+  bool is_written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                    fwrite(tables.data(), sizeof(float), tables.size(), file) == tables.size();
+  is_written = (fclose(file) == 0) && is_written;
+  if (is_written) is_written = rename(temporary_path.c_str(), cache_path.c_str()) == 0;
+  if (!is_written) unlink(temporary_path.c_str());
+  return is_written;
+}
+
+Wavetable::~Wavetable() {
+  if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+}
+
+/**
+ * Map a cache file, checking that it was made from the same WAV, with the same table layout.
+ *
+ * @return nullptr if there is no such cache
+ */
+std::unique_ptr<Wavetable> Wavetable::map(const std::string &cache_path, uint64_t source_key) {
+
+  int fd = open(cache_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return nullptr;
+
+  struct stat status;
+  void *mapping = MAP_FAILED;
+  size_t size = 0;
+  if (fstat(fd, &status) == 0 && (size_t) status.st_size >= sizeof(CacheHeader)) {
+    size = (size_t) status.st_size;
+    mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  // The mapping holds its own reference to the file
+  close(fd);
+  if (mapping == MAP_FAILED) return nullptr;
+
+  std::unique_ptr<Wavetable> wavetable(new Wavetable());
+  wavetable->mapping_ = mapping;
+  wavetable->mapping_size_ = size;
+
+  const CacheHeader *header = (const CacheHeader *) mapping;
+  bool is_valid = memcmp(header->magic, kCacheMagic, sizeof(kCacheMagic)) == 0 &&
+                  header->version == WAVETABLE_CACHE_VERSION &&
+                  header->source_key == source_key &&
+                  header->table_size == WAVETABLE_SIZE &&
+                  header->level_count == WAVETABLE_LEVELS &&
+                  header->frame_count >= 1 && header->frame_count <= MAX_WAVETABLE_FRAMES &&
+                  size == sizeof(CacheHeader) + sizeof(float) * header->frame_count *
+                                                WAVETABLE_LEVELS * WAVETABLE_STRIDE;
+  if (!is_valid) return nullptr;
+
+  wavetable->frame_count_ = header->frame_count;
+  wavetable->samples_ = (const float *) ((const uint8_t *) mapping + sizeof(CacheHeader));
+  return wavetable;
+}
+
+std::unique_ptr<Wavetable> Wavetable::load(const std::string &wav_path,
+                                           const std::string &cache_dir,
+                                           int cycle_length) {
+
+  uint64_t source_key;
+  if (!getSourceKey(wav_path, cycle_length, &source_key)) {
+    LOGE("Unable to open wavetable %s", wav_path.c_str());
+    return nullptr;
+  }
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "/wavetable-%016llx.cache",
+           (unsigned long long) source_key);
+  std::string cache_path = cache_dir + file_name;
+
+  std::unique_ptr<Wavetable> wavetable = map(cache_path, source_key);
+  if (wavetable) return wavetable;
+
+  std::vector<uint8_t> data;
+  std::vector<float> samples;
+  if (!readFile(wav_path, &data)) {
+    LOGE("Unable to read wavetable %s", wav_path.c_str());
+    return nullptr;
+  }
+  if (!decodeWav(data.data(), data.size(), &samples)) return nullptr;
+  data = std::vector<uint8_t>();
+
+  if (cycle_length <= 0) {
+    bool is_multiple = samples.size() >= WAVETABLE_SIZE && samples.size() % WAVETABLE_SIZE == 0;
+    cycle_length = is_multiple ? WAVETABLE_SIZE : (int) samples.size();
+  }
+  if (cycle_length < 2 || samples.size() < (size_t) cycle_length) {
+    LOGE("Wavetable %s is shorter than a cycle", wav_path.c_str());
+    return nullptr;
+  }
+  int frame_count = (int) (samples.size() / cycle_length);
+  if (frame_count > MAX_WAVETABLE_FRAMES) {
+    LOGW("Wavetable %s has %d frames, only the first %d are used", wav_path.c_str(),
+         frame_count, MAX_WAVETABLE_FRAMES);
+    frame_count = MAX_WAVETABLE_FRAMES;
+  }
+
+  wavetable.reset(new Wavetable());
+  wavetable->buffer_.resize((size_t) frame_count * WAVETABLE_LEVELS * WAVETABLE_STRIDE);
+  buildTables(samples.data(), cycle_length, frame_count, wavetable->buffer_.data());
+
+  CacheHeader header = {};
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = WAVETABLE_CACHE_VERSION;
+  header.source_key = source_key;
+  header.table_size = WAVETABLE_SIZE;
+  header.level_count = WAVETABLE_LEVELS;
+  header.frame_count = frame_count;
+
+  // Play from the cache rather than from memory once it's written, so the pages are shared
+  if (writeCache(cache_path, header, wavetable->buffer_)) {
+    std::unique_ptr<Wavetable> mapped = map(cache_path, source_key);
+    if (mapped) return mapped;
+  } else {
+    LOGW("Unable to write wavetable cache %s", cache_path.c_str());
+  }
+
+  wavetable->frame_count_ = frame_count;
+  wavetable->samples_ = wavetable->buffer_.data();
+  return wavetable;
+}
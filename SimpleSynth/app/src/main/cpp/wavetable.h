@@ -0,0 +1,97 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_WAVETABLE_H
+#define SIMPLESYNTH_WAVETABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Samples per cycle in every table, whatever the cycle length of the source
+#define WAVETABLE_SIZE 2048
+
+// Level 0 holds every harmonic below the table's Nyquist, each level after it half as many, down
+// to the fundamental alone
+#define WAVETABLE_LEVELS 11
+
+// Each table is followed by a copy of its first sample, so interpolation never wraps
+#define WAVETABLE_STRIDE (WAVETABLE_SIZE + 1)
+
+#define MAX_WAVETABLE_FRAMES 256
+
+/**
+ * A band limited wavetable imported from a WAV file: one or more single cycle frames, each
+ * stored as a mip-map of WAVETABLE_LEVELS tables, so an oscillator can read the most detailed
+ * table which won't alias at its pitch. The tables are laid out frame by frame, and level by
+ * level within a frame.
+ *
+ * Each frame's levels are made by taking its spectrum, dropping the harmonics above the level's
+ * limit and the DC, and converting back with an inverse FFT. That only has to be done once per
+ * file: the tables are written to a cache file, and later loads of the same WAV memory map the
+ * cache instead. The mapping is read only and shared, so a large library loads in the time it
+ * takes to map it, pages are only read from storage as voices touch them, and every synth in the
+ * process playing the same table shares the same pages.
+ *
+ * The cache stores floats in the device's own byte order, it isn't meant to be moved between
+ * devices.
+ */
+class Wavetable {
+
+public:
+  ~Wavetable();
+
+  /**
+   * Load the wavetable for a WAV file: mapped from its cache in cache_dir if there is an up to
+   * date one, otherwise imported and cached. Importing takes a few milliseconds per frame, so
+   * this must not be called from the audio or UI threads.
+   *
+   * The WAV can be 16, 24 or 32 bit PCM, or 32 bit float. Channels are mixed down to mono.
+   *
+   * @param cycle_length samples per frame in the WAV, or 0 to take WAVETABLE_SIZE if the length
+   * of the file is a multiple of it, and otherwise the whole file as a single cycle
+   * @return nullptr if the WAV can't be read. If the cache can't be written the table is still
+   * returned, held in memory.
+   */
+  static std::unique_ptr<Wavetable> load(const std::string &wav_path,
+                                         const std::string &cache_dir,
+                                         int cycle_length);
+
+  int getFrameCount() const { return frame_count_; }
+
+  const float *getTable(int frame, int level) const {
+    return samples_ + (frame * WAVETABLE_LEVELS + level) * WAVETABLE_STRIDE;
+  }
+
+  // Whether the tables were mapped from a cache file rather than held in memory
+  bool isMapped() const { return mapping_ != nullptr; }
+
+private:
+  Wavetable() {}
+
+  static std::unique_ptr<Wavetable> map(const std::string &cache_path, uint64_t source_key);
+
+  int frame_count_ = 0;
+  const float *samples_ = nullptr;
+
+  void *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  std::vector<float> buffer_;  // when not mapped
+};
+
+#endif //SIMPLESYNTH_WAVETABLE_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include "wavetable_oscillator.h"
+
+// Past half a cycle per frame even the fundamental aliases
+#define MAX_PHASE_INCREMENT 0.499f
+#define MIN_PHASE_INCREMENT 1e-6f
+
+/**
+ * The mip level to read at a phase increment. Level l holds harmonics up to
+ * (WAVETABLE_SIZE / 2) >> l, which stay below Nyquist while 2^l >= WAVETABLE_SIZE * increment.
+ * frexpf gives the exponent which rounds that logarithm up, without calling log2f.
+ */
+static inline int mipLevel(float phase_increment) {
+  int exponent;
+  frexpf(phase_increment * WAVETABLE_SIZE, &exponent);
+  exponent = (exponent < 0) ? 0 : exponent;
+  return (exponent < WAVETABLE_LEVELS - 1) ? exponent : WAVETABLE_LEVELS - 1;
+}
+
+static inline float readTable(const float *table, float phase) {
+  float index = phase * WAVETABLE_SIZE;
+  int i = (int) index;
+  float fraction = index - i;
+  return table[i] + (table[i + 1] - table[i]) * fraction;
+}
+
+WavetableOscillator::WavetableOscillator(int frame_rate) :
+    frame_rate_(frame_rate) {
+
+  for (int v = 0; v < MAX_VOICES; v++) {
+    phase_increments_[v] = 0;
+    voice_levels_[v] = 0;
+    resetVoice(v);
+  }
+}
+
+void WavetableOscillator::setTable(std::unique_ptr<Wavetable> table) {
+  {
+    std::lock_guard<std::mutex> lock(table_lock_);
+    table_.swap(table);
+  }
+  // table now holds the old one, which may be a mapping, so it's released outside the lock
+}
+
+void WavetableOscillator::setPosition(float position) {
+  position_ = fminf(fmaxf(position, 0.0f), 1.0f);
+}
+
+void WavetableOscillator::setFrequency(int lane, float frequency_hz) {
+  phase_increments_[lane] = frequency_hz / frame_rate_;
+}
+
+void WavetableOscillator::setVoiceLevel(int lane, float level) {
+  voice_levels_[lane] = level;
+}
+
+void WavetableOscillator::resetVoice(int lane) {
+  phases_[lane] = 0;
+}
+
+void WavetableOscillator::render(const float *pitch_modulation,
+                                 float *left_buffer,
+                                 float *right_buffer,
+                                 int num_lanes,
+                                 int num_frames) {
+
+  assert(num_lanes <= MAX_VOICES && num_frames <= MAX_BLOCK_FRAMES);
+
+  std::unique_lock<std::mutex> lock(table_lock_, std::try_to_lock);
+  if (!lock.owns_lock() || !table_) return;
+
+  // The position is only read once a block, so both frames are the same for every voice
+  const Wavetable &table = *table_;
+  const float frame_position = position_ * (table.getFrameCount() - 1);
+  const int first_frame = (int) frame_position;
+  const int second_frame = (first_frame + 1 < table.getFrameCount()) ? first_frame + 1
+                                                                     : first_frame;
+  const float morph = frame_position - first_frame;
+
+  for (int i = 0; i < num_frames; i++) {
+
+    const int offset = i * num_lanes;
+    const float *pitch = pitch_modulation + offset;
+    float *left = left_buffer + offset;
+    float *right = right_buffer + offset;
+
+    for (int v = 0; v < num_lanes; v++) {
+      float dt = fminf(fmaxf(phase_increments_[v] * pitch[v], MIN_PHASE_INCREMENT),
+                       MAX_PHASE_INCREMENT);
+      float t = phases_[v];
+      int level = mipLevel(dt);
+
+      float first = readTable(table.getTable(first_frame, level), t);
+      float second = readTable(table.getTable(second_frame, level), t);
+      float value = (first + (second - first) * morph) * voice_levels_[v];
+      left[v] += value;
+      right[v] += value;
+
+      t += dt;
+      phases_[v] = (t >= 1.0f) ? t - 1.0f : t;
+    }
+  }
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLESYNTH_WAVETABLE_OSCILLATOR_H
+#define SIMPLESYNTH_WAVETABLE_OSCILLATOR_H
+
+#include <memory>
+#include <mutex>
+#include "audio_common.h"
+#include "wavetable.h"
+
+/**
+ * Plays a Wavetable for every voice. Each frame, each voice picks the mip level with the most
+ * harmonics that all stay below Nyquist at its current pitch, including any pitch modulation,
+ * and interpolates linearly between samples. The position morphs between adjacent frames of a
+ * multi-frame table.
+ *
+ * The table is swapped in from the thread which loaded it. If that happens while a block is
+ * rendering, the next block is rendered silent rather than the audio thread waiting.
+ */
+class WavetableOscillator {
+
+public:
+  WavetableOscillator(int frame_rate);
+
+  // Replace the table, the old one is released on the calling thread
+  void setTable(std::unique_ptr<Wavetable> table);
+
+  // From 0 for the first frame to 1 for the last
+  void setPosition(float position);
+
+  void setFrequency(int lane, float frequency_hz);
+
+  // Gain of a voice, 0 silences it
+  void setVoiceLevel(int lane, float level);
+
+  void resetVoice(int lane);
+
+  /**
+   * Render a block for every voice, adding it to the output buffers. All buffers use the lane
+   * layout described in audio_common.h.
+   *
+   * @param pitch_modulation frequency multiplier for each voice and frame
+   */
+  void render(const float *pitch_modulation,
+              float *left_buffer,
+              float *right_buffer,
+              int num_lanes,
+              int num_frames);
+
+private:
+  int frame_rate_;
+  float position_ = 0;
+
+  std::unique_ptr<Wavetable> table_;
+  std::mutex table_lock_;
+
+  float phase_increments_[MAX_VOICES];
+  float voice_levels_[MAX_VOICES];
+  float phases_[MAX_VOICES];
+};
+
+#endif //SIMPLESYNTH_WAVETABLE_OSCILLATOR_H
@@ -68,8 +68,44 @@ public class MainActivity extends AppCompatActivity {
                                                         int[] exclusiveCores);
     private static native void native_noteOn();
     private static native void native_noteOff();
+    private static native void native_sendMidi(byte[] data, int offset, int count, long timestamp);
+    private static native void native_setMpeEnabled(boolean isEnabled);
+    private static native void native_setMpePitchBendRange(float semitones);
+    private static native boolean native_loadMidiFile(byte[] data);
+    private static native void native_playMidiFile();
+    private static native void native_stopMidiFile();
+    private static native float native_benchmarkMidiFile(byte[] data, int frameRate, int voiceType);
+    private static native float native_benchmarkFixedPoint(int frameRate);
+    private static native void native_setFixedPointEnabled(boolean isEnabled);
     private static native void native_setWorkCycles(int workCycles);
+    private static native void native_setVoiceType(int voiceType);
+    private static native void native_setUnisonVoices(int voiceCount);
+    private static native void native_setUnisonDetune(float semitones);
+    private static native void native_setUnisonSpread(float spread);
+    private static native void native_setFmAlgorithm(int algorithm);
+    private static native void native_setFmFeedback(float feedback);
+    private static native void native_setFmOperator(int op, float ratio, float level);
+    private static native void native_setAdditivePartialCount(int partialCount);
+    private static native void native_setAdditivePartial(int index, float ratio, float amplitude);
+    private static native void native_setNoiseColor(int color);
+    private static native void native_setWaveform(int waveform);
+    private static native void native_setPulseWidth(float pulseWidth);
+    private static native boolean native_loadWavetable(String wavPath, String cacheDir,
+                                                       int cycleLength);
+    private static native int native_getWavetableLoadState();
+    private static native void native_setWavetablePosition(float position);
     private static native void native_setLoadStabilizationEnabled(boolean isEnabled);
+    private static native void native_setFilterCutoff(float cutoffHz);
+    private static native void native_setFilterResonance(float resonance);
+    private static native void native_setFilterMode(int mode);
+    private static native void native_setParameterRate(int parameter, int rate);
+    private static native void native_setLfoRate(int lfo, float rateHz);
+    private static native void native_setLfoShape(int lfo, int shape);
+    private static native void native_setModulationRoute(int slot, int source, int destination,
+                                                         float depth);
+    private static native void native_setAutomation(int target, long[] frames, float[] values,
+                                                    int[] curves, float[] controls1,
+                                                    float[] controls2);
 
     @Override
     protected void onCreate(Bundle savedInstanceState) {
@@ -15,9 +15,15 @@
  */
 
 #include <string>
+#include <cstring>
+#include <math.h>
 #include "audio_common.h"
 #include <logging_macros.h>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 static const int32_t audioFormatEnum[] = {
     AAUDIO_FORMAT_INVALID,
     AAUDIO_FORMAT_UNSPECIFIED,
@@ -109,9 +115,161 @@ int64_t get_time_nanoseconds(clockid_t clockid){
   return timestamp_to_nanoseconds(ts);
 }
 
-void ConvertMonoToStereo(int16_t *buffer, int32_t numFrames) {
-    for (int i = numFrames - 1; i >= 0; i--) {
-        buffer[i*2] = buffer[i];
-        buffer[(i*2)+1] = buffer[i];
+constexpr float kInt16ToFloat = 1.0f / 32768.0f;
+constexpr float kFloatToInt16 = 32767.0f;
+
+/*
+ * Generic deinterleave, used for channel layouts which don't have a specialized path. Each input
+ * channel is accumulated into its output plane; the compiler vectorizes the inner loops for the
+ * fixed stride cases.
+ */
+template <typename T>
+static void deinterleaveGeneric(const T *input, int32_t inputChannelCount,
+                                float * const *output, int32_t outputChannelCount,
+                                int32_t numFrames, float scale) {
+  for (int32_t c = 0; c < outputChannelCount; c++) {
+    int32_t sourceCount = 0;
+    for (int32_t i = c; i < inputChannelCount; i += outputChannelCount) sourceCount++;
+
+    float *plane = output[c];
+    if (sourceCount == 0) {
+      const T *source = input + (c % inputChannelCount);
+      for (int32_t n = 0; n < numFrames; n++) {
+        plane[n] = source[n * inputChannelCount] * scale;
+      }
+      continue;
     }
-}
\ No newline at end of file
+
+    float channelScale = scale / sourceCount;
+    const T *source = input + c;
+    for (int32_t n = 0; n < numFrames; n++) {
+      plane[n] = source[n * inputChannelCount] * channelScale;
+    }
+    for (int32_t i = c + outputChannelCount; i < inputChannelCount; i += outputChannelCount) {
+      source = input + i;
+      for (int32_t n = 0; n < numFrames; n++) {
+        plane[n] += source[n * inputChannelCount] * channelScale;
+      }
+    }
+  }
+}
+
+void DeinterleaveToPlanar(const float *input, int32_t inputChannelCount,
+                          float * const *output, int32_t outputChannelCount, int32_t numFrames) {
+
+  if (inputChannelCount == 1) {
+    for (int32_t c = 0; c < outputChannelCount; c++) {
+      memcpy(output[c], input, numFrames * sizeof(float));
+    }
+    return;
+  }
+
+  if (inputChannelCount == 2 && outputChannelCount == 2) {
+    float *left = output[0];
+    float *right = output[1];
+    int32_t n = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for (; n + 4 <= numFrames; n += 4) {
+      float32x4x2_t frames = vld2q_f32(input + n * 2);
+      vst1q_f32(left + n, frames.val[0]);
+      vst1q_f32(right + n, frames.val[1]);
+    }
+#endif
+    for (; n < numFrames; n++) {
+      left[n] = input[n * 2];
+      right[n] = input[n * 2 + 1];
+    }
+    return;
+  }
+
+  deinterleaveGeneric(input, inputChannelCount, output, outputChannelCount, numFrames, 1.0f);
+}
+
+void DeinterleaveToPlanar(const int16_t *input, int32_t inputChannelCount,
+                          float * const *output, int32_t outputChannelCount, int32_t numFrames) {
+
+  if (inputChannelCount == 2 && outputChannelCount == 2) {
+    float *left = output[0];
+    float *right = output[1];
+    int32_t n = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    float32x4_t scale = vdupq_n_f32(kInt16ToFloat);
+    for (; n + 4 <= numFrames; n += 4) {
+      int16x4x2_t frames = vld2_s16(input + n * 2);
+      vst1q_f32(left + n, vmulq_f32(vcvtq_f32_s32(vmovl_s16(frames.val[0])), scale));
+      vst1q_f32(right + n, vmulq_f32(vcvtq_f32_s32(vmovl_s16(frames.val[1])), scale));
+    }
+#endif
+    for (; n < numFrames; n++) {
+      left[n] = input[n * 2] * kInt16ToFloat;
+      right[n] = input[n * 2 + 1] * kInt16ToFloat;
+    }
+    return;
+  }
+
+  deinterleaveGeneric(input, inputChannelCount, output, outputChannelCount, numFrames,
+                      kInt16ToFloat);
+}
+
+void InterleaveFromPlanar(const float * const *input, int32_t channelCount,
+                          float *output, int32_t numFrames) {
+
+  if (channelCount == 2) {
+    const float *left = input[0];
+    const float *right = input[1];
+    int32_t n = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for (; n + 4 <= numFrames; n += 4) {
+      float32x4x2_t frames;
+      frames.val[0] = vld1q_f32(left + n);
+      frames.val[1] = vld1q_f32(right + n);
+      vst2q_f32(output + n * 2, frames);
+    }
+#endif
+    for (; n < numFrames; n++) {
+      output[n * 2] = left[n];
+      output[n * 2 + 1] = right[n];
+    }
+    return;
+  }
+
+  for (int32_t c = 0; c < channelCount; c++) {
+    const float *plane = input[c];
+    for (int32_t n = 0; n < numFrames; n++) {
+      output[n * channelCount + c] = plane[n];
+    }
+  }
+}
+
+void InterleaveFromPlanar(const float * const *input, int32_t channelCount,
+                          int16_t *output, int32_t numFrames) {
+
+  if (channelCount == 2) {
+    const float *left = input[0];
+    const float *right = input[1];
+    int32_t n = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    float32x4_t scale = vdupq_n_f32(kFloatToInt16);
+    for (; n + 4 <= numFrames; n += 4) {
+      // vqmovn saturates, which gives us the clipping for free
+      int16x4x2_t frames;
+      frames.val[0] = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(left + n), scale)));
+      frames.val[1] = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(right + n), scale)));
+      vst2_s16(output + n * 2, frames);
+    }
+#endif
+    for (; n < numFrames; n++) {
+      output[n * 2] = static_cast<int16_t>(fmaxf(-1.0f, fminf(1.0f, left[n])) * kFloatToInt16);
+      output[n * 2 + 1] = static_cast<int16_t>(fmaxf(-1.0f, fminf(1.0f, right[n])) * kFloatToInt16);
+    }
+    return;
+  }
+
+  for (int32_t c = 0; c < channelCount; c++) {
+    const float *plane = input[c];
+    for (int32_t n = 0; n < numFrames; n++) {
+      output[n * channelCount + c] =
+          static_cast<int16_t>(fmaxf(-1.0f, fminf(1.0f, plane[n])) * kFloatToInt16);
+    }
+  }
+}
@@ -50,7 +50,26 @@ int64_t timestamp_to_nanoseconds(timespec ts);
 
 int64_t get_time_nanoseconds(clockid_t clockid);
 
-// Note: buffer must be at least double the length of numFrames to accommodate the stereo data
-void ConvertMonoToStereo(int16_t *buffer, int32_t numFrames);
+constexpr int kMaxInputChannelCount = 4;
+
+/*
+ * Sample conversion between interleaved stream buffers and planar float buffers. Each function
+ * converts the sample format and channel layout in a single pass so the audio data is only
+ * touched once on the way in and once on the way out.
+ *
+ * When deinterleaving, output channel c is the average of all input channels i where
+ * i % outputChannelCount == c. If there are no such channels (e.g. a mono input into a stereo
+ * bus) the output channel is a copy of input channel c % inputChannelCount.
+ */
+void DeinterleaveToPlanar(const float *input, int32_t inputChannelCount,
+                          float * const *output, int32_t outputChannelCount, int32_t numFrames);
+void DeinterleaveToPlanar(const int16_t *input, int32_t inputChannelCount,
+                          float * const *output, int32_t outputChannelCount, int32_t numFrames);
+
+void InterleaveFromPlanar(const float * const *input, int32_t channelCount,
+                          float *output, int32_t numFrames);
+// Samples outside [-1.0, 1.0] are clipped
+void InterleaveFromPlanar(const float * const *input, int32_t channelCount,
+                          int16_t *output, int32_t numFrames);
 
 #endif // AAUDIO_AUDIO_COMMON_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include "audio_tap.h"
+
+void AudioTap::setup(int32_t maxFramesPerCallback, int32_t numCallbacks) {
+
+  maxFramesPerCallback_ = maxFramesPerCallback;
+
+  // One slot is always left empty so that a full ring can be told from an empty one
+  numSlots_ = numCallbacks + 1;
+  records_.assign(numSlots_, AudioTapRecord());
+  samples_.assign(numSlots_ * maxFramesPerCallback, 0.0f);
+  framePosition_ = 0;
+  readIndex_.store(0);
+  writeIndex_.store(0);
+}
+
+void AudioTap::write(const float *audioData, int32_t channelCount, int32_t numFrames,
+                     int64_t timestampNs, int32_t xRunCount) {
+  writeSamples(audioData, channelCount, numFrames, timestampNs, xRunCount, 1.0f);
+}
+
+void AudioTap::write(const int16_t *audioData, int32_t channelCount, int32_t numFrames,
+                     int64_t timestampNs, int32_t xRunCount) {
+  writeSamples(audioData, channelCount, numFrames, timestampNs, xRunCount, 1.0f / 32768.0f);
+}
+
+template <class T>
+void AudioTap::writeSamples(const T *audioData, int32_t channelCount, int32_t numFrames,
+                            int64_t timestampNs, int32_t xRunCount, float scale) {
+
+  int64_t framePosition = framePosition_;
+  framePosition_ += numFrames;
+  if (numSlots_ == 0 || numFrames <= 0) return;
+
+  int32_t writeIndex = writeIndex_.load(std::memory_order_relaxed);
+  int32_t nextIndex = (writeIndex + 1) % numSlots_;
+  if (nextIndex == readIndex_.load(std::memory_order_acquire)) return;
+
+  numFrames = std::min(numFrames, maxFramesPerCallback_);
+  float *samples = &samples_[writeIndex * maxFramesPerCallback_];
+  for (int32_t i = 0; i < numFrames; i++) {
+    samples[i] = audioData[i * channelCount] * scale;
+  }
+  records_[writeIndex] = {framePosition, timestampNs, numFrames, xRunCount};
+  writeIndex_.store(nextIndex, std::memory_order_release);
+}
+
+bool AudioTap::read(AudioTapRecord *record, float *samples) {
+
+  int32_t readIndex = readIndex_.load(std::memory_order_relaxed);
+  if (readIndex == writeIndex_.load(std::memory_order_acquire)) return false;
+
+  *record = records_[readIndex];
+  const float *slot = &samples_[readIndex * maxFramesPerCallback_];
+  std::copy(slot, slot + record->numFrames, samples);
+  readIndex_.store((readIndex + 1) % numSlots_, std::memory_order_release);
+  return true;
+}
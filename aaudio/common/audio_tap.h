@@ -0,0 +1,72 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_AUDIO_TAP_H
+#define AAUDIO_AUDIO_TAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+struct AudioTapRecord {
+  int64_t framePosition;  // of the first frame, counted from when the tap was set up
+  int64_t timestampNs;    // when the callback ran
+  int32_t numFrames;
+  int32_t xRunCount;      // the stream's xrun count when the callback ran
+};
+
+/**
+ * Copies the first channel of the audio passed through a data callback to another thread,
+ * along with when the callback ran. One slot of the ring holds one callback's audio, so the
+ * audio thread only ever copies and never waits.
+ *
+ * If the reader falls behind, callbacks are dropped rather than overwrite audio it hasn't read.
+ * The frame position still moves on, so the reader can tell that audio is missing.
+ *
+ * The writer must be the audio thread and the reader a single other thread.
+ */
+class AudioTap {
+public:
+  // Must not be called while the tap is being written or read
+  void setup(int32_t maxFramesPerCallback, int32_t numCallbacks);
+
+  // Called from the audio thread. Callbacks longer than maxFramesPerCallback are truncated.
+  void write(const float *audioData, int32_t channelCount, int32_t numFrames,
+             int64_t timestampNs, int32_t xRunCount);
+  void write(const int16_t *audioData, int32_t channelCount, int32_t numFrames,
+             int64_t timestampNs, int32_t xRunCount);
+
+  /**
+   * @param samples must hold maxFramesPerCallback samples
+   * @return false if there's nothing to read
+   */
+  bool read(AudioTapRecord *record, float *samples);
+
+private:
+  template <class T>
+  void writeSamples(const T *audioData, int32_t channelCount, int32_t numFrames,
+                    int64_t timestampNs, int32_t xRunCount, float scale);
+
+  int32_t maxFramesPerCallback_ = 0;
+  int32_t numSlots_ = 0;
+  std::vector<AudioTapRecord> records_;
+  std::vector<float> samples_;
+  int64_t framePosition_ = 0;
+  std::atomic<int32_t> readIndex_{0};
+  std::atomic<int32_t> writeIndex_{0};
+};
+
+#endif //AAUDIO_AUDIO_TAP_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "fft.h"
+
+bool Fft::setup(int32_t size) {
+
+  if (size < 2 || (size & (size - 1)) != 0) return false;
+  size_ = size;
+
+  int32_t bits = 0;
+  while ((1 << bits) < size) bits++;
+
+  bitReversal_.resize(size);
+  for (int32_t i = 0; i < size; i++) {
+    int32_t reversed = 0;
+    for (int32_t b = 0; b < bits; b++) {
+      if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+    }
+    bitReversal_[i] = reversed;
+  }
+
+  // Only the first half of the unit circle is needed, the stage loops stride through it
+  cosTable_.resize(size / 2);
+  sinTable_.resize(size / 2);
+  for (int32_t i = 0; i < size / 2; i++) {
+    double angle = 2.0 * M_PI * i / size;
+    cosTable_[i] = static_cast<float>(cos(angle));
+    sinTable_[i] = static_cast<float>(sin(angle));
+  }
+  return true;
+}
+
+void Fft::forward(float *real, float *imaginary) const {
+  transform(real, imaginary, -1.0f);
+}
+
+void Fft::inverse(float *real, float *imaginary) const {
+  transform(real, imaginary, 1.0f);
+  float scale = 1.0f / size_;
+  for (int32_t i = 0; i < size_; i++) {
+    real[i] *= scale;
+    imaginary[i] *= scale;
+  }
+}
+
+void Fft::transform(float *real, float *imaginary, float direction) const {
+
+  for (int32_t i = 0; i < size_; i++) {
+    int32_t j = bitReversal_[i];
+    if (j > i) {
+      float tempReal = real[i];
+      float tempImaginary = imaginary[i];
+      real[i] = real[j];
+      imaginary[i] = imaginary[j];
+      real[j] = tempReal;
+      imaginary[j] = tempImaginary;
+    }
+  }
+
+  for (int32_t length = 2; length <= size_; length <<= 1) {
+    int32_t halfLength = length >> 1;
+    int32_t tableStride = size_ / length;
+    for (int32_t start = 0; start < size_; start += length) {
+      for (int32_t k = 0; k < halfLength; k++) {
+        float wReal = cosTable_[k * tableStride];
+        float wImaginary = direction * sinTable_[k * tableStride];
+        int32_t even = start + k;
+        int32_t odd = even + halfLength;
+        float oddReal = real[odd] * wReal - imaginary[odd] * wImaginary;
+        float oddImaginary = real[odd] * wImaginary + imaginary[odd] * wReal;
+        real[odd] = real[even] - oddReal;
+        imaginary[odd] = imaginary[even] - oddImaginary;
+        real[even] += oddReal;
+        imaginary[even] += oddImaginary;
+      }
+    }
+  }
+}
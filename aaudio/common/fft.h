@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_FFT_H
+#define AAUDIO_FFT_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * An in-place radix-2 complex FFT. The twiddle factors and bit reversal table are computed in
+ * setup so that forward and inverse don't allocate or call any trig functions, which makes them
+ * safe to use on the audio thread.
+ */
+class Fft {
+public:
+  /**
+   * @param size the transform size, must be a power of 2. Must not be called from the audio
+   * thread.
+   * @return false if size is not a power of 2
+   */
+  bool setup(int32_t size);
+  int32_t getSize() const { return size_; }
+
+  void forward(float *real, float *imaginary) const;
+
+  // The inverse is scaled by 1/size so that inverse(forward(x)) == x
+  void inverse(float *real, float *imaginary) const;
+
+private:
+  void transform(float *real, float *imaginary, float direction) const;
+
+  int32_t size_ = 0;
+  std::vector<int32_t> bitReversal_;
+  std::vector<float> cosTable_;
+  std::vector<float> sinTable_;
+};
+
+#endif //AAUDIO_FFT_H
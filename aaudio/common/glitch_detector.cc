@@ -0,0 +1,416 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include "glitch_detector.h"
+
+// Levels are tracked over about 20ms. Nothing is reported until a whole cycle of a 20Hz note
+// has been seen, so the baselines below have settled.
+constexpr float kLevelSeconds = 0.02f;
+constexpr float kWarmupSeconds = 0.05f;
+
+// Anything quieter than this is silence, which can't glitch
+constexpr float kActiveLevelDb = -50.0f;
+
+// A second difference 20dB above its recent RMS, 12dB above its recent peak, and big enough to
+// hear, is a discontinuity. The peak decays slowly enough to last from one cycle of a 20Hz note
+// to the next, so the edges of a saw or square wave set it rather than being reported each cycle.
+constexpr float kDiscontinuityRatio = 10.0f;
+constexpr float kDiscontinuityPeakRatio = 4.0f;
+constexpr float kDifferencePeakSeconds = 0.25f;
+constexpr float kMinDiscontinuity = 0.01f;
+
+// A discontinuity's level is relative to the recent RMS, which is zero after DC or a ramp
+constexpr float kMinDifferenceRms = 1e-6f;
+
+// A frame which differs from the one a period before by less than this is the signal repeating
+// itself to within rounding, which a waveform whose cycle divides the period does, and NAN never
+// compares greater so nothing repeats until the history is full
+constexpr float kRepeatChangeLevel = 1e-4f;
+
+// Runs of zeros from 0.2ms to 0.5s are dropouts, anything longer is the signal stopping
+constexpr float kZeroLevel = 1e-6f;
+constexpr float kMinDropoutSeconds = 0.0002f;
+constexpr float kMaxDropoutSeconds = 0.5f;
+
+// Glitches of one type which are closer together than this are reported as one
+constexpr float kMergeSeconds = 0.002f;
+
+// Test tones are fitted in 10ms blocks. Frames which are 18dB above the usual residual, and no
+// more than 60dB below the tone, are glitches.
+constexpr float kToneBlockSeconds = 0.01f;
+constexpr int32_t kToneWarmupBlocks = 4;
+constexpr float kResidualRatio = 8.0f;
+constexpr float kMinResidualDb = -60.0f;
+constexpr float kResidualFloorSmoothing = 0.1f;
+constexpr double kFrequencyTrackingGain = 0.5;
+constexpr double kMaxPhaseStepRadians = 0.5;
+
+constexpr int32_t kMaxAnchors = 64;
+
+static float amplitudeToDb(float amplitude) {
+  return 20.0f * log10f(amplitude + 1e-20f);
+}
+
+static float decibelsToAmplitude(float decibels) {
+  return powf(10.0f, decibels / 20.0f);
+}
+
+// Solve a symmetric 3x3 system by Cramer's rule, returns false if it's singular
+static bool solve3(const double m[3][3], const double r[3], double x[3]) {
+
+  auto determinant = [](const double a[3][3]) {
+    return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+           a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+           a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+  };
+  double d = determinant(m);
+  if (fabs(d) < 1e-12) return false;
+  for (int c = 0; c < 3; c++) {
+    double replaced[3][3];
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) replaced[i][j] = (j == c) ? r[i] : m[i][j];
+    }
+    x[c] = determinant(replaced) / d;
+  }
+  return true;
+}
+
+const char *GlitchTypeToString(GlitchType type) {
+  switch (type) {
+    case GLITCH_TYPE_DISCONTINUITY: return "discontinuity";
+    case GLITCH_TYPE_DROPOUT: return "dropout";
+    case GLITCH_TYPE_REPEATED_BUFFER: return "repeated_buffer";
+    case GLITCH_TYPE_TONE_RESIDUAL: return "tone_residual";
+  }
+  return "unknown";
+}
+
+void GlitchDetector::setup(int32_t sampleRate, int32_t repeatPeriodFrames) {
+
+  sampleRate_ = sampleRate;
+  levelCoefficient_ = 1.0f - expf(-1.0f / (kLevelSeconds * sampleRate));
+  differencePeakDecay_ = expf(-1.0f / (kDifferencePeakSeconds * sampleRate));
+  minDropoutFrames_ = std::max(1, static_cast<int32_t>(kMinDropoutSeconds * sampleRate));
+  maxDropoutFrames_ = static_cast<int32_t>(kMaxDropoutSeconds * sampleRate);
+  mergeFrames_ = static_cast<int32_t>(kMergeSeconds * sampleRate);
+  repeatPeriodFrames_ = repeatPeriodFrames;
+  history_.assign(repeatPeriodFrames, 0.0f);
+  toneBlockFrames_ = static_cast<int32_t>(kToneBlockSeconds * sampleRate);
+
+  // Repeats are found a period after the discontinuity which starts them, and tone residuals up to
+  // a block after the glitch
+  holdFrames_ = mergeFrames_ + std::max(repeatPeriodFrames_, toneBlockFrames_);
+  toneBlock_.assign(toneBlockFrames_, 0.0f);
+  anchors_.assign(kMaxAnchors, Anchor());
+  anchorCount_ = 0;
+  events_.clear();
+  nextFramePosition_ = -1;
+  restart();
+}
+
+void GlitchDetector::setTestTone(float frequency) {
+
+  toneFrequency_ = frequency;
+  tonePhaseIncrement_ = 2.0 * M_PI * frequency / sampleRate_;
+  restart();
+}
+
+/**
+ * Start the analysis again from scratch, after a gap in the audio or a change of settings.
+ * Anything already found is kept.
+ */
+void GlitchDetector::restart() {
+
+  finish();
+
+  meanSquare_ = 0;
+  differenceMeanSquare_ = 0;
+  differencePeak_ = 0;
+  previous_[0] = previous_[1] = 0;
+  warmupFrames_ = static_cast<int32_t>(kWarmupSeconds * sampleRate_);
+  zeroRunFrames_ = 0;
+
+  // NAN never matches
+  std::fill(history_.begin(), history_.end(), std::numeric_limits<float>::quiet_NaN());
+  historyIndex_ = 0;
+  matchFrames_ = 0;
+  isMatchAfterChange_ = false;
+  constantFrames_ = 0;
+
+  toneBlockCount_ = 0;
+  tonePhase_ = 0;
+  toneAmplitude_ = 0;
+  hasToneOffset_ = false;
+  toneWarmupBlocks_ = kToneWarmupBlocks;
+}
+
+void GlitchDetector::process(const float *samples, int32_t numFrames, int64_t framePosition,
+                             int64_t timestampNs, int32_t xRunCount) {
+
+  if (nextFramePosition_ >= 0 && framePosition != nextFramePosition_) restart();
+  nextFramePosition_ = framePosition + numFrames;
+
+  anchorIndex_ = (anchorIndex_ + 1) % kMaxAnchors;
+  anchors_[anchorIndex_] = {framePosition, timestampNs, xRunCount};
+  anchorCount_ = std::min(anchorCount_ + 1, kMaxAnchors);
+
+  for (int32_t i = 0; i < numFrames; i++) {
+    if (toneFrequency_ > 0) {
+      toneBlock_[toneBlockCount_++] = samples[i];
+      if (toneBlockCount_ == toneBlockFrames_) {
+        toneBlockStart_ = framePosition + i + 1 - toneBlockFrames_;
+        processToneBlock();
+        toneBlockCount_ = 0;
+      }
+    } else {
+      processSample(samples[i], framePosition + i);
+    }
+  }
+  flushPending(nextFramePosition_);
+}
+
+void GlitchDetector::processSample(float sample, int64_t frame) {
+
+  float activeLevel = decibelsToAmplitude(kActiveLevelDb);
+  bool isZero = fabsf(sample) <= kZeroLevel;
+  bool wasZero = fabsf(previous_[0]) <= kZeroLevel;
+  bool wasZeroBefore = fabsf(previous_[1]) <= kZeroLevel;
+
+  // Jumps to or from zero are left to the dropout detection
+  float previous = previous_[0];
+  float difference = sample - 2.0f * previous_[0] + previous_[1];
+  float differenceSquared = difference * difference;
+  float differencePeak = differencePeak_ * differencePeakDecay_;
+  bool isDiscontinuity = warmupFrames_ == 0 && !isZero && !wasZero && !wasZeroBefore &&
+                         fabsf(difference) > kMinDiscontinuity &&
+                         fabsf(difference) > kDiscontinuityPeakRatio * differencePeak &&
+                         differenceSquared > kDiscontinuityRatio * kDiscontinuityRatio *
+                                             differenceMeanSquare_;
+  if (isDiscontinuity) {
+    flag(GLITCH_TYPE_DISCONTINUITY, frame, 1,
+         amplitudeToDb(fabsf(difference) /
+                       std::max(sqrtf(differenceMeanSquare_), kMinDifferenceRms)));
+  }
+
+  // Every sample counts towards the baselines, so an edge which keeps coming back becomes part of
+  // what the signal normally does. A one off glitch only masks much smaller ones for a while.
+  differenceMeanSquare_ += (differenceSquared - differenceMeanSquare_) * levelCoefficient_;
+  differencePeak_ = std::max(differencePeak, fabsf(difference));
+  previous_[1] = previous_[0];
+  previous_[0] = sample;
+  if (warmupFrames_ > 0) warmupFrames_--;
+
+  if (isZero) {
+    if (zeroRunFrames_ == 0) levelBeforeZeros_ = sqrtf(meanSquare_);
+    zeroRunFrames_++;
+  } else {
+    if (zeroRunFrames_ >= minDropoutFrames_ && zeroRunFrames_ <= maxDropoutFrames_ &&
+        levelBeforeZeros_ > activeLevel) {
+      addEvent(GLITCH_TYPE_DROPOUT, frame - zeroRunFrames_, zeroRunFrames_,
+               amplitudeToDb(levelBeforeZeros_));
+    }
+    zeroRunFrames_ = 0;
+  }
+  meanSquare_ += (sample * sample - meanSquare_) * levelCoefficient_;
+
+  if (repeatPeriodFrames_ > 0) {
+    float repeated = history_[historyIndex_];
+    history_[historyIndex_] = sample;
+    historyIndex_ = (historyIndex_ + 1) % repeatPeriodFrames_;
+    if (sample == repeated) {
+      matchFrames_++;
+    } else {
+      matchFrames_ = 0;
+      isMatchAfterChange_ = fabsf(sample - repeated) > kRepeatChangeLevel;
+    }
+    constantFrames_ = (sample == previous) ? constantFrames_ + 1 : 0;
+
+    // Only the first period of a match is a repeat, and only if the signal wasn't already
+    // repeating to within rounding, so a waveform whose cycle divides the period isn't one.
+    // Neither is a period of DC or zeros, which the dropout detection looks after.
+    if (matchFrames_ == repeatPeriodFrames_ && isMatchAfterChange_ &&
+        constantFrames_ < repeatPeriodFrames_) {
+      float level = sqrtf(meanSquare_);
+      if (level > activeLevel) {
+
+        // The jump into the repeat is part of the same glitch
+        int64_t start = frame + 1 - repeatPeriodFrames_;
+        GlitchEvent &pending = pending_[GLITCH_TYPE_DISCONTINUITY];
+        if (isPending_[GLITCH_TYPE_DISCONTINUITY] &&
+            pending.framePosition >= start - mergeFrames_) {
+          isPending_[GLITCH_TYPE_DISCONTINUITY] = false;
+        }
+        addEvent(GLITCH_TYPE_REPEATED_BUFFER, start, repeatPeriodFrames_, amplitudeToDb(level));
+      }
+    }
+  }
+}
+
+/**
+ * Least squares fit of a sine at the tracked frequency, plus an offset, to a block of the tone.
+ * The phase is carried on from block to block, so a change in the fitted phase means the
+ * frequency is off and it's corrected.
+ *
+ * Once the tone is locked the residual is taken against the last clean block's fit carried
+ * forward, so a glitch can't pull the fit towards itself and spread over the whole block.
+ */
+void GlitchDetector::processToneBlock() {
+
+  int32_t length = toneBlockFrames_;
+  double m[3][3] = {};
+  double r[3] = {};
+  for (int32_t n = 0; n < length; n++) {
+    double phase = tonePhase_ + tonePhaseIncrement_ * n;
+    double basis[3] = {sin(phase), cos(phase), 1.0};
+    for (int i = 0; i < 3; i++) {
+      r[i] += basis[i] * toneBlock_[n];
+      for (int j = 0; j < 3; j++) m[i][j] += basis[i] * basis[j];
+    }
+  }
+  double fit[3] = {0, 0, 0};
+  solve3(m, r, fit);
+  float amplitude = static_cast<float>(hypot(fit[0], fit[1]));
+
+  bool isToneLocked = toneWarmupBlocks_ == 0 && toneAmplitude_ > 0;
+  const double *model = isToneLocked ? toneFit_ : fit;
+  float threshold = std::max(kResidualRatio * residualFloor_,
+                             decibelsToAmplitude(kMinResidualDb) * toneAmplitude_);
+  double residualSquares = 0;
+  int32_t flaggedFrames = 0;
+  for (int32_t n = 0; n < length; n++) {
+    double phase = tonePhase_ + tonePhaseIncrement_ * n;
+    float residual = toneBlock_[n] -
+        static_cast<float>(model[0] * sin(phase) + model[1] * cos(phase) + model[2]);
+    residualSquares += residual * residual;
+    if (isToneLocked && fabsf(residual) > threshold) {
+      flag(GLITCH_TYPE_TONE_RESIDUAL, toneBlockStart_ + n, 1,
+           amplitudeToDb(fabsf(residual) / toneAmplitude_));
+      flaggedFrames++;
+    }
+  }
+  float residualRms = static_cast<float>(sqrt(residualSquares / length));
+  double offset = atan2(fit[1], fit[0]);
+  tonePhase_ = fmod(tonePhase_ + tonePhaseIncrement_ * length, 2.0 * M_PI);
+
+  if (amplitude < decibelsToAmplitude(kActiveLevelDb)) {
+
+    // No tone. If it went away briefly that's a glitch, which has been flagged above, otherwise
+    // it has stopped and has to be found again.
+    GlitchEvent &pending = pending_[GLITCH_TYPE_TONE_RESIDUAL];
+    if (isToneLocked && isPending_[GLITCH_TYPE_TONE_RESIDUAL] &&
+        pending.durationFrames > maxDropoutFrames_) {
+      isPending_[GLITCH_TYPE_TONE_RESIDUAL] = false;
+      toneAmplitude_ = 0;
+    }
+    if (toneAmplitude_ == 0) toneWarmupBlocks_ = kToneWarmupBlocks;
+    hasToneOffset_ = false;
+    return;
+  }
+
+  // Only clean blocks train the frequency, level and residual floor
+  if (flaggedFrames > 0) {
+    hasToneOffset_ = false;
+    return;
+  }
+  if (hasToneOffset_) {
+    double step = remainder(offset - toneOffset_, 2.0 * M_PI);
+    if (fabs(step) < kMaxPhaseStepRadians) {
+      tonePhaseIncrement_ += kFrequencyTrackingGain * step / length;
+    }
+  }
+  toneOffset_ = static_cast<float>(offset);
+  hasToneOffset_ = true;
+
+  // The phase runs on from block to block, so the fit carries straight over to the next one
+  std::copy(fit, fit + 3, toneFit_);
+
+  if (toneWarmupBlocks_ > 0) {
+    toneWarmupBlocks_--;
+    toneAmplitude_ = amplitude;
+    residualFloor_ = residualRms;
+  } else {
+    toneAmplitude_ += (amplitude - toneAmplitude_) * kResidualFloorSmoothing;
+    residualFloor_ += (residualRms - residualFloor_) * kResidualFloorSmoothing;
+  }
+}
+
+void GlitchDetector::flag(GlitchType type, int64_t frame, int32_t durationFrames,
+                          float levelDb) {
+
+  GlitchEvent &pending = pending_[type];
+  if (isPending_[type] && frame <= pending.framePosition + pending.durationFrames + mergeFrames_) {
+    int64_t end = std::max(pending.framePosition + pending.durationFrames, frame + durationFrames);
+    pending.durationFrames = static_cast<int32_t>(end - pending.framePosition);
+    pending.levelDb = std::max(pending.levelDb, levelDb);
+    return;
+  }
+  if (isPending_[type]) events_.push_back(pending);
+  pending = makeEvent(type, frame, durationFrames, levelDb);
+  isPending_[type] = true;
+}
+
+void GlitchDetector::flushPending(int64_t frame) {
+
+  for (int type = 0; type <= GLITCH_TYPE_TONE_RESIDUAL; type++) {
+    GlitchEvent &pending = pending_[type];
+    if (isPending_[type] && frame > pending.framePosition + pending.durationFrames + holdFrames_) {
+      events_.push_back(pending);
+      isPending_[type] = false;
+    }
+  }
+}
+
+void GlitchDetector::addEvent(GlitchType type, int64_t frame, int32_t durationFrames,
+                              float levelDb) {
+  events_.push_back(makeEvent(type, frame, durationFrames, levelDb));
+}
+
+/**
+ * Timestamp the event from the latest chunk which started at or before it. Events are found soon
+ * after the audio arrives so the chunk is normally still in the ring.
+ */
+GlitchEvent GlitchDetector::makeEvent(GlitchType type, int64_t frame, int32_t durationFrames,
+                                      float levelDb) const {
+
+  const Anchor *anchor = nullptr;
+  for (int32_t i = 0; i < anchorCount_; i++) {
+    anchor = &anchors_[(anchorIndex_ + kMaxAnchors - i) % kMaxAnchors];
+    if (anchor->framePosition <= frame) break;
+  }
+  GlitchEvent event = {type, frame, durationFrames, levelDb, 0, 0};
+  if (anchor != nullptr) {
+    event.timestampNs = anchor->timestampNs +
+        (frame - anchor->framePosition) * 1000000000LL / sampleRate_;
+    event.xRunCount = anchor->xRunCount;
+  }
+  return event;
+}
+
+void GlitchDetector::finish() {
+
+  for (int type = 0; type <= GLITCH_TYPE_TONE_RESIDUAL; type++) {
+    if (isPending_[type]) events_.push_back(pending_[type]);
+    isPending_[type] = false;
+  }
+}
+
+void GlitchDetector::takeEvents(std::vector<GlitchEvent> *events) {
+  events->insert(events->end(), events_.begin(), events_.end());
+  events_.clear();
+}
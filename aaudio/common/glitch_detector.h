@@ -0,0 +1,159 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_GLITCH_DETECTOR_H
+#define AAUDIO_GLITCH_DETECTOR_H
+
+#include <cstdint>
+#include <vector>
+
+enum GlitchType {
+  GLITCH_TYPE_DISCONTINUITY,   // a sudden jump in the waveform
+  GLITCH_TYPE_DROPOUT,         // a run of zeros in the middle of a signal
+  GLITCH_TYPE_REPEATED_BUFFER, // a buffer's worth of frames which exactly repeats the last one
+  GLITCH_TYPE_TONE_RESIDUAL,   // a departure from the expected test tone
+};
+
+const char *GlitchTypeToString(GlitchType type);
+
+struct GlitchEvent {
+  GlitchType type;
+  int64_t framePosition;   // of the first glitched frame, counted from the start of the stream
+  int32_t durationFrames;
+
+  // How big the glitch was in dB. Relative to the tone for tone residuals and to the recent signal
+  // level for discontinuities, the signal level before it for dropouts and repeated buffers.
+  float levelDb;
+
+  // When the callback which contained the first glitched frame ran, plus the offset of the frame
+  // within it, and the stream's xrun count at that time. These line the glitch up with callback
+  // timing records and xruns.
+  int64_t timestampNs;
+  int32_t xRunCount;
+};
+
+/**
+ * Finds glitches in a mono stream of audio, either as it's tapped from a running stream or
+ * offline from a capture. Audio is passed in chunks, normally one per data callback, each tagged
+ * with its position in the stream and when it was handed over.
+ *
+ * Without a test tone the detector looks for discontinuities, dropouts and repeated buffers in
+ * arbitrary audio. A discontinuity is a second difference which is much larger than both its
+ * recent average and its recent peak, so the edges of a periodic waveform aren't. A dropout is a
+ * run of zeros which interrupts a signal and then ends. A repeated buffer is repeatPeriodFrames
+ * which exactly match the frames before them, which is what a stream which replays its last
+ * buffer on an underrun produces.
+ *
+ * With a test tone each block of audio is fitted to a sine at the tone's frequency, which is
+ * tracked so that clock drift doesn't matter, and any frames which depart from the fit by much
+ * more than the usual residual are glitches. This catches every kind of glitch in a tone, down to
+ * well below the level of the tone.
+ *
+ * Not for use on the audio thread.
+ */
+class GlitchDetector {
+public:
+  /**
+   * @param repeatPeriodFrames the length of buffer to look for repeats of, e.g. the burst size,
+   * or 0 to not look for repeats
+   */
+  void setup(int32_t sampleRate, int32_t repeatPeriodFrames);
+
+  // @param frequency the frequency of a test tone, or 0 for arbitrary audio
+  void setTestTone(float frequency);
+
+  /**
+   * @param framePosition the position of the first frame in the stream. If this doesn't follow on
+   * from the last chunk some audio was lost before it reached the detector, which restarts its
+   * analysis rather than report a glitch.
+   * @param timestampNs when the first frame was handed over, or 0 for offline captures
+   */
+  void process(const float *samples, int32_t numFrames, int64_t framePosition,
+               int64_t timestampNs, int32_t xRunCount);
+
+  // Add the glitches found so far to events, and forget them
+  void takeEvents(std::vector<GlitchEvent> *events);
+
+  // At the end of a capture, report the glitches which are being held back in case a later
+  // finding explains them
+  void finish();
+
+private:
+  struct Anchor {
+    int64_t framePosition;
+    int64_t timestampNs;
+    int32_t xRunCount;
+  };
+
+  void restart();
+  void processSample(float sample, int64_t frame);
+  void processToneBlock();
+  void flag(GlitchType type, int64_t frame, int32_t durationFrames, float levelDb);
+  void flushPending(int64_t frame);
+  void addEvent(GlitchType type, int64_t frame, int32_t durationFrames, float levelDb);
+  GlitchEvent makeEvent(GlitchType type, int64_t frame, int32_t durationFrames,
+                        float levelDb) const;
+
+  int32_t sampleRate_ = 0;
+  float toneFrequency_ = 0;
+  int64_t nextFramePosition_ = -1;
+  std::vector<Anchor> anchors_;
+  int32_t anchorIndex_ = 0;
+  int32_t anchorCount_ = 0;
+  std::vector<GlitchEvent> events_;
+
+  // Flagged frames close together are merged into one event, which is held back for a while in
+  // case a later finding explains it
+  int32_t mergeFrames_ = 0;
+  int32_t holdFrames_ = 0;
+  bool isPending_[GLITCH_TYPE_TONE_RESIDUAL + 1] = {};
+  GlitchEvent pending_[GLITCH_TYPE_TONE_RESIDUAL + 1];
+
+  // Arbitrary audio
+  float levelCoefficient_ = 0;
+  float meanSquare_ = 0;
+  float differenceMeanSquare_ = 0;
+  float differencePeak_ = 0;
+  float differencePeakDecay_ = 0;
+  float previous_[2] = {0, 0};
+  int32_t warmupFrames_ = 0;
+  int32_t zeroRunFrames_ = 0;
+  float levelBeforeZeros_ = 0;
+  int32_t minDropoutFrames_ = 0;
+  int32_t maxDropoutFrames_ = 0;
+  int32_t repeatPeriodFrames_ = 0;
+  std::vector<float> history_;
+  int32_t historyIndex_ = 0;
+  int32_t matchFrames_ = 0;
+  bool isMatchAfterChange_ = false;
+  int32_t constantFrames_ = 0;
+
+  // Test tone
+  int32_t toneBlockFrames_ = 0;
+  std::vector<float> toneBlock_;
+  int32_t toneBlockCount_ = 0;
+  int64_t toneBlockStart_ = 0;
+  double tonePhase_ = 0;
+  double tonePhaseIncrement_ = 0;
+  double toneFit_[3] = {0, 0, 0};  // sine, cosine and offset of the last clean block
+  float toneOffset_ = 0;
+  bool hasToneOffset_ = false;
+  float toneAmplitude_ = 0;
+  float residualFloor_ = 0;
+  int32_t toneWarmupBlocks_ = 0;
+};
+
+#endif //AAUDIO_GLITCH_DETECTOR_H
@@ -0,0 +1,433 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <aaudio/AAudio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "aaudio_host.h"
+#include "channel_model.h"
+
+constexpr int32_t kDefaultSampleRate = 48000;
+constexpr int32_t kDefaultFramesPerBurst = 192;
+constexpr int32_t kBurstsPerBuffer = 4;
+constexpr int32_t kDefaultOutputChannelCount = 2;
+constexpr int32_t kDefaultInputChannelCount = 1;
+constexpr float kInt16ToFloat = 1.0f / 32768.0f;
+constexpr float kFloatToInt16 = 32767.0f;
+
+struct AAudioStreamBuilderStruct {
+  int32_t deviceId = AAUDIO_UNSPECIFIED;
+  aaudio_direction_t direction = AAUDIO_DIRECTION_OUTPUT;
+  int32_t channelCount = AAUDIO_UNSPECIFIED;
+  aaudio_format_t format = AAUDIO_FORMAT_UNSPECIFIED;
+  aaudio_sharing_mode_t sharingMode = AAUDIO_SHARING_MODE_SHARED;
+  aaudio_performance_mode_t performanceMode = AAUDIO_PERFORMANCE_MODE_NONE;
+  int32_t bufferCapacity = AAUDIO_UNSPECIFIED;
+  AAudioStream_dataCallback dataCallback = nullptr;
+  void *dataUserData = nullptr;
+  AAudioStream_errorCallback errorCallback = nullptr;
+  void *errorUserData = nullptr;
+};
+
+struct AAudioStreamStruct {
+  AAudioStreamBuilderStruct settings;
+  int32_t sampleRate;
+  int32_t framesPerBurst;
+  int32_t bufferCapacity;
+  int32_t bufferSize;
+  std::atomic<aaudio_stream_state_t> state {AAUDIO_STREAM_STATE_OPEN};
+  std::atomic<int64_t> framesWritten {0};
+  std::atomic<int64_t> framesRead {0};
+  std::atomic<int32_t> xRunCount {0};
+  std::thread callbackThread;
+
+  // Recording streams only, mono frames which have arrived from the channel model
+  std::deque<float> recorded;
+};
+
+static int32_t deviceSampleRate = kDefaultSampleRate;
+static int32_t deviceFramesPerBurst = kDefaultFramesPerBurst;
+static ChannelModel *deviceChannelModel = nullptr;
+static bool isExclusiveAvailable = true;
+static int32_t underrunPeriod = 0;
+static bool isRealTime = false;
+
+// The recording stream which is currently open, the playback thread delivers to it
+static std::mutex recordingLock;
+static AAudioStream *recordingStream = nullptr;
+
+void AAudioHost_setDevice(int32_t sampleRate, int32_t framesPerBurst) {
+  deviceSampleRate = sampleRate;
+  deviceFramesPerBurst = framesPerBurst;
+}
+
+void AAudioHost_setChannelModel(ChannelModel *channelModel) {
+  deviceChannelModel = channelModel;
+}
+
+void AAudioHost_setExclusiveAvailable(bool isAvailable) {
+  isExclusiveAvailable = isAvailable;
+}
+
+void AAudioHost_setUnderrunPeriod(int32_t callbackPeriod) {
+  underrunPeriod = callbackPeriod;
+}
+
+void AAudioHost_setRealTime(bool realTime) {
+  isRealTime = realTime;
+}
+
+static int32_t bytesPerSample(aaudio_format_t format) {
+  return (format == AAUDIO_FORMAT_PCM_I16) ? sizeof(int16_t) : sizeof(float);
+}
+
+// Deliver a burst of mic audio to the recording stream, if it's running
+static void deliverToRecordingStream(const float *mic, int32_t numFrames) {
+
+  std::lock_guard<std::mutex> lock(recordingLock);
+  AAudioStream *stream = recordingStream;
+  if (stream == nullptr || stream->state != AAUDIO_STREAM_STATE_STARTED) return;
+
+  stream->recorded.insert(stream->recorded.end(), mic, mic + numFrames);
+  stream->framesWritten += numFrames;
+  int32_t overflow = static_cast<int32_t>(stream->recorded.size()) - stream->bufferCapacity;
+  if (overflow > 0) {
+    stream->recorded.erase(stream->recorded.begin(), stream->recorded.begin() + overflow);
+    stream->xRunCount++;
+  }
+}
+
+/**
+ * The playback device. Each burst the mic first picks up what the speaker played during the
+ * previous one, then the app is asked for the next burst.
+ */
+static void runPlaybackStream(AAudioStream *stream) {
+
+  int32_t numFrames = stream->framesPerBurst;
+  int32_t channelCount = stream->settings.channelCount;
+  std::vector<uint8_t> buffer(numFrames * channelCount * bytesPerSample(stream->settings.format));
+  std::vector<float> speaker(numFrames, 0.0f);
+  std::vector<float> mic(numFrames, 0.0f);
+  int32_t callbackCount = 0;
+  auto burstPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(static_cast<double>(numFrames) / stream->sampleRate));
+  auto nextBurstTime = std::chrono::steady_clock::now();
+
+  while (stream->state == AAUDIO_STREAM_STATE_STARTED) {
+
+    if (isRealTime) {
+      std::this_thread::sleep_until(nextBurstTime);
+      nextBurstTime += burstPeriod;
+    }
+
+    if (deviceChannelModel != nullptr) {
+      deviceChannelModel->process(speaker.data(), mic.data(), numFrames);
+    }
+    deliverToRecordingStream(mic.data(), numFrames);
+
+    aaudio_data_callback_result_t result = stream->settings.dataCallback(
+        stream, stream->settings.dataUserData, buffer.data(), numFrames);
+    stream->framesWritten += numFrames;
+    stream->framesRead += numFrames;
+    callbackCount++;
+    if (underrunPeriod > 0 && callbackCount % underrunPeriod == 0 &&
+        stream->bufferSize <= stream->framesPerBurst) {
+      stream->xRunCount++;
+    }
+
+    // The speaker plays the average of the channels
+    for (int32_t i = 0; i < numFrames; i++) {
+      float sum = 0;
+      for (int32_t c = 0; c < channelCount; c++) {
+        int32_t index = i * channelCount + c;
+        sum += (stream->settings.format == AAUDIO_FORMAT_PCM_I16) ?
+               reinterpret_cast<int16_t *>(buffer.data())[index] * kInt16ToFloat :
+               reinterpret_cast<float *>(buffer.data())[index];
+      }
+      speaker[i] = sum / channelCount;
+    }
+
+    if (result == AAUDIO_CALLBACK_RESULT_STOP) {
+      stream->state = AAUDIO_STREAM_STATE_STOPPED;
+    }
+  }
+}
+
+const char *AAudio_convertResultToText(aaudio_result_t returnCode) {
+  switch (returnCode) {
+    case AAUDIO_OK: return "AAUDIO_OK";
+    case AAUDIO_ERROR_ILLEGAL_ARGUMENT: return "AAUDIO_ERROR_ILLEGAL_ARGUMENT";
+    case AAUDIO_ERROR_INVALID_STATE: return "AAUDIO_ERROR_INVALID_STATE";
+    case AAUDIO_ERROR_UNAVAILABLE: return "AAUDIO_ERROR_UNAVAILABLE";
+    case AAUDIO_ERROR_UNIMPLEMENTED: return "AAUDIO_ERROR_UNIMPLEMENTED";
+    default: return "Unrecognized AAudio error";
+  }
+}
+
+aaudio_result_t AAudio_createStreamBuilder(AAudioStreamBuilder **builder) {
+  *builder = new AAudioStreamBuilder();
+  return AAUDIO_OK;
+}
+
+void AAudioStreamBuilder_setDeviceId(AAudioStreamBuilder *builder, int32_t deviceId) {
+  builder->deviceId = deviceId;
+}
+
+void AAudioStreamBuilder_setDirection(AAudioStreamBuilder *builder, aaudio_direction_t direction) {
+  builder->direction = direction;
+}
+
+// The device has a single sample rate, which is what every stream gets
+void AAudioStreamBuilder_setSampleRate(AAudioStreamBuilder *builder __unused,
+                                       int32_t sampleRate __unused) {
+}
+
+void AAudioStreamBuilder_setChannelCount(AAudioStreamBuilder *builder, int32_t channelCount) {
+  builder->channelCount = channelCount;
+}
+
+void AAudioStreamBuilder_setFormat(AAudioStreamBuilder *builder, aaudio_format_t format) {
+  builder->format = format;
+}
+
+void AAudioStreamBuilder_setSharingMode(AAudioStreamBuilder *builder,
+                                        aaudio_sharing_mode_t sharingMode) {
+  builder->sharingMode = sharingMode;
+}
+
+void AAudioStreamBuilder_setPerformanceMode(AAudioStreamBuilder *builder,
+                                            aaudio_performance_mode_t mode) {
+  builder->performanceMode = mode;
+}
+
+void AAudioStreamBuilder_setBufferCapacityInFrames(AAudioStreamBuilder *builder,
+                                                   int32_t numFrames) {
+  builder->bufferCapacity = numFrames;
+}
+
+void AAudioStreamBuilder_setDataCallback(AAudioStreamBuilder *builder,
+                                         AAudioStream_dataCallback callback, void *userData) {
+  builder->dataCallback = callback;
+  builder->dataUserData = userData;
+}
+
+void AAudioStreamBuilder_setErrorCallback(AAudioStreamBuilder *builder,
+                                          AAudioStream_errorCallback callback, void *userData) {
+  builder->errorCallback = callback;
+  builder->errorUserData = userData;
+}
+
+aaudio_result_t AAudioStreamBuilder_openStream(AAudioStreamBuilder *builder,
+                                               AAudioStream **stream) {
+
+  bool isInput = builder->direction == AAUDIO_DIRECTION_INPUT;
+  if (builder->format != AAUDIO_FORMAT_UNSPECIFIED &&
+      builder->format != AAUDIO_FORMAT_PCM_I16 && builder->format != AAUDIO_FORMAT_PCM_FLOAT) {
+    return AAUDIO_ERROR_INVALID_FORMAT;
+  }
+  if (!isInput && builder->dataCallback == nullptr) return AAUDIO_ERROR_UNIMPLEMENTED;
+  if (isInput && recordingStream != nullptr) return AAUDIO_ERROR_UNAVAILABLE;
+
+  AAudioStream *newStream = new AAudioStream();
+  newStream->settings = *builder;
+  if (newStream->settings.format == AAUDIO_FORMAT_UNSPECIFIED) {
+    newStream->settings.format = AAUDIO_FORMAT_PCM_FLOAT;
+  }
+  if (!isExclusiveAvailable) newStream->settings.sharingMode = AAUDIO_SHARING_MODE_SHARED;
+  if (newStream->settings.channelCount == AAUDIO_UNSPECIFIED) {
+    newStream->settings.channelCount = isInput ? kDefaultInputChannelCount :
+                                       kDefaultOutputChannelCount;
+  }
+  newStream->sampleRate = deviceSampleRate;
+  newStream->framesPerBurst = deviceFramesPerBurst;
+  newStream->bufferCapacity = std::max(builder->bufferCapacity,
+                                       deviceFramesPerBurst * kBurstsPerBuffer);
+  newStream->bufferSize = newStream->bufferCapacity;
+
+  if (isInput) {
+    std::lock_guard<std::mutex> lock(recordingLock);
+    recordingStream = newStream;
+  }
+  *stream = newStream;
+  return AAUDIO_OK;
+}
+
+aaudio_result_t AAudioStreamBuilder_delete(AAudioStreamBuilder *builder) {
+  delete builder;
+  return AAUDIO_OK;
+}
+
+aaudio_result_t AAudioStream_requestStart(AAudioStream *stream) {
+
+  if (stream->state == AAUDIO_STREAM_STATE_STARTED) return AAUDIO_OK;
+  if (stream->callbackThread.joinable()) stream->callbackThread.join();
+
+  if (stream->settings.direction == AAUDIO_DIRECTION_INPUT) {
+    std::lock_guard<std::mutex> lock(recordingLock);
+    stream->recorded.clear();
+    stream->state = AAUDIO_STREAM_STATE_STARTED;
+  } else {
+    stream->state = AAUDIO_STREAM_STATE_STARTED;
+    stream->callbackThread = std::thread(runPlaybackStream, stream);
+  }
+  return AAUDIO_OK;
+}
+
+aaudio_result_t AAudioStream_requestStop(AAudioStream *stream) {
+
+  if (stream->state == AAUDIO_STREAM_STATE_STARTED) stream->state = AAUDIO_STREAM_STATE_STOPPED;
+  if (stream->callbackThread.joinable() &&
+      stream->callbackThread.get_id() != std::this_thread::get_id()) {
+    stream->callbackThread.join();
+  }
+  return AAUDIO_OK;
+}
+
+aaudio_result_t AAudioStream_close(AAudioStream *stream) {
+
+  AAudioStream_requestStop(stream);
+  {
+    std::lock_guard<std::mutex> lock(recordingLock);
+    if (recordingStream == stream) recordingStream = nullptr;
+  }
+  delete stream;
+  return AAUDIO_OK;
+}
+
+// Reads never wait, the timeout is ignored
+aaudio_result_t AAudioStream_read(AAudioStream *stream, void *buffer, int32_t numFrames,
+                                  int64_t timeoutNanoseconds __unused) {
+
+  if (stream->settings.direction != AAUDIO_DIRECTION_INPUT) return AAUDIO_ERROR_UNIMPLEMENTED;
+  if (stream->state != AAUDIO_STREAM_STATE_STARTED) return AAUDIO_ERROR_INVALID_STATE;
+
+  std::lock_guard<std::mutex> lock(recordingLock);
+  int32_t framesRead = std::min(numFrames, static_cast<int32_t>(stream->recorded.size()));
+  int32_t channelCount = stream->settings.channelCount;
+  for (int32_t i = 0; i < framesRead; i++) {
+    float sample = stream->recorded[i];
+    for (int32_t c = 0; c < channelCount; c++) {
+      if (stream->settings.format == AAUDIO_FORMAT_PCM_I16) {
+        float clipped = std::min(std::max(sample, -1.0f), 1.0f);
+        static_cast<int16_t *>(buffer)[i * channelCount + c] =
+            static_cast<int16_t>(clipped * kFloatToInt16);
+      } else {
+        static_cast<float *>(buffer)[i * channelCount + c] = sample;
+      }
+    }
+  }
+  stream->recorded.erase(stream->recorded.begin(), stream->recorded.begin() + framesRead);
+  stream->framesRead += framesRead;
+  return framesRead;
+}
+
+// Playback is only supported through the data callback
+aaudio_result_t AAudioStream_write(AAudioStream *stream __unused, const void *buffer __unused,
+                                   int32_t numFrames __unused,
+                                   int64_t timeoutNanoseconds __unused) {
+  return AAUDIO_ERROR_UNIMPLEMENTED;
+}
+
+aaudio_result_t AAudioStream_setBufferSizeInFrames(AAudioStream *stream, int32_t numFrames) {
+  stream->bufferSize = std::min(std::max(numFrames, stream->framesPerBurst),
+                                stream->bufferCapacity);
+  return stream->bufferSize;
+}
+
+int32_t AAudioStream_getBufferSizeInFrames(AAudioStream *stream) {
+  return stream->bufferSize;
+}
+
+int32_t AAudioStream_getBufferCapacityInFrames(AAudioStream *stream) {
+  return stream->bufferCapacity;
+}
+
+int32_t AAudioStream_getFramesPerBurst(AAudioStream *stream) {
+  return stream->framesPerBurst;
+}
+
+int32_t AAudioStream_getXRunCount(AAudioStream *stream) {
+  return stream->xRunCount;
+}
+
+int32_t AAudioStream_getSampleRate(AAudioStream *stream) {
+  return stream->sampleRate;
+}
+
+int32_t AAudioStream_getChannelCount(AAudioStream *stream) {
+  return stream->settings.channelCount;
+}
+
+int32_t AAudioStream_getDeviceId(AAudioStream *stream) {
+  return stream->settings.deviceId;
+}
+
+aaudio_format_t AAudioStream_getFormat(AAudioStream *stream) {
+  return stream->settings.format;
+}
+
+aaudio_sharing_mode_t AAudioStream_getSharingMode(AAudioStream *stream) {
+  return stream->settings.sharingMode;
+}
+
+aaudio_performance_mode_t AAudioStream_getPerformanceMode(AAudioStream *stream) {
+  return stream->settings.performanceMode;
+}
+
+aaudio_direction_t AAudioStream_getDirection(AAudioStream *stream) {
+  return stream->settings.direction;
+}
+
+aaudio_stream_state_t AAudioStream_getState(AAudioStream *stream) {
+  return stream->state;
+}
+
+int64_t AAudioStream_getFramesWritten(AAudioStream *stream) {
+  return stream->framesWritten;
+}
+
+int64_t AAudioStream_getFramesRead(AAudioStream *stream) {
+  return stream->framesRead;
+}
+
+/**
+ * The device presents and captures frames the moment they're handed over, so the timestamps just
+ * reflect the buffering. A playback stream's buffer is assumed to be full, and a shared one goes
+ * through a mixer which holds another burst.
+ */
+aaudio_result_t AAudioStream_getTimestamp(AAudioStream *stream, clockid_t clockid,
+                                          int64_t *framePosition, int64_t *timeNanoseconds) {
+
+  if (stream->state != AAUDIO_STREAM_STATE_STARTED) return AAUDIO_ERROR_INVALID_STATE;
+
+  if (stream->settings.direction == AAUDIO_DIRECTION_INPUT) {
+    *framePosition = stream->framesWritten;
+  } else {
+    int32_t mixerFrames = (stream->settings.sharingMode == AAUDIO_SHARING_MODE_SHARED) ?
+                          stream->framesPerBurst : 0;
+    *framePosition = std::max(static_cast<int64_t>(0),
+                              stream->framesRead - stream->bufferSize - mixerFrames);
+  }
+  timespec now;
+  clock_gettime(clockid, &now);
+  *timeNanoseconds = static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  return AAUDIO_OK;
+}
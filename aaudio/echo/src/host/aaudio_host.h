@@ -0,0 +1,54 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_HOST_AAUDIO_HOST_H
+#define AAUDIO_HOST_AAUDIO_HOST_H
+
+#include <cstdint>
+
+class ChannelModel;
+
+/**
+ * Controls for the host AAudio stand-in, which has a single playback and recording device. The
+ * playback stream's data callback is called from its own thread, by default back to back with no
+ * waiting, so the streams run as fast as the engine can keep up. Whatever it plays goes through the
+ * channel model and arrives at the recording stream a burst later.
+ *
+ * Must be called before any streams are opened.
+ */
+void AAudioHost_setDevice(int32_t sampleRate, int32_t framesPerBurst);
+
+// The path from playback to recording, the recording stream gets silence if this is null
+void AAudioHost_setChannelModel(ChannelModel *channelModel);
+
+// Whether the device can give exclusive streams, if not they fall back to shared like on Android
+void AAudioHost_setExclusiveAvailable(bool isAvailable);
+
+/**
+ * Make the playback stream underrun once every callbackPeriod callbacks while its buffer is a
+ * single burst, as a device whose callbacks are sometimes late would. 0, the default, never
+ * underruns.
+ */
+void AAudioHost_setUnderrunPeriod(int32_t callbackPeriod);
+
+/**
+ * Call the playback stream's data callback once a burst period, as a real device would, rather
+ * than back to back. For sessions whose timing matters, e.g. control changes made from another
+ * thread while a session log is being written.
+ */
+void AAudioHost_setRealTime(bool isRealTime);
+
+#endif //AAUDIO_HOST_AAUDIO_HOST_H
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "channel_model.h"
+
+constexpr float kButterworthQ = 0.70710678f;
+constexpr uint32_t kNoiseSeed = 0x12345678;
+
+static float decibelsToAmplitude(float decibels) {
+  return powf(10.0f, decibels / 20.0f);
+}
+
+void ChannelModel::setup(int32_t sampleRate, const ChannelModelParameters &parameters) {
+
+  parameters_ = parameters;
+  gain_ = decibelsToAmplitude(parameters.gainDb);
+  noiseAmplitude_ = decibelsToAmplitude(parameters.noiseDb);
+
+  // Audio EQ cookbook filters, normalized so that a0 = 1
+  float omega = 2.0f * static_cast<float>(M_PI) * parameters.highPassFrequency / sampleRate;
+  float alpha = sinf(omega) / (2.0f * kButterworthQ);
+  float a0 = 1.0f + alpha;
+  highPass_ = {(1.0f + cosf(omega)) / 2.0f / a0, -(1.0f + cosf(omega)) / a0,
+               (1.0f + cosf(omega)) / 2.0f / a0, -2.0f * cosf(omega) / a0, (1.0f - alpha) / a0,
+               0, 0};
+
+  omega = 2.0f * static_cast<float>(M_PI) * parameters.lowPassFrequency / sampleRate;
+  alpha = sinf(omega) / (2.0f * kButterworthQ);
+  a0 = 1.0f + alpha;
+  lowPass_ = {(1.0f - cosf(omega)) / 2.0f / a0, (1.0f - cosf(omega)) / a0,
+              (1.0f - cosf(omega)) / 2.0f / a0, -2.0f * cosf(omega) / a0, (1.0f - alpha) / a0,
+              0, 0};
+
+  int32_t delayFrames = static_cast<int32_t>(lroundf(parameters.latencyMs * sampleRate / 1000));
+  delayLine_.assign(delayFrames + 1, 0.0f);
+  delayIndex_ = 0;
+  noiseState_ = kNoiseSeed;
+}
+
+float ChannelModel::Biquad::process(float input) {
+  float output = b0 * input + z1;
+  z1 = b1 * input - a1 * output + z2;
+  z2 = b2 * input - a2 * output;
+  return output;
+}
+
+// Box-Muller on a xorshift generator, so runs are repeatable
+float ChannelModel::nextGaussian() {
+
+  float uniform[2];
+  for (float &value : uniform) {
+    noiseState_ ^= noiseState_ << 13;
+    noiseState_ ^= noiseState_ >> 17;
+    noiseState_ ^= noiseState_ << 5;
+    value = (noiseState_ + 1.0f) / 4294967296.0f;
+  }
+  return sqrtf(-2.0f * logf(uniform[0])) * cosf(2.0f * static_cast<float>(M_PI) * uniform[1]);
+}
+
+void ChannelModel::process(const float *speaker, float *mic, int32_t numFrames) {
+
+  int32_t delayLength = static_cast<int32_t>(delayLine_.size());
+  for (int32_t i = 0; i < numFrames; i++) {
+    float x = speaker[i];
+    float distorted = x + parameters_.secondOrder * x * x + parameters_.thirdOrder * x * x * x;
+    float filtered = lowPass_.process(highPass_.process(distorted));
+
+    delayLine_[delayIndex_] = filtered * gain_;
+    delayIndex_ = (delayIndex_ + 1) % delayLength;
+    mic[i] = delayLine_[delayIndex_] + noiseAmplitude_ * nextGaussian();
+  }
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_HOST_CHANNEL_MODEL_H
+#define AAUDIO_HOST_CHANNEL_MODEL_H
+
+#include <cstdint>
+#include <vector>
+
+struct ChannelModelParameters {
+  float latencyMs = 10.0f;
+  float gainDb = -6.0f;
+  float highPassFrequency = 100.0f;    // the speaker's bass roll off
+  float lowPassFrequency = 15000.0f;   // the mic's treble roll off
+  float secondOrder = 0.0f;            // coefficients of x^2 and x^3 in the speaker's distortion
+  float thirdOrder = 0.0f;
+  float noiseDb = -90.0f;              // RMS of the white noise at the mic, relative to full scale
+};
+
+/**
+ * A synthetic acoustic path from a speaker to a mic, for running the echo engine against the
+ * host AAudio stand-in. The speaker distorts with a polynomial, the response is band limited by
+ * a 2nd order high-pass and low-pass, and the mic adds white noise. All of these are simple
+ * enough that a measurement of the path can be checked against the parameters.
+ */
+class ChannelModel {
+public:
+  void setup(int32_t sampleRate, const ChannelModelParameters &parameters);
+
+  // Mono in and out
+  void process(const float *speaker, float *mic, int32_t numFrames);
+
+private:
+  struct Biquad {
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+
+    float process(float input);
+  };
+
+  float nextGaussian();
+
+  ChannelModelParameters parameters_;
+  float gain_ = 1.0f;
+  float noiseAmplitude_ = 0;
+  Biquad highPass_;
+  Biquad lowPass_;
+  std::vector<float> delayLine_;
+  int32_t delayIndex_ = 0;
+  uint32_t noiseState_ = 1;
+};
+
+#endif //AAUDIO_HOST_CHANNEL_MODEL_H
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the feedback suppressor inside a simulated speaker to mic loop and prints how quickly it
+ * stopped the howl, how quiet the loop ended up and what the suppressor cost as JSON, e.g.
+ *
+ *   echo_feedback_benchmark --loop-gain-db 3.5 --frequency 1000 --delay-frames 320
+ *
+ * The loop is a delay and a resonance whose peak gain is above unity, with white noise at the
+ * mic to start it off, so without the suppressor it howls up to full scale. Returns 2 if the
+ * loop is still howling at the end, which is what --no-suppressor is expected to do.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "feedback_suppressor.h"
+
+// Anything louder than this over the last second is still howling
+constexpr float kHowlingDb = -20.0f;
+constexpr float kSettleSeconds = 1.0f;
+constexpr float kResonanceQ = 10.0f;
+
+static void printUsage(const char *program) {
+  fprintf(stderr, "usage: %s [--sample-rate HZ] [--burst FRAMES] [--seconds S]"
+          " [--loop-gain-db DB] [--frequency HZ] [--delay-frames FRAMES] [--noise-db DB]"
+          " [--no-suppressor]\n", program);
+}
+
+// A constant 0 dB peak gain band-pass, which is where the loop's gain is highest
+struct Resonance {
+  float b0, b2, a1, a2;
+  float z1 = 0, z2 = 0;
+
+  void setup(float frequency, int32_t sampleRate) {
+    float w0 = 2.0f * static_cast<float>(M_PI) * frequency / sampleRate;
+    float alpha = sinf(w0) / (2.0f * kResonanceQ);
+    float a0 = 1.0f + alpha;
+    b0 = alpha / a0;
+    b2 = -alpha / a0;
+    a1 = -2.0f * cosf(w0) / a0;
+    a2 = (1.0f - alpha) / a0;
+  }
+
+  float process(float input) {
+    float output = b0 * input + z1;
+    z1 = -a1 * output + z2;
+    z2 = b2 * input - a2 * output;
+    return output;
+  }
+};
+
+static float toDb(double meanSquare) {
+  return 10.0f * static_cast<float>(log10(meanSquare + 1e-20));
+}
+
+int main(int argc, char **argv) {
+
+  int32_t sampleRate = 48000;
+  int32_t framesPerBurst = 192;
+  float seconds = 10.0f;
+  float loopGainDb = 3.5f;
+  float frequency = 1000.0f;
+  int32_t delayFrames = 320;
+  float noiseDb = -60.0f;
+  bool isSuppressorOn = true;
+
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    if (strcmp(option, "--no-suppressor") == 0) {
+      isSuppressorOn = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    float value = strtof(argv[++i], nullptr);
+    if (strcmp(option, "--sample-rate") == 0) {
+      sampleRate = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--burst") == 0) {
+      framesPerBurst = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--seconds") == 0) {
+      seconds = value;
+    } else if (strcmp(option, "--loop-gain-db") == 0) {
+      loopGainDb = value;
+    } else if (strcmp(option, "--frequency") == 0) {
+      frequency = value;
+    } else if (strcmp(option, "--delay-frames") == 0) {
+      delayFrames = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--noise-db") == 0) {
+      noiseDb = value;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (sampleRate <= 0 || framesPerBurst <= 0 || delayFrames <= 0 || seconds < kSettleSeconds) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  FeedbackSuppressor suppressor;
+  suppressor.setup(sampleRate, 1);
+  Resonance resonance;
+  resonance.setup(frequency, sampleRate);
+  float loopGain = powf(10.0f, loopGainDb / 20.0f);
+  float noiseAmplitude = powf(10.0f, noiseDb / 20.0f) * sqrtf(3.0f);  // uniform, so RMS matches
+  uint32_t noiseState = 1;
+
+  std::vector<float> delayLine(delayFrames, 0.0f);
+  int32_t delayIndex = 0;
+  std::vector<float> block(framesPerBurst);
+  float *channels[] = {block.data()};
+
+  int64_t totalFrames = static_cast<int64_t>(seconds * sampleRate);
+  int64_t settleStart = totalFrames - static_cast<int64_t>(kSettleSeconds * sampleRate);
+  double settledSquares = 0;
+  double peakSquare = 0;
+  double processSeconds = 0;
+  double maxProcessUs = 0;
+  int32_t blockCount = 0;
+  int32_t maxNotchCount = 0;
+  double firstNotchSeconds = -1;
+
+  for (int64_t frame = 0; frame < totalFrames; frame += framesPerBurst) {
+    int32_t numFrames = static_cast<int32_t>(std::min<int64_t>(framesPerBurst,
+                                                               totalFrames - frame));
+    // The mic hears what the speaker played delayFrames ago through the resonance, plus noise
+    for (int32_t i = 0; i < numFrames; i++) {
+      noiseState = noiseState * 1664525u + 1013904223u;
+      float noise = (static_cast<float>(noiseState >> 8) / (1 << 24) * 2.0f - 1.0f) *
+                    noiseAmplitude;
+      int32_t index = (delayIndex + i) % delayFrames;
+      block[i] = loopGain * resonance.process(delayLine[index]) + noise;
+    }
+
+    if (isSuppressorOn) {
+      auto start = std::chrono::steady_clock::now();
+      suppressor.process(channels, 1, numFrames);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      processSeconds += elapsed.count();
+      maxProcessUs = std::max(maxProcessUs, elapsed.count() * 1e6);
+      blockCount++;
+      int32_t notchCount = suppressor.getActiveNotchCount();
+      if (notchCount > 0 && firstNotchSeconds < 0) {
+        firstNotchSeconds = static_cast<double>(frame) / sampleRate;
+      }
+      maxNotchCount = std::max(maxNotchCount, notchCount);
+    }
+
+    // The speaker clips at full scale, which is what stops a howl growing without one
+    for (int32_t i = 0; i < numFrames; i++) {
+      float output = std::min(std::max(block[i], -1.0f), 1.0f);
+      delayLine[(delayIndex + i) % delayFrames] = output;
+      double square = static_cast<double>(output) * output;
+      peakSquare = std::max(peakSquare, square);
+      if (frame + i >= settleStart) settledSquares += square;
+    }
+    delayIndex = (delayIndex + numFrames) % delayFrames;
+  }
+
+  float settledDb = toDb(settledSquares / (totalFrames - settleStart));
+  double averageProcessUs = (blockCount > 0) ? processSeconds * 1e6 / blockCount : 0;
+  double realTimeLoad = processSeconds / seconds;
+  printf("{\"suppressor\":%s,\"loopGainDb\":%.1f,\"frequency\":%.1f,\"delayFrames\":%d,"
+         "\"peakDb\":%.1f,\"settledDb\":%.1f,\"firstNotchSeconds\":%.3f,\"maxNotches\":%d,"
+         "\"averageProcessUs\":%.2f,\"maxProcessUs\":%.2f,\"realTimeLoad\":%.5f}\n",
+         isSuppressorOn ? "true" : "false", loopGainDb, frequency, delayFrames,
+         toDb(peakSquare), settledDb, firstNotchSeconds, maxNotchCount, averageProcessUs,
+         maxProcessUs, realTimeLoad);
+  return settledDb > kHowlingDb ? 2 : 0;
+}
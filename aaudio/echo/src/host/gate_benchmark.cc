@@ -0,0 +1,130 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures what the echo path costs per callback with the voice activity gate held open and held
+ * closed, and prints both as JSON, e.g.
+ *
+ *   echo_gate_benchmark --seconds 2 --open-noise-db -30
+ *
+ * Each case records an echo session with live grains on against the channel model, whose mic
+ * noise is either far below the gate's thresholds (a quiet room) or above them, then replays the
+ * log as fast as it can so that only the engine's render is timed.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "aaudio_host.h"
+#include "channel_model.h"
+#include "echo_audio_engine.h"
+
+constexpr char kLogPath[] = "gate_benchmark_session.log";
+constexpr float kClosedNoiseDb = -90.0f;
+
+static void printUsage(const char *program) {
+  fprintf(stderr, "usage: %s [--sample-rate HZ] [--burst FRAMES] [--seconds S]"
+          " [--open-noise-db DB]\n", program);
+}
+
+/**
+ * Record an echo session with the given mic noise and replay it.
+ * @return false if the session couldn't be recorded or replayed
+ */
+static bool measure(int32_t sampleRate, float noiseDb, float seconds,
+                    SessionReplayResults *results) {
+
+  ChannelModelParameters parameters;
+  parameters.noiseDb = noiseDb;
+  ChannelModel channelModel;
+  channelModel.setup(sampleRate, parameters);
+  AAudioHost_setChannelModel(&channelModel);
+  {
+    EchoAudioEngine engine;
+    engine.setGranularParameters(40.0f, 60.0f, 200.0f, 0.0f, 0.5f, 0.5f, 0.5f);
+    engine.setGranularOn(true);
+    engine.setSessionLogPath(kLogPath);
+    engine.setEchoOn(true);
+    std::this_thread::sleep_for(std::chrono::duration<float>(seconds));
+    engine.setEchoOn(false);
+  }
+  AAudioHost_setChannelModel(nullptr);
+
+  EchoAudioEngine engine;
+  bool isReplayed = engine.replaySession(kLogPath, false, results);
+  remove(kLogPath);
+  return isReplayed;
+}
+
+int main(int argc, char **argv) {
+
+  int32_t sampleRate = 48000;
+  int32_t framesPerBurst = 192;
+  float seconds = 2.0f;
+  float openNoiseDb = -30.0f;
+
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    float value = strtof(argv[++i], nullptr);
+    if (strcmp(option, "--sample-rate") == 0) {
+      sampleRate = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--burst") == 0) {
+      framesPerBurst = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--seconds") == 0) {
+      seconds = value;
+    } else if (strcmp(option, "--open-noise-db") == 0) {
+      openNoiseDb = value;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (sampleRate <= 0 || framesPerBurst <= 0 || seconds <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  // Paced like a device, otherwise the callbacks would fill the log faster than it is written
+  AAudioHost_setDevice(sampleRate, framesPerBurst);
+  AAudioHost_setRealTime(true);
+
+  const char *names[] = {"open", "closed"};
+  const float noiseDbs[] = {openNoiseDb, kClosedNoiseDb};
+  printf("{\"sampleRate\":%d,\"burst\":%d,\"gate\":[", sampleRate, framesPerBurst);
+  for (int g = 0; g < 2; g++) {
+    SessionReplayResults results;
+    if (!measure(sampleRate, noiseDbs[g], seconds, &results)) {
+      fprintf(stderr, "Unable to record and replay the %s gate session\n", names[g]);
+      return 1;
+    }
+    double averageRenderUs = results.renderSeconds * 1e6 / results.callbackCount;
+    double realTimeLoad = (results.sessionSeconds > 0) ?
+        results.renderSeconds / results.sessionSeconds : 0;
+    printf("%s{\"state\":\"%s\",\"noiseDb\":%.1f,\"callbacks\":%d,\"averageRenderUs\":%.2f,"
+           "\"maxRenderUs\":%.2f,\"realTimeLoad\":%.5f}",
+           (g > 0) ? "," : "", names[g], noiseDbs[g], results.callbackCount, averageRenderUs,
+           results.maxCallbackRenderUs, realTimeLoad);
+  }
+  printf("]}\n");
+  AAudioHost_setRealTime(false);
+  return 0;
+}
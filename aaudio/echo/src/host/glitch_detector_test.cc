@@ -0,0 +1,146 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs clean waveforms through the glitch detector and checks that nothing is found in them,
+ * then injects a dropout, a click and a repeated buffer into a chord and checks that each is
+ * found exactly once. Prints each case and returns non-zero if any fails.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "glitch_detector.h"
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kFramesPerBurst = 192;
+constexpr float kSeconds = 2.0f;
+
+static std::vector<float> makeSignal(std::function<float(int32_t)> sample) {
+  std::vector<float> signal(static_cast<size_t>(kSeconds * kSampleRate));
+  for (size_t i = 0; i < signal.size(); i++) signal[i] = sample(static_cast<int32_t>(i));
+  return signal;
+}
+
+static float sine(float frequency, int32_t frame) {
+  return sinf(static_cast<float>(fmod(2.0 * M_PI * frequency * frame / kSampleRate, 2.0 * M_PI)));
+}
+
+// Every harmonic below Nyquist, so the saw is as sharp as it can be without aliasing
+static float bandLimitedSaw(float frequency, int32_t frame) {
+  float sum = 0;
+  for (int h = 1; h * frequency < kSampleRate / 2; h++) {
+    sum += sine(h * frequency, frame) / h;
+  }
+  return 0.5f * sum;
+}
+
+static float naivePhase(float frequency, int32_t frame) {
+  double cycles = static_cast<double>(frequency) * frame / kSampleRate;
+  return static_cast<float>(cycles - floor(cycles));
+}
+
+static float chord(int32_t frame) {
+  return 0.2f * (sine(440.0f, frame) + sine(554.37f, frame) + sine(659.26f, frame));
+}
+
+// Passes the signal through in bursts, as a stream's callbacks would
+static std::vector<GlitchEvent> detect(const std::vector<float> &signal) {
+
+  GlitchDetector detector;
+  detector.setup(kSampleRate, kFramesPerBurst);
+  for (size_t frame = 0; frame < signal.size(); frame += kFramesPerBurst) {
+    int32_t numFrames = static_cast<int32_t>(std::min<size_t>(kFramesPerBurst,
+                                                               signal.size() - frame));
+    detector.process(signal.data() + frame, numFrames, static_cast<int64_t>(frame), 0, 0);
+  }
+  detector.finish();
+  std::vector<GlitchEvent> events;
+  detector.takeEvents(&events);
+  return events;
+}
+
+int main() {
+
+  int failureCount = 0;
+
+  auto expectClean = [&](const char *name, std::function<float(int32_t)> sample) {
+    std::vector<GlitchEvent> events = detect(makeSignal(sample));
+    bool isPassed = events.empty();
+    printf("%s: %s has no glitches", isPassed ? "PASS" : "FAIL", name);
+    if (!isPassed) {
+      printf(", found %zu, the first a %s at frame %lld", events.size(),
+             GlitchTypeToString(events[0].type), static_cast<long long>(events[0].framePosition));
+    }
+    printf("\n");
+    if (!isPassed) failureCount++;
+  };
+
+  expectClean("1kHz sine", [](int32_t frame) { return 0.5f * sine(1000.0f, frame); });
+  expectClean("chord", chord);
+  for (float frequency : {55.0f, 110.0f, 220.0f}) {
+    char name[64];
+    snprintf(name, sizeof(name), "%.0fHz band limited saw", frequency);
+    expectClean(name, [frequency](int32_t frame) { return bandLimitedSaw(frequency, frame); });
+  }
+  expectClean("100Hz naive saw", [](int32_t frame) {
+    return 0.8f * (2.0f * naivePhase(100.0f, frame) - 1.0f);
+  });
+  expectClean("30Hz naive square", [](int32_t frame) {
+    return (naivePhase(30.0f, frame) < 0.5f) ? 0.5f : -0.5f;
+  });
+  uint32_t noiseState = 1;
+  expectClean("white noise", [&noiseState](int32_t) {
+    noiseState = noiseState * 1664525u + 1013904223u;
+    return (static_cast<float>(noiseState >> 8) / (1 << 24) * 2.0f - 1.0f) * 0.3f;
+  });
+
+  auto expectFoundOnce = [&](const char *name, GlitchType type, int64_t frame,
+                             const std::vector<float> &signal) {
+    std::vector<GlitchEvent> events = detect(signal);
+    bool isPassed = events.size() == 1 && events[0].type == type &&
+                    llabs(events[0].framePosition - frame) <= 2;
+    printf("%s: %s is found once", isPassed ? "PASS" : "FAIL", name);
+    if (!isPassed) {
+      printf(", found %zu:", events.size());
+      for (const GlitchEvent &event : events) {
+        printf(" %s at frame %lld", GlitchTypeToString(event.type),
+               static_cast<long long>(event.framePosition));
+      }
+    }
+    printf("\n");
+    if (!isPassed) failureCount++;
+  };
+
+  const int32_t glitchFrame = kSampleRate + 1000;
+  std::vector<float> dropout = makeSignal(chord);
+  std::fill(dropout.begin() + glitchFrame, dropout.begin() + glitchFrame + 480, 0.0f);
+  expectFoundOnce("10ms dropout", GLITCH_TYPE_DROPOUT, glitchFrame, dropout);
+
+  std::vector<float> click = makeSignal(chord);
+  click[glitchFrame] += 0.2f;
+  expectFoundOnce("click", GLITCH_TYPE_DISCONTINUITY, glitchFrame - 1, click);
+
+  // The last burst is played again and the rest of the signal follows a burst late
+  std::vector<float> repeat = makeSignal(chord);
+  repeat.insert(repeat.begin() + glitchFrame, repeat.begin() + glitchFrame - kFramesPerBurst,
+                repeat.begin() + glitchFrame);
+  expectFoundOnce("repeated burst", GLITCH_TYPE_REPEATED_BUFFER, glitchFrame, repeat);
+
+  return failureCount == 0 ? 0 : 1;
+}
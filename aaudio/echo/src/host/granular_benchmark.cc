@@ -0,0 +1,126 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the granular processor on stereo noise with more and more overlapping grains, and prints
+ * the cost per burst for each grain count as JSON, e.g.
+ *
+ *   echo_granular_benchmark --burst 64 --seconds 1
+ *
+ * The grains are a fixed length with no jitter, so the number playing at once is the density
+ * times the length. Each count is run for a second before it is timed, so that the pool has
+ * filled up to it.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "granular_processor.h"
+
+constexpr int32_t kGrainCounts[] = {8, 32, 128, 256, 500};
+constexpr float kGrainMs = 250.0f;
+constexpr float kWarmUpSeconds = 1.0f;
+
+static void printUsage(const char *program) {
+  fprintf(stderr, "usage: %s [--sample-rate HZ] [--burst FRAMES] [--seconds S]\n", program);
+}
+
+int main(int argc, char **argv) {
+
+  int32_t sampleRate = 48000;
+  int32_t framesPerBurst = 64;
+  float seconds = 1.0f;
+
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    float value = strtof(argv[++i], nullptr);
+    if (strcmp(option, "--sample-rate") == 0) {
+      sampleRate = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--burst") == 0) {
+      framesPerBurst = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--seconds") == 0) {
+      seconds = value;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (sampleRate <= 0 || framesPerBurst <= 0 || seconds <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<float> left(framesPerBurst), right(framesPerBurst);
+  float *channels[] = {left.data(), right.data()};
+  uint32_t noiseState = 1;
+  auto fillNoise = [&]() {
+    for (int32_t i = 0; i < framesPerBurst; i++) {
+      noiseState = noiseState * 1664525u + 1013904223u;
+      left[i] = (static_cast<float>(noiseState >> 8) / (1 << 24) - 0.5f) * 0.5f;
+      right[i] = left[i];
+    }
+  };
+
+  printf("{\"sampleRate\":%d,\"burst\":%d,\"grains\":[", sampleRate, framesPerBurst);
+  for (size_t g = 0; g < sizeof(kGrainCounts) / sizeof(kGrainCounts[0]); g++) {
+    GranularProcessor processor;
+    processor.setup(sampleRate);
+    float density = kGrainCounts[g] * 1000.0f / kGrainMs;
+    processor.setParameters(density, kGrainMs, 100.0f, 0.0f, 0.0f, 1.0f, 0.5f);
+    processor.setEnabled(true);
+
+    int64_t warmUpFrames = static_cast<int64_t>(kWarmUpSeconds * sampleRate);
+    for (int64_t frame = 0; frame < warmUpFrames; frame += framesPerBurst) {
+      fillNoise();
+      processor.process(channels, 2, framesPerBurst);
+    }
+
+    // Only the processor is timed, the noise is made outside the clock
+    int64_t totalFrames = static_cast<int64_t>(seconds * sampleRate);
+    double processSeconds = 0;
+    double maxProcessUs = 0;
+    int64_t grainSum = 0;
+    int32_t burstCount = 0;
+    for (int64_t frame = 0; frame < totalFrames; frame += framesPerBurst) {
+      fillNoise();
+      auto start = std::chrono::steady_clock::now();
+      processor.process(channels, 2, framesPerBurst);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      processSeconds += elapsed.count();
+      maxProcessUs = std::max(maxProcessUs, elapsed.count() * 1e6);
+      grainSum += processor.getActiveGrainCount();
+      burstCount++;
+    }
+
+    double averageGrains = static_cast<double>(grainSum) / burstCount;
+    double averageProcessUs = processSeconds * 1e6 / burstCount;
+    double nsPerGrainFrame = (averageGrains > 0) ?
+        averageProcessUs * 1000.0 / (averageGrains * framesPerBurst) : 0;
+    printf("%s{\"targetGrains\":%d,\"averageGrains\":%.1f,\"averageProcessUs\":%.2f,"
+           "\"maxProcessUs\":%.2f,\"nsPerGrainFrame\":%.2f,\"realTimeLoad\":%.4f}",
+           (g > 0) ? "," : "", kGrainCounts[g], averageGrains, averageProcessUs, maxProcessUs,
+           nsPerGrainFrame, processSeconds / seconds);
+  }
+  printf("]}\n");
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for the parts of the NDK's AAudio API used by the echo sample, so that the echo
+ * engine can run headless on a development machine. The values match the NDK header. Streams are
+ * implemented in aaudio_host.cc.
+ */
+
+#ifndef AAUDIO_HOST_AAUDIO_H
+#define AAUDIO_HOST_AAUDIO_H
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+
+#ifndef __unused
+#define __unused __attribute__((unused))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AAUDIO_UNSPECIFIED 0
+
+typedef int32_t aaudio_result_t;
+enum {
+  AAUDIO_OK = 0,
+  AAUDIO_ERROR_BASE = -900,
+  AAUDIO_ERROR_DISCONNECTED = -899,
+  AAUDIO_ERROR_ILLEGAL_ARGUMENT = -898,
+  AAUDIO_ERROR_INTERNAL = -896,
+  AAUDIO_ERROR_INVALID_STATE = -895,
+  AAUDIO_ERROR_INVALID_HANDLE = -892,
+  AAUDIO_ERROR_UNIMPLEMENTED = -890,
+  AAUDIO_ERROR_UNAVAILABLE = -889,
+  AAUDIO_ERROR_NO_MEMORY = -887,
+  AAUDIO_ERROR_TIMEOUT = -885,
+  AAUDIO_ERROR_INVALID_FORMAT = -883,
+};
+
+typedef int32_t aaudio_direction_t;
+enum {
+  AAUDIO_DIRECTION_OUTPUT = 0,
+  AAUDIO_DIRECTION_INPUT = 1,
+};
+
+typedef int32_t aaudio_format_t;
+enum {
+  AAUDIO_FORMAT_INVALID = -1,
+  AAUDIO_FORMAT_UNSPECIFIED = 0,
+  AAUDIO_FORMAT_PCM_I16 = 1,
+  AAUDIO_FORMAT_PCM_FLOAT = 2,
+};
+
+typedef int32_t aaudio_stream_state_t;
+enum {
+  AAUDIO_STREAM_STATE_UNINITIALIZED = 0,
+  AAUDIO_STREAM_STATE_UNKNOWN = 1,
+  AAUDIO_STREAM_STATE_OPEN = 2,
+  AAUDIO_STREAM_STATE_STARTING = 3,
+  AAUDIO_STREAM_STATE_STARTED = 4,
+  AAUDIO_STREAM_STATE_PAUSING = 5,
+  AAUDIO_STREAM_STATE_PAUSED = 6,
+  AAUDIO_STREAM_STATE_FLUSHING = 7,
+  AAUDIO_STREAM_STATE_FLUSHED = 8,
+  AAUDIO_STREAM_STATE_STOPPING = 9,
+  AAUDIO_STREAM_STATE_STOPPED = 10,
+  AAUDIO_STREAM_STATE_CLOSING = 11,
+  AAUDIO_STREAM_STATE_CLOSED = 12,
+  AAUDIO_STREAM_STATE_DISCONNECTED = 13,
+};
+
+typedef int32_t aaudio_sharing_mode_t;
+enum {
+  AAUDIO_SHARING_MODE_EXCLUSIVE = 0,
+  AAUDIO_SHARING_MODE_SHARED = 1,
+};
+
+typedef int32_t aaudio_performance_mode_t;
+enum {
+  AAUDIO_PERFORMANCE_MODE_NONE = 10,
+  AAUDIO_PERFORMANCE_MODE_POWER_SAVING = 11,
+  AAUDIO_PERFORMANCE_MODE_LOW_LATENCY = 12,
+};
+
+typedef int32_t aaudio_data_callback_result_t;
+enum {
+  AAUDIO_CALLBACK_RESULT_CONTINUE = 0,
+  AAUDIO_CALLBACK_RESULT_STOP = 1,
+};
+
+typedef struct AAudioStreamStruct AAudioStream;
+typedef struct AAudioStreamBuilderStruct AAudioStreamBuilder;
+
+typedef aaudio_data_callback_result_t (*AAudioStream_dataCallback)(AAudioStream *stream,
+                                                                   void *userData,
+                                                                   void *audioData,
+                                                                   int32_t numFrames);
+typedef void (*AAudioStream_errorCallback)(AAudioStream *stream,
+                                           void *userData,
+                                           aaudio_result_t error);
+
+const char *AAudio_convertResultToText(aaudio_result_t returnCode);
+aaudio_result_t AAudio_createStreamBuilder(AAudioStreamBuilder **builder);
+
+void AAudioStreamBuilder_setDeviceId(AAudioStreamBuilder *builder, int32_t deviceId);
+void AAudioStreamBuilder_setDirection(AAudioStreamBuilder *builder, aaudio_direction_t direction);
+void AAudioStreamBuilder_setSampleRate(AAudioStreamBuilder *builder, int32_t sampleRate);
+void AAudioStreamBuilder_setChannelCount(AAudioStreamBuilder *builder, int32_t channelCount);
+void AAudioStreamBuilder_setFormat(AAudioStreamBuilder *builder, aaudio_format_t format);
+void AAudioStreamBuilder_setSharingMode(AAudioStreamBuilder *builder,
+                                        aaudio_sharing_mode_t sharingMode);
+void AAudioStreamBuilder_setPerformanceMode(AAudioStreamBuilder *builder,
+                                            aaudio_performance_mode_t mode);
+void AAudioStreamBuilder_setBufferCapacityInFrames(AAudioStreamBuilder *builder,
+                                                   int32_t numFrames);
+void AAudioStreamBuilder_setDataCallback(AAudioStreamBuilder *builder,
+                                         AAudioStream_dataCallback callback, void *userData);
+void AAudioStreamBuilder_setErrorCallback(AAudioStreamBuilder *builder,
+                                          AAudioStream_errorCallback callback, void *userData);
+aaudio_result_t AAudioStreamBuilder_openStream(AAudioStreamBuilder *builder,
+                                               AAudioStream **stream);
+aaudio_result_t AAudioStreamBuilder_delete(AAudioStreamBuilder *builder);
+
+aaudio_result_t AAudioStream_requestStart(AAudioStream *stream);
+aaudio_result_t AAudioStream_requestStop(AAudioStream *stream);
+aaudio_result_t AAudioStream_close(AAudioStream *stream);
+aaudio_result_t AAudioStream_read(AAudioStream *stream, void *buffer, int32_t numFrames,
+                                  int64_t timeoutNanoseconds);
+aaudio_result_t AAudioStream_write(AAudioStream *stream, const void *buffer, int32_t numFrames,
+                                   int64_t timeoutNanoseconds);
+aaudio_result_t AAudioStream_setBufferSizeInFrames(AAudioStream *stream, int32_t numFrames);
+int32_t AAudioStream_getBufferSizeInFrames(AAudioStream *stream);
+int32_t AAudioStream_getBufferCapacityInFrames(AAudioStream *stream);
+int32_t AAudioStream_getFramesPerBurst(AAudioStream *stream);
+int32_t AAudioStream_getXRunCount(AAudioStream *stream);
+int32_t AAudioStream_getSampleRate(AAudioStream *stream);
+int32_t AAudioStream_getChannelCount(AAudioStream *stream);
+int32_t AAudioStream_getDeviceId(AAudioStream *stream);
+aaudio_format_t AAudioStream_getFormat(AAudioStream *stream);
+aaudio_sharing_mode_t AAudioStream_getSharingMode(AAudioStream *stream);
+aaudio_performance_mode_t AAudioStream_getPerformanceMode(AAudioStream *stream);
+aaudio_direction_t AAudioStream_getDirection(AAudioStream *stream);
+aaudio_stream_state_t AAudioStream_getState(AAudioStream *stream);
+int64_t AAudioStream_getFramesWritten(AAudioStream *stream);
+int64_t AAudioStream_getFramesRead(AAudioStream *stream);
+aaudio_result_t AAudioStream_getTimestamp(AAudioStream *stream, clockid_t clockid,
+                                          int64_t *framePosition, int64_t *timeNanoseconds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //AAUDIO_HOST_AAUDIO_H
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the echo engine's measurement headless, against the host AAudio stand-in and a synthetic
+ * channel, and prints the results as JSON. The channel parameters can be set on the command
+ * line, e.g.
+ *
+ *   echo_measure --latency-ms 20 --third-order 0.1 --noise-db -80
+ *
+ * With --record the session is also logged, for echo_replay.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "aaudio_host.h"
+#include "channel_model.h"
+#include "echo_audio_engine.h"
+
+constexpr int kPollMilliseconds = 10;
+
+static void printUsage(const char *program) {
+  fprintf(stderr, "usage: %s [--sample-rate HZ] [--burst FRAMES] [--latency-ms MS] [--gain-db DB]"
+          " [--high-pass-hz HZ] [--low-pass-hz HZ] [--second-order A2] [--third-order A3]"
+          " [--noise-db DB] [--record LOG]\n", program);
+}
+
+int main(int argc, char **argv) {
+
+  int32_t sampleRate = 48000;
+  int32_t framesPerBurst = 192;
+  ChannelModelParameters parameters;
+  const char *logPath = nullptr;
+
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    const char *option = argv[i];
+    float value = strtof(argv[i + 1], nullptr);
+    if (strcmp(option, "--sample-rate") == 0) {
+      sampleRate = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--burst") == 0) {
+      framesPerBurst = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--latency-ms") == 0) {
+      parameters.latencyMs = value;
+    } else if (strcmp(option, "--gain-db") == 0) {
+      parameters.gainDb = value;
+    } else if (strcmp(option, "--high-pass-hz") == 0) {
+      parameters.highPassFrequency = value;
+    } else if (strcmp(option, "--low-pass-hz") == 0) {
+      parameters.lowPassFrequency = value;
+    } else if (strcmp(option, "--second-order") == 0) {
+      parameters.secondOrder = value;
+    } else if (strcmp(option, "--third-order") == 0) {
+      parameters.thirdOrder = value;
+    } else if (strcmp(option, "--noise-db") == 0) {
+      parameters.noiseDb = value;
+    } else if (strcmp(option, "--record") == 0) {
+      logPath = argv[i + 1];
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  ChannelModel channelModel;
+  channelModel.setup(sampleRate, parameters);
+  AAudioHost_setDevice(sampleRate, framesPerBurst);
+  AAudioHost_setChannelModel(&channelModel);
+
+  EchoAudioEngine engine;
+  engine.setMeasurementOn(true);
+  if (logPath != nullptr) engine.setSessionLogPath(logPath);
+  engine.setEchoOn(true);
+  while (!engine.isMeasurementComplete()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kPollMilliseconds));
+  }
+  engine.setEchoOn(false);
+
+  MeasurementResults results;
+  if (!engine.getMeasurementResults(&results)) {
+    fprintf(stderr, "Nothing was captured, or it arrived too late to measure\n");
+    return 1;
+  }
+  printf("%s\n", results.toJson().c_str());
+  return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Runs the echo engine's stream configuration probe against the host AAudio stand-in and prints
+ * the results as JSON. The stand-in's device can be made to refuse exclusive streams, or to
+ * underrun with a single burst buffer, to see how the probe copes, e.g.
+ *
+ *   echo_probe --no-exclusive --underrun-period 8
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "aaudio_host.h"
+#include "echo_audio_engine.h"
+
+static void printUsage(const char *program) {
+  fprintf(stderr, "usage: %s [--sample-rate HZ] [--burst FRAMES] [--no-exclusive]"
+          " [--underrun-period CALLBACKS]\n", program);
+}
+
+int main(int argc, char **argv) {
+
+  int32_t sampleRate = 48000;
+  int32_t framesPerBurst = 192;
+
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    if (strcmp(option, "--no-exclusive") == 0) {
+      AAudioHost_setExclusiveAvailable(false);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    int32_t value = atoi(argv[++i]);
+    if (strcmp(option, "--sample-rate") == 0) {
+      sampleRate = value;
+    } else if (strcmp(option, "--burst") == 0) {
+      framesPerBurst = value;
+    } else if (strcmp(option, "--underrun-period") == 0) {
+      AAudioHost_setUnderrunPeriod(value);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  AAudioHost_setDevice(sampleRate, framesPerBurst);
+
+  EchoAudioEngine engine;
+  StreamProbeResults results;
+  if (!engine.probeStreamConfigurations(&results)) {
+    fprintf(stderr, "No stream configuration could be opened and run\n");
+    return 1;
+  }
+
+  // Run echo briefly in the selected configuration, to show what it was granted
+  engine.setEchoOn(true);
+  std::string report = engine.getStreamReport();
+  engine.setEchoOn(false);
+  printf("%s\n", report.c_str());
+  return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Records a measurement session, checks that it replays bit for bit, then replays copies with a
+ * corrupted header or first callback and checks that each fails cleanly rather than rendering
+ * past the engine's buffers. Prints each case and returns non-zero if any fails.
+ *
+ * Measurement mode bypasses the gate, gain control, effect, granular processor and suppressor, so
+ * an echo session with grains from a loaded source, and parameter and window changes part way
+ * through, is recorded and replayed too.
+ */
+
+#include <math.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "aaudio_host.h"
+#include "channel_model.h"
+#include "echo_audio_engine.h"
+
+constexpr char kLogPath[] = "replay_test_session.log";
+constexpr char kCorruptLogPath[] = "replay_test_corrupt.log";
+constexpr char kEchoLogPath[] = "replay_test_echo.log";
+constexpr int kPollMilliseconds = 10;
+constexpr int kEchoStageMilliseconds = 300;
+
+static bool readFile(const char *path, std::vector<uint8_t> *data) {
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr) return false;
+  uint8_t buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data->insert(data->end(), buffer, buffer + count);
+  }
+  fclose(file);
+  return true;
+}
+
+static bool writeFile(const char *path, const std::vector<uint8_t> &data) {
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr) return false;
+  bool isWritten = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && isWritten;
+}
+
+// @return the offset of the first callback record's SessionCallback, or 0 if there isn't one
+static size_t findFirstCallback(const std::vector<uint8_t> &log) {
+  SessionHeader header;
+  memcpy(&header, log.data(), sizeof(header));
+  size_t offset = sizeof(header) + header.granularSourceFrames * sizeof(float);
+  SessionRecordHeader record;
+  while (offset + sizeof(record) <= log.size()) {
+    memcpy(&record, log.data() + offset, sizeof(record));
+    offset += sizeof(record);
+    if (record.type == SESSION_RECORD_CALLBACK) return offset;
+    offset += record.payloadBytes;
+  }
+  return 0;
+}
+
+/**
+ * Echo with grains from a loaded source, changing the grains' parameters and window, and turning
+ * them off, a few callbacks apart, so the control records land between callbacks.
+ */
+static void recordEchoSession() {
+
+  // Back to back callbacks would fill the log faster than it can be written
+  AAudioHost_setRealTime(true);
+  std::vector<float> source(48000);
+  uint32_t noiseState = 1;
+  for (size_t i = 0; i < source.size(); i++) {
+    noiseState = noiseState * 1664525u + 1013904223u;
+    float noise = static_cast<float>(noiseState >> 8) / (1 << 24) - 0.5f;
+    source[i] = 0.3f * sinf(2.0f * static_cast<float>(M_PI) * 220.0f * i / 48000) + 0.1f * noise;
+  }
+
+  EchoAudioEngine engine;
+  engine.setGranularSource(source.data(), static_cast<int32_t>(source.size()));
+  engine.setGranularParameters(40.0f, 60.0f, 200.0f, 0.0f, 0.5f, 0.5f, 0.5f);
+  engine.setGranularOn(true);
+  engine.setSessionLogPath(kEchoLogPath);
+  engine.setEchoOn(true);
+  auto wait = []() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kEchoStageMilliseconds));
+  };
+  wait();
+  engine.setGranularParameters(120.0f, 30.0f, 500.0f, 7.0f, 1.0f, 1.0f, 0.8f);
+  wait();
+  engine.setGranularWindow(static_cast<int32_t>(GrainWindow::Gaussian));
+  wait();
+  engine.setGranularOn(false);
+  wait();
+  engine.setEchoOn(false);
+  AAudioHost_setRealTime(false);
+}
+
+static bool replay(const std::vector<uint8_t> &log, SessionReplayResults *results) {
+  if (!writeFile(kCorruptLogPath, log)) return false;
+  EchoAudioEngine engine;
+  return engine.replaySession(kCorruptLogPath, false, results);
+}
+
+int main() {
+
+  ChannelModel channelModel;
+  channelModel.setup(48000, ChannelModelParameters());
+  AAudioHost_setDevice(48000, 192);
+  AAudioHost_setChannelModel(&channelModel);
+  {
+    EchoAudioEngine engine;
+    engine.setMeasurementOn(true);
+    engine.setSessionLogPath(kLogPath);
+    engine.setEchoOn(true);
+    while (!engine.isMeasurementComplete()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kPollMilliseconds));
+    }
+    engine.setEchoOn(false);
+  }
+
+  std::vector<uint8_t> log;
+  size_t callbackOffset;
+  if (!readFile(kLogPath, &log) || log.size() < sizeof(SessionHeader) ||
+      (callbackOffset = findFirstCallback(log)) == 0) {
+    fprintf(stderr, "The session wasn't recorded\n");
+    return 1;
+  }
+
+  int failureCount = 0;
+  SessionReplayResults results;
+  {
+    EchoAudioEngine engine;
+    bool isReplayed = engine.replaySession(kLogPath, false, &results);
+    bool isPassed = isReplayed && results.mismatchedCallbackCount == 0;
+    printf("%s: intact log replays bit for bit\n", isPassed ? "PASS" : "FAIL");
+    if (!isPassed) failureCount++;
+  }
+
+  recordEchoSession();
+  {
+    EchoAudioEngine engine;
+    bool isReplayed = engine.replaySession(kEchoLogPath, false, &results);
+    // The starting state of each control is logged, then the three changes
+    bool isPassed = isReplayed && results.mismatchedCallbackCount == 0 &&
+                    results.callbackCount > 0 &&
+                    results.controlEventCount == CONTROL_EVENT_TYPE_COUNT + 3;
+    printf("%s: echo session with grains replays bit for bit, %d callbacks, %d control changes,"
+           " %d mismatched\n", isPassed ? "PASS" : "FAIL", results.callbackCount,
+           results.controlEventCount, results.mismatchedCallbackCount);
+    if (!isPassed) failureCount++;
+  }
+
+  auto expectRejected = [&](const char *name, std::function<void(SessionHeader *,
+                                                                 SessionCallback *)> corrupt) {
+    std::vector<uint8_t> corrupted = log;
+    SessionHeader *header = reinterpret_cast<SessionHeader *>(corrupted.data());
+    SessionCallback *callback =
+        reinterpret_cast<SessionCallback *>(corrupted.data() + callbackOffset);
+    corrupt(header, callback);
+    bool isPassed = !replay(corrupted, &results);
+    printf("%s: %s is rejected\n", isPassed ? "PASS" : "FAIL", name);
+    if (!isPassed) failureCount++;
+  };
+
+  expectRejected("oversized callback", [](SessionHeader *, SessionCallback *callback) {
+    callback->numFrames = 100000;
+    callback->framesToRead = 100000;
+    callback->frameCount = 100000;
+  });
+  expectRejected("empty callback", [](SessionHeader *, SessionCallback *callback) {
+    callback->numFrames = 0;
+  });
+  expectRejected("read past the callback", [](SessionHeader *, SessionCallback *callback) {
+    callback->framesToRead = callback->numFrames + 1;
+  });
+  expectRejected("input not matching the read", [](SessionHeader *, SessionCallback *callback) {
+    callback->frameCount = (callback->frameCount > 0) ? callback->frameCount - 1
+                                                      : callback->framesToRead;
+  });
+  expectRejected("zero sample rate", [](SessionHeader *header, SessionCallback *) {
+    header->sampleRate = 0;
+  });
+  expectRejected("unknown format", [](SessionHeader *header, SessionCallback *) {
+    header->inputFormat = 99;
+  });
+  expectRejected("too many channels", [](SessionHeader *header, SessionCallback *) {
+    header->outputChannelCount = kMaxInputChannelCount + 1;
+  });
+  expectRejected("oversized granular source", [](SessionHeader *header, SessionCallback *) {
+    header->granularSourceFrames = 0x7fffffff;
+  });
+
+  remove(kLogPath);
+  remove(kCorruptLogPath);
+  remove(kEchoLogPath);
+  return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Replays a session log through the echo engine on the development machine and prints the
+ * timings and whether the output matched as JSON, e.g.
+ *
+ *   echo_replay session.log --real-time
+ *
+ * Runs the callbacks back to back by default, which is what to profile. With --real-time each
+ * callback starts when it did in the session.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "echo_audio_engine.h"
+
+int main(int argc, char **argv) {
+
+  if (argc < 2 || (argc == 3 && strcmp(argv[2], "--real-time") != 0) || argc > 3) {
+    fprintf(stderr, "usage: %s LOG [--real-time]\n", argv[0]);
+    return 1;
+  }
+
+  EchoAudioEngine engine;
+  SessionReplayResults results;
+  if (!engine.replaySession(argv[1], argc == 3, &results)) {
+    fprintf(stderr, "%s couldn't be replayed\n", argv[1]);
+    return 1;
+  }
+  printf("%s\n", results.toJson().c_str());
+  return results.mismatchedCallbackCount == 0 ? 0 : 2;
+}
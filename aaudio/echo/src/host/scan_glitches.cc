@@ -0,0 +1,175 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the glitch detector over a WAV capture and prints the glitches it finds as JSON, e.g.
+ *
+ *   echo_glitch_scan --repeat-period 192 capture.wav
+ *   echo_glitch_scan --tone 1000 capture.wav
+ *
+ * Reads 16, 24 and 32 bit PCM and 32 bit float, and scans the first channel. Returns 2 if any
+ * glitches were found.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "glitch_detector.h"
+
+// As many frames as a callback might hand over, so the detector sees the capture as it would live
+constexpr int32_t kChunkFrames = 192;
+
+static void printUsage(const char *program) {
+  fprintf(stderr, "usage: %s [--repeat-period FRAMES] [--tone HZ] capture.wav\n", program);
+}
+
+static uint32_t readLittleEndian(const uint8_t *bytes, int numBytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < numBytes; i++) value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+  return value;
+}
+
+/**
+ * Reads the first channel of a WAV file.
+ * @return false if the file can't be read or isn't a format this understands
+ */
+static bool readWav(const char *path, std::vector<float> *samples, int32_t *sampleRate) {
+
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr) return false;
+  std::vector<uint8_t> bytes;
+  uint8_t buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + count);
+  }
+  fclose(file);
+  if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 ||
+      memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+
+  int format = 0;
+  int numChannels = 0;
+  int bitsPerSample = 0;
+  for (size_t offset = 12; offset + 8 <= bytes.size(); ) {
+    const uint8_t *chunk = bytes.data() + offset;
+    size_t chunkBytes = readLittleEndian(chunk + 4, 4);
+    size_t available = std::min(chunkBytes, bytes.size() - offset - 8);
+    if (memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+      format = static_cast<int>(readLittleEndian(chunk + 8, 2));
+      numChannels = static_cast<int>(readLittleEndian(chunk + 10, 2));
+      *sampleRate = static_cast<int32_t>(readLittleEndian(chunk + 12, 4));
+      bitsPerSample = static_cast<int>(readLittleEndian(chunk + 22, 2));
+      if (format == 0xFFFE && available >= 26) {
+        format = static_cast<int>(readLittleEndian(chunk + 32, 2));  // the extensible subformat
+      }
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      bool isPcm = format == 1 && (bitsPerSample == 16 || bitsPerSample == 24 ||
+                                   bitsPerSample == 32);
+      bool isFloat = format == 3 && bitsPerSample == 32;
+      if (numChannels <= 0 || *sampleRate <= 0 || !(isPcm || isFloat)) return false;
+      int bytesPerSample = bitsPerSample / 8;
+      size_t frameBytes = static_cast<size_t>(bytesPerSample) * numChannels;
+      const uint8_t *data = chunk + 8;
+      for (size_t frame = 0; (frame + 1) * frameBytes <= available; frame++) {
+        const uint8_t *sample = data + frame * frameBytes;
+        uint32_t value = readLittleEndian(sample, bytesPerSample);
+        if (isFloat) {
+          float floatValue;
+          memcpy(&floatValue, &value, sizeof(floatValue));
+          samples->push_back(floatValue);
+        } else {
+          // Sign extend by moving the sample to the top of an int32_t
+          int32_t intValue = static_cast<int32_t>(value << (32 - bitsPerSample));
+          samples->push_back(static_cast<float>(intValue) / 2147483648.0f);
+        }
+      }
+      return true;
+    }
+    offset += 8 + chunkBytes + (chunkBytes & 1);
+  }
+  return false;
+}
+
+int main(int argc, char **argv) {
+
+  int32_t repeatPeriodFrames = 0;
+  float toneFrequency = 0;
+  const char *path = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    if (strncmp(option, "--", 2) != 0 && path == nullptr) {
+      path = option;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    float value = strtof(argv[++i], nullptr);
+    if (strcmp(option, "--repeat-period") == 0) {
+      repeatPeriodFrames = static_cast<int32_t>(value);
+    } else if (strcmp(option, "--tone") == 0) {
+      toneFrequency = value;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (path == nullptr || repeatPeriodFrames < 0 || toneFrequency < 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<float> samples;
+  int32_t sampleRate = 0;
+  if (!readWav(path, &samples, &sampleRate)) {
+    fprintf(stderr, "Unable to read %s as a PCM or float WAV\n", path);
+    return 1;
+  }
+
+  GlitchDetector detector;
+  detector.setup(sampleRate, repeatPeriodFrames);
+  detector.setTestTone(toneFrequency);
+  for (size_t frame = 0; frame < samples.size(); frame += kChunkFrames) {
+    int32_t numFrames = static_cast<int32_t>(std::min<size_t>(kChunkFrames,
+                                                               samples.size() - frame));
+    detector.process(samples.data() + frame, numFrames, static_cast<int64_t>(frame), 0, 0);
+  }
+  detector.finish();
+  std::vector<GlitchEvent> events;
+  detector.takeEvents(&events);
+  std::sort(events.begin(), events.end(), [](const GlitchEvent &a, const GlitchEvent &b) {
+    return a.framePosition < b.framePosition;
+  });
+
+  printf("{\"sampleRate\":%d,\"frames\":%zu,\"glitches\":[", sampleRate, samples.size());
+  for (size_t i = 0; i < events.size(); i++) {
+    const GlitchEvent &event = events[i];
+    printf("%s{\"type\":\"%s\",\"frame\":%lld,\"seconds\":%.4f,\"durationFrames\":%d,"
+           "\"levelDb\":%.1f}",
+           (i > 0) ? "," : "", GlitchTypeToString(event.type),
+           static_cast<long long>(event.framePosition),
+           static_cast<double>(event.framePosition) / sampleRate, event.durationFrames,
+           event.levelDb);
+  }
+  printf("]}\n");
+  return events.empty() ? 0 : 2;
+}
@@ -16,11 +16,14 @@
 
 #include "audio_effect.h"
 
-void AudioEffect::process(int16_t *inputBuffer, int32_t samplesPerFrame, int32_t numFrames) {
+void AudioEffect::process(float * const *channels, int32_t channelCount, int32_t numFrames) {
 
-  for (int i = 0; i < (numFrames * samplesPerFrame); i++){
+  for (int c = 0; c < channelCount; c++) {
+    float *channel = channels[c];
+    for (int i = 0; i < numFrames; i++) {
 
-    // DO SOMETHING MORE EXCITING HERE!
-    inputBuffer[i] = inputBuffer[i];
+      // DO SOMETHING MORE EXCITING HERE!
+      channel[i] = channel[i];
+    }
   }
 }
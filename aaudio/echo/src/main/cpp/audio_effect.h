@@ -22,7 +22,21 @@
 
 class AudioEffect {
 public:
-  void process(int16_t *inputBuffer, int32_t samplesPerFrame, int32_t numFrames);
+  /**
+   * Process a block of audio in place.
+   *
+   * @param channels planar float buffers, one per channel, each holding numFrames samples
+   * @param channelCount the number of channels
+   * @param numFrames the number of frames to process
+   */
+  void process(float * const *channels, int32_t channelCount, int32_t numFrames);
+
+  /**
+   * @return the number of frames this effect keeps producing output for after its input has gone
+   * silent, e.g. the decay of a reverb or delay. Upstream gates use this to decide when the effect
+   * can be bypassed.
+   */
+  int32_t getTailFrames() const { return 0; }
 };
 
 
@@ -0,0 +1,430 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <cstdio>
+#include "audio_measurement.h"
+#include "fft.h"
+
+// The stimulus starts with a short silence, so the effects of starting the streams have died
+// down, then an exponential sweep covering the audio band.
+constexpr float kLeadInSeconds = 0.25f;
+constexpr float kSweepSeconds = 2.0f;
+constexpr float kSweepStartFrequency = 20.0f;
+constexpr float kSweepEndFrequency = 20000.0f;
+constexpr float kMaxFrequencyRatio = 0.45f;    // of the sample rate
+constexpr float kFadeSeconds = 0.005f;
+
+// Nothing is played after the sweep until its response has arrived, so the tail must be longer
+// than the round trip latency plus the length of the impulse response
+constexpr float kSweepTailSeconds = 0.5f;
+constexpr float kMaxLatencySeconds = 0.3f;  // a longer round trip fails the measurement
+
+// Each tone is analyzed once it has settled, the tones are held for long enough to be captured
+// after the worst case latency
+constexpr float kToneFrequencies[] = {100.0f, 300.0f, 1000.0f, 3000.0f, 10000.0f};
+constexpr float kToneSettleSeconds = 0.1f;
+constexpr float kToneAnalysisSeconds = 0.2f;
+constexpr int32_t kToneLobeBins = 2;
+constexpr int32_t kMaxToneHarmonic = 10;
+constexpr float kBandLowFrequency = 20.0f;
+constexpr float kBandHighFrequency = 20000.0f;
+
+// Deconvolution. The regularization stops bins where the sweep has almost no energy from
+// amplifying noise, relative to the sweep's peak power it is far below anything in band.
+constexpr float kRegularization = 1e-6f;
+constexpr float kMinImpulsePeak = 1e-4f;       // -80dB, anything quieter is not connected
+constexpr float kImpulsePrerollSeconds = 0.002f;
+constexpr float kWindowFraction = 0.75f;       // of the gap to the next harmonic response
+constexpr int32_t kPointsPerOctave = 6;
+
+static int32_t floorPowerOfTwo(float value) {
+  int32_t power = 1;
+  while (power * 2 <= value) power *= 2;
+  return power;
+}
+
+static int32_t ceilPowerOfTwo(int32_t value) {
+  int32_t power = 1;
+  while (power < value) power *= 2;
+  return power;
+}
+
+static float powerToDb(double power) {
+  return static_cast<float>(10.0 * log10(power + 1e-20));
+}
+
+// Half a Hann window at either end
+static float fadeGain(int32_t frame, int32_t numFrames, int32_t fadeFrames) {
+  int32_t distance = std::min(frame, numFrames - 1 - frame);
+  if (distance >= fadeFrames) return 1.0f;
+  return 0.5f - 0.5f * cosf(static_cast<float>(M_PI) * distance / fadeFrames);
+}
+
+/**
+ * Power spectrum of part of an impulse response. The window rises over the preroll and falls
+ * over its last quarter, so the response isn't cut off abruptly at either end.
+ *
+ * @param start may be negative, the impulse response is circular
+ * @param power receives length / 2 + 1 bins
+ */
+static void impulsePowerSpectrum(const std::vector<float> &impulse, int32_t start, int32_t length,
+                                 int32_t preroll, std::vector<float> *power) {
+
+  int32_t size = static_cast<int32_t>(impulse.size());
+  int32_t fadeOut = length / 4;
+  std::vector<float> real(length);
+  std::vector<float> imaginary(length, 0.0f);
+  for (int32_t n = 0; n < length; n++) {
+    float gain = 1.0f;
+    if (n < preroll) {
+      gain = 0.5f - 0.5f * cosf(static_cast<float>(M_PI) * n / preroll);
+    } else if (n >= length - fadeOut) {
+      gain = 0.5f + 0.5f * cosf(static_cast<float>(M_PI) * (n - (length - fadeOut)) / fadeOut);
+    }
+    real[n] = impulse[((start + n) % size + size) % size] * gain;
+  }
+
+  Fft fft;
+  fft.setup(length);
+  fft.forward(real.data(), imaginary.data());
+  power->resize(length / 2 + 1);
+  for (int32_t k = 0; k <= length / 2; k++) {
+    (*power)[k] = real[k] * real[k] + imaginary[k] * imaginary[k];
+  }
+}
+
+// Average power in a 1/6 octave band around a frequency, always including the nearest bin
+static double bandPower(const std::vector<float> &power, int32_t fftSize, int32_t sampleRate,
+                        float frequency) {
+
+  float binWidth = static_cast<float>(sampleRate) / fftSize;
+  int32_t last = static_cast<int32_t>(power.size()) - 1;
+  int32_t nearest = std::min(static_cast<int32_t>(lroundf(frequency / binWidth)), last);
+  int32_t low = std::min(nearest, static_cast<int32_t>(ceilf(frequency / 1.0595f / binWidth)));
+  int32_t high = std::max(nearest,
+                          std::min(static_cast<int32_t>(frequency * 1.0595f / binWidth), last));
+  double sum = 0;
+  for (int32_t k = low; k <= high; k++) sum += power[k];
+  return sum / (high - low + 1);
+}
+
+void AudioMeasurement::setup(int32_t sampleRate, float levelDb) {
+
+  sampleRate_ = sampleRate;
+  amplitude_ = powf(10.0f, levelDb / 20.0f);
+  float maxFrequency = kMaxFrequencyRatio * sampleRate;
+
+  sweepStart_ = static_cast<int32_t>(kLeadInSeconds * sampleRate);
+  sweepFrames_ = static_cast<int32_t>(kSweepSeconds * sampleRate);
+  sweepTailFrames_ = static_cast<int32_t>(kSweepTailSeconds * sampleRate);
+  sweepEndFrequency_ = std::min(kSweepEndFrequency, maxFrequency);
+  sweepRate_ = kSweepSeconds / logf(sweepEndFrequency_ / kSweepStartFrequency);
+
+  // The tones are moved onto the nearest analysis bin so that they don't leak into their
+  // neighbours
+  toneSettleFrames_ = static_cast<int32_t>(kToneSettleSeconds * sampleRate);
+  toneFftSize_ = floorPowerOfTwo(kToneAnalysisSeconds * sampleRate);
+  int32_t toneFrames = toneSettleFrames_ + toneFftSize_ +
+                       static_cast<int32_t>(kMaxLatencySeconds * sampleRate);
+  float binWidth = static_cast<float>(sampleRate) / toneFftSize_;
+  int32_t position = sweepStart_ + sweepFrames_ + sweepTailFrames_;
+  toneStarts_.clear();
+  toneFrequencies_.clear();
+  for (float frequency : kToneFrequencies) {
+    if (frequency > maxFrequency) continue;
+    toneStarts_.push_back(position);
+    toneFrequencies_.push_back(roundf(frequency / binWidth) * binWidth);
+    position += toneFrames;
+  }
+
+  stimulus_.assign(position, 0.0f);
+  capture_.assign(position, 0.0f);
+  generateSweep();
+  for (size_t i = 0; i < toneStarts_.size(); i++) {
+    generateTone(toneStarts_[i], toneFrames, toneFrequencies_[i]);
+  }
+
+  position_ = 0;
+  missingInputFrames_ = 0;
+  hasInput_ = false;
+  isComplete_.store(false);
+}
+
+void AudioMeasurement::generateSweep() {
+
+  int32_t fadeFrames = static_cast<int32_t>(kFadeSeconds * sampleRate_);
+  for (int32_t n = 0; n < sweepFrames_; n++) {
+    double time = static_cast<double>(n) / sampleRate_;
+    double phase = 2.0 * M_PI * kSweepStartFrequency * sweepRate_ * (exp(time / sweepRate_) - 1.0);
+    stimulus_[sweepStart_ + n] = amplitude_ * fadeGain(n, sweepFrames_, fadeFrames) *
+                                 static_cast<float>(sin(phase));
+  }
+}
+
+void AudioMeasurement::generateTone(int32_t start, int32_t numFrames, float frequency) {
+
+  int32_t fadeFrames = static_cast<int32_t>(kFadeSeconds * sampleRate_);
+  double phaseIncrement = 2.0 * M_PI * frequency / sampleRate_;
+  for (int32_t n = 0; n < numFrames; n++) {
+    stimulus_[start + n] = amplitude_ * fadeGain(n, numFrames, fadeFrames) *
+                           static_cast<float>(sin(phaseIncrement * n));
+  }
+}
+
+void AudioMeasurement::process(const float *input, int32_t numInputFrames, float *output,
+                               int32_t numFrames) {
+
+  int32_t length = static_cast<int32_t>(stimulus_.size());
+  for (int32_t i = 0; i < numFrames; i++) {
+    if (position_ == length) {
+      output[i] = 0;
+      continue;
+    }
+    if (i < numInputFrames) {
+      capture_[position_] = input[i];
+      hasInput_ = true;
+    } else {
+      // The recording stream is usually empty at first, only gaps after that shift the timing
+      capture_[position_] = 0;
+      if (hasInput_) missingInputFrames_++;
+    }
+    output[i] = stimulus_[position_];
+    position_++;
+  }
+
+  if (position_ == length) isComplete_.store(true, std::memory_order_release);
+}
+
+bool AudioMeasurement::isComplete() const {
+  return isComplete_.load(std::memory_order_acquire);
+}
+
+bool AudioMeasurement::analyze(MeasurementResults *results) const {
+
+  if (!isComplete()) return false;
+
+  results->sampleRate = sampleRate_;
+  results->missingInputFrames = missingInputFrames_;
+  if (!analyzeSweep(results)) return false;
+
+  results->tones.resize(toneStarts_.size());
+  for (size_t i = 0; i < toneStarts_.size(); i++) {
+    analyzeTone(toneStarts_[i] + results->latencyFrames + toneSettleFrames_, toneFrequencies_[i],
+                &results->tones[i]);
+  }
+  return true;
+}
+
+bool AudioMeasurement::analyzeSweep(MeasurementResults *results) const {
+
+  // Deconvolve by dividing by the sweep's spectrum. The transform is long enough to hold the
+  // whole sweep and its tail, so the responses of the harmonics, which come out ahead of the
+  // direct path, wrap around to the end rather than overlapping it.
+  int32_t size = ceilPowerOfTwo(sweepFrames_ + sweepTailFrames_);
+  std::vector<float> sweepReal(size, 0.0f);
+  std::vector<float> sweepImaginary(size, 0.0f);
+  std::vector<float> real(size, 0.0f);
+  std::vector<float> imaginary(size, 0.0f);
+  std::copy(stimulus_.begin() + sweepStart_, stimulus_.begin() + sweepStart_ + sweepFrames_,
+            sweepReal.begin());
+  std::copy(capture_.begin() + sweepStart_,
+            capture_.begin() + sweepStart_ + sweepFrames_ + sweepTailFrames_, real.begin());
+
+  Fft fft;
+  fft.setup(size);
+  fft.forward(sweepReal.data(), sweepImaginary.data());
+  fft.forward(real.data(), imaginary.data());
+
+  float maxPower = 0;
+  for (int32_t k = 0; k < size; k++) {
+    maxPower = std::max(maxPower, sweepReal[k] * sweepReal[k] +
+                                  sweepImaginary[k] * sweepImaginary[k]);
+  }
+  float regularization = maxPower * kRegularization;
+  for (int32_t k = 0; k < size; k++) {
+    float denominator = sweepReal[k] * sweepReal[k] + sweepImaginary[k] * sweepImaginary[k] +
+                        regularization;
+    float responseReal = (real[k] * sweepReal[k] + imaginary[k] * sweepImaginary[k]) / denominator;
+    float responseImaginary =
+        (imaginary[k] * sweepReal[k] - real[k] * sweepImaginary[k]) / denominator;
+    real[k] = responseReal;
+    imaginary[k] = responseImaginary;
+  }
+  fft.inverse(real.data(), imaginary.data());
+  std::vector<float> &impulse = real;
+
+  // The direct path is the largest peak after the stimulus was played. It is searched for
+  // across the whole tail, so that a path later than the tones leave room for is reported as a
+  // failure rather than mistaken for an earlier peak.
+  int32_t peak = 0;
+  for (int32_t n = 1; n < sweepTailFrames_; n++) {
+    if (fabsf(impulse[n]) > fabsf(impulse[peak])) peak = n;
+  }
+  if (fabsf(impulse[peak]) < kMinImpulsePeak ||
+      peak > static_cast<int32_t>(kMaxLatencySeconds * sampleRate_)) {
+    return false;
+  }
+  results->latencyFrames = peak;
+
+  int32_t preroll = static_cast<int32_t>(kImpulsePrerollSeconds * sampleRate_);
+  int32_t impulseFrames = floorPowerOfTwo(kWindowFraction * sweepRate_ * logf(2.0f) * sampleRate_);
+  results->impulseResponse.resize(impulseFrames);
+  for (int32_t n = 0; n < impulseFrames; n++) {
+    results->impulseResponse[n] = impulse[((peak - preroll + n) % size + size) % size];
+  }
+
+  // Harmonic k arrives sweepRate * ln(k) seconds ahead of the direct path. The harmonics are
+  // compared with the same length of the direct path so that both are smoothed alike.
+  int32_t harmonicFrames = floorPowerOfTwo(
+      kWindowFraction * sweepRate_ * logf(kMaxSweepHarmonic / (kMaxSweepHarmonic - 1.0f)) *
+      sampleRate_);
+  std::vector<float> linearPower;
+  std::vector<float> shortLinearPower;
+  std::vector<float> harmonicPower[kMaxSweepHarmonic - 1];
+  impulsePowerSpectrum(impulse, peak - preroll, impulseFrames, preroll, &linearPower);
+  impulsePowerSpectrum(impulse, peak - preroll, harmonicFrames, preroll, &shortLinearPower);
+  for (int32_t h = 2; h <= kMaxSweepHarmonic; h++) {
+    int32_t offset = static_cast<int32_t>(lroundf(sweepRate_ * logf(h) * sampleRate_));
+    impulsePowerSpectrum(impulse, peak - offset - preroll, harmonicFrames, preroll,
+                         &harmonicPower[h - 2]);
+  }
+
+  results->frequencyResponse.clear();
+  for (int32_t i = 0; ; i++) {
+    float frequency = kSweepStartFrequency * powf(2.0f, static_cast<float>(i) / kPointsPerOctave);
+    if (frequency > sweepEndFrequency_) break;
+
+    FrequencyResponsePoint point;
+    point.frequency = frequency;
+    point.magnitudeDb = powerToDb(bandPower(linearPower, impulseFrames, sampleRate_, frequency));
+    double fundamental = bandPower(shortLinearPower, harmonicFrames, sampleRate_, frequency);
+    for (int32_t h = 2; h <= kMaxSweepHarmonic; h++) {
+      point.harmonicDb[h - 2] = (frequency * h > sweepEndFrequency_) ? NAN :
+          powerToDb(bandPower(harmonicPower[h - 2], harmonicFrames, sampleRate_, frequency * h) /
+                    fundamental);
+    }
+    results->frequencyResponse.push_back(point);
+  }
+  return true;
+}
+
+void AudioMeasurement::analyzeTone(int32_t start, float frequency, ToneResult *result) const {
+
+  int32_t size = toneFftSize_;
+  std::vector<float> real(size);
+  std::vector<float> imaginary(size, 0.0f);
+  for (int32_t n = 0; n < size; n++) {
+    float window = 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * n / size);
+    real[n] = capture_[start + n] * window;
+  }
+  Fft fft;
+  fft.setup(size);
+  fft.forward(real.data(), imaginary.data());
+
+  float binWidth = static_cast<float>(sampleRate_) / size;
+  auto power = [&](int32_t k) {
+    return static_cast<double>(real[k]) * real[k] +
+           static_cast<double>(imaginary[k]) * imaginary[k];
+  };
+  auto lobePower = [&](int32_t center) {
+    double sum = 0;
+    for (int32_t k = center - kToneLobeBins; k <= center + kToneLobeBins; k++) sum += power(k);
+    return sum;
+  };
+
+  float bandHigh = std::min(kBandHighFrequency, kMaxFrequencyRatio * sampleRate_);
+  int32_t fundamentalBin = static_cast<int32_t>(lroundf(frequency / binWidth));
+  int32_t firstBin = static_cast<int32_t>(ceilf(kBandLowFrequency / binWidth));
+  int32_t lastBin = static_cast<int32_t>(bandHigh / binWidth);
+
+  double fundamental = lobePower(fundamentalBin);
+  double harmonics = 0;
+  int32_t harmonicCount = 0;
+  for (int32_t h = 2; h <= kMaxToneHarmonic; h++) {
+    int32_t bin = fundamentalBin * h;
+    if (bin + kToneLobeBins > lastBin) break;
+    harmonics += lobePower(bin);
+    harmonicCount++;
+  }
+  double band = 0;
+  for (int32_t k = firstBin; k <= lastBin; k++) band += power(k);
+
+  // A Hann windowed sine of amplitude A puts 3 * size^2 * A^2 / 32 into its lobe
+  result->frequency = frequency;
+  result->levelDb = powerToDb(fundamental * 32.0 / (3.0 * size * size));
+  result->thdDb = (harmonicCount > 0) ? powerToDb(harmonics / fundamental) : NAN;
+  result->thdNoiseDb = powerToDb(std::max(band - fundamental, 0.0) / fundamental);
+}
+
+static void appendNumber(std::string *json, float value) {
+  char number[32];
+  if (isfinite(value)) {
+    snprintf(number, sizeof(number), "%.6g", value);
+    json->append(number);
+  } else {
+    json->append("null");
+  }
+}
+
+std::string MeasurementResults::toJson() const {
+
+  std::string json = "{\"sampleRate\":";
+  appendNumber(&json, sampleRate);
+  json.append(",\"latencyFrames\":");
+  appendNumber(&json, latencyFrames);
+  json.append(",\"latencyMs\":");
+  appendNumber(&json, (sampleRate > 0) ? 1000.0f * latencyFrames / sampleRate : 0.0f);
+  json.append(",\"missingInputFrames\":");
+  appendNumber(&json, missingInputFrames);
+
+  json.append(",\"frequencyResponse\":[");
+  for (size_t i = 0; i < frequencyResponse.size(); i++) {
+    const FrequencyResponsePoint &point = frequencyResponse[i];
+    json.append((i > 0) ? ",{\"frequency\":" : "{\"frequency\":");
+    appendNumber(&json, point.frequency);
+    json.append(",\"magnitudeDb\":");
+    appendNumber(&json, point.magnitudeDb);
+    json.append(",\"harmonicDb\":[");
+    for (int32_t h = 0; h < kMaxSweepHarmonic - 1; h++) {
+      if (h > 0) json.append(",");
+      appendNumber(&json, point.harmonicDb[h]);
+    }
+    json.append("]}");
+  }
+
+  json.append("],\"tones\":[");
+  for (size_t i = 0; i < tones.size(); i++) {
+    json.append((i > 0) ? ",{\"frequency\":" : "{\"frequency\":");
+    appendNumber(&json, tones[i].frequency);
+    json.append(",\"levelDb\":");
+    appendNumber(&json, tones[i].levelDb);
+    json.append(",\"thdDb\":");
+    appendNumber(&json, tones[i].thdDb);
+    json.append(",\"thdNoiseDb\":");
+    appendNumber(&json, tones[i].thdNoiseDb);
+    json.append("}");
+  }
+
+  json.append("],\"impulseResponse\":[");
+  for (size_t i = 0; i < impulseResponse.size(); i++) {
+    if (i > 0) json.append(",");
+    appendNumber(&json, impulseResponse[i]);
+  }
+  json.append("]}");
+  return json;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_AUDIO_MEASUREMENT_H
+#define AAUDIO_AUDIO_MEASUREMENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Harmonics 2 to kMaxSweepHarmonic are separated out of the sweep response
+constexpr int kMaxSweepHarmonic = 4;
+
+struct FrequencyResponsePoint {
+  float frequency;
+  float magnitudeDb;
+
+  // Level of harmonics 2, 3, ... relative to the fundamental when driven at this frequency, or
+  // NAN where the harmonic is above the end of the sweep
+  float harmonicDb[kMaxSweepHarmonic - 1];
+};
+
+struct ToneResult {
+  float frequency;
+  float levelDb;      // of the captured fundamental, relative to a full scale sine
+  float thdDb;        // harmonics relative to the fundamental, NAN if they're all above 20kHz
+  float thdNoiseDb;   // everything but the fundamental from 20Hz to 20kHz, relative to it
+};
+
+/**
+ * The results of a measurement. Levels are in dB. The impulse response starts a little before
+ * the direct path, which arrives latencyFrames after the stimulus was written. If any input went
+ * missing once recording had started the timing shifted part way through and the results are
+ * unreliable.
+ */
+struct MeasurementResults {
+  int32_t sampleRate = 0;
+  int32_t latencyFrames = 0;
+  int32_t missingInputFrames = 0;
+  std::vector<float> impulseResponse;
+  std::vector<FrequencyResponsePoint> frequencyResponse;
+  std::vector<ToneResult> tones;
+
+  std::string toJson() const;
+};
+
+/**
+ * Measures the path from the playback stream back to the recording stream, e.g. speaker to mic
+ * or a loopback cable.
+ *
+ * An exponential sine sweep is played, followed by a series of stepped sine tones. The captured
+ * sweep is deconvolved by dividing its spectrum by the sweep's spectrum. This gives the impulse
+ * response of the path, from which come the latency and the frequency response. Harmonic
+ * distortion turns up as separate impulse responses ahead of the linear one, one per harmonic,
+ * so the harmonic levels across the whole band come from the same sweep. The tones are held for
+ * long enough to settle and are analyzed for THD and THD+N.
+ *
+ * The whole stimulus and capture are allocated in setup. The audio thread only copies samples,
+ * all of the analysis is done in analyze, which must not be called from the audio thread.
+ */
+class AudioMeasurement {
+public:
+  /**
+   * Must not be called from the audio thread.
+   *
+   * @param levelDb the peak level of the stimulus relative to full scale
+   */
+  void setup(int32_t sampleRate, float levelDb);
+
+  /**
+   * Play the next part of the stimulus and capture the input. Input frames which didn't arrive
+   * in time are captured as silence so the capture stays aligned with the stimulus.
+   *
+   * @param input the recorded audio, may be the same buffer as output
+   * @param numInputFrames the number of frames recorded, may be fewer than numFrames
+   * @param output receives numFrames of the stimulus, or silence once the measurement is complete
+   */
+  void process(const float *input, int32_t numInputFrames, float *output, int32_t numFrames);
+
+  bool isComplete() const;
+
+  /**
+   * @return false if the measurement isn't complete, or the direct path couldn't be found in
+   * the captured sweep or arrived later than the tones allow for
+   */
+  bool analyze(MeasurementResults *results) const;
+
+private:
+  void generateSweep();
+  void generateTone(int32_t start, int32_t numFrames, float frequency);
+  bool analyzeSweep(MeasurementResults *results) const;
+  void analyzeTone(int32_t start, float frequency, ToneResult *result) const;
+
+  int32_t sampleRate_ = 0;
+  float amplitude_ = 0;
+
+  // Timeline, in frames from the start of the stimulus
+  int32_t sweepStart_ = 0;
+  int32_t sweepFrames_ = 0;
+  int32_t sweepTailFrames_ = 0;
+  float sweepEndFrequency_ = 0;
+  float sweepRate_ = 0;             // the sweep's L, the time in seconds to rise by a factor of e
+  std::vector<int32_t> toneStarts_;
+  std::vector<float> toneFrequencies_;
+  int32_t toneSettleFrames_ = 0;
+  int32_t toneFftSize_ = 0;
+
+  std::vector<float> stimulus_;
+  std::vector<float> capture_;
+  int32_t position_ = 0;
+  int32_t missingInputFrames_ = 0;
+  bool hasInput_ = false;
+  std::atomic<bool> isComplete_ {false};
+};
+
+#endif //AAUDIO_AUDIO_MEASUREMENT_H
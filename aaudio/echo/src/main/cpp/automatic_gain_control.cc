@@ -0,0 +1,178 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <cstring>
+#include "automatic_gain_control.h"
+
+// Levels are in dB relative to full scale
+constexpr float kTargetLevelDb = -18.0f;
+constexpr float kCeilingDb = -1.0f;
+constexpr float kNoiseFloorDb = -55.0f;
+constexpr float kMinGainDb = -10.0f;
+constexpr float kMaxGainDb = 30.0f;
+
+// Slow loop time constants
+constexpr float kLevelAttackSeconds = 0.1f;
+constexpr float kLevelReleaseSeconds = 1.0f;
+constexpr float kSlowGainSeconds = 2.0f;
+
+// Fast loop. The look-ahead is kept short since it adds directly to the echo latency.
+constexpr float kLookAheadSeconds = 0.002f;
+constexpr float kGainReleaseSeconds = 0.5f;
+
+static float decibelsToAmplitude(float decibels) {
+  return powf(10.0f, decibels / 20.0f);
+}
+
+static float timeConstantToCoefficient(float seconds, int32_t sampleRate) {
+  return expf(-1.0f / (seconds * sampleRate));
+}
+
+void AutomaticGainControl::setup(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) {
+
+  sampleRate_ = sampleRate;
+  maxFrames_ = maxFrames;
+  lookAheadFrames_ = static_cast<int32_t>(kLookAheadSeconds * sampleRate);
+
+  targetAmplitude_ = decibelsToAmplitude(kTargetLevelDb);
+  ceiling_ = decibelsToAmplitude(kCeilingDb);
+  noiseFloorPower_ = decibelsToAmplitude(kNoiseFloorDb * 2);
+  minGain_ = decibelsToAmplitude(kMinGainDb);
+  maxGain_ = decibelsToAmplitude(kMaxGainDb);
+
+  levelAttackCoefficient_ = timeConstantToCoefficient(kLevelAttackSeconds, sampleRate);
+  levelReleaseCoefficient_ = timeConstantToCoefficient(kLevelReleaseSeconds, sampleRate);
+
+  // Pull the gain down within a quarter of the look-ahead so it has (almost) settled by the
+  // time the peak which caused it reaches the output
+  gainAttackCoefficient_ = timeConstantToCoefficient(kLookAheadSeconds / 4, sampleRate);
+  gainReleaseCoefficient_ = timeConstantToCoefficient(kGainReleaseSeconds, sampleRate);
+
+  int32_t delayLineLength = lookAheadFrames_ + maxFrames;
+  delayLines_.assign(channelCount, std::vector<float>(delayLineLength, 0));
+  framePeaks_.assign(delayLineLength, 0);
+  peakQueue_.assign(delayLineLength, 0);
+  frameGains_.assign(maxFrames, 1.0f);
+  reset();
+}
+
+void AutomaticGainControl::reset() {
+
+  for (std::vector<float> &delayLine : delayLines_) {
+    std::fill(delayLine.begin(), delayLine.end(), 0.0f);
+  }
+  std::fill(framePeaks_.begin(), framePeaks_.end(), 0.0f);
+  level_ = 0;
+  slowGain_ = 1.0f;
+  gain_ = 1.0f;
+  gainDb_.store(0, std::memory_order_relaxed);
+}
+
+void AutomaticGainControl::process(float * const *channels, int32_t channelCount,
+                                   int32_t numFrames) {
+
+  if (numFrames <= 0 || numFrames > maxFrames_ ||
+      channelCount != static_cast<int32_t>(delayLines_.size())) {
+    return;
+  }
+
+  // Append the new block to the delay lines and work out the peak of each new frame
+  float *peaks = framePeaks_.data() + lookAheadFrames_;
+  memset(peaks, 0, numFrames * sizeof(float));
+  for (int32_t c = 0; c < channelCount; c++) {
+    const float *input = channels[c];
+    memcpy(delayLines_[c].data() + lookAheadFrames_, input, numFrames * sizeof(float));
+    for (int32_t i = 0; i < numFrames; i++) {
+      peaks[i] = fmaxf(peaks[i], fabsf(input[i]));
+    }
+  }
+
+  updateSlowGain(numFrames);
+  computeFastGains(numFrames);
+
+  // Apply the gains to the delayed audio, then keep the end of the delay lines as the history
+  // for the next block
+  const float *gains = frameGains_.data();
+  for (int32_t c = 0; c < channelCount; c++) {
+    float *output = channels[c];
+    float *delayLine = delayLines_[c].data();
+    for (int32_t i = 0; i < numFrames; i++) {
+      output[i] = delayLine[i] * gains[i];
+    }
+    memmove(delayLine, delayLine + numFrames, lookAheadFrames_ * sizeof(float));
+  }
+  memmove(framePeaks_.data(), framePeaks_.data() + numFrames, lookAheadFrames_ * sizeof(float));
+
+  gainDb_.store(20.0f * log10f(gain_), std::memory_order_relaxed);
+}
+
+/**
+ * The slow loop. The level follower runs per frame but the gain it implies is only recalculated
+ * once per block, since it moves over seconds rather than milliseconds.
+ */
+void AutomaticGainControl::updateSlowGain(int32_t numFrames) {
+
+  const float *peaks = framePeaks_.data() + lookAheadFrames_;
+  float level = level_;
+  for (int32_t i = 0; i < numFrames; i++) {
+    float power = peaks[i] * peaks[i];
+    float coefficient = (power > level) ? levelAttackCoefficient_ : levelReleaseCoefficient_;
+    level = power + coefficient * (level - power);
+  }
+  level_ = level;
+
+  // Don't adapt to background noise, otherwise the gain creeps up to the maximum during pauses
+  // and the first word after a pause is far too loud
+  if (level_ < noiseFloorPower_) return;
+
+  float targetGain = fminf(maxGain_, fmaxf(minGain_, targetAmplitude_ / sqrtf(level_)));
+
+  float coefficient = expf(-static_cast<float>(numFrames) / (kSlowGainSeconds * sampleRate_));
+  slowGain_ = targetGain + coefficient * (slowGain_ - targetGain);
+}
+
+/**
+ * The fast loop. For each output frame find the largest peak in the look-ahead window and, if
+ * the slow gain would push it over the ceiling, reduce the gain so that it doesn't.
+ */
+void AutomaticGainControl::computeFastGains(int32_t numFrames) {
+
+  const float *peaks = framePeaks_.data();
+  int32_t *queue = peakQueue_.data();
+  int32_t head = 0;
+  int32_t tail = 0;
+  float gain = gain_;
+
+  // Output frame i sees the window [i, i + lookAheadFrames_] of the delay line
+  for (int32_t j = 0; j < lookAheadFrames_ + numFrames; j++) {
+
+    while (tail > head && peaks[queue[tail - 1]] <= peaks[j]) tail--;
+    queue[tail++] = j;
+
+    int32_t i = j - lookAheadFrames_;
+    if (i < 0) continue;
+    if (queue[head] < i) head++;
+
+    float peak = peaks[queue[head]];
+    float targetGain = (peak * slowGain_ > ceiling_) ? ceiling_ / peak : slowGain_;
+    float coefficient = (targetGain < gain) ? gainAttackCoefficient_ : gainReleaseCoefficient_;
+    gain = targetGain + coefficient * (gain - targetGain);
+    frameGains_[i] = gain;
+  }
+  gain_ = gain;
+}
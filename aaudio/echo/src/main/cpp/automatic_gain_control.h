@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_AUTOMATIC_GAIN_CONTROL_H
+#define AAUDIO_AUTOMATIC_GAIN_CONTROL_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Automatic gain control for the input stage of the echo path. Built-in mics differ in
+ * sensitivity by tens of dB between devices, this brings the input to a consistent level before
+ * it reaches the effects.
+ *
+ * The gain computer has two parts:
+ *  - A slow loop which tracks the average speech level over a few seconds and moves the gain
+ *    towards the value which would bring that level to the target.
+ *  - A fast loop which uses a short look-ahead window to find upcoming peaks and pulls the gain
+ *    down before they arrive so that they are never pushed above the ceiling.
+ *
+ * The audio is delayed by the look-ahead time. The per frame gains are computed into a buffer
+ * first and then applied to each channel in a separate loop which the compiler can vectorize.
+ */
+class AutomaticGainControl {
+public:
+  /**
+   * Allocate the internal buffers, must not be called from the audio thread.
+   *
+   * @param sampleRate the sample rate of the audio to be processed
+   * @param channelCount the number of planar channels passed to process
+   * @param maxFrames the maximum number of frames which will be passed to process
+   */
+  void setup(int32_t sampleRate, int32_t channelCount, int32_t maxFrames);
+  void reset();
+
+  void process(float * const *channels, int32_t channelCount, int32_t numFrames);
+
+  /**
+   * @return the most recently applied gain in dB. Safe to call from any thread.
+   */
+  float getGainDb() const { return gainDb_.load(std::memory_order_relaxed); }
+
+private:
+  void updateSlowGain(int32_t numFrames);
+  void computeFastGains(int32_t numFrames);
+
+  int32_t sampleRate_ = 0;
+  int32_t lookAheadFrames_ = 0;
+  int32_t maxFrames_ = 0;
+
+  float targetAmplitude_ = 0;
+  float ceiling_ = 0;
+  float noiseFloorPower_ = 0;
+  float minGain_ = 0;
+  float maxGain_ = 0;
+
+  // Slow loop: average level and the gain which brings it to the target
+  float level_ = 0;
+  float slowGain_ = 1.0f;
+  float levelAttackCoefficient_ = 0;
+  float levelReleaseCoefficient_ = 0;
+
+  // Fast loop: the applied gain, which follows the slow gain unless a peak is coming
+  float gain_ = 1.0f;
+  float gainAttackCoefficient_ = 0;
+  float gainReleaseCoefficient_ = 0;
+
+  // Each channel's delay line holds the look-ahead history followed by the current block
+  std::vector<std::vector<float>> delayLines_;
+
+  // Peak magnitude of each frame in the delay lines, and a monotonic queue of indices into it
+  // which is used to find the maximum over the look-ahead window in constant time per frame
+  std::vector<float> framePeaks_;
+  std::vector<int32_t> peakQueue_;
+
+  std::vector<float> frameGains_;
+  std::atomic<float> gainDb_ {0};
+};
+
+#endif //AAUDIO_AUTOMATIC_GAIN_CONTROL_H
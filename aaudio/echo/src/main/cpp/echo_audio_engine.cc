@@ -15,11 +15,23 @@
  */
 
 #include <logging_macros.h>
+#include <algorithm>
+#include <chrono>
 #include <climits>
+#include <cstring>
+#include <functional>
 #include <assert.h>
 #include <audio_common.h>
 #include "echo_audio_engine.h"
 
+// The measurement stimulus is kept well below full scale so the speaker isn't driven into its
+// own distortion
+constexpr float kMeasurementLevelDb = -12.0f;
+
+// The session log ring holds a couple of seconds of input, plus the per callback records at
+// bursts as small as 32 frames
+constexpr float kSessionLogBufferSeconds = 2.0f;
+constexpr int32_t kSessionLogBytesPerFrame = 2;
 
 /**
  * Every time the playback stream requires data this method will be called.
@@ -63,23 +75,60 @@ void errorCallback(AAudioStream *stream,
   audioEngine->errorCallback(stream, error);
 }
 
+EchoAudioEngine::EchoAudioEngine() {
+
+  // Start the thread which logs for the audio callbacks, they can't block on the log themselves
+  AudioLog::initialize();
+}
+
 EchoAudioEngine::~EchoAudioEngine() {
   stopStream(playStream_);
   stopStream(recordingStream_);
   closeStream(playStream_);
   closeStream(recordingStream_);
+
+  // Log whatever the callbacks queued before the streams closed
+  AudioLog::flush();
 }
 
 void EchoAudioEngine::setRecordingDeviceId(int32_t deviceId) {
 
+  if (deviceId != recordingDeviceId_) resetStreamConfiguration();
   recordingDeviceId_ = deviceId;
 }
 
 void EchoAudioEngine::setPlaybackDeviceId(int32_t deviceId) {
 
+  if (deviceId != playbackDeviceId_) resetStreamConfiguration();
   playbackDeviceId_ = deviceId;
 }
 
+// A probe only holds for the devices it was run on
+void EchoAudioEngine::resetStreamConfiguration() {
+
+  streamConfiguration_ = StreamProber::getConfigurations()[0];
+  playbackBufferBursts_ = 1;
+  streamProbeResults_ = StreamProbeResults();
+}
+
+/**
+ * Set the number of channels to request from the recording device. Takes effect the next time
+ * the streams are opened. Anything other than mono is mixed down onto the playback channels,
+ * e.g. a stereo mic is played as left/right and the channels of a 4 mic array are averaged in
+ * pairs.
+ *
+ * @param channelCount the number of input channels, from 1 to kMaxInputChannelCount
+ */
+void EchoAudioEngine::setInputChannelCount(int32_t channelCount) {
+
+  if (channelCount < kMonoChannelCount || channelCount > kMaxInputChannelCount) {
+    LOGW("Unsupported input channel count %d, must be between %d and %d",
+         channelCount, kMonoChannelCount, kMaxInputChannelCount);
+    return;
+  }
+  requestedInputChannelCount_ = channelCount;
+}
+
 void EchoAudioEngine::setEchoOn(bool isEchoOn) {
 
   if (isEchoOn != isEchoOn_) {
@@ -93,6 +142,130 @@ void EchoAudioEngine::setEchoOn(bool isEchoOn) {
   }
 }
 
+/**
+ * Replace the echo with a measurement of the path from the playback device back to the
+ * recording device. The measurement starts when echo is turned on and plays a sweep and a series
+ * of tones, for about 7 seconds, through the playback stream. Can only be changed while echo is
+ * off.
+ */
+void EchoAudioEngine::setMeasurementOn(bool isMeasurementOn) {
+
+  if (isEchoOn_) {
+    LOGW("Measurement can't be turned on or off while echo is on");
+    return;
+  }
+  isMeasurementOn_ = isMeasurementOn;
+}
+
+bool EchoAudioEngine::isMeasurementComplete() {
+  return isMeasurementOn_ && measurement_.isComplete();
+}
+
+/**
+ * Analyze a completed measurement. This takes a while so must not be called from the UI thread.
+ *
+ * @return false if the measurement hasn't completed or nothing was captured
+ */
+bool EchoAudioEngine::getMeasurementResults(MeasurementResults *results) {
+
+  if (!isMeasurementComplete()) return false;
+  return measurement_.analyze(results);
+}
+
+/**
+ * Look for glitches in the played and recorded audio while echo is on, see GlitchMonitor. Can
+ * only be changed while echo is off. Each time echo is turned on the previous report is cleared.
+ */
+void EchoAudioEngine::setGlitchMonitorOn(bool isGlitchMonitorOn) {
+
+  if (isEchoOn_) {
+    LOGW("The glitch monitor can't be turned on or off while echo is on");
+    return;
+  }
+  isGlitchMonitorOn_ = isGlitchMonitorOn;
+}
+
+/**
+ * Tell the glitch monitor that a test tone, e.g. from a signal generator, is being played into
+ * the mic so that it can find much smaller glitches than it can in arbitrary audio. Takes effect
+ * the next time echo is turned on.
+ *
+ * @param frequency the frequency of the tone in Hz, or 0 for no tone
+ */
+void EchoAudioEngine::setGlitchTestTone(float frequency) {
+
+  glitchTestToneFrequency_ = frequency;
+}
+
+std::string EchoAudioEngine::getGlitchReport() {
+  return glitchMonitor_.getReport();
+}
+
+/**
+ * Try each of the StreamProber's configurations on the current devices, and open the streams with
+ * the best from now on. Can only be run while echo is off, and takes a few seconds.
+ */
+bool EchoAudioEngine::probeStreamConfigurations(StreamProbeResults *results) {
+
+  if (isEchoOn_) {
+    LOGW("Stream configurations can't be probed while echo is on");
+    return false;
+  }
+  StreamProber prober;
+  bool isProbed = prober.probe(recordingDeviceId_, playbackDeviceId_, requestedInputChannelCount_,
+                               results);
+  streamProbeResults_ = *results;
+  if (isProbed) {
+    const StreamProbeResult &best = results->configurations[results->selectedIndex];
+    streamConfiguration_ = best.requested;
+    playbackBufferBursts_ = std::max(1, best.bufferSizeFrames / best.framesPerBurst);
+    LOGI("Selected stream configuration %d, %.1f ms latency with a %d burst buffer",
+         results->selectedIndex, best.latencyMs, playbackBufferBursts_);
+  }
+  return isProbed;
+}
+
+/**
+ * What the streams were asked for and what they were granted, for telemetry, with the results of
+ * the last probe. As JSON.
+ */
+std::string EchoAudioEngine::getStreamReport() {
+
+  char number[256];
+  snprintf(number, sizeof(number),
+           "{\"requested\":{\"sharingMode\":\"%s\",\"format\":\"%s\",\"channelCount\":%d,"
+           "\"sampleRate\":%d,\"bufferBursts\":%d}",
+           SharingModeToString(streamConfiguration_.sharingMode),
+           SampleFormatToString(streamConfiguration_.format),
+           streamConfiguration_.outputChannelCount, streamConfiguration_.sampleRate,
+           playbackBufferBursts_);
+  std::string json = number;
+
+  AAudioStream *streams[] = {playStream_, recordingStream_};
+  const char *names[] = {"playback", "recording"};
+  for (int32_t i = 0; i < 2; i++) {
+    AAudioStream *stream = streams[i];
+    if (stream == nullptr) continue;
+    snprintf(number, sizeof(number),
+             ",\"%s\":{\"sharingMode\":\"%s\",\"performanceMode\":\"%s\",\"format\":\"%s\","
+             "\"channelCount\":%d,\"sampleRate\":%d,\"framesPerBurst\":%d,"
+             "\"bufferSizeFrames\":%d,\"xRunCount\":%d}",
+             names[i], SharingModeToString(AAudioStream_getSharingMode(stream)),
+             PerformanceModeToString(AAudioStream_getPerformanceMode(stream)),
+             SampleFormatToString(AAudioStream_getFormat(stream)),
+             AAudioStream_getChannelCount(stream), AAudioStream_getSampleRate(stream),
+             AAudioStream_getFramesPerBurst(stream), AAudioStream_getBufferSizeInFrames(stream),
+             AAudioStream_getXRunCount(stream));
+    json.append(number);
+  }
+  if (!streamProbeResults_.configurations.empty()) {
+    json.append(",\"probe\":");
+    json.append(streamProbeResults_.toJson());
+  }
+  json.append("}");
+  return json;
+}
+
 void EchoAudioEngine::openAllStreams() {
 
   // Note: The order of stream creation is important. We create the playback stream first,
@@ -104,6 +277,16 @@ void EchoAudioEngine::openAllStreams() {
   // Now start the recording stream first so that we can read from it during the playback
   // stream's dataCallback
   if (recordingStream_ != nullptr && playStream_ != nullptr) {
+
+    // The playback stream will never ask for more frames than its buffer can hold
+    maxFramesPerCallback_ = AAudioStream_getBufferCapacityInFrames(playStream_);
+    setupProcessing();
+    if (isGlitchMonitorOn_) {
+      glitchMonitor_.start(sampleRate_, maxFramesPerCallback_, framesPerBurst_,
+                           glitchTestToneFrequency_);
+    }
+    if (!sessionLogPath_.empty()) startSessionRecording();
+
     startStream(recordingStream_);
     startStream(playStream_);
   } else {
@@ -132,8 +315,293 @@ void EchoAudioEngine::closeAllStreams() {
     closeStream(recordingStream_);
     recordingStream_ = nullptr;
   }
+
+  // Nothing is tapped or recorded once the streams are closed, and any control changes which the
+  // callback didn't get to are applied directly
+  glitchMonitor_.stop();
+  sessionRecorder_.stop();
+  applyControlEvents(false);
+}
+
+/**
+ * Set up everything the data callback uses. The gate timings depend on the sample rate and the
+ * buffers depend on the negotiated formats, which are only known once both streams have been
+ * opened, or from the log when a session is replayed.
+ */
+void EchoAudioEngine::setupProcessing() {
+
+  inputGate_.setup(sampleRate_);
+  effectTailFramesRemaining_ = 0;
+  isGateClosing_ = false;
+  allocateBuffers();
+  inputGainControl_.setup(sampleRate_, outputChannelCount_, maxFramesPerCallback_);
+  granularProcessor_.setup(sampleRate_);
+  feedbackSuppressor_.setup(sampleRate_, outputChannelCount_);
+  if (isMeasurementOn_) measurement_.setup(sampleRate_, kMeasurementLevelDb);
+  callbackFramePosition_ = 0;
 }
 
+/**
+ * @return the gain currently applied by the input gain control in dB. This is updated once per
+ * data callback and can be polled from the UI thread.
+ */
+float EchoAudioEngine::getInputGainDb() {
+  return inputGainControl_.getGainDb();
+}
+
+void EchoAudioEngine::setGranularOn(bool isGranularOn) {
+
+  ControlEvent event = {CONTROL_GRANULAR_ON, {isGranularOn ? 1.0f : 0.0f}};
+  sendControlEvent(event);
+}
+
+/**
+ * @see GranularProcessor#setParameters
+ */
+void EchoAudioEngine::setGranularParameters(float density, float grainMs, float positionMs,
+                                            float pitchSemitones, float jitter, float spread,
+                                            float mix) {
+
+  ControlEvent event = {CONTROL_GRANULAR_PARAMETERS,
+                        {density, grainMs, positionMs, pitchSemitones, jitter, spread, mix}};
+  sendControlEvent(event);
+}
+
+void EchoAudioEngine::setGranularWindow(int32_t window) {
+
+  ControlEvent event = {CONTROL_GRANULAR_WINDOW, {static_cast<float>(window)}};
+  sendControlEvent(event);
+}
+
+/**
+ * Play grains from a mono buffer, e.g. a decoded file, instead of the live input. An empty buffer
+ * switches back to the live input. The source is copied, and since the copy is read by the data
+ * callback it can only be replaced while echo is off.
+ */
+void EchoAudioEngine::setGranularSource(const float *source, int32_t numFrames) {
+
+  if (isEchoOn_) {
+    LOGW("The granular source can't be changed while echo is on");
+    return;
+  }
+
+  // A copy is kept for session logs
+  if (source != nullptr && numFrames > 0) {
+    granularSource_.assign(source, source + numFrames);
+  } else {
+    granularSource_.clear();
+  }
+  granularProcessor_.setSource(source, numFrames);
+}
+
+/**
+ * While echo is on control changes are queued for the data callback, which applies them all at
+ * the start of the next callback. Otherwise they're applied straight away.
+ */
+void EchoAudioEngine::sendControlEvent(const ControlEvent &event) {
+
+  if (!isEchoOn_) {
+    applyControlEvent(event);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(controlEventsLock_);
+  int32_t writeIndex = controlWriteIndex_.load(std::memory_order_relaxed);
+  int32_t nextIndex = (writeIndex + 1) % kMaxControlEvents;
+  if (nextIndex == controlReadIndex_.load(std::memory_order_acquire)) {
+    LOGW("Too many control changes at once, dropping one");
+    return;
+  }
+  controlEvents_[writeIndex] = event;
+  controlWriteIndex_.store(nextIndex, std::memory_order_release);
+}
+
+/**
+ * Apply the queued control changes, logging each one if a session is being recorded. Called at
+ * the start of each data callback, and once the streams are closed.
+ */
+void EchoAudioEngine::applyControlEvents(bool isRecordingSession) {
+
+  int32_t readIndex = controlReadIndex_.load(std::memory_order_relaxed);
+  while (readIndex != controlWriteIndex_.load(std::memory_order_acquire)) {
+    const ControlEvent &event = controlEvents_[readIndex];
+    applyControlEvent(event);
+    if (isRecordingSession) sessionRecorder_.recordControl(callbackFramePosition_, event);
+    readIndex = (readIndex + 1) % kMaxControlEvents;
+    controlReadIndex_.store(readIndex, std::memory_order_release);
+  }
+}
+
+void EchoAudioEngine::applyControlEvent(const ControlEvent &event) {
+
+  const float *values = event.values;
+  switch (event.type) {
+    case CONTROL_GRANULAR_ON:
+      granularProcessor_.setEnabled(values[0] != 0.0f);
+      break;
+    case CONTROL_GRANULAR_PARAMETERS:
+      granularProcessor_.setParameters(values[0], values[1], values[2], values[3], values[4],
+                                       values[5], values[6]);
+      break;
+    case CONTROL_GRANULAR_WINDOW:
+      granularProcessor_.setWindow(static_cast<GrainWindow>(static_cast<int32_t>(values[0])));
+      break;
+    default:
+      AUDIO_LOGW("Unknown control event %d", event.type);
+  }
+}
+
+/**
+ * @param events receives one event per ControlEventType which together set the current state
+ */
+void EchoAudioEngine::getControlState(ControlEvent *events) {
+
+  events[CONTROL_GRANULAR_ON] = {CONTROL_GRANULAR_ON,
+                                 {granularProcessor_.isEnabled() ? 1.0f : 0.0f}};
+  events[CONTROL_GRANULAR_PARAMETERS] = {CONTROL_GRANULAR_PARAMETERS, {}};
+  granularProcessor_.getParameters(events[CONTROL_GRANULAR_PARAMETERS].values);
+  events[CONTROL_GRANULAR_WINDOW] = {CONTROL_GRANULAR_WINDOW,
+      {static_cast<float>(static_cast<int32_t>(granularProcessor_.getWindow()))}};
+}
+
+/**
+ * Record every echo session to a log which replaySession can play back, see session_log.h. The
+ * log is overwritten each time echo is turned on. Can only be changed while echo is off.
+ *
+ * @param path where to write the log, or empty to stop recording sessions
+ */
+void EchoAudioEngine::setSessionLogPath(const std::string &path) {
+
+  if (isEchoOn_) {
+    LOGW("The session log can't be changed while echo is on");
+    return;
+  }
+  sessionLogPath_ = path;
+}
+
+/**
+ * Start logging the session which is about to start. The log starts with the negotiated stream
+ * settings, the granular source and the current control state, which with the input is
+ * everything the render work depends on.
+ */
+void EchoAudioEngine::startSessionRecording() {
+
+  SessionHeader header = {};
+  memcpy(header.magic, kSessionLogMagic, sizeof(header.magic));
+  header.sampleRate = sampleRate_;
+  header.framesPerBurst = framesPerBurst_;
+  header.maxFramesPerCallback = maxFramesPerCallback_;
+  header.inputFormat = inputFormat_;
+  header.inputChannelCount = inputChannelCount_;
+  header.outputFormat = outputFormat_;
+  header.outputChannelCount = outputChannelCount_;
+  header.isMeasurementOn = isMeasurementOn_ ? 1 : 0;
+  header.granularSourceFrames = static_cast<int32_t>(granularSource_.size());
+
+  int32_t bytesPerInputFrame = inputChannelCount_ * (SampleFormatToBpp(inputFormat_) / 8);
+  int32_t ringBytes = static_cast<int32_t>(kSessionLogBufferSeconds * sampleRate_ *
+                                           (bytesPerInputFrame + kSessionLogBytesPerFrame));
+  if (!sessionRecorder_.start(sessionLogPath_, header, granularSource_.data(), ringBytes)) return;
+
+  ControlEvent state[CONTROL_EVENT_TYPE_COUNT];
+  getControlState(state);
+  for (const ControlEvent &event : state) sessionRecorder_.recordControl(0, event);
+}
+
+/**
+ * Replay a session log through the same processing as the data callback, with the session's
+ * settings, input and control changes, and check that every callback's output matches what was
+ * recorded. Nothing is played. Takes as long as the render work, or as long as the session did
+ * if isRealTime, so must not be called from the UI thread. Can only be called while echo is off,
+ * and the engine's own settings are put back afterwards.
+ *
+ * @param isRealTime start each callback at the same time after the start as it was recorded,
+ * instead of running them back to back
+ * @return false if the log couldn't be read, held no callbacks, or has a corrupt record
+ */
+bool EchoAudioEngine::replaySession(const std::string &path, bool isRealTime,
+                                    SessionReplayResults *results) {
+
+  if (isEchoOn_) {
+    LOGW("A session can't be replayed while echo is on");
+    return false;
+  }
+  SessionReader reader;
+  if (!reader.open(path)) return false;
+
+  ControlEvent savedState[CONTROL_EVENT_TYPE_COUNT];
+  getControlState(savedState);
+  bool wasMeasurementOn = isMeasurementOn_;
+
+  const SessionHeader &header = reader.getHeader();
+  sampleRate_ = header.sampleRate;
+  framesPerBurst_ = header.framesPerBurst;
+  maxFramesPerCallback_ = header.maxFramesPerCallback;
+  inputFormat_ = header.inputFormat;
+  inputChannelCount_ = header.inputChannelCount;
+  outputFormat_ = header.outputFormat;
+  outputChannelCount_ = header.outputChannelCount;
+  isMeasurementOn_ = header.isMeasurementOn != 0;
+  const std::vector<float> &source = reader.getGranularSource();
+  granularProcessor_.setSource(source.data(), static_cast<int32_t>(source.size()));
+  setupProcessing();
+
+  *results = SessionReplayResults();
+  int32_t bytesPerOutputFrame = outputChannelCount_ * (SampleFormatToBpp(outputFormat_) / 8);
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> input;
+  SessionRecordHeader record;
+  ControlEvent control;
+  SessionCallback callback;
+  int64_t firstTimestampNs = 0;
+  auto replayStart = std::chrono::steady_clock::now();
+
+  while (reader.next(&record, &control, &callback, &input)) {
+    if (record.type == SESSION_RECORD_CONTROL) {
+      applyControlEvent(control);
+      results->controlEventCount++;
+      continue;
+    }
+
+    if (results->callbackCount == 0) firstTimestampNs = callback.timestampNs;
+    results->sessionSeconds = (callback.timestampNs - firstTimestampNs) * 1e-9;
+    if (isRealTime) {
+      std::this_thread::sleep_until(
+          replayStart + std::chrono::nanoseconds(callback.timestampNs - firstTimestampNs));
+    }
+
+    std::copy(input.begin(), input.begin() + std::min(input.size(), inputBuffer_.size()),
+              inputBuffer_.begin());
+    output.resize(callback.numFrames * bytesPerOutputFrame);
+    auto renderStart = std::chrono::steady_clock::now();
+    renderCallback(output.data(), callback.numFrames, callback.framesToRead, callback.frameCount);
+    std::chrono::duration<double> renderTime = std::chrono::steady_clock::now() - renderStart;
+    results->renderSeconds += renderTime.count();
+    results->maxCallbackRenderUs = std::max(results->maxCallbackRenderUs,
+                                            renderTime.count() * 1e6);
+    callbackFramePosition_ += callback.numFrames;
+
+    if (SessionChecksum(output.data(), static_cast<int32_t>(output.size())) !=
+        callback.outputChecksum) {
+      if (results->mismatchedCallbackCount == 0) {
+        results->firstMismatchFramePosition = record.framePosition;
+      }
+      results->mismatchedCallbackCount++;
+    }
+    results->callbackCount++;
+  }
+  std::chrono::duration<double> replayTime = std::chrono::steady_clock::now() - replayStart;
+  results->replaySeconds = replayTime.count();
+
+  isMeasurementOn_ = wasMeasurementOn;
+  granularProcessor_.setSource(granularSource_.data(),
+                               static_cast<int32_t>(granularSource_.size()));
+  for (const ControlEvent &event : savedState) applyControlEvent(event);
+  return results->callbackCount > 0 && !reader.isCorrupt();
+}
+
+
+
 /**
  * Creates a stream builder which can be used to construct streams
  * @return a new stream builder object
@@ -164,6 +632,11 @@ void EchoAudioEngine::openRecordingStream() {
     // Now that the parameters are set up we can open the stream
     aaudio_result_t result = AAudioStreamBuilder_openStream(builder, &recordingStream_);
     if (result == AAUDIO_OK && recordingStream_ != nullptr) {
+
+      // The recording device may not support the requested format or channel count, in which
+      // case we convert from whatever we were given
+      inputFormat_ = AAudioStream_getFormat(recordingStream_);
+      inputChannelCount_ = AAudioStream_getChannelCount(recordingStream_);
       warnIfNotLowLatency(recordingStream_);
       PrintAudioStreamInfo(recordingStream_);
     } else {
@@ -190,11 +663,14 @@ void EchoAudioEngine::openPlaybackStream() {
 
       sampleRate_ = AAudioStream_getSampleRate(playStream_);
       framesPerBurst_ = AAudioStream_getFramesPerBurst(playStream_);
+      outputFormat_ = AAudioStream_getFormat(playStream_);
+      outputChannelCount_ = AAudioStream_getChannelCount(playStream_);
 
       warnIfNotLowLatency(playStream_);
       
-      // Set the buffer size to the burst size - this will give us the minimum possible latency
-      AAudioStream_setBufferSizeInFrames(playStream_, framesPerBurst_);
+      // Set the buffer size to the burst size - this will give us the minimum possible latency -
+      // unless a probe found that the device underruns without a few more
+      AAudioStream_setBufferSizeInFrames(playStream_, framesPerBurst_ * playbackBufferBursts_);
       PrintAudioStreamInfo(playStream_);
 
     } else {
@@ -207,16 +683,17 @@ void EchoAudioEngine::openPlaybackStream() {
 }
 
 /**
- * Sets the stream parameters which are specific to recording, including the sample rate which
- * is determined from the playback stream.
+ * Sets the stream parameters which are specific to recording, including the sample rate and
+ * format which are determined from the playback stream.
  * @param builder The recording stream builder
  */
 void EchoAudioEngine::setupRecordingStreamParameters(AAudioStreamBuilder *builder) {
   AAudioStreamBuilder_setDeviceId(builder, recordingDeviceId_);
   AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_INPUT);
   AAudioStreamBuilder_setSampleRate(builder, sampleRate_);
-  AAudioStreamBuilder_setChannelCount(builder, inputChannelCount_);
+  AAudioStreamBuilder_setChannelCount(builder, requestedInputChannelCount_);
   setupCommonStreamParameters(builder);
+  AAudioStreamBuilder_setFormat(builder, outputFormat_);
 }
 
 /**
@@ -228,7 +705,8 @@ void EchoAudioEngine::setupPlaybackStreamParameters(AAudioStreamBuilder *builder
 
   AAudioStreamBuilder_setDeviceId(builder, playbackDeviceId_);
   AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
-  AAudioStreamBuilder_setChannelCount(builder, outputChannelCount_);
+  AAudioStreamBuilder_setSampleRate(builder, streamConfiguration_.sampleRate);
+  AAudioStreamBuilder_setChannelCount(builder, streamConfiguration_.outputChannelCount);
 
   // The :: here indicates that the function is in the global namespace
   // i.e. *not* EchoAudioEngine::dataCallback, but dataCallback defined at the top of this class
@@ -241,10 +719,10 @@ void EchoAudioEngine::setupPlaybackStreamParameters(AAudioStreamBuilder *builder
  * @param builder The playback or recording stream builder
  */
 void EchoAudioEngine::setupCommonStreamParameters(AAudioStreamBuilder *builder) {
-  AAudioStreamBuilder_setFormat(builder, format_);
-  // We request EXCLUSIVE mode since this will give us the lowest possible latency.
-  // If EXCLUSIVE mode isn't available the builder will fall back to SHARED mode.
-  AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_EXCLUSIVE);
+  AAudioStreamBuilder_setFormat(builder, streamConfiguration_.format);
+  // Unless a probe found otherwise we request EXCLUSIVE mode since this will give us the lowest
+  // possible latency. If EXCLUSIVE mode isn't available the builder will fall back to SHARED mode.
+  AAudioStreamBuilder_setSharingMode(builder, streamConfiguration_.sharingMode);
   AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
   AAudioStreamBuilder_setErrorCallback(builder, ::errorCallback, this);
 }
@@ -293,43 +771,57 @@ aaudio_data_callback_result_t EchoAudioEngine::dataCallback(AAudioStream *stream
                                                             int32_t numFrames) {
   if (isEchoOn_) {
 
+    // Control changes are only applied here, between callbacks, so that a recorded session
+    // knows exactly which frame each one took effect at
+    bool isRecordingSession = sessionRecorder_.isRecording();
+    applyControlEvents(isRecordingSession);
+    int64_t callbackTimeNs = (glitchMonitor_.isRunning() || isRecordingSession) ?
+                             get_time_nanoseconds(CLOCK_MONOTONIC) : 0;
+
     // frameCount could be
     //    < 0 : error code
     //    >= 0 : actual value read from stream
     aaudio_result_t frameCount = 0;
+    int32_t framesToRead = 0;
 
     if (recordingStream_ != nullptr) {
 
+      // The recording stream may have a different format and channel count to the playback
+      // stream so we read into our own buffer, which is sized for the largest callback
+      framesToRead = (numFrames < maxFramesPerCallback_) ? numFrames : maxFramesPerCallback_;
+
       // If this is the first data callback we want to drain the recording buffer so we're getting
       // the most up to date data
       if (isFirstDataCallback_) {
-        drainRecordingStream(audioData, numFrames);
+        drainRecordingStream(inputBuffer_.data(), framesToRead);
         isFirstDataCallback_ = false;
       }
 
-      frameCount = AAudioStream_read(recordingStream_, audioData, numFrames,
+      frameCount = AAudioStream_read(recordingStream_, inputBuffer_.data(), framesToRead,
                                      static_cast<int64_t>(0));
-
-      ConvertMonoToStereo(static_cast<int16_t *>(audioData), frameCount);
-
-      audioEffect_.process(static_cast<int16_t *>(audioData), outputChannelCount_, frameCount);
-
-      if (frameCount < 0) {
-        LOGE("****AAudioStream_read() returns %s",
-             AAudio_convertResultToText(frameCount));
-        frameCount = 0;  // continue to play silent audio
+      if (frameCount > 0 && glitchMonitor_.isRunning()) {
+        glitchMonitor_.tapInput(inputBuffer_.data(), inputFormat_ == AAUDIO_FORMAT_PCM_FLOAT,
+                                inputChannelCount_, frameCount, callbackTimeNs,
+                                AAudioStream_getXRunCount(recordingStream_));
       }
     }
+    renderCallback(audioData, numFrames, framesToRead, frameCount);
 
-    /**
-    * If there's not enough audio data from input stream, fill the rest of buffer with
-    * 0 (silence) and continue to loop
-    */
-    numFrames -= frameCount;
-    if (numFrames > 0) {
-      memset(static_cast<int16_t *>(audioData) + frameCount * outputChannelCount_,
-             0, sizeof(int16_t) * numFrames * outputChannelCount_);
+    // The glitch monitor and the session log get the whole callback, including any silence
+    if (glitchMonitor_.isRunning()) {
+      glitchMonitor_.tapOutput(audioData, outputFormat_ == AAUDIO_FORMAT_PCM_FLOAT,
+                               outputChannelCount_, numFrames, callbackTimeNs,
+                               AAudioStream_getXRunCount(stream));
+    }
+    if (isRecordingSession) {
+      int32_t bytesPerInputFrame = inputChannelCount_ * (SampleFormatToBpp(inputFormat_) / 8);
+      int32_t bytesPerOutputFrame = outputChannelCount_ * (SampleFormatToBpp(outputFormat_) / 8);
+      SessionCallback callback = {callbackTimeNs, numFrames, framesToRead, frameCount,
+                                  SessionChecksum(audioData, numFrames * bytesPerOutputFrame)};
+      sessionRecorder_.recordCallback(callbackFramePosition_, callback, inputBuffer_.data(),
+                                      std::max(frameCount, 0) * bytesPerInputFrame);
     }
+    callbackFramePosition_ += numFrames;
     return AAUDIO_CALLBACK_RESULT_CONTINUE;
 
   } else {
@@ -337,6 +829,164 @@ aaudio_data_callback_result_t EchoAudioEngine::dataCallback(AAudioStream *stream
   }
 }
 
+/**
+ * Render one playback callback from the recorded audio already in inputBuffer_. This is all the
+ * work a callback does after the read, shared by the live streams and session replay.
+ *
+ * @param framesToRead how many frames were asked of the recording stream
+ * @param frameCount what the read returned, which may be an error
+ */
+void EchoAudioEngine::renderCallback(void *audioData, int32_t numFrames, int32_t framesToRead,
+                                     aaudio_result_t frameCount) {
+
+  if (isMeasurementOn_) {
+
+    // The stimulus has to keep playing whether or not any input arrived, missing input is
+    // counted by the measurement
+    processMeasurement(std::max(frameCount, 0), framesToRead);
+    writeEffectBusToOutput(audioData, framesToRead);
+    frameCount = framesToRead;
+  } else if (frameCount < 0) {
+    AUDIO_LOGE("****AAudioStream_read() returns %s",
+         AAudio_convertResultToText(frameCount));
+    frameCount = 0;  // continue to play silent audio
+  } else if (shouldProcessInput(inputBuffer_.data(), frameCount)) {
+
+    // Each sample is converted exactly once on the way in and once on the way out, all the
+    // effects work on the planar float bus in between
+    convertInputToEffectBus(frameCount);
+    inputGainControl_.process(effectBus_.data(), outputChannelCount_, frameCount);
+    audioEffect_.process(effectBus_.data(), outputChannelCount_, frameCount);
+    granularProcessor_.process(effectBus_.data(), outputChannelCount_, frameCount);
+
+    // Feedback suppression goes last so that it sees exactly what will be sent to the speaker
+    feedbackSuppressor_.process(effectBus_.data(), outputChannelCount_, frameCount);
+    if (isGateClosing_) fadeOutEffectBus(frameCount);
+    writeEffectBusToOutput(audioData, frameCount);
+  } else {
+    frameCount = 0;  // the input is silent, skip processing and play silent audio
+  }
+
+  /**
+  * If there's not enough audio data from input stream, fill the rest of buffer with
+  * 0 (silence) and continue to loop
+  */
+  numFrames -= frameCount;
+  if (numFrames > 0) {
+    int32_t bytesPerFrame = outputChannelCount_ * (SampleFormatToBpp(outputFormat_) / 8);
+    memset(static_cast<uint8_t *>(audioData) + frameCount * bytesPerFrame,
+           0, numFrames * bytesPerFrame);
+  }
+}
+
+/**
+ * Allocate the buffers used by the data callback. Must be called once the formats, channel counts
+ * and maxFramesPerCallback_ are known, and must not be called while the streams are running.
+ */
+void EchoAudioEngine::allocateBuffers() {
+
+  int32_t bytesPerInputFrame = inputChannelCount_ * (SampleFormatToBpp(inputFormat_) / 8);
+  inputBuffer_.assign(maxFramesPerCallback_ * bytesPerInputFrame, 0);
+
+  effectBusData_.assign(outputChannelCount_, std::vector<float>(maxFramesPerCallback_, 0));
+  effectBus_.resize(outputChannelCount_);
+  for (int32_t c = 0; c < outputChannelCount_; c++) {
+    effectBus_[c] = effectBusData_[c].data();
+  }
+}
+
+/**
+ * Convert the recorded audio in inputBuffer_ to planar float on the effect bus, mixing the input
+ * channels onto the output channels.
+ */
+void EchoAudioEngine::convertInputToEffectBus(int32_t numFrames) {
+
+  if (inputFormat_ == AAUDIO_FORMAT_PCM_FLOAT) {
+    DeinterleaveToPlanar(reinterpret_cast<const float *>(inputBuffer_.data()), inputChannelCount_,
+                         effectBus_.data(), outputChannelCount_, numFrames);
+  } else {
+    DeinterleaveToPlanar(reinterpret_cast<const int16_t *>(inputBuffer_.data()),
+                         inputChannelCount_, effectBus_.data(), outputChannelCount_, numFrames);
+  }
+}
+
+/**
+ * Convert the planar float effect bus into the playback stream's format.
+ */
+void EchoAudioEngine::writeEffectBusToOutput(void *audioData, int32_t numFrames) {
+
+  if (outputFormat_ == AAUDIO_FORMAT_PCM_FLOAT) {
+    InterleaveFromPlanar(effectBus_.data(), outputChannelCount_,
+                         static_cast<float *>(audioData), numFrames);
+  } else {
+    InterleaveFromPlanar(effectBus_.data(), outputChannelCount_,
+                         static_cast<int16_t *>(audioData), numFrames);
+  }
+}
+
+/**
+ * Fade the effect bus out linearly over the block, reaching zero on its last frame. Used on the
+ * last block before the echo path is bypassed so that the output doesn't step down to silence.
+ */
+void EchoAudioEngine::fadeOutEffectBus(int32_t numFrames) {
+
+  if (numFrames <= 0) return;
+  float gainStep = 1.0f / numFrames;
+  for (int32_t c = 0; c < outputChannelCount_; c++) {
+    float *channel = effectBus_[c];
+    for (int32_t i = 0; i < numFrames; i++) {
+      channel[i] *= 1.0f - static_cast<float>(i + 1) * gainStep;
+    }
+  }
+}
+
+/**
+ * Capture the recorded audio for the measurement and put the next part of its stimulus on every
+ * channel of the effect bus. The effects are bypassed so that only the device path is measured.
+ */
+void EchoAudioEngine::processMeasurement(int32_t numInputFrames, int32_t numFrames) {
+
+  convertInputToEffectBus(numInputFrames);
+  measurement_.process(effectBus_[0], numInputFrames, effectBus_[0], numFrames);
+  for (int32_t c = 1; c < outputChannelCount_; c++) {
+    std::copy(effectBus_[0], effectBus_[0] + numFrames, effectBus_[c]);
+  }
+}
+
+/**
+ * Decide whether a block of recorded audio is worth processing. While the voice activity gate is
+ * open every block is processed. Once it closes the effects keep running until their tail has
+ * finished, after which the whole echo path is bypassed and silence is played instead. The last
+ * block before the bypass is flagged in isGateClosing_ so that it can be faded out. This saves
+ * the cost of the conversion and effect chain while nobody is talking.
+ *
+ * @param inputBuffer the recorded audio, still in the recording stream's format
+ * @param numFrames the number of recorded frames in inputBuffer
+ * @return true if the block should be converted and passed through the effects
+ */
+bool EchoAudioEngine::shouldProcessInput(const void *inputBuffer, int32_t numFrames) {
+
+  int32_t numSamples = numFrames * inputChannelCount_;
+  bool isGateOpen = (inputFormat_ == AAUDIO_FORMAT_PCM_FLOAT) ?
+      inputGate_.process(static_cast<const float *>(inputBuffer), numSamples, numFrames) :
+      inputGate_.process(static_cast<const int16_t *>(inputBuffer), numSamples, numFrames);
+
+  isGateClosing_ = false;
+  if (isGateOpen) {
+    // Always at least one more block, for the fade out
+    effectTailFramesRemaining_ = std::max(std::max(audioEffect_.getTailFrames(),
+                                                   granularProcessor_.getTailFrames()), 1);
+    return true;
+  }
+
+  if (effectTailFramesRemaining_ > 0) {
+    effectTailFramesRemaining_ -= numFrames;
+    isGateClosing_ = effectTailFramesRemaining_ <= 0;
+    return true;
+  }
+  return false;
+}
+
 /**
  * Drain the recording stream of any existing data by reading from it until it's empty. This is
  * usually run to clear out any stale data before performing an actual read operation, thereby
@@ -17,17 +17,49 @@
 #ifndef AAUDIO_ECHOAUDIOENGINE_H
 #define AAUDIO_ECHOAUDIOENGINE_H
 
+#include <atomic>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 #include "audio_common.h"
 #include "audio_effect.h"
+#include "audio_measurement.h"
+#include "automatic_gain_control.h"
+#include "feedback_suppressor.h"
+#include "glitch_monitor.h"
+#include "granular_processor.h"
+#include "session_log.h"
+#include "stream_prober.h"
+#include "voice_activity_gate.h"
+
+constexpr int32_t kMaxControlEvents = 64;
 
 class EchoAudioEngine {
 
 public:
+  EchoAudioEngine();
   ~EchoAudioEngine();
   void setRecordingDeviceId(int32_t deviceId);
   void setPlaybackDeviceId(int32_t deviceId);
+  void setInputChannelCount(int32_t channelCount);
+  float getInputGainDb();
+  void setGranularOn(bool isGranularOn);
+  void setGranularParameters(float density, float grainMs, float positionMs,
+                             float pitchSemitones, float jitter, float spread, float mix);
+  void setGranularWindow(int32_t window);
+  void setGranularSource(const float *source, int32_t numFrames);
   void setEchoOn(bool isEchoOn);
+  void setMeasurementOn(bool isMeasurementOn);
+  bool isMeasurementComplete();
+  bool getMeasurementResults(MeasurementResults *results);
+  void setGlitchMonitorOn(bool isGlitchMonitorOn);
+  void setGlitchTestTone(float frequency);
+  std::string getGlitchReport();
+  void setSessionLogPath(const std::string &path);
+  bool replaySession(const std::string &path, bool isRealTime, SessionReplayResults *results);
+  bool probeStreamConfigurations(StreamProbeResults *results);
+  std::string getStreamReport();
   aaudio_data_callback_result_t dataCallback(AAudioStream *stream,
                                              void *audioData,
                                              int32_t numFrames);
@@ -37,11 +69,22 @@ public:
 private:
 
   bool isEchoOn_ = false;
+  bool isMeasurementOn_ = false;
+  bool isGlitchMonitorOn_ = false;
+  float glitchTestToneFrequency_ = 0;
   bool isFirstDataCallback_ = true;
   int32_t recordingDeviceId_ = AAUDIO_UNSPECIFIED;
   int32_t playbackDeviceId_ = AAUDIO_UNSPECIFIED;
-  aaudio_format_t format_ = AAUDIO_FORMAT_PCM_I16;
+
+  // What the streams are opened with, the best configuration from the last probe or the lowest
+  // latency one on paper if there hasn't been a probe since the devices were chosen
+  StreamConfiguration streamConfiguration_ = StreamProber::getConfigurations()[0];
+  int32_t playbackBufferBursts_ = 1;
+  StreamProbeResults streamProbeResults_;
+  aaudio_format_t inputFormat_ = AAUDIO_FORMAT_PCM_FLOAT;
+  aaudio_format_t outputFormat_ = AAUDIO_FORMAT_PCM_FLOAT;
   int32_t sampleRate_;
+  int32_t requestedInputChannelCount_ = kMonoChannelCount;
   int32_t inputChannelCount_ = kMonoChannelCount;
   int32_t outputChannelCount_ = kStereoChannelCount;
   AAudioStream *recordingStream_ = nullptr;
@@ -49,10 +92,51 @@ private:
   int32_t framesPerBurst_;
   std::thread* streamRestartThread_;
   std::mutex restartingLock_;
+  AutomaticGainControl inputGainControl_;
   AudioEffect audioEffect_;
+  GranularProcessor granularProcessor_;
+  FeedbackSuppressor feedbackSuppressor_;
+  AudioMeasurement measurement_;
+  GlitchMonitor glitchMonitor_;
+
+  // Control changes made while echo is on, waiting for the data callback to apply them
+  ControlEvent controlEvents_[kMaxControlEvents];
+  std::atomic<int32_t> controlReadIndex_{0};
+  std::atomic<int32_t> controlWriteIndex_{0};
+  std::mutex controlEventsLock_;
+
+  std::string sessionLogPath_;
+  SessionRecorder sessionRecorder_;
+  std::vector<float> granularSource_;
+  int64_t callbackFramePosition_ = 0;
+
+  // Buffers used by the data callback, sized when the streams are opened. The effect bus holds
+  // one planar float buffer per output channel.
+  int32_t maxFramesPerCallback_ = 0;
+  std::vector<uint8_t> inputBuffer_;
+  std::vector<std::vector<float>> effectBusData_;
+  std::vector<float *> effectBus_;
+  VoiceActivityGate inputGate_;
+  int32_t effectTailFramesRemaining_ = 0;
+  bool isGateClosing_ = false;  // the current block is the last before the echo path is bypassed
 
   void openRecordingStream();
   void drainRecordingStream(void *audioData, int32_t numFrames);
+  bool shouldProcessInput(const void *inputBuffer, int32_t numFrames);
+  void allocateBuffers();
+  void convertInputToEffectBus(int32_t numFrames);
+  void writeEffectBusToOutput(void *audioData, int32_t numFrames);
+  void fadeOutEffectBus(int32_t numFrames);
+  void processMeasurement(int32_t numInputFrames, int32_t numFrames);
+  void renderCallback(void *audioData, int32_t numFrames, int32_t framesToRead,
+                      aaudio_result_t frameCount);
+  void setupProcessing();
+  void sendControlEvent(const ControlEvent &event);
+  void applyControlEvents(bool isRecordingSession);
+  void applyControlEvent(const ControlEvent &event);
+  void getControlState(ControlEvent *events);
+  void startSessionRecording();
+  void resetStreamConfiguration();
   void openPlaybackStream();
 
   void startStream(AAudioStream* stream);
@@ -0,0 +1,397 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <cstring>
+#include "feedback_suppressor.h"
+
+// Analysis runs every kHopSize frames over the last kFftSize frames. At 48kHz this is a new
+// spectrum roughly every 10ms with a resolution of roughly 47Hz.
+constexpr int32_t kFftSize = 1024;
+constexpr int32_t kHopSize = kFftSize / 2;
+
+// Only look for feedback in the range a phone speaker can actually reproduce
+constexpr float kMinFrequency = 150.0f;
+constexpr float kMaxFrequency = 10000.0f;
+
+// Peak picking, in dB relative to a full scale sine. Peaks are tracked well before they're loud
+// enough to be howling, so that a howl which builds quickly is still seen growing.
+constexpr float kMinPeakLevelDb = -70.0f;
+constexpr float kPeakToAverageDb = 12.0f;
+constexpr float kPeakToNeighbourDb = 12.0f;
+constexpr int32_t kNeighbourBins = 4;
+
+// A peak must persist for this long and grow by at least kMinGrowthDb before a notch is deployed.
+// Peaks which are already prominent are treated as howling even if they've stopped growing, as
+// one which has reached full scale and clipped has.
+constexpr float kPersistSeconds = 0.15f;
+constexpr float kTrackBinTolerance = 1.5f;
+constexpr float kMinGrowthDb = 3.0f;
+constexpr float kHowlPeakToAverageDb = 20.0f;
+
+// Notches start at -20dB and get 6dB deeper each time the peak is detected again, down to -60dB
+constexpr float kNotchQ = 30.0f;
+constexpr float kInitialNotchDepth = 0.9f;
+constexpr float kMaxNotchDepth = 0.999f;
+
+// A notch is released once its peak has been gone for the hold time
+constexpr float kNotchHoldSeconds = 5.0f;
+constexpr float kReleasePeakToAverageDb = 10.0f;
+constexpr float kDepthAttackSeconds = 0.02f;
+constexpr float kDepthReleaseSeconds = 1.0f;
+
+void FeedbackSuppressor::setup(int32_t sampleRate, int32_t channelCount) {
+
+  sampleRate_ = sampleRate;
+  channelCount_ = (channelCount < kMaxFeedbackChannelCount) ?
+                  channelCount : kMaxFeedbackChannelCount;
+
+  fft_.setup(kFftSize);
+  window_.resize(kFftSize);
+  for (int32_t i = 0; i < kFftSize; i++) {
+    window_[i] = static_cast<float>(0.5 - 0.5 * cos(2.0 * M_PI * i / kFftSize));
+  }
+  analysisBuffer_.assign(kFftSize, 0);
+  real_.assign(kFftSize, 0);
+  imaginary_.assign(kFftSize, 0);
+  powerDb_.assign(kFftSize / 2 + 1, 0);
+
+  float binWidth = static_cast<float>(sampleRate) / kFftSize;
+  minBin_ = static_cast<int32_t>(kMinFrequency / binWidth);
+  maxBin_ = static_cast<int32_t>(fminf(kMaxFrequency, sampleRate * 0.45f) / binWidth);
+  if (minBin_ < kNeighbourBins) minBin_ = kNeighbourBins;
+
+  float analysisPeriod = static_cast<float>(kHopSize) / sampleRate;
+  persistFrames_ = static_cast<int32_t>(ceilf(kPersistSeconds / analysisPeriod));
+  holdFrames_ = static_cast<int32_t>(ceilf(kNotchHoldSeconds / analysisPeriod));
+  reset();
+}
+
+void FeedbackSuppressor::reset() {
+
+  std::fill(analysisBuffer_.begin(), analysisBuffer_.end(), 0.0f);
+  analysisWriteIndex_ = 0;
+  framesUntilAnalysis_ = kHopSize;
+  peakCount_ = 0;
+  for (PeakTrack &track : tracks_) track.isActive = false;
+  for (NotchFilter &notch : notches_) notch.isActive = false;
+}
+
+int32_t FeedbackSuppressor::getActiveNotchCount() const {
+
+  int32_t count = 0;
+  for (const NotchFilter &notch : notches_) {
+    if (notch.isActive) count++;
+  }
+  return count;
+}
+
+void FeedbackSuppressor::process(float * const *channels, int32_t channelCount,
+                                 int32_t numFrames) {
+
+  if (channelCount != channelCount_ || sampleRate_ <= 0) return;
+
+  // Split the block at analysis boundaries so that notches deployed by an analysis apply from
+  // the very next frame
+  int32_t offset = 0;
+  while (offset < numFrames) {
+    int32_t chunkFrames = numFrames - offset;
+    if (chunkFrames > framesUntilAnalysis_) chunkFrames = framesUntilAnalysis_;
+
+    pushAnalysisFrames(channels, offset, chunkFrames);
+    applyNotches(channels, offset, chunkFrames);
+
+    offset += chunkFrames;
+    framesUntilAnalysis_ -= chunkFrames;
+    if (framesUntilAnalysis_ == 0) {
+      analyze();
+      framesUntilAnalysis_ = kHopSize;
+    }
+  }
+}
+
+/**
+ * Append the mono mix of the unprocessed input to the circular analysis buffer.
+ */
+void FeedbackSuppressor::pushAnalysisFrames(float * const *channels, int32_t offset,
+                                            int32_t numFrames) {
+
+  float scale = 1.0f / channelCount_;
+  for (int32_t i = 0; i < numFrames; i++) {
+    float sum = 0;
+    for (int32_t c = 0; c < channelCount_; c++) sum += channels[c][offset + i];
+    analysisBuffer_[analysisWriteIndex_] = sum * scale;
+    analysisWriteIndex_ = (analysisWriteIndex_ + 1) & (kFftSize - 1);
+  }
+}
+
+/**
+ * Run the active notches over the audio. Each notch is a constant gain band-pass which is
+ * subtracted from the signal, scaled by the notch depth. This lets the depth be faded in and out
+ * without touching the filter coefficients.
+ */
+void FeedbackSuppressor::applyNotches(float * const *channels, int32_t offset,
+                                      int32_t numFrames) {
+
+  float attackStep = numFrames / (kDepthAttackSeconds * sampleRate_);
+  float releaseStep = numFrames / (kDepthReleaseSeconds * sampleRate_);
+
+  for (NotchFilter &notch : notches_) {
+    if (!notch.isActive) continue;
+
+    // Ramp the depth linearly across the chunk towards its target
+    float startDepth = notch.depth;
+    float endDepth = notch.targetDepth;
+    if (endDepth > startDepth + attackStep) endDepth = startDepth + attackStep;
+    if (endDepth < startDepth - releaseStep) endDepth = startDepth - releaseStep;
+    float depthIncrement = (endDepth - startDepth) / numFrames;
+
+    for (int32_t c = 0; c < channelCount_; c++) {
+      float *samples = channels[c] + offset;
+      float z1 = notch.z1[c];
+      float z2 = notch.z2[c];
+      float depth = startDepth;
+      for (int32_t i = 0; i < numFrames; i++) {
+        float x = samples[i];
+        float bandPass = notch.b0 * x + z1;
+        z1 = z2 - notch.a1 * bandPass;
+        z2 = notch.b2 * x - notch.a2 * bandPass;
+        depth += depthIncrement;
+        samples[i] = x - depth * bandPass;
+      }
+      notch.z1[c] = z1;
+      notch.z2[c] = z2;
+    }
+
+    notch.depth = endDepth;
+    if (notch.depth <= 0 && notch.targetDepth <= 0) notch.isActive = false;
+  }
+}
+
+void FeedbackSuppressor::analyze() {
+
+  // Unwrap the circular buffer so the oldest frame is first
+  for (int32_t i = 0; i < kFftSize; i++) {
+    int32_t index = (analysisWriteIndex_ + i) & (kFftSize - 1);
+    real_[i] = analysisBuffer_[index] * window_[i];
+    imaginary_[i] = 0;
+  }
+  fft_.forward(real_.data(), imaginary_.data());
+
+  // Normalize so that a full scale sine reads 0dB. A Hann window halves the amplitude and the
+  // energy of a real sine is split between the positive and negative frequencies.
+  const float normalization = 4.0f / kFftSize;
+  float powerSum = 0;
+  for (int32_t k = minBin_ - kNeighbourBins; k <= maxBin_ + kNeighbourBins; k++) {
+    float re = real_[k] * normalization;
+    float im = imaginary_[k] * normalization;
+    float power = re * re + im * im;
+    if (k >= minBin_ && k <= maxBin_) powerSum += power;
+    powerDb_[k] = 10.0f * log10f(power + 1e-20f);
+  }
+  averagePowerDb_ = 10.0f * log10f(powerSum / (maxBin_ - minBin_ + 1) + 1e-20f);
+
+  findPeaks();
+  updateTracks();
+  updateNotches();
+}
+
+/**
+ * Find the most prominent narrow peaks in the spectrum, keeping up to kMaxPeaksPerFrame sorted
+ * by level.
+ */
+void FeedbackSuppressor::findPeaks() {
+
+  peakCount_ = 0;
+  for (int32_t k = minBin_; k <= maxBin_; k++) {
+    float level = powerDb_[k];
+    if (level < kMinPeakLevelDb) continue;
+    if (level <= powerDb_[k - 1] || level < powerDb_[k + 1]) continue;
+    if (level - averagePowerDb_ < kPeakToAverageDb) continue;
+    if (level - powerDb_[k - kNeighbourBins] < kPeakToNeighbourDb ||
+        level - powerDb_[k + kNeighbourBins] < kPeakToNeighbourDb) {
+      continue;
+    }
+
+    // Insertion sort into the (tiny) peak list
+    int32_t position = peakCount_;
+    while (position > 0 && peakLevelsDb_[position - 1] < level) position--;
+    if (position >= kMaxPeaksPerFrame) continue;
+    int32_t last = (peakCount_ < kMaxPeaksPerFrame) ? peakCount_ : kMaxPeaksPerFrame - 1;
+    for (int32_t i = last; i > position; i--) {
+      peakBins_[i] = peakBins_[i - 1];
+      peakLevelsDb_[i] = peakLevelsDb_[i - 1];
+    }
+    peakBins_[position] = parabolicPeakBin(k);
+    peakLevelsDb_[position] = level;
+    if (peakCount_ < kMaxPeaksPerFrame) peakCount_++;
+  }
+}
+
+/**
+ * Follow peaks from one analysis frame to the next. A peak which persists and grows is the
+ * signature of feedback, at which point a notch is deployed on it.
+ */
+void FeedbackSuppressor::updateTracks() {
+
+  bool wasMatched[kMaxPeakTracks] = {};
+
+  for (int32_t p = 0; p < peakCount_; p++) {
+    PeakTrack *match = nullptr;
+    PeakTrack *freeTrack = nullptr;
+    for (int32_t t = 0; t < kMaxPeakTracks; t++) {
+      PeakTrack &track = tracks_[t];
+      if (!track.isActive) {
+        if (freeTrack == nullptr) freeTrack = &track;
+      } else if (!wasMatched[t] && fabsf(track.bin - peakBins_[p]) <= kTrackBinTolerance) {
+        match = &track;
+        wasMatched[t] = true;
+        break;
+      }
+    }
+
+    if (match != nullptr) {
+      match->bin = peakBins_[p];
+      match->levelDb = peakLevelsDb_[p];
+      match->frameCount++;
+    } else if (freeTrack != nullptr) {
+      freeTrack->isActive = true;
+      freeTrack->bin = peakBins_[p];
+      freeTrack->levelDb = peakLevelsDb_[p];
+      freeTrack->firstLevelDb = peakLevelsDb_[p];
+      freeTrack->frameCount = 1;
+      wasMatched[freeTrack - tracks_] = true;
+    }
+  }
+
+  for (int32_t t = 0; t < kMaxPeakTracks; t++) {
+    PeakTrack &track = tracks_[t];
+    if (!track.isActive) continue;
+
+    // A track ends as soon as its peak disappears for a single frame
+    if (!wasMatched[t]) {
+      track.isActive = false;
+      continue;
+    }
+
+    if (track.frameCount < persistFrames_) continue;
+    bool isGrowing = (track.levelDb - track.firstLevelDb) >= kMinGrowthDb;
+    bool isHowling = (track.levelDb - averagePowerDb_) >= kHowlPeakToAverageDb;
+    if (isGrowing || isHowling) {
+      deployNotch(track.bin);
+
+      // The peak has to persist again before the notch is made any deeper
+      track.firstLevelDb = track.levelDb;
+      track.frameCount = 0;
+    }
+  }
+}
+
+/**
+ * Release notches whose peaks have decayed.
+ */
+void FeedbackSuppressor::updateNotches() {
+
+  float binWidth = static_cast<float>(sampleRate_) / kFftSize;
+  for (NotchFilter &notch : notches_) {
+    if (!notch.isActive || notch.targetDepth <= 0) continue;
+
+    int32_t bin = static_cast<int32_t>(notch.frequency / binWidth + 0.5f);
+    bool isPeakPresent = (powerDb_[bin] - averagePowerDb_) >= kReleasePeakToAverageDb;
+    if (isPeakPresent) {
+      notch.holdFramesRemaining = holdFrames_;
+    } else if (--notch.holdFramesRemaining <= 0) {
+      notch.targetDepth = 0;
+    }
+  }
+}
+
+/**
+ * Put a notch on a howling peak. If the peak is within the bandwidth of a notch it is retuned and
+ * made deeper, otherwise a free notch is taken from the pool. When the pool is empty the
+ * shallowest notch is reused.
+ *
+ * A notch shifts the phase around it, so the loop often starts howling again just outside it.
+ * Retuning the notch onto that would only move the howl back, so it gets a notch of its own.
+ */
+void FeedbackSuppressor::deployNotch(float bin) {
+
+  float frequency = binToFrequency(bin);
+  float mergeDistance = 0.5f * frequency / kNotchQ;
+
+  NotchFilter *target = nullptr;
+  for (NotchFilter &notch : notches_) {
+    if (notch.isActive && fabsf(notch.frequency - frequency) <= mergeDistance) {
+      target = &notch;
+      break;
+    }
+  }
+
+  if (target != nullptr) {
+    setNotchFrequency(*target, frequency);
+    float deeper = 1.0f - (1.0f - fmaxf(target->targetDepth, kInitialNotchDepth)) * 0.5f;
+    target->targetDepth = fminf(deeper, kMaxNotchDepth);
+    target->holdFramesRemaining = holdFrames_;
+    return;
+  }
+
+  for (NotchFilter &notch : notches_) {
+    if (!notch.isActive) {
+      target = &notch;
+      break;
+    }
+    if (target == nullptr || notch.targetDepth < target->targetDepth) target = &notch;
+  }
+
+  target->isActive = true;
+  target->depth = 0;
+  target->targetDepth = kInitialNotchDepth;
+  target->holdFramesRemaining = holdFrames_;
+  memset(target->z1, 0, sizeof(target->z1));
+  memset(target->z2, 0, sizeof(target->z2));
+  setNotchFrequency(*target, frequency);
+}
+
+void FeedbackSuppressor::setNotchFrequency(NotchFilter &notch, float frequency) {
+
+  notch.frequency = frequency;
+  float w0 = static_cast<float>(2.0 * M_PI) * frequency / sampleRate_;
+  float alpha = sinf(w0) / (2.0f * kNotchQ);
+  float a0 = 1.0f + alpha;
+  notch.b0 = alpha / a0;
+  notch.b2 = -alpha / a0;
+  notch.a1 = -2.0f * cosf(w0) / a0;
+  notch.a2 = (1.0f - alpha) / a0;
+}
+
+float FeedbackSuppressor::binToFrequency(float bin) const {
+  return bin * sampleRate_ / kFftSize;
+}
+
+/**
+ * Refine the location of a peak to a fraction of a bin by fitting a parabola through the peak
+ * bin and its neighbours.
+ */
+float FeedbackSuppressor::parabolicPeakBin(int32_t bin) const {
+
+  float left = powerDb_[bin - 1];
+  float centre = powerDb_[bin];
+  float right = powerDb_[bin + 1];
+  float denominator = left - 2.0f * centre + right;
+  if (denominator == 0) return static_cast<float>(bin);
+  return bin + 0.5f * (left - right) / denominator;
+}
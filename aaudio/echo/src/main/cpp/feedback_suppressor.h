@@ -0,0 +1,121 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_FEEDBACK_SUPPRESSOR_H
+#define AAUDIO_FEEDBACK_SUPPRESSOR_H
+
+#include <cstdint>
+#include <vector>
+#include "fft.h"
+
+constexpr int kMaxNotchFilters = 8;
+constexpr int kMaxFeedbackChannelCount = 8;
+constexpr int kMaxPeaksPerFrame = 4;
+constexpr int kMaxPeakTracks = 16;
+
+/**
+ * Detects acoustic feedback (howling) between the speaker and the mic and removes it with narrow
+ * notch filters. This is a much cheaper alternative to full acoustic echo cancellation.
+ *
+ * Feedback shows up as a narrow spectral peak which persists and grows from one analysis frame
+ * to the next, whereas speech and music peaks move around. Once a peak has persisted and grown
+ * for long enough a notch filter is deployed at its frequency. If the peak is still there on
+ * later frames the notch is retuned to the peak and made deeper. When the peak has decayed for
+ * the hold time the notch is faded out and returned to the pool.
+ *
+ * Detection looks at the signal entering the suppressor rather than its output. Since the notch
+ * breaks the feedback loop the peak decays at the input too, which is what lets the notch be
+ * released again.
+ *
+ * All the filters, analysis buffers and tracking state are allocated in setup.
+ */
+class FeedbackSuppressor {
+public:
+  /**
+   * Must not be called from the audio thread.
+   *
+   * @param sampleRate the sample rate of the audio to be processed
+   * @param channelCount the number of planar channels passed to process
+   */
+  void setup(int32_t sampleRate, int32_t channelCount);
+  void reset();
+
+  void process(float * const *channels, int32_t channelCount, int32_t numFrames);
+
+  int32_t getActiveNotchCount() const;
+
+private:
+  struct PeakTrack {
+    float bin;
+    float levelDb;
+    float firstLevelDb;
+    int32_t frameCount;
+    bool isActive;
+  };
+
+  struct NotchFilter {
+    float frequency;
+    float depth;          // 0 = bypassed, 1 = the full band-pass is removed
+    float targetDepth;
+    int32_t holdFramesRemaining;
+    bool isActive;
+
+    // Constant 0 dB peak gain band-pass coefficients, normalized so that a0 = 1
+    float b0, b2, a1, a2;
+
+    // Transposed direct form II state, one pair per channel
+    float z1[kMaxFeedbackChannelCount];
+    float z2[kMaxFeedbackChannelCount];
+  };
+
+  void pushAnalysisFrames(float * const *channels, int32_t offset, int32_t numFrames);
+  void applyNotches(float * const *channels, int32_t offset, int32_t numFrames);
+  void analyze();
+  void findPeaks();
+  void updateTracks();
+  void updateNotches();
+  void deployNotch(float bin);
+  void setNotchFrequency(NotchFilter &notch, float frequency);
+  float binToFrequency(float bin) const;
+  float parabolicPeakBin(int32_t bin) const;
+
+  int32_t sampleRate_ = 0;
+  int32_t channelCount_ = 0;
+
+  // Analysis
+  Fft fft_;
+  std::vector<float> window_;
+  std::vector<float> analysisBuffer_;
+  int32_t analysisWriteIndex_ = 0;
+  int32_t framesUntilAnalysis_ = 0;
+  std::vector<float> real_;
+  std::vector<float> imaginary_;
+  std::vector<float> powerDb_;
+  float averagePowerDb_ = 0;
+  int32_t minBin_ = 0;
+  int32_t maxBin_ = 0;
+  int32_t persistFrames_ = 0;
+  int32_t holdFrames_ = 0;
+
+  float peakBins_[kMaxPeaksPerFrame];
+  float peakLevelsDb_[kMaxPeaksPerFrame];
+  int32_t peakCount_ = 0;
+
+  PeakTrack tracks_[kMaxPeakTracks];
+  NotchFilter notches_[kMaxNotchFilters];
+};
+
+#endif //AAUDIO_FEEDBACK_SUPPRESSOR_H
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <logging_macros.h>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include "glitch_monitor.h"
+
+// The taps hold about a quarter of a second of callbacks at the usual burst sizes, which is far
+// more than the analysis thread falls behind by
+constexpr int32_t kTapCallbacks = 64;
+constexpr int32_t kAnalysisPeriodMs = 10;
+
+static const char *kStreamNames[GLITCH_STREAM_COUNT] = {"output", "input"};
+
+GlitchMonitor::~GlitchMonitor() {
+  stop();
+}
+
+void GlitchMonitor::start(int32_t sampleRate, int32_t maxFramesPerCallback,
+                          int32_t repeatPeriodFrames, float toneFrequency) {
+
+  stop();
+  sampleRate_ = sampleRate;
+  samples_.assign(maxFramesPerCallback, 0.0f);
+  for (int32_t s = 0; s < GLITCH_STREAM_COUNT; s++) {
+    taps_[s].setup(maxFramesPerCallback, kTapCallbacks);
+    detectors_[s].setup(sampleRate, repeatPeriodFrames);
+    detectors_[s].setTestTone(toneFrequency);
+    events_[s].clear();
+    framesAnalyzed_[s] = 0;
+  }
+  isRunning_.store(true, std::memory_order_release);
+  analysisThread_ = std::thread(&GlitchMonitor::analyze, this);
+}
+
+void GlitchMonitor::stop() {
+
+  if (!isRunning_.exchange(false)) return;
+  analysisThread_.join();
+}
+
+bool GlitchMonitor::isRunning() const {
+  return isRunning_.load(std::memory_order_acquire);
+}
+
+void GlitchMonitor::tapOutput(const void *audioData, bool isFloat, int32_t channelCount,
+                              int32_t numFrames, int64_t timestampNs, int32_t xRunCount) {
+  tap(GLITCH_STREAM_OUTPUT, audioData, isFloat, channelCount, numFrames, timestampNs, xRunCount);
+}
+
+void GlitchMonitor::tapInput(const void *audioData, bool isFloat, int32_t channelCount,
+                             int32_t numFrames, int64_t timestampNs, int32_t xRunCount) {
+  tap(GLITCH_STREAM_INPUT, audioData, isFloat, channelCount, numFrames, timestampNs, xRunCount);
+}
+
+void GlitchMonitor::tap(GlitchStream stream, const void *audioData, bool isFloat,
+                        int32_t channelCount, int32_t numFrames, int64_t timestampNs,
+                        int32_t xRunCount) {
+
+  if (!isRunning()) return;
+  if (isFloat) {
+    taps_[stream].write(static_cast<const float *>(audioData), channelCount, numFrames,
+                        timestampNs, xRunCount);
+  } else {
+    taps_[stream].write(static_cast<const int16_t *>(audioData), channelCount, numFrames,
+                        timestampNs, xRunCount);
+  }
+}
+
+void GlitchMonitor::analyze() {
+
+  while (isRunning()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kAnalysisPeriodMs));
+    for (int32_t s = 0; s < GLITCH_STREAM_COUNT; s++) {
+      drain(static_cast<GlitchStream>(s));
+    }
+  }
+
+  // Pick up whatever was tapped before the streams stopped
+  for (int32_t s = 0; s < GLITCH_STREAM_COUNT; s++) {
+    drain(static_cast<GlitchStream>(s));
+  }
+}
+
+void GlitchMonitor::drain(GlitchStream stream) {
+
+  AudioTapRecord record;
+  int64_t numFrames = 0;
+  while (taps_[stream].read(&record, samples_.data())) {
+    detectors_[stream].process(samples_.data(), record.numFrames, record.framePosition,
+                               record.timestampNs, record.xRunCount);
+    numFrames += record.numFrames;
+  }
+
+  found_.clear();
+  detectors_[stream].takeEvents(&found_);
+  for (const GlitchEvent &event : found_) {
+    LOGW("Glitch on %s: %s at frame %" PRId64 " for %d frames, %.1f dB, xruns %d",
+         kStreamNames[stream], GlitchTypeToString(event.type), event.framePosition,
+         event.durationFrames, event.levelDb, event.xRunCount);
+  }
+
+  std::lock_guard<std::mutex> lock(eventsLock_);
+  framesAnalyzed_[stream] += numFrames;
+  events_[stream].insert(events_[stream].end(), found_.begin(), found_.end());
+}
+
+/**
+ * The report has the sample rate and, for each stream, how many frames were analyzed and every
+ * glitch found, e.g.
+ *
+ * {"sampleRate":48000,"output":{"framesAnalyzed":480000,"glitches":[{"type":"dropout",
+ * "framePosition":30000,"durationFrames":240,"levelDb":-15.8,"timestampNs":1625000000,
+ * "xRunCount":1}]},"input":{...}}
+ */
+std::string GlitchMonitor::getReport() {
+
+  std::lock_guard<std::mutex> lock(eventsLock_);
+  char number[160];
+  snprintf(number, sizeof(number), "{\"sampleRate\":%d", sampleRate_);
+  std::string json = number;
+  for (int32_t s = 0; s < GLITCH_STREAM_COUNT; s++) {
+    snprintf(number, sizeof(number), ",\"%s\":{\"framesAnalyzed\":%" PRId64 ",\"glitches\":[",
+             kStreamNames[s], framesAnalyzed_[s]);
+    json.append(number);
+    for (size_t i = 0; i < events_[s].size(); i++) {
+      const GlitchEvent &event = events_[s][i];
+      snprintf(number, sizeof(number),
+               "%s{\"type\":\"%s\",\"framePosition\":%" PRId64 ",\"durationFrames\":%d,"
+               "\"levelDb\":%.1f,\"timestampNs\":%" PRId64 ",\"xRunCount\":%d}",
+               (i > 0) ? "," : "", GlitchTypeToString(event.type), event.framePosition,
+               event.durationFrames, event.levelDb, event.timestampNs, event.xRunCount);
+      json.append(number);
+    }
+    json.append("]}");
+  }
+  json.append("}");
+  return json;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_GLITCH_MONITOR_H
+#define AAUDIO_GLITCH_MONITOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "audio_tap.h"
+#include "glitch_detector.h"
+
+enum GlitchStream {
+  GLITCH_STREAM_OUTPUT,
+  GLITCH_STREAM_INPUT,
+  GLITCH_STREAM_COUNT,
+};
+
+/**
+ * Looks for glitches in the audio going to the playback stream and coming from the recording
+ * stream while echo is running. The data callback taps both into lock free rings, and a thread of
+ * the monitor's own drains them into a GlitchDetector per stream every few milliseconds, so none
+ * of the analysis happens on the audio thread.
+ *
+ * Each glitch is logged as it's found and kept for the report, with the time of the callback it
+ * happened in and the stream's xrun count then.
+ */
+class GlitchMonitor {
+public:
+  ~GlitchMonitor();
+
+  /**
+   * Start monitoring. Must not be called from the audio thread, or while it's tapping.
+   *
+   * @param repeatPeriodFrames the length of buffer to look for repeats of, normally the burst size
+   * @param toneFrequency the frequency of a test tone which should be on both streams, or 0
+   */
+  void start(int32_t sampleRate, int32_t maxFramesPerCallback, int32_t repeatPeriodFrames,
+             float toneFrequency);
+  void stop();
+  bool isRunning() const;
+
+  // Called from the audio thread
+  void tapOutput(const void *audioData, bool isFloat, int32_t channelCount, int32_t numFrames,
+                 int64_t timestampNs, int32_t xRunCount);
+  void tapInput(const void *audioData, bool isFloat, int32_t channelCount, int32_t numFrames,
+                int64_t timestampNs, int32_t xRunCount);
+
+  // All the glitches found since the monitor was last started, as JSON
+  std::string getReport();
+
+private:
+  void tap(GlitchStream stream, const void *audioData, bool isFloat, int32_t channelCount,
+           int32_t numFrames, int64_t timestampNs, int32_t xRunCount);
+  void analyze();
+  void drain(GlitchStream stream);
+
+  int32_t sampleRate_ = 0;
+  AudioTap taps_[GLITCH_STREAM_COUNT];
+  GlitchDetector detectors_[GLITCH_STREAM_COUNT];
+  std::vector<float> samples_;
+  std::vector<GlitchEvent> found_;
+
+  std::atomic<bool> isRunning_{false};
+  std::thread analysisThread_;
+  std::mutex eventsLock_;
+  std::vector<GlitchEvent> events_[GLITCH_STREAM_COUNT];
+  int64_t framesAnalyzed_[GLITCH_STREAM_COUNT] = {};
+};
+
+#endif //AAUDIO_GLITCH_MONITOR_H
@@ -0,0 +1,370 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <climits>
+#include "granular_processor.h"
+
+// Just over 2.7 seconds of live input at 48kHz
+constexpr int32_t kLiveSourceFrames = 1 << 17;
+
+// Grains are scheduled and rendered in chunks of at most this many frames
+constexpr int32_t kChunkFrames = 64;
+
+constexpr int32_t kWindowTableSize = 1024;
+constexpr int32_t kWindowTableStride = kWindowTableSize + 1;
+constexpr float kTukeyTaper = 0.5f;
+constexpr float kGaussianWidth = 0.15f;
+
+// Parameter ranges
+constexpr float kMinDensity = 1.0f;
+constexpr float kMaxDensity = 2000.0f;
+constexpr float kMinGrainMs = 5.0f;
+constexpr float kMaxGrainMs = 500.0f;
+constexpr float kMaxPitchSemitones = 24.0f;
+
+// The largest random offsets applied at full jitter
+constexpr float kMaxPositionJitterMs = 100.0f;
+constexpr float kMaxPitchJitterSemitones = 1.0f;
+constexpr float kMaxTimingJitter = 0.9f;
+
+constexpr float kQuarterPi = 0.78539816f;
+constexpr float kTwoPi = 6.2831853f;
+
+template <typename T>
+static T clamp(T value, T low, T high) {
+  return std::min(std::max(value, low), high);
+}
+
+static float windowValue(GrainWindow window, float x) {
+
+  switch (window) {
+    case GrainWindow::Triangle:
+      return 1.0f - fabsf(2.0f * x - 1.0f);
+    case GrainWindow::Tukey: {
+      float edge = std::min(x, 1.0f - x);
+      if (edge >= kTukeyTaper / 2) return 1.0f;
+      return 0.5f - 0.5f * cosf(kTwoPi * edge / kTukeyTaper);
+    }
+    case GrainWindow::Gaussian: {
+      float distance = (x - 0.5f) / kGaussianWidth;
+      return expf(-0.5f * distance * distance);
+    }
+    case GrainWindow::Hann:
+    default:
+      return 0.5f - 0.5f * cosf(kTwoPi * x);
+  }
+}
+
+void GranularProcessor::setup(int32_t sampleRate) {
+
+  sampleRate_ = sampleRate;
+  liveSource_.assign(kLiveSourceFrames + 1, 0);
+
+  int32_t windowCount = static_cast<int32_t>(GrainWindow::Count);
+  windowTables_.resize(windowCount * kWindowTableStride);
+  for (int32_t w = 0; w < windowCount; w++) {
+    float *table = &windowTables_[w * kWindowTableStride];
+    for (int32_t i = 0; i <= kWindowTableSize; i++) {
+      table[i] = windowValue(static_cast<GrainWindow>(w),
+                             static_cast<float>(i) / kWindowTableSize);
+    }
+  }
+
+  grainBuffer_.assign(kChunkFrames, 0);
+  wetLeft_.assign(kChunkFrames, 0);
+  wetRight_.assign(kChunkFrames, 0);
+  reset();
+}
+
+void GranularProcessor::reset() {
+
+  std::fill(liveSource_.begin(), liveSource_.end(), 0.0f);
+  liveWriteIndex_ = 0;
+  playhead_ = 0;
+  activeGrainCount_ = 0;
+  framesUntilNextGrain_ = 0;
+
+  // Restart the random sequence too so that the same input and parameters always give the same
+  // grains, which is what lets a recorded session be replayed exactly
+  randomState_ = 1;
+
+  isLiveSource_ = loadedSource_.empty();
+  if (isLiveSource_) {
+    source_ = liveSource_.data();
+    sourceFrames_ = kLiveSourceFrames;
+  } else {
+    source_ = loadedSource_.data();
+    sourceFrames_ = static_cast<int32_t>(loadedSource_.size()) - 1;
+  }
+}
+
+void GranularProcessor::setSource(const float *source, int32_t numFrames) {
+
+  if (source != nullptr && numFrames > 0) {
+    loadedSource_.assign(source, source + numFrames);
+    loadedSource_.push_back(source[0]);
+  } else {
+    loadedSource_.clear();
+  }
+  reset();
+}
+
+void GranularProcessor::setParameters(float density, float grainMs, float positionMs,
+                                      float pitchSemitones, float jitter, float spread,
+                                      float mix) {
+
+  density_.store(clamp(density, kMinDensity, kMaxDensity), std::memory_order_relaxed);
+  grainMs_.store(clamp(grainMs, kMinGrainMs, kMaxGrainMs), std::memory_order_relaxed);
+  positionMs_.store(std::max(positionMs, 0.0f), std::memory_order_relaxed);
+  pitchSemitones_.store(clamp(pitchSemitones, -kMaxPitchSemitones, kMaxPitchSemitones),
+                        std::memory_order_relaxed);
+  jitter_.store(clamp(jitter, 0.0f, 1.0f), std::memory_order_relaxed);
+  spread_.store(clamp(spread, 0.0f, 1.0f), std::memory_order_relaxed);
+  mix_.store(clamp(mix, 0.0f, 1.0f), std::memory_order_relaxed);
+}
+
+void GranularProcessor::getParameters(float *values) const {
+
+  values[0] = density_.load(std::memory_order_relaxed);
+  values[1] = grainMs_.load(std::memory_order_relaxed);
+  values[2] = positionMs_.load(std::memory_order_relaxed);
+  values[3] = pitchSemitones_.load(std::memory_order_relaxed);
+  values[4] = jitter_.load(std::memory_order_relaxed);
+  values[5] = spread_.load(std::memory_order_relaxed);
+  values[6] = mix_.load(std::memory_order_relaxed);
+}
+
+void GranularProcessor::setWindow(GrainWindow window) {
+  if (window >= GrainWindow::Hann && window < GrainWindow::Count) {
+    window_.store(static_cast<int32_t>(window), std::memory_order_relaxed);
+  }
+}
+
+int32_t GranularProcessor::getTailFrames() const {
+
+  if (!isEnabled()) return 0;
+
+  // A loaded source doesn't depend on the input at all
+  if (!isLiveSource_) return INT_MAX;
+
+  float tailMs = positionMs_.load(std::memory_order_relaxed) + kMaxPositionJitterMs +
+                 grainMs_.load(std::memory_order_relaxed);
+  return static_cast<int32_t>(tailMs * 0.001f * sampleRate_);
+}
+
+float GranularProcessor::nextRandom() {
+
+  // xorshift32, returns a value from -1 to 1
+  randomState_ ^= randomState_ << 13;
+  randomState_ ^= randomState_ >> 17;
+  randomState_ ^= randomState_ << 5;
+  return static_cast<int32_t>(randomState_) * (1.0f / 2147483648.0f);
+}
+
+void GranularProcessor::process(float * const *channels, int32_t channelCount,
+                                int32_t numFrames) {
+
+  if (!isEnabled() || sampleRate_ <= 0 || channelCount <= 0) return;
+
+  for (int32_t offset = 0; offset < numFrames; offset += kChunkFrames) {
+    int32_t chunkFrames = std::min(numFrames - offset, kChunkFrames);
+    processChunk(channels, channelCount, offset, chunkFrames);
+  }
+}
+
+void GranularProcessor::processChunk(float * const *channels, int32_t channelCount,
+                                     int32_t offset, int32_t numFrames) {
+
+  if (isLiveSource_) {
+    writeLiveSource(channels, channelCount, offset, numFrames);
+  }
+  scheduleGrains(numFrames);
+  renderGrains(numFrames);
+
+  float *wetLeft = wetLeft_.data();
+  float *wetRight = wetRight_.data();
+  if (channelCount == 1) {
+    for (int32_t i = 0; i < numFrames; i++) wetLeft[i] = 0.5f * (wetLeft[i] + wetRight[i]);
+  }
+
+  float mix = mix_.load(std::memory_order_relaxed);
+  float dryGain = 1.0f - mix;
+  float wetGain = mix * wetGain_;
+  for (int32_t c = 0; c < channelCount; c++) {
+    float *channel = channels[c] + offset;
+    const float *wet = (c & 1) ? wetRight : wetLeft;
+    for (int32_t i = 0; i < numFrames; i++) {
+      channel[i] = channel[i] * dryGain + wet[i] * wetGain;
+    }
+  }
+
+  if (!isLiveSource_) {
+    playhead_ += numFrames;
+    if (playhead_ >= sourceFrames_) playhead_ -= sourceFrames_;
+  }
+}
+
+/**
+ * Record the mono mix of the input into the live source.
+ */
+void GranularProcessor::writeLiveSource(float * const *channels, int32_t channelCount,
+                                        int32_t offset, int32_t numFrames) {
+
+  float scale = 1.0f / channelCount;
+  for (int32_t i = 0; i < numFrames; i++) {
+    float sum = 0;
+    for (int32_t c = 0; c < channelCount; c++) sum += channels[c][offset + i];
+    liveSource_[liveWriteIndex_] = sum * scale;
+    liveWriteIndex_ = (liveWriteIndex_ + 1) & (kLiveSourceFrames - 1);
+  }
+  liveSource_[kLiveSourceFrames] = liveSource_[0];
+}
+
+/**
+ * Start the grains which are due in the next numFrames frames. Each grain starts at the exact
+ * frame it was scheduled for, not at the start of the chunk.
+ */
+void GranularProcessor::scheduleGrains(int32_t numFrames) {
+
+  // Read the parameters once so that every grain in the chunk sees the same values
+  float density = density_.load(std::memory_order_relaxed);
+  float grainFrames = grainMs_.load(std::memory_order_relaxed) * 0.001f * sampleRate_;
+  float positionFrames = positionMs_.load(std::memory_order_relaxed) * 0.001f * sampleRate_;
+  float pitchSemitones = pitchSemitones_.load(std::memory_order_relaxed);
+  float jitter = jitter_.load(std::memory_order_relaxed);
+  float spread = spread_.load(std::memory_order_relaxed);
+  int32_t windowOffset = window_.load(std::memory_order_relaxed) * kWindowTableStride;
+
+  float interval = sampleRate_ / density;
+  float positionJitterFrames = jitter * kMaxPositionJitterMs * 0.001f * sampleRate_;
+
+  // Overlapping grains are uncorrelated so their levels add up as power
+  wetGain_ = 1.0f / sqrtf(std::max(1.0f, grainFrames / interval));
+
+  while (framesUntilNextGrain_ < numFrames) {
+
+    int32_t startFrame = static_cast<int32_t>(framesUntilNextGrain_);
+    framesUntilNextGrain_ += interval * (1.0f + kMaxTimingJitter * jitter * nextRandom());
+
+    // If the pool is exhausted the grain is simply dropped
+    if (activeGrainCount_ >= kMaxGrains) continue;
+
+    float pitch = exp2f((pitchSemitones + kMaxPitchJitterSemitones * jitter * nextRandom())
+                        / 12.0f);
+    int32_t length = std::max(static_cast<int32_t>(grainFrames), 1);
+    float delay = positionFrames + positionJitterFrames * nextRandom();
+
+    float now;
+    if (isLiveSource_) {
+      // A grain which plays faster than real time must start far enough back that it never
+      // catches up with the input, and a slow one must finish before the input overwrites it
+      float minDelay = std::max(length * (pitch - 1.0f), 0.0f) + 2.0f;
+      float maxDelay = sourceFrames_ - kChunkFrames - std::max(length * (1.0f - pitch), 0.0f)
+                       - 2.0f;
+      delay = clamp(delay, minDelay, std::max(minDelay, maxDelay));
+      now = static_cast<float>(liveWriteIndex_ - numFrames + startFrame);
+    } else {
+      now = playhead_ + startFrame;
+    }
+    float position = fmodf(now - delay, static_cast<float>(sourceFrames_));
+    if (position < 0) position += sourceFrames_;
+
+    float angle = (spread * nextRandom() + 1.0f) * kQuarterPi;
+
+    int32_t g = activeGrainCount_++;
+    positions_[g] = position;
+    increments_[g] = pitch;
+    windowPhases_[g] = 0;
+    windowIncrements_[g] = 1.0f / length;
+    leftGains_[g] = cosf(angle);
+    rightGains_[g] = sinf(angle);
+    windowOffsets_[g] = windowOffset;
+    startFrames_[g] = startFrame;
+    framesRemaining_[g] = length;
+  }
+  framesUntilNextGrain_ -= numFrames;
+}
+
+/**
+ * Render every active grain and sum them into wetLeft_ and wetRight_. Finished grains are
+ * returned to the pool by moving the last active grain into their slot.
+ */
+void GranularProcessor::renderGrains(int32_t numFrames) {
+
+  float *wetLeft = wetLeft_.data();
+  float *wetRight = wetRight_.data();
+  float *grain = grainBuffer_.data();
+  std::fill(wetLeft, wetLeft + numFrames, 0.0f);
+  std::fill(wetRight, wetRight + numFrames, 0.0f);
+
+  const float *source = source_;
+  const float sourceFrames = static_cast<float>(sourceFrames_);
+
+  int32_t g = 0;
+  while (g < activeGrainCount_) {
+
+    int32_t start = startFrames_[g];
+    int32_t end = start + std::min(numFrames - start, framesRemaining_[g]);
+    const float *window = &windowTables_[windowOffsets_[g]];
+    float position = positions_[g];
+    float increment = increments_[g];
+    float windowPhase = windowPhases_[g];
+    float windowIncrement = windowIncrements_[g];
+
+    for (int32_t i = start; i < end; i++) {
+      int32_t s = static_cast<int32_t>(position);
+      float sample = source[s] + (position - s) * (source[s + 1] - source[s]);
+
+      float x = windowPhase * kWindowTableSize;
+      int32_t w = static_cast<int32_t>(x);
+      float gain = window[w] + (x - w) * (window[w + 1] - window[w]);
+
+      grain[i] = sample * gain;
+      position += increment;
+      if (position >= sourceFrames) position -= sourceFrames;
+      windowPhase += windowIncrement;
+    }
+
+    // Summing is kept out of the loop above so that it vectorizes
+    float leftGain = leftGains_[g];
+    float rightGain = rightGains_[g];
+    for (int32_t i = start; i < end; i++) {
+      wetLeft[i] += grain[i] * leftGain;
+      wetRight[i] += grain[i] * rightGain;
+    }
+
+    framesRemaining_[g] -= end - start;
+    if (framesRemaining_[g] > 0) {
+      positions_[g] = position;
+      windowPhases_[g] = windowPhase;
+      startFrames_[g] = 0;
+      g++;
+    } else {
+      int32_t last = --activeGrainCount_;
+      positions_[g] = positions_[last];
+      increments_[g] = increments_[last];
+      windowPhases_[g] = windowPhases_[last];
+      windowIncrements_[g] = windowIncrements_[last];
+      leftGains_[g] = leftGains_[last];
+      rightGains_[g] = rightGains_[last];
+      windowOffsets_[g] = windowOffsets_[last];
+      startFrames_[g] = startFrames_[last];
+      framesRemaining_[g] = framesRemaining_[last];
+    }
+  }
+}
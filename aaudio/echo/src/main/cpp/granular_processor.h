@@ -0,0 +1,152 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_GRANULAR_PROCESSOR_H
+#define AAUDIO_GRANULAR_PROCESSOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+constexpr int32_t kMaxGrains = 512;
+constexpr int32_t kGranularParameterCount = 7;
+
+enum class GrainWindow : int32_t {
+  Hann = 0,
+  Triangle,
+  Tukey,
+  Gaussian,
+  Count
+};
+
+/**
+ * A granular synthesis effect for the echo path. Short grains are cut from a source buffer, each
+ * with its own window, pitch, position and pan, and summed on top of the dry signal.
+ *
+ * The source is either the live input, which is recorded into a ring buffer as it passes
+ * through, or a buffer loaded with setSource. In live mode the position is how far behind the
+ * input a grain starts, with a loaded source it is an offset from a playhead which moves through
+ * the source at normal speed.
+ *
+ * Grains come from a fixed pool which is allocated in setup together with the window tables, so
+ * nothing is allocated on the audio thread. The grain state is stored as one array per field and
+ * the active grains are kept packed at the front of the arrays. Each grain is rendered into a
+ * scratch buffer and then added to the output in a loop which the compiler can vectorize.
+ *
+ * The parameters are atomics so they can be set from the UI thread while audio is running.
+ */
+class GranularProcessor {
+public:
+  /**
+   * Allocate the source, grain pool and window tables. Must not be called from the audio thread.
+   *
+   * @param sampleRate the sample rate of the audio to be processed
+   */
+  void setup(int32_t sampleRate);
+  void reset();
+
+  /**
+   * Replace the live input with a mono source buffer, or pass an empty buffer to go back to the
+   * live input. Must not be called while process may be running.
+   */
+  void setSource(const float *source, int32_t numFrames);
+
+  void setEnabled(bool isEnabled) { isEnabled_.store(isEnabled, std::memory_order_relaxed); }
+  bool isEnabled() const { return isEnabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @param density grains started per second
+   * @param grainMs length of each grain
+   * @param positionMs how far behind the input (or the playhead) grains start
+   * @param pitchSemitones pitch shift applied to every grain
+   * @param jitter randomization of grain start time, position and pitch, from 0 to 1
+   * @param spread stereo width of the grains, from 0 (centre) to 1
+   * @param mix level of the grains against the dry signal, from 0 (dry) to 1 (grains only)
+   */
+  void setParameters(float density, float grainMs, float positionMs, float pitchSemitones,
+                     float jitter, float spread, float mix);
+  // @param values receives kGranularParameterCount values, in the order setParameters takes them
+  void getParameters(float *values) const;
+  void setWindow(GrainWindow window);
+  GrainWindow getWindow() const {
+    return static_cast<GrainWindow>(window_.load(std::memory_order_relaxed));
+  }
+
+  void process(float * const *channels, int32_t channelCount, int32_t numFrames);
+
+  /**
+   * @return how many frames the grains can keep sounding for after the input has gone silent
+   */
+  int32_t getTailFrames() const;
+
+  int32_t getActiveGrainCount() const { return activeGrainCount_; }
+
+private:
+  void processChunk(float * const *channels, int32_t channelCount, int32_t offset,
+                    int32_t numFrames);
+  void writeLiveSource(float * const *channels, int32_t channelCount, int32_t offset,
+                       int32_t numFrames);
+  void scheduleGrains(int32_t numFrames);
+  void renderGrains(int32_t numFrames);
+  float nextRandom();
+
+  int32_t sampleRate_ = 0;
+
+  // Parameters, written by the UI thread
+  std::atomic<bool> isEnabled_ {false};
+  std::atomic<float> density_ {20.0f};
+  std::atomic<float> grainMs_ {80.0f};
+  std::atomic<float> positionMs_ {200.0f};
+  std::atomic<float> pitchSemitones_ {0.0f};
+  std::atomic<float> jitter_ {0.2f};
+  std::atomic<float> spread_ {0.5f};
+  std::atomic<float> mix_ {0.5f};
+  std::atomic<int32_t> window_ {static_cast<int32_t>(GrainWindow::Hann)};
+
+  // The source holds one extra guard frame, a copy of the first frame, so that interpolation
+  // never has to wrap. The live source length is a power of 2.
+  std::vector<float> liveSource_;
+  std::vector<float> loadedSource_;
+  float *source_ = nullptr;
+  int32_t sourceFrames_ = 0;
+  bool isLiveSource_ = true;
+  int32_t liveWriteIndex_ = 0;
+  float playhead_ = 0;
+
+  std::vector<float> windowTables_;
+
+  // The grain pool. Grains [0, activeGrainCount_) are playing.
+  int32_t activeGrainCount_ = 0;
+  float positions_[kMaxGrains];
+  float increments_[kMaxGrains];
+  float windowPhases_[kMaxGrains];
+  float windowIncrements_[kMaxGrains];
+  float leftGains_[kMaxGrains];
+  float rightGains_[kMaxGrains];
+  int32_t windowOffsets_[kMaxGrains];
+  int32_t startFrames_[kMaxGrains];
+  int32_t framesRemaining_[kMaxGrains];
+
+  float framesUntilNextGrain_ = 0;
+  float wetGain_ = 1.0f;
+  uint32_t randomState_ = 1;
+
+  std::vector<float> grainBuffer_;
+  std::vector<float> wetLeft_;
+  std::vector<float> wetRight_;
+};
+
+#endif //AAUDIO_GRANULAR_PROCESSOR_H
@@ -73,5 +73,223 @@ Java_com_google_sample_aaudio_echo_EchoEngine_setPlaybackDeviceId(JNIEnv *env,
   engine->setPlaybackDeviceId(deviceId);
 }
 
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setInputChannelCount(JNIEnv *env,
+                                                                   jclass, jint channelCount) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  engine->setInputChannelCount(channelCount);
+}
+
+JNIEXPORT jfloat JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_getInputGainDb(JNIEnv *env, jclass) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return 0;
+  }
+
+  return engine->getInputGainDb();
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setGranularOn(JNIEnv *env, jclass,
+                                                            jboolean isGranularOn) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  engine->setGranularOn(isGranularOn);
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setGranularParameters(JNIEnv *env, jclass,
+                                                                    jfloat density,
+                                                                    jfloat grainMs,
+                                                                    jfloat positionMs,
+                                                                    jfloat pitchSemitones,
+                                                                    jfloat jitter,
+                                                                    jfloat spread,
+                                                                    jfloat mix) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  engine->setGranularParameters(density, grainMs, positionMs, pitchSemitones, jitter, spread, mix);
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setGranularWindow(JNIEnv *env, jclass,
+                                                                jint window) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  engine->setGranularWindow(window);
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setGranularSource(JNIEnv *env, jclass,
+                                                                jfloatArray source) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  if (source == nullptr) {
+    engine->setGranularSource(nullptr, 0);
+    return;
+  }
+  jsize numFrames = env->GetArrayLength(source);
+  jfloat *samples = env->GetFloatArrayElements(source, nullptr);
+  engine->setGranularSource(samples, numFrames);
+  env->ReleaseFloatArrayElements(source, samples, JNI_ABORT);
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setMeasurementOn(JNIEnv *env, jclass,
+                                                               jboolean isMeasurementOn) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  engine->setMeasurementOn(isMeasurementOn);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_isMeasurementComplete(JNIEnv *env, jclass) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return JNI_FALSE;
+  }
+
+  return static_cast<jboolean>(engine->isMeasurementComplete());
+}
+
+/**
+ * @return the measurement results as JSON, or null if the measurement isn't complete or failed
+ */
+JNIEXPORT jstring JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_getMeasurementResults(JNIEnv *env, jclass) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return nullptr;
+  }
+
+  MeasurementResults results;
+  if (!engine->getMeasurementResults(&results)) return nullptr;
+  return env->NewStringUTF(results.toJson().c_str());
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setGlitchMonitorOn(JNIEnv *env, jclass,
+                                                                 jboolean isGlitchMonitorOn) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  engine->setGlitchMonitorOn(isGlitchMonitorOn);
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setGlitchTestTone(JNIEnv *env, jclass,
+                                                                jfloat frequency) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  engine->setGlitchTestTone(frequency);
+}
+
+/**
+ * @return the glitches found since echo was last turned on with the monitor on, as JSON
+ */
+JNIEXPORT jstring JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_getGlitchReport(JNIEnv *env, jclass) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return nullptr;
+  }
+
+  return env->NewStringUTF(engine->getGlitchReport().c_str());
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_setSessionLogPath(JNIEnv *env, jclass,
+                                                                jstring path) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return;
+  }
+
+  if (path == nullptr) {
+    engine->setSessionLogPath("");
+    return;
+  }
+  const char *chars = env->GetStringUTFChars(path, nullptr);
+  engine->setSessionLogPath(chars);
+  env->ReleaseStringUTFChars(path, chars);
+}
+
+/**
+ * @return the replay timings and whether the output matched, as JSON, or null if the log
+ * couldn't be replayed
+ */
+JNIEXPORT jstring JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_replaySession(JNIEnv *env, jclass, jstring path,
+                                                            jboolean isRealTime) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return nullptr;
+  }
+
+  const char *chars = env->GetStringUTFChars(path, nullptr);
+  std::string logPath(chars);
+  env->ReleaseStringUTFChars(path, chars);
+
+  SessionReplayResults results;
+  if (!engine->replaySession(logPath, isRealTime, &results)) return nullptr;
+  return env->NewStringUTF(results.toJson().c_str());
+}
+
+/**
+ * Try the stream configurations and use the best from now on. Blocks for a few seconds, so call
+ * it from a background thread while echo is off.
+ *
+ * @return every configuration's results and the selected one, as JSON, or null if none worked
+ */
+JNIEXPORT jstring JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_probeStreams(JNIEnv *env, jclass) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return nullptr;
+  }
+
+  StreamProbeResults results;
+  if (!engine->probeStreamConfigurations(&results)) return nullptr;
+  return env->NewStringUTF(results.toJson().c_str());
+}
+
+/**
+ * @return the stream configuration in use, what the open streams were granted and the last probe,
+ * as JSON
+ */
+JNIEXPORT jstring JNICALL
+Java_com_google_sample_aaudio_echo_EchoEngine_getStreamReport(JNIEnv *env, jclass) {
+  if (engine == nullptr) {
+    LOGE("Engine is null, you must call createEngine before calling this method");
+    return nullptr;
+  }
+
+  return env->NewStringUTF(engine->getStreamReport().c_str());
+}
 
 }
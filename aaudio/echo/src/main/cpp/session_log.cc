@@ -0,0 +1,262 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <logging_macros.h>
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <audio_common.h>
+#include "session_log.h"
+
+// The writer wakes often enough that the ring only ever holds a fraction of its capacity
+constexpr int32_t kWriterPeriodMs = 20;
+
+uint32_t SessionChecksum(const void *data, int32_t numBytes) {
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  uint32_t hash = 2166136261u;
+  for (int32_t i = 0; i < numBytes; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+SessionRecorder::~SessionRecorder() {
+  stop();
+}
+
+bool SessionRecorder::start(const std::string &path, const SessionHeader &header,
+                            const float *granularSource, int32_t ringBytes) {
+
+  stop();
+  file_ = fopen(path.c_str(), "wb");
+  if (file_ == nullptr) {
+    LOGE("Unable to create session log %s", path.c_str());
+    return false;
+  }
+  fwrite(&header, sizeof(header), 1, file_);
+  if (header.granularSourceFrames > 0) {
+    fwrite(granularSource, sizeof(float), header.granularSourceFrames, file_);
+  }
+
+  ring_.assign(ringBytes, 0);
+  writePosition_.store(0);
+  readPosition_.store(0);
+  isOverflowed_.store(false);
+  isRecording_.store(true, std::memory_order_release);
+  writerThread_ = std::thread(&SessionRecorder::writeToFile, this);
+  return true;
+}
+
+/**
+ * Write out whatever is left and close the log. Must not be called while the audio thread may be
+ * recording.
+ */
+void SessionRecorder::stop() {
+
+  if (!isRecording_.exchange(false)) return;
+  writerThread_.join();
+  fclose(file_);
+  file_ = nullptr;
+  if (isOverflowed_.load()) {
+    LOGE("The session log couldn't be written fast enough and was cut short");
+  }
+}
+
+bool SessionRecorder::isRecording() const {
+  return isRecording_.load(std::memory_order_acquire);
+}
+
+void SessionRecorder::recordControl(int64_t framePosition, const ControlEvent &event) {
+
+  SessionRecordHeader record = {SESSION_RECORD_CONTROL, sizeof(event), framePosition};
+  append(record, &event, sizeof(event), nullptr, 0);
+}
+
+void SessionRecorder::recordCallback(int64_t framePosition, const SessionCallback &callback,
+                                     const void *input, int32_t inputBytes) {
+
+  SessionRecordHeader record = {SESSION_RECORD_CALLBACK,
+                                static_cast<int32_t>(sizeof(callback)) + inputBytes,
+                                framePosition};
+  append(record, &callback, sizeof(callback), input, inputBytes);
+}
+
+/**
+ * Add a whole record to the ring, or nothing at all.
+ */
+void SessionRecorder::append(const SessionRecordHeader &record, const void *payload,
+                             int32_t payloadBytes, const void *extra, int32_t extraBytes) {
+
+  if (!isRecording() || isOverflowed_.load(std::memory_order_relaxed)) return;
+
+  int64_t writePosition = writePosition_.load(std::memory_order_relaxed);
+  int64_t readPosition = readPosition_.load(std::memory_order_acquire);
+  int32_t recordBytes = sizeof(record) + payloadBytes + extraBytes;
+  if (writePosition + recordBytes - readPosition > static_cast<int64_t>(ring_.size())) {
+    isOverflowed_.store(true, std::memory_order_relaxed);
+    return;
+  }
+  copyIn(writePosition, &record, sizeof(record));
+  copyIn(writePosition + sizeof(record), payload, payloadBytes);
+  copyIn(writePosition + sizeof(record) + payloadBytes, extra, extraBytes);
+  writePosition_.store(writePosition + recordBytes, std::memory_order_release);
+}
+
+void SessionRecorder::copyIn(int64_t position, const void *data, int32_t numBytes) {
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  int32_t offset = static_cast<int32_t>(position % ring_.size());
+  int32_t firstBytes = std::min(numBytes, static_cast<int32_t>(ring_.size()) - offset);
+  memcpy(&ring_[offset], bytes, firstBytes);
+  memcpy(&ring_[0], bytes + firstBytes, numBytes - firstBytes);
+}
+
+void SessionRecorder::writeToFile() {
+
+  while (isRecording()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kWriterPeriodMs));
+    flush();
+  }
+  flush();
+}
+
+void SessionRecorder::flush() {
+
+  int64_t readPosition = readPosition_.load(std::memory_order_relaxed);
+  int64_t writePosition = writePosition_.load(std::memory_order_acquire);
+  int64_t numBytes = writePosition - readPosition;
+  if (numBytes == 0) return;
+
+  size_t offset = static_cast<size_t>(readPosition % ring_.size());
+  size_t firstBytes = std::min(static_cast<size_t>(numBytes), ring_.size() - offset);
+  fwrite(&ring_[offset], 1, firstBytes, file_);
+  fwrite(&ring_[0], 1, numBytes - firstBytes, file_);
+  readPosition_.store(writePosition, std::memory_order_release);
+}
+
+SessionReader::~SessionReader() {
+  if (file_ != nullptr) fclose(file_);
+}
+
+bool SessionReader::open(const std::string &path) {
+
+  if (file_ != nullptr) fclose(file_);
+  file_ = fopen(path.c_str(), "rb");
+  if (file_ == nullptr) {
+    LOGE("Unable to open session log %s", path.c_str());
+    return false;
+  }
+  if (fread(&header_, sizeof(header_), 1, file_) != 1 ||
+      memcmp(header_.magic, kSessionLogMagic, sizeof(kSessionLogMagic)) != 0) {
+    LOGE("%s is not a session log", path.c_str());
+    return false;
+  }
+  if (!isHeaderValid()) {
+    LOGE("Session log %s has invalid stream settings", path.c_str());
+    return false;
+  }
+  isCorrupt_ = false;
+  long sourceStart = ftell(file_);
+  if (fseek(file_, 0, SEEK_END) != 0 ||
+      (ftell(file_) - sourceStart) / static_cast<long>(sizeof(float)) <
+      header_.granularSourceFrames || fseek(file_, sourceStart, SEEK_SET) != 0) {
+    LOGE("Session log %s is truncated", path.c_str());
+    return false;
+  }
+  granularSource_.resize(header_.granularSourceFrames);
+  if (fread(granularSource_.data(), sizeof(float), granularSource_.size(), file_) !=
+      granularSource_.size()) {
+    LOGE("Session log %s is truncated", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SessionReader::isHeaderValid() const {
+
+  auto isFormatValid = [](int32_t format) {
+    return format == AAUDIO_FORMAT_PCM_I16 || format == AAUDIO_FORMAT_PCM_FLOAT;
+  };
+  auto isChannelCountValid = [](int32_t channelCount) {
+    return channelCount >= 1 && channelCount <= kMaxInputChannelCount;
+  };
+  // A callback can't be asked for more than a second of audio
+  return header_.sampleRate > 0 && header_.framesPerBurst > 0 &&
+         header_.maxFramesPerCallback > 0 && header_.maxFramesPerCallback <= header_.sampleRate &&
+         isFormatValid(header_.inputFormat) && isFormatValid(header_.outputFormat) &&
+         isChannelCountValid(header_.inputChannelCount) &&
+         isChannelCountValid(header_.outputChannelCount) && header_.granularSourceFrames >= 0;
+}
+
+/**
+ * Whether a callback can be rendered into buffers sized from the header: the engine renders
+ * framesToRead frames in measurement mode and frameCount otherwise, and copies the input into a
+ * buffer of maxFramesPerCallback frames. A negative frameCount is a read error, recorded with no
+ * input.
+ */
+bool SessionReader::isCallbackValid(const SessionCallback &callback, size_t inputBytes) const {
+
+  int32_t bytesPerInputFrame = header_.inputChannelCount *
+                               (SampleFormatToBpp(header_.inputFormat) / 8);
+  return callback.numFrames > 0 && callback.numFrames <= header_.maxFramesPerCallback &&
+         callback.framesToRead >= 0 && callback.framesToRead <= callback.numFrames &&
+         callback.frameCount <= callback.framesToRead &&
+         inputBytes == static_cast<size_t>(std::max(callback.frameCount, 0)) * bytesPerInputFrame;
+}
+
+bool SessionReader::next(SessionRecordHeader *record, ControlEvent *control,
+                         SessionCallback *callback, std::vector<uint8_t> *input) {
+
+  while (file_ != nullptr && fread(record, sizeof(*record), 1, file_) == 1) {
+    switch (record->type) {
+      case SESSION_RECORD_CONTROL:
+        if (record->payloadBytes != sizeof(*control)) return setCorrupt(*record);
+        return fread(control, sizeof(*control), 1, file_) == 1;
+      case SESSION_RECORD_CALLBACK: {
+        int32_t inputBytes = record->payloadBytes - static_cast<int32_t>(sizeof(*callback));
+        if (inputBytes < 0) return setCorrupt(*record);
+        if (fread(callback, sizeof(*callback), 1, file_) != 1) return false;
+        if (!isCallbackValid(*callback, inputBytes)) return setCorrupt(*record);
+        input->resize(inputBytes);
+        return fread(input->data(), 1, inputBytes, file_) == static_cast<size_t>(inputBytes);
+      }
+      default:
+        if (record->payloadBytes < 0) return setCorrupt(*record);
+        if (fseek(file_, record->payloadBytes, SEEK_CUR) != 0) return false;
+    }
+  }
+  return false;
+}
+
+bool SessionReader::setCorrupt(const SessionRecordHeader &record) {
+  LOGE("Session log record at frame %" PRId64 " is corrupt", record.framePosition);
+  isCorrupt_ = true;
+  return false;
+}
+
+std::string SessionReplayResults::toJson() const {
+
+  char json[512];
+  snprintf(json, sizeof(json),
+           "{\"callbacks\":%d,\"controlEvents\":%d,\"mismatchedCallbacks\":%d,"
+           "\"firstMismatchFrame\":%" PRId64 ",\"sessionSeconds\":%.3f,\"replaySeconds\":%.3f,"
+           "\"renderSeconds\":%.6f,\"maxCallbackRenderUs\":%.1f}",
+           callbackCount, controlEventCount, mismatchedCallbackCount, firstMismatchFramePosition,
+           sessionSeconds, replaySeconds, renderSeconds, maxCallbackRenderUs);
+  return json;
+}
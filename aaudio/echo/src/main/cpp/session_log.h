@@ -0,0 +1,192 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_SESSION_LOG_H
+#define AAUDIO_SESSION_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * A session log holds everything the echo engine's render work depends on while echo is on, so
+ * that a session from the field can be replayed offline, bit for bit, under a profiler.
+ *
+ * The log is a SessionHeader, followed by the granular source if one was loaded, followed by
+ * records. Each record is a SessionRecordHeader followed by its payload:
+ *
+ *   SESSION_RECORD_CONTROL   a ControlEvent, applied before the callback at framePosition
+ *   SESSION_RECORD_CALLBACK  a SessionCallback, followed by the input read during the callback in
+ *                            the recording stream's format
+ *
+ * Everything is written in the byte order of the device that recorded it.
+ */
+
+constexpr char kSessionLogMagic[8] = {'E', 'C', 'H', 'O', 'L', 'O', 'G', '1'};
+constexpr int32_t kMaxControlValues = 7;
+
+enum ControlEventType : int32_t {
+  CONTROL_GRANULAR_ON,          // values[0] is non-zero for on
+  CONTROL_GRANULAR_PARAMETERS,  // values are as GranularProcessor::setParameters takes them
+  CONTROL_GRANULAR_WINDOW,      // values[0] is the GrainWindow
+  CONTROL_EVENT_TYPE_COUNT,
+};
+
+struct ControlEvent {
+  int32_t type;
+  float values[kMaxControlValues];
+};
+
+struct SessionHeader {
+  char magic[8];
+  int32_t sampleRate;
+  int32_t framesPerBurst;
+  int32_t maxFramesPerCallback;
+  int32_t inputFormat;
+  int32_t inputChannelCount;
+  int32_t outputFormat;
+  int32_t outputChannelCount;
+  int32_t isMeasurementOn;
+  int32_t granularSourceFrames;  // the number of floats which follow the header
+};
+
+enum SessionRecordType : int32_t {
+  SESSION_RECORD_CONTROL = 1,
+  SESSION_RECORD_CALLBACK = 2,
+};
+
+struct SessionRecordHeader {
+  int32_t type;
+  int32_t payloadBytes;   // records of unknown types can be skipped
+  int64_t framePosition;  // playback frames written before the callback
+};
+
+struct SessionCallback {
+  int64_t timestampNs;      // when the callback started, on CLOCK_MONOTONIC
+  int32_t numFrames;        // asked for by the playback stream
+  int32_t framesToRead;     // asked of the recording stream
+  int32_t frameCount;       // what the read returned, which may be an error
+  uint32_t outputChecksum;  // of everything written to the playback stream
+};
+
+// FNV-1a, cheap enough to run over every callback's output on the audio thread
+uint32_t SessionChecksum(const void *data, int32_t numBytes);
+
+/**
+ * Writes a session log. The audio thread appends records to a lock free ring and a thread of
+ * the recorder's own writes them to the file, so the audio thread never touches the file.
+ *
+ * If the writer falls so far behind that a record doesn't fit in the ring, recording stops at
+ * the last complete record, so the log still replays up to that point.
+ */
+class SessionRecorder {
+public:
+  ~SessionRecorder();
+
+  /**
+   * Create the log and write its header. Must not be called from the audio thread.
+   *
+   * @param ringBytes how much can be buffered between the audio thread and the file
+   * @return false if the log couldn't be created
+   */
+  bool start(const std::string &path, const SessionHeader &header, const float *granularSource,
+             int32_t ringBytes);
+  void stop();
+  bool isRecording() const;
+
+  // Called from the audio thread, or before it starts
+  void recordControl(int64_t framePosition, const ControlEvent &event);
+  void recordCallback(int64_t framePosition, const SessionCallback &callback, const void *input,
+                      int32_t inputBytes);
+
+private:
+  void append(const SessionRecordHeader &record, const void *payload, int32_t payloadBytes,
+              const void *extra, int32_t extraBytes);
+  void copyIn(int64_t position, const void *data, int32_t numBytes);
+  void writeToFile();
+  void flush();
+
+  FILE *file_ = nullptr;
+  std::vector<uint8_t> ring_;
+
+  // Byte counts since the start, which only ever go up
+  std::atomic<int64_t> writePosition_{0};
+  std::atomic<int64_t> readPosition_{0};
+
+  std::atomic<bool> isRecording_{false};
+  std::atomic<bool> isOverflowed_{false};
+  std::thread writerThread_;
+};
+
+/**
+ * Reads back a log written by SessionRecorder.
+ */
+class SessionReader {
+public:
+  ~SessionReader();
+
+  /**
+   * @return false if the file can't be opened, isn't a session log, or its stream settings
+   * aren't ones the engine could have run with
+   */
+  bool open(const std::string &path);
+  const SessionHeader &getHeader() const { return header_; }
+  const std::vector<float> &getGranularSource() const { return granularSource_; }
+
+  /**
+   * Read the next control event or callback.
+   *
+   * @param input receives the callback's input
+   * @return false at the end of the log, which may be cut short if recording was, or at a
+   * record which is corrupt
+   */
+  bool next(SessionRecordHeader *record, ControlEvent *control, SessionCallback *callback,
+            std::vector<uint8_t> *input);
+
+  // Whether next stopped at a corrupt record rather than the end of the log
+  bool isCorrupt() const { return isCorrupt_; }
+
+private:
+  bool isHeaderValid() const;
+  bool isCallbackValid(const SessionCallback &callback, size_t inputBytes) const;
+  bool setCorrupt(const SessionRecordHeader &record);
+
+  FILE *file_ = nullptr;
+  bool isCorrupt_ = false;
+  SessionHeader header_;
+  std::vector<float> granularSource_;
+};
+
+struct SessionReplayResults {
+  int32_t callbackCount = 0;
+  int32_t controlEventCount = 0;
+
+  // Callbacks whose output didn't match what was recorded, and the frame position of the first
+  int32_t mismatchedCallbackCount = 0;
+  int64_t firstMismatchFramePosition = -1;
+
+  double sessionSeconds = 0;  // between the first and last callbacks when recorded
+  double replaySeconds = 0;   // wall clock time of the replay
+  double renderSeconds = 0;   // time spent rendering callbacks
+  double maxCallbackRenderUs = 0;
+
+  std::string toJson() const;
+};
+
+#endif //AAUDIO_SESSION_LOG_H
@@ -0,0 +1,356 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <logging_macros.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <audio_common.h>
+#include "stream_prober.h"
+
+// Each configuration runs for a settling period, which isn't scored because streams often
+// underrun as they start, then for the window which is. Both are counted in frames rather than
+// time so that a probe against the host stand-in, which runs faster than real time, sees the
+// same amount of audio.
+constexpr int32_t kProbeSettleMs = 100;
+constexpr int32_t kProbeWindowMs = 400;
+
+// A configuration whose callbacks stop, e.g. because the device went away, is abandoned
+constexpr int32_t kProbeTimeoutMs = 2000;
+constexpr int32_t kProbePollMs = 5;
+
+// Score penalties, in milliseconds of latency. A stream which underran during the window is
+// likely to glitch again even with the bigger buffer, and one which isn't on the low latency
+// path has no headroom for the effects.
+constexpr double kXRunPenaltyMs = 10.0;
+constexpr double kNotLowLatencyPenaltyMs = 20.0;
+
+// Scores closer than this are a tie, which goes to the configuration that is ranked higher
+constexpr double kScoreToleranceMs = 0.5;
+
+constexpr int32_t kProbeSampleRate = 48000;
+
+static aaudio_data_callback_result_t probeDataCallback(AAudioStream *stream __unused,
+                                                       void *userData,
+                                                       void *audioData,
+                                                       int32_t numFrames) {
+  return static_cast<StreamProber *>(userData)->dataCallback(audioData, numFrames);
+}
+
+const char *SharingModeToString(aaudio_sharing_mode_t sharingMode) {
+  return (sharingMode == AAUDIO_SHARING_MODE_EXCLUSIVE) ? "exclusive" : "shared";
+}
+
+const char *SampleFormatToString(aaudio_format_t format) {
+  switch (format) {
+    case AAUDIO_FORMAT_PCM_I16: return "i16";
+    case AAUDIO_FORMAT_PCM_FLOAT: return "float";
+    default: return "unspecified";
+  }
+}
+
+const char *PerformanceModeToString(aaudio_performance_mode_t performanceMode) {
+  switch (performanceMode) {
+    case AAUDIO_PERFORMANCE_MODE_LOW_LATENCY: return "lowLatency";
+    case AAUDIO_PERFORMANCE_MODE_POWER_SAVING: return "powerSaving";
+    default: return "none";
+  }
+}
+
+std::vector<StreamConfiguration> StreamProber::getConfigurations() {
+  return {
+      {AAUDIO_SHARING_MODE_EXCLUSIVE, AAUDIO_FORMAT_PCM_FLOAT, kStereoChannelCount,
+       AAUDIO_UNSPECIFIED},
+      {AAUDIO_SHARING_MODE_EXCLUSIVE, AAUDIO_FORMAT_PCM_I16, kStereoChannelCount,
+       AAUDIO_UNSPECIFIED},
+      {AAUDIO_SHARING_MODE_EXCLUSIVE, AAUDIO_FORMAT_PCM_FLOAT, kStereoChannelCount,
+       kProbeSampleRate},
+      {AAUDIO_SHARING_MODE_SHARED, AAUDIO_FORMAT_PCM_FLOAT, kStereoChannelCount,
+       AAUDIO_UNSPECIFIED},
+      {AAUDIO_SHARING_MODE_SHARED, AAUDIO_FORMAT_PCM_I16, kStereoChannelCount,
+       AAUDIO_UNSPECIFIED},
+      {AAUDIO_SHARING_MODE_SHARED, AAUDIO_FORMAT_PCM_FLOAT, kMonoChannelCount,
+       AAUDIO_UNSPECIFIED},
+      {AAUDIO_SHARING_MODE_SHARED, AAUDIO_FORMAT_PCM_FLOAT, kStereoChannelCount,
+       kProbeSampleRate},
+  };
+}
+
+bool StreamProber::probe(int32_t recordingDeviceId, int32_t playbackDeviceId,
+                         int32_t inputChannelCount, StreamProbeResults *results) {
+
+  recordingDeviceId_ = recordingDeviceId;
+  playbackDeviceId_ = playbackDeviceId;
+  inputChannelCount_ = inputChannelCount;
+
+  results->configurations.clear();
+  results->selectedIndex = -1;
+  for (const StreamConfiguration &configuration : getConfigurations()) {
+    StreamProbeResult result;
+    probeConfiguration(configuration, &result);
+    bool isUsable = result.isOpened && result.callbackCount > 0;
+    int32_t selected = results->selectedIndex;
+    if (isUsable && (selected < 0 ||
+        result.score < results->configurations[selected].score - kScoreToleranceMs)) {
+      results->selectedIndex = static_cast<int32_t>(results->configurations.size());
+    }
+    results->configurations.push_back(result);
+  }
+  return results->selectedIndex >= 0;
+}
+
+AAudioStream *StreamProber::openStream(const StreamConfiguration &configuration,
+                                       aaudio_direction_t direction, int32_t sampleRate,
+                                       aaudio_format_t format) {
+
+  AAudioStreamBuilder *builder = nullptr;
+  aaudio_result_t result = AAudio_createStreamBuilder(&builder);
+  if (result != AAUDIO_OK || builder == nullptr) {
+    LOGE("Error creating stream builder: %s", AAudio_convertResultToText(result));
+    return nullptr;
+  }
+
+  bool isInput = direction == AAUDIO_DIRECTION_INPUT;
+  AAudioStreamBuilder_setDeviceId(builder, isInput ? recordingDeviceId_ : playbackDeviceId_);
+  AAudioStreamBuilder_setDirection(builder, direction);
+  AAudioStreamBuilder_setSampleRate(builder, sampleRate);
+  AAudioStreamBuilder_setChannelCount(builder, isInput ? inputChannelCount_ :
+                                               configuration.outputChannelCount);
+  AAudioStreamBuilder_setFormat(builder, format);
+  AAudioStreamBuilder_setSharingMode(builder, configuration.sharingMode);
+  AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+  if (!isInput) AAudioStreamBuilder_setDataCallback(builder, ::probeDataCallback, this);
+
+  AAudioStream *stream = nullptr;
+  result = AAudioStreamBuilder_openStream(builder, &stream);
+  if (result != AAUDIO_OK) {
+    LOGW("Probe couldn't open a %s stream: %s", isInput ? "recording" : "playback",
+         AAudio_convertResultToText(result));
+    stream = nullptr;
+  }
+  AAudioStreamBuilder_delete(builder);
+  return stream;
+}
+
+/**
+ * Open and run one configuration. The streams are opened the way the engine opens them, the
+ * playback stream first and then the recording stream with the playback stream's sample rate and
+ * format.
+ */
+void StreamProber::probeConfiguration(const StreamConfiguration &configuration,
+                                      StreamProbeResult *result) {
+
+  result->requested = configuration;
+  playStream_ = openStream(configuration, AAUDIO_DIRECTION_OUTPUT, configuration.sampleRate,
+                           configuration.format);
+  if (playStream_ == nullptr) return;
+
+  int32_t sampleRate = AAudioStream_getSampleRate(playStream_);
+  aaudio_format_t format = AAudioStream_getFormat(playStream_);
+  recordingStream_ = openStream(configuration, AAUDIO_DIRECTION_INPUT, sampleRate, format);
+  if (recordingStream_ == nullptr) {
+    AAudioStream_close(playStream_);
+    playStream_ = nullptr;
+    return;
+  }
+
+  result->isOpened = true;
+  result->sharingMode = AAudioStream_getSharingMode(playStream_);
+  result->performanceMode = AAudioStream_getPerformanceMode(playStream_);
+  result->format = format;
+  result->outputChannelCount = AAudioStream_getChannelCount(playStream_);
+  result->sampleRate = sampleRate;
+  result->isMMap = result->sharingMode == AAUDIO_SHARING_MODE_EXCLUSIVE &&
+                   AAudioStream_getSharingMode(recordingStream_) == AAUDIO_SHARING_MODE_EXCLUSIVE;
+  if (AAudioStream_getPerformanceMode(recordingStream_) != AAUDIO_PERFORMANCE_MODE_LOW_LATENCY) {
+    result->performanceMode = AAudioStream_getPerformanceMode(recordingStream_);
+  }
+  result->framesPerBurst = AAudioStream_getFramesPerBurst(playStream_);
+
+  sampleRate_ = sampleRate;
+  framesPerBurst_ = result->framesPerBurst;
+  bufferCapacity_ = AAudioStream_getBufferCapacityInFrames(playStream_);
+  bufferSize_ = AAudioStream_getBufferSizeInFrames(playStream_);
+  setBufferSize(framesPerBurst_);
+  bytesPerOutputFrame_ = result->outputChannelCount * (SampleFormatToBpp(format) / 8);
+  int32_t bytesPerInputFrame = AAudioStream_getChannelCount(recordingStream_) *
+                               (SampleFormatToBpp(AAudioStream_getFormat(recordingStream_)) / 8);
+  inputBufferFrames_ = bufferCapacity_;
+  inputBuffer_.assign(inputBufferFrames_ * bytesPerInputFrame, 0);
+  settleFrames_ = static_cast<int64_t>(sampleRate) * kProbeSettleMs / 1000;
+  endFrames_ = settleFrames_ + static_cast<int64_t>(sampleRate) * kProbeWindowMs / 1000;
+  framesRendered_ = 0;
+  lastCallbackNs_ = 0;
+  isInWindow_ = false;
+  windowCallbackCount_ = 0;
+  maxCallbackIntervalNs_ = 0;
+  xRunsAtWindowStart_ = 0;
+  lastOutputXRuns_ = 0;
+  latencySumMs_ = 0;
+  latencyCount_ = 0;
+  isWindowComplete_ = false;
+
+  AAudioStream_requestStart(recordingStream_);
+  AAudioStream_requestStart(playStream_);
+  auto timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(kProbeTimeoutMs);
+  while (!isWindowComplete_ && std::chrono::steady_clock::now() < timeout) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kProbePollMs));
+  }
+  AAudioStream_requestStop(playStream_);
+  AAudioStream_requestStop(recordingStream_);
+
+  if (isWindowComplete_) {
+    result->bufferSizeFrames = bufferSize_;
+    result->callbackCount = windowCallbackCount_;
+    result->maxCallbackIntervalMs = maxCallbackIntervalNs_ * 1e-6;
+    result->xRunCount = AAudioStream_getXRunCount(playStream_) +
+                        AAudioStream_getXRunCount(recordingStream_) - xRunsAtWindowStart_;
+    result->isLatencyMeasured = latencyCount_ > 0;
+    if (result->isLatencyMeasured) {
+      result->latencyMs = latencySumMs_ / latencyCount_;
+    } else {
+      // Without timestamps, assume a full playback buffer and a burst waiting to be recorded
+      result->latencyMs = (bufferSize_ + framesPerBurst_) * 1000.0 / sampleRate;
+    }
+    result->score = result->latencyMs + result->xRunCount * kXRunPenaltyMs +
+                    ((result->performanceMode == AAUDIO_PERFORMANCE_MODE_LOW_LATENCY) ?
+                     0 : kNotLowLatencyPenaltyMs);
+  } else {
+    LOGW("Probe callbacks stopped before the window was complete");
+  }
+
+  AAudioStream_close(playStream_);
+  AAudioStream_close(recordingStream_);
+  playStream_ = nullptr;
+  recordingStream_ = nullptr;
+
+  LOGI("Probed %s %s %d channel(s) at %d Hz: %s, burst %d, buffer %d, %d xrun(s), %.1f ms",
+       SharingModeToString(configuration.sharingMode), SampleFormatToString(configuration.format),
+       configuration.outputChannelCount, configuration.sampleRate,
+       SharingModeToString(result->sharingMode), result->framesPerBurst,
+       result->bufferSizeFrames, result->xRunCount, result->latencyMs);
+}
+
+/**
+ * Ask for a new playback buffer size, which the stream may round. If it refuses, the buffer keeps
+ * the size it had.
+ */
+void StreamProber::setBufferSize(int32_t numFrames) {
+
+  aaudio_result_t result = AAudioStream_setBufferSizeInFrames(playStream_, numFrames);
+  if (result < 0) {
+    LOGE("Probe couldn't set the buffer to %d frames: %s", numFrames,
+         AAudio_convertResultToText(result));
+    return;
+  }
+  bufferSize_ = result;
+}
+
+/**
+ * Plays silence and keeps the recording stream drained, as the engine would. Once the streams
+ * have settled each callback is timed, the playback buffer is grown if it has underrun and the
+ * latency is taken from the timestamps. The window is measured here rather than on another thread
+ * so that it's the same number of callbacks however fast they come, and the stream stops itself
+ * at the end.
+ */
+aaudio_data_callback_result_t StreamProber::dataCallback(void *audioData, int32_t numFrames) {
+
+  int32_t framesToRead = (numFrames < inputBufferFrames_) ? numFrames : inputBufferFrames_;
+  AAudioStream_read(recordingStream_, inputBuffer_.data(), framesToRead, static_cast<int64_t>(0));
+  memset(audioData, 0, static_cast<size_t>(numFrames) * bytesPerOutputFrame_);
+  framesRendered_ += numFrames;
+
+  int64_t nowNs = get_time_nanoseconds(CLOCK_MONOTONIC);
+  int32_t outputXRuns = AAudioStream_getXRunCount(playStream_);
+  if (!isInWindow_) {
+    if (framesRendered_ >= settleFrames_) {
+      isInWindow_ = true;
+      xRunsAtWindowStart_ = outputXRuns + AAudioStream_getXRunCount(recordingStream_);
+      lastOutputXRuns_ = outputXRuns;
+      lastCallbackNs_ = nowNs;
+    }
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+  }
+
+  windowCallbackCount_++;
+  maxCallbackIntervalNs_ = std::max(maxCallbackIntervalNs_, nowNs - lastCallbackNs_);
+  lastCallbackNs_ = nowNs;
+
+  // Underruns mean the buffer is too small to cover the callback's scheduling jitter
+  if (outputXRuns > lastOutputXRuns_ && bufferSize_ < bufferCapacity_) {
+    setBufferSize(bufferSize_ + framesPerBurst_);
+  }
+  lastOutputXRuns_ = outputXRuns;
+
+  // The frame about to be written is heard once the frames ahead of it have been presented, and
+  // a frame arriving now is read once the frames before it have been
+  int64_t framePosition;
+  int64_t timeNs;
+  if (AAudioStream_getTimestamp(playStream_, CLOCK_MONOTONIC, &framePosition, &timeNs) ==
+      AAUDIO_OK) {
+    double outputMs = (AAudioStream_getFramesWritten(playStream_) - framePosition) * 1000.0 /
+                      sampleRate_ + (timeNs - nowNs) * 1e-6;
+    if (AAudioStream_getTimestamp(recordingStream_, CLOCK_MONOTONIC, &framePosition, &timeNs) ==
+        AAUDIO_OK) {
+      double inputMs = (framePosition - AAudioStream_getFramesRead(recordingStream_)) * 1000.0 /
+                       sampleRate_ + (nowNs - timeNs) * 1e-6;
+      latencySumMs_ += outputMs + inputMs;
+      latencyCount_++;
+    }
+  }
+
+  if (framesRendered_ >= endFrames_) {
+    isWindowComplete_ = true;
+    return AAUDIO_CALLBACK_RESULT_STOP;
+  }
+  return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+std::string StreamProbeResults::toJson() const {
+
+  char number[512];
+  std::string json = "{\"configurations\":[";
+  for (size_t i = 0; i < configurations.size(); i++) {
+    const StreamProbeResult &result = configurations[i];
+    snprintf(number, sizeof(number),
+             "%s{\"requested\":{\"sharingMode\":\"%s\",\"format\":\"%s\",\"channelCount\":%d,"
+             "\"sampleRate\":%d},\"opened\":%s",
+             (i > 0) ? "," : "", SharingModeToString(result.requested.sharingMode),
+             SampleFormatToString(result.requested.format), result.requested.outputChannelCount,
+             result.requested.sampleRate, result.isOpened ? "true" : "false");
+    json.append(number);
+    if (result.isOpened) {
+      snprintf(number, sizeof(number),
+               ",\"sharingMode\":\"%s\",\"performanceMode\":\"%s\",\"format\":\"%s\","
+               "\"channelCount\":%d,\"sampleRate\":%d,\"mmap\":%s,\"framesPerBurst\":%d,"
+               "\"bufferSizeFrames\":%d,\"callbacks\":%d,\"maxCallbackIntervalMs\":%.2f,"
+               "\"xRunCount\":%d,\"latencyMs\":%.2f,\"latencyMeasured\":%s,\"score\":%.2f",
+               SharingModeToString(result.sharingMode),
+               PerformanceModeToString(result.performanceMode), SampleFormatToString(result.format),
+               result.outputChannelCount, result.sampleRate, result.isMMap ? "true" : "false",
+               result.framesPerBurst, result.bufferSizeFrames, result.callbackCount,
+               result.maxCallbackIntervalMs, result.xRunCount, result.latencyMs,
+               result.isLatencyMeasured ? "true" : "false", result.score);
+      json.append(number);
+    }
+    json.append("}");
+  }
+  snprintf(number, sizeof(number), "],\"selected\":%d}", selectedIndex);
+  json.append(number);
+  return json;
+}
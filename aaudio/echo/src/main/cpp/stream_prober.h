@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_STREAM_PROBER_H
+#define AAUDIO_STREAM_PROBER_H
+
+#include <aaudio/AAudio.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Short names for the stream settings, as used in the JSON reports
+const char *SharingModeToString(aaudio_sharing_mode_t sharingMode);
+const char *SampleFormatToString(aaudio_format_t format);
+const char *PerformanceModeToString(aaudio_performance_mode_t performanceMode);
+
+// What to ask for when opening the echo streams. A sample rate of AAUDIO_UNSPECIFIED takes the
+// device's native rate.
+struct StreamConfiguration {
+  aaudio_sharing_mode_t sharingMode;
+  aaudio_format_t format;
+  int32_t outputChannelCount;
+  int32_t sampleRate;
+};
+
+// What a configuration was granted and how its streams behaved over the probe window
+struct StreamProbeResult {
+  StreamConfiguration requested;
+  bool isOpened = false;
+  aaudio_sharing_mode_t sharingMode = AAUDIO_SHARING_MODE_SHARED;
+  aaudio_performance_mode_t performanceMode = AAUDIO_PERFORMANCE_MODE_NONE;
+  aaudio_format_t format = AAUDIO_FORMAT_UNSPECIFIED;
+  int32_t outputChannelCount = 0;
+  int32_t sampleRate = 0;
+
+  // AAudio only grants exclusive streams on the MMAP path, it doesn't otherwise tell apps
+  bool isMMap = false;
+
+  int32_t framesPerBurst = 0;
+  int32_t bufferSizeFrames = 0;   // after growing it to stop any underruns
+  int32_t callbackCount = 0;
+  double maxCallbackIntervalMs = 0;
+  int32_t xRunCount = 0;          // of both streams, over the window
+
+  // From the stream timestamps: how long a frame written to the playback stream takes to be
+  // heard plus how long a recorded frame waits to be read. Estimated from the buffer sizes if the
+  // device didn't give timestamps.
+  double latencyMs = 0;
+  bool isLatencyMeasured = false;
+
+  // Lower is better, see StreamProber::probe()
+  double score = 0;
+};
+
+struct StreamProbeResults {
+  std::vector<StreamProbeResult> configurations;
+  int32_t selectedIndex = -1;
+
+  std::string toJson() const;
+};
+
+/**
+ * Finds the stream configuration which gives the echo the lowest latency that runs without
+ * glitching. Opening a stream never fails just because the device can't do what was asked, it
+ * falls back to whatever it can do (shared rather than exclusive, a resampler, a bigger buffer),
+ * so the only way to know what a configuration really gives is to run it.
+ *
+ * Each configuration in a ranked list is opened as a recording and playback stream pair, the way
+ * the engine opens them, and run with silence for a short window. The playback buffer starts at a
+ * single burst and grows by a burst whenever it underruns, as the engine's would have to.
+ *
+ * Opens its own streams, so the engine's must be closed while it runs.
+ */
+class StreamProber {
+public:
+  // The configurations which are tried, most preferred first
+  static std::vector<StreamConfiguration> getConfigurations();
+
+  /**
+   * Probe each configuration in turn. Takes a fraction of a second per configuration, so must
+   * not be called from the UI thread.
+   *
+   * @param inputChannelCount the channel count the recording stream asks for
+   * @return false if no configuration could be opened and run
+   */
+  bool probe(int32_t recordingDeviceId, int32_t playbackDeviceId, int32_t inputChannelCount,
+             StreamProbeResults *results);
+
+  // Called from the playback stream's callback thread
+  aaudio_data_callback_result_t dataCallback(void *audioData, int32_t numFrames);
+
+private:
+  void probeConfiguration(const StreamConfiguration &configuration, StreamProbeResult *result);
+  AAudioStream *openStream(const StreamConfiguration &configuration, aaudio_direction_t direction,
+                           int32_t sampleRate, aaudio_format_t format);
+  void setBufferSize(int32_t numFrames);
+
+  int32_t recordingDeviceId_ = AAUDIO_UNSPECIFIED;
+  int32_t playbackDeviceId_ = AAUDIO_UNSPECIFIED;
+  int32_t inputChannelCount_ = 1;
+
+  // The streams being probed. The rest is only touched by their data callback until it sets
+  // isWindowComplete_.
+  AAudioStream *playStream_ = nullptr;
+  AAudioStream *recordingStream_ = nullptr;
+  int32_t sampleRate_ = 0;
+  int32_t framesPerBurst_ = 0;
+  int32_t bufferCapacity_ = 0;
+  int32_t bufferSize_ = 0;
+  int32_t bytesPerOutputFrame_ = 0;
+  std::vector<uint8_t> inputBuffer_;
+  int32_t inputBufferFrames_ = 0;
+  int64_t settleFrames_ = 0;
+  int64_t endFrames_ = 0;
+  int64_t framesRendered_ = 0;
+  int64_t lastCallbackNs_ = 0;
+  bool isInWindow_ = false;
+  int32_t windowCallbackCount_ = 0;
+  int64_t maxCallbackIntervalNs_ = 0;
+  int32_t xRunsAtWindowStart_ = 0;
+  int32_t lastOutputXRuns_ = 0;
+  double latencySumMs_ = 0;
+  int32_t latencyCount_ = 0;
+  std::atomic<bool> isWindowComplete_{false};
+};
+
+#endif //AAUDIO_STREAM_PROBER_H
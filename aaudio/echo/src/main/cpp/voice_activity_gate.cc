@@ -0,0 +1,104 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "voice_activity_gate.h"
+
+// Thresholds are in dB relative to a full scale signal
+constexpr float kOpenThresholdDb = -50.0f;
+constexpr float kCloseThresholdDb = -56.0f;
+
+// The attack is kept short so that the first syllable of a word isn't swallowed
+constexpr float kAttackSeconds = 0.002f;
+constexpr float kReleaseSeconds = 0.050f;
+constexpr float kHoldSeconds = 0.300f;
+
+constexpr float kInt16ToFloat = 1.0f / 32768.0f;
+
+static float decibelsToPower(float decibels) {
+  return powf(10.0f, decibels / 10.0f);
+}
+
+void VoiceActivityGate::setup(int32_t sampleRate) {
+  sampleRate_ = sampleRate;
+  openThreshold_ = decibelsToPower(kOpenThresholdDb);
+  closeThreshold_ = decibelsToPower(kCloseThresholdDb);
+  holdFrames_ = static_cast<int32_t>(kHoldSeconds * sampleRate);
+  reset();
+}
+
+void VoiceActivityGate::reset() {
+  envelope_ = 0;
+  holdFramesRemaining_ = 0;
+  isOpen_ = false;
+}
+
+/**
+ * Sum of squares of a block. Four independent accumulators are used so the compiler is free to
+ * vectorize the loop without having to re-associate floating point additions.
+ */
+template <typename T>
+static float sumOfSquares(const T *buffer, int32_t numSamples) {
+  float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+  int32_t i = 0;
+  for (; i + 4 <= numSamples; i += 4) {
+    float s0 = buffer[i];
+    float s1 = buffer[i + 1];
+    float s2 = buffer[i + 2];
+    float s3 = buffer[i + 3];
+    sum0 += s0 * s0;
+    sum1 += s1 * s1;
+    sum2 += s2 * s2;
+    sum3 += s3 * s3;
+  }
+  for (; i < numSamples; i++) {
+    float s = buffer[i];
+    sum0 += s * s;
+  }
+  return sum0 + sum1 + sum2 + sum3;
+}
+
+bool VoiceActivityGate::process(const int16_t *buffer, int32_t numSamples, int32_t numFrames) {
+
+  if (numSamples <= 0 || sampleRate_ <= 0) return isOpen_;
+  float energy = sumOfSquares(buffer, numSamples) * (kInt16ToFloat * kInt16ToFloat) / numSamples;
+  return update(energy, numFrames);
+}
+
+bool VoiceActivityGate::process(const float *buffer, int32_t numSamples, int32_t numFrames) {
+
+  if (numSamples <= 0 || sampleRate_ <= 0) return isOpen_;
+  float energy = sumOfSquares(buffer, numSamples) / numSamples;
+  return update(energy, numFrames);
+}
+
+bool VoiceActivityGate::update(float energy, int32_t numFrames) {
+
+  // The smoothing coefficients depend on the block length, which can change between callbacks
+  float blockSeconds = static_cast<float>(numFrames) / sampleRate_;
+  float seconds = (energy > envelope_) ? kAttackSeconds : kReleaseSeconds;
+  float coefficient = expf(-blockSeconds / seconds);
+  envelope_ = energy + coefficient * (envelope_ - energy);
+
+  if (envelope_ >= openThreshold_) {
+    isOpen_ = true;
+    holdFramesRemaining_ = holdFrames_;
+  } else if (isOpen_ && envelope_ < closeThreshold_) {
+    holdFramesRemaining_ -= numFrames;
+    if (holdFramesRemaining_ <= 0) isOpen_ = false;
+  }
+  return isOpen_;
+}
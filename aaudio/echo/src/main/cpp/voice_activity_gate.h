@@ -0,0 +1,58 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_VOICE_ACTIVITY_GATE_H
+#define AAUDIO_VOICE_ACTIVITY_GATE_H
+
+#include <cstdint>
+
+/**
+ * A cheap energy based voice activity gate. The mean square energy of each block is smoothed by
+ * an envelope follower which rises quickly (attack) and falls slowly. The gate opens as soon as
+ * the envelope crosses the open threshold and only closes once the envelope has stayed below the
+ * (lower) close threshold for the hold time. The gap between the two thresholds plus the hold
+ * time stop the gate from chattering on the tail end of words.
+ */
+class VoiceActivityGate {
+public:
+  void setup(int32_t sampleRate);
+  void reset();
+
+  /**
+   * Update the gate with a block of input audio.
+   *
+   * @param buffer interleaved samples
+   * @param numSamples the number of samples (not frames) in buffer
+   * @param numFrames the number of frames in buffer, used to advance the hold timer
+   * @return true if the gate is open and the block should be processed
+   */
+  bool process(const int16_t *buffer, int32_t numSamples, int32_t numFrames);
+  bool process(const float *buffer, int32_t numSamples, int32_t numFrames);
+  bool isOpen() const { return isOpen_; }
+
+private:
+  bool update(float energy, int32_t numFrames);
+
+  float openThreshold_ = 0;
+  float closeThreshold_ = 0;
+  float envelope_ = 0;
+  int32_t sampleRate_ = 0;
+  int32_t holdFrames_ = 0;
+  int32_t holdFramesRemaining_ = 0;
+  bool isOpen_ = false;
+};
+
+#endif //AAUDIO_VOICE_ACTIVITY_GATE_H
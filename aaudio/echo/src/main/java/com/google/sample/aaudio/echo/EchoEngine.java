@@ -36,4 +36,22 @@ public enum EchoEngine {
     static native void setEchoOn(boolean isEchoOn);
     static native void setRecordingDeviceId(int deviceId);
     static native void setPlaybackDeviceId(int deviceId);
+    static native void setInputChannelCount(int channelCount);
+    static native float getInputGainDb();
+    static native void setGranularOn(boolean isGranularOn);
+    static native void setGranularParameters(float density, float grainMs, float positionMs,
+                                             float pitchSemitones, float jitter, float spread,
+                                             float mix);
+    static native void setGranularWindow(int window);
+    static native void setGranularSource(float[] source);
+    static native void setMeasurementOn(boolean isMeasurementOn);
+    static native boolean isMeasurementComplete();
+    static native String getMeasurementResults();
+    static native void setGlitchMonitorOn(boolean isGlitchMonitorOn);
+    static native void setGlitchTestTone(float frequency);
+    static native String getGlitchReport();
+    static native void setSessionLogPath(String path);
+    static native String replaySession(String path, boolean isRealTime);
+    static native String probeStreams();
+    static native String getStreamReport();
 }
@@ -69,6 +69,9 @@ PlayAudioEngine::PlayAudioEngine() {
   // blocking. See https://developer.android.com/studio/profile/systrace-commandline.html
   Trace::initialize();
 
+  // Start the thread which logs for the data callback, so that it never blocks on the log
+  AudioLog::initialize();
+
   sampleChannels_ = kStereoChannelCount;
   sampleFormat_ = AAUDIO_FORMAT_PCM_FLOAT;
 
@@ -246,12 +249,12 @@ aaudio_data_callback_result_t PlayAudioEngine::dataCallback(AAudioStream *stream
   }
 
   if (shouldChangeBufferSize){
-    LOGD("Setting buffer size to %d", bufferSize);
+    AUDIO_LOGD("Setting buffer size to %d", bufferSize);
     bufferSize = AAudioStream_setBufferSizeInFrames(stream, bufferSize);
     if (bufferSize > 0) {
       bufSizeInFrames_ = bufferSize;
     } else {
-      LOGE("Error setting buffer size: %s", AAudio_convertResultToText(bufferSize));
+      AUDIO_LOGE("Error setting buffer size: %s", AAudio_convertResultToText(bufferSize));
     }
   }
 
@@ -334,7 +337,7 @@ PlayAudioEngine::calculateCurrentOutputLatencyMillis(AAudioStream *stream, doubl
     *latencyMillis = (double) (nextFramePresentationTime - nextFrameWriteTime)
                            / NANOS_PER_MILLISECOND;
   } else {
-    LOGE("Error calculating latency: %s", AAudio_convertResultToText(result));
+    AUDIO_LOGE("Error calculating latency: %s", AAudio_convertResultToText(result));
   }
 
   return result;
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <time.h>
+#include "logging_macros.h"
+#include "audio_log.h"
+
+// Threads which can log at once, e.g. a playback and a recording callback and a few helpers.
+// Messages from any more are dropped and counted.
+static const int32_t AUDIO_LOG_MAX_THREADS = 8;
+
+// Messages queued per thread, a power of two
+static const int32_t AUDIO_LOG_RING_SIZE = 64;
+
+// Messages per call site per thread in each rate limit period, and the number of call sites
+// tracked per thread
+static const int32_t AUDIO_LOG_RATE_LIMIT_MESSAGES = 5;
+static const int64_t AUDIO_LOG_RATE_LIMIT_PERIOD_NS = 1000000000;
+static const int32_t AUDIO_LOG_RATE_LIMIT_SLOTS = 16;
+
+static const int32_t AUDIO_LOG_DRAIN_PERIOD_MS = 20;
+static const int32_t AUDIO_LOG_MAX_MESSAGE_LENGTH = 512;
+
+namespace {
+
+struct Message {
+  const char *format;
+  int32_t priority;
+  int32_t argument_count;
+  AudioLogArgument arguments[kAudioLogMaxArguments];
+};
+
+struct RateLimit {
+  const char *format;
+  int64_t period_start_ns;
+  int32_t count;
+};
+
+enum RingState {
+  RING_FREE,
+  RING_OWNED,    // by a thread which is logging
+  RING_RETIRED,  // its thread has exited, it's free once drained
+};
+
+// A single producer, single consumer queue of messages. Only the owning thread writes messages
+// and touches the rate limits, only the background thread reads messages.
+struct Ring {
+  std::atomic<int32_t> state{RING_FREE};
+  std::atomic<uint32_t> write_index{0};
+  std::atomic<uint32_t> read_index{0};
+  std::atomic<int32_t> dropped_count{0};
+  std::atomic<int32_t> rate_limited_count{0};
+  Message messages[AUDIO_LOG_RING_SIZE];
+  RateLimit rate_limits[AUDIO_LOG_RATE_LIMIT_SLOTS];
+};
+
+// Hands a thread's ring back when the thread exits
+struct RingOwner {
+  Ring *ring = nullptr;
+
+  ~RingOwner() {
+    if (ring != nullptr) ring->state.store(RING_RETIRED, std::memory_order_release);
+  }
+};
+
+}
+
+static Ring rings[AUDIO_LOG_MAX_THREADS];
+static std::atomic<int32_t> unqueued_count{0};
+static thread_local RingOwner ring_owner;
+static std::once_flag initialize_flag;
+static std::mutex drain_lock;
+
+static int64_t nowNanoseconds() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+static Ring *claimRing() {
+
+  for (Ring &ring : rings) {
+    int32_t expected = RING_FREE;
+    if (ring.state.compare_exchange_strong(expected, RING_OWNED, std::memory_order_acq_rel)) {
+      memset(ring.rate_limits, 0, sizeof(ring.rate_limits));
+      return &ring;
+    }
+  }
+  return nullptr;
+}
+
+// @return true if a message from this call site should be dropped
+static bool isRateLimited(Ring *ring, const char *format, int64_t now_ns) {
+
+  size_t slot = (reinterpret_cast<uintptr_t>(format) >> 2) % AUDIO_LOG_RATE_LIMIT_SLOTS;
+  RateLimit &limit = ring->rate_limits[slot];
+  if (limit.format != format || now_ns - limit.period_start_ns >= AUDIO_LOG_RATE_LIMIT_PERIOD_NS) {
+    limit.format = format;
+    limit.period_start_ns = now_ns;
+    limit.count = 0;
+  }
+  return ++limit.count > AUDIO_LOG_RATE_LIMIT_MESSAGES;
+}
+
+void AudioLog::queue(int priority, const char *format, const AudioLogArgument *arguments,
+                     int32_t argument_count) {
+
+  Ring *ring = ring_owner.ring;
+  if (ring == nullptr) {
+    ring = claimRing();
+    if (ring == nullptr) {
+      unqueued_count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    ring_owner.ring = ring;
+  }
+
+  if (isRateLimited(ring, format, nowNanoseconds())) {
+    ring->rate_limited_count.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  uint32_t write_index = ring->write_index.load(std::memory_order_relaxed);
+  if (write_index - ring->read_index.load(std::memory_order_acquire) >= AUDIO_LOG_RING_SIZE) {
+    ring->dropped_count.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Message &message = ring->messages[write_index & (AUDIO_LOG_RING_SIZE - 1)];
+  message.format = format;
+  message.priority = priority;
+  message.argument_count = argument_count;
+  for (int32_t i = 0; i < argument_count; i++) message.arguments[i] = arguments[i];
+  ring->write_index.store(write_index + 1, std::memory_order_release);
+}
+
+static int64_t signedValue(const AudioLogArgument &argument) {
+  return (argument.type == AudioLogArgument::TYPE_DOUBLE) ?
+         static_cast<int64_t>(argument.double_value) : argument.int_value;
+}
+
+static double doubleValue(const AudioLogArgument &argument) {
+  switch (argument.type) {
+    case AudioLogArgument::TYPE_DOUBLE: return argument.double_value;
+    case AudioLogArgument::TYPE_UNSIGNED: return static_cast<uint64_t>(argument.int_value);
+    default: return argument.int_value;
+  }
+}
+
+/**
+ * printf the message one conversion at a time, since its arguments can't be turned back into a
+ * va_list. The length modifiers in the format are replaced with ones which match how each
+ * argument was stored.
+ */
+static void formatMessage(const Message &message, char *text, size_t size) {
+
+  const char *format = message.format;
+  int32_t argument_index = 0;
+  size_t length = 0;
+
+  while (*format != '\0' && length + 1 < size) {
+    if (*format != '%') {
+      text[length++] = *format++;
+      continue;
+    }
+    if (format[1] == '%') {
+      text[length++] = '%';
+      format += 2;
+      continue;
+    }
+
+    const char *conversion_start = format;
+    char conversion[32] = "%";
+    size_t conversion_length = 1;
+    format++;
+    while (*format != '\0' && strchr("-+ #0123456789.", *format) != nullptr &&
+           conversion_length < sizeof(conversion) - 4) {
+      conversion[conversion_length++] = *format++;
+    }
+    while (*format != '\0' && strchr("hljztL", *format) != nullptr) format++;
+    char type = *format;
+    if (type != '\0') format++;
+
+    int written = 0;
+    bool has_argument = argument_index < message.argument_count;
+    const AudioLogArgument &argument = message.arguments[has_argument ? argument_index : 0];
+    switch (has_argument ? type : '\0') {
+      case 'd':
+      case 'i':
+        strcpy(conversion + conversion_length, "lld");
+        written = snprintf(text + length, size - length, conversion,
+                           static_cast<long long>(signedValue(argument)));
+        break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+        conversion[conversion_length] = 'l';
+        conversion[conversion_length + 1] = 'l';
+        conversion[conversion_length + 2] = type;
+        conversion[conversion_length + 3] = '\0';
+        written = snprintf(text + length, size - length, conversion,
+                           static_cast<unsigned long long>(signedValue(argument)));
+        break;
+      case 'c':
+        strcpy(conversion + conversion_length, "c");
+        written = snprintf(text + length, size - length, conversion,
+                           static_cast<int>(signedValue(argument)));
+        break;
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+        conversion[conversion_length] = type;
+        conversion[conversion_length + 1] = '\0';
+        written = snprintf(text + length, size - length, conversion, doubleValue(argument));
+        break;
+      case 's':
+        strcpy(conversion + conversion_length, "s");
+        written = snprintf(text + length, size - length, conversion,
+                           (argument.type != AudioLogArgument::TYPE_STRING) ? "(not a string)" :
+                           (argument.string_value == nullptr) ? "(null)" : argument.string_value);
+        break;
+      case 'p':
+        written = snprintf(text + length, size - length, "%p", argument.pointer_value);
+        break;
+      default:
+        // An unsupported conversion, or one with no argument, is copied as it is
+        written = snprintf(text + length, size - length, "%.*s",
+                           static_cast<int>(format - conversion_start), conversion_start);
+        has_argument = false;
+        break;
+    }
+    if (has_argument) argument_index++;
+    if (written > 0) length = std::min(length + written, size - 1);
+  }
+  text[length] = '\0';
+}
+
+void AudioLog::drain() {
+
+  std::lock_guard<std::mutex> lock(drain_lock);
+  char text[AUDIO_LOG_MAX_MESSAGE_LENGTH];
+  int32_t dropped_count = unqueued_count.exchange(0, std::memory_order_relaxed);
+  int32_t rate_limited_count = 0;
+
+  for (Ring &ring : rings) {
+    int32_t state = ring.state.load(std::memory_order_acquire);
+    if (state == RING_FREE) continue;
+
+    uint32_t read_index = ring.read_index.load(std::memory_order_relaxed);
+    uint32_t write_index = ring.write_index.load(std::memory_order_acquire);
+    while (read_index != write_index) {
+      const Message &message = ring.messages[read_index & (AUDIO_LOG_RING_SIZE - 1)];
+      formatMessage(message, text, sizeof(text));
+      __android_log_print(message.priority, MODULE_NAME, "%s", text);
+      ring.read_index.store(++read_index, std::memory_order_release);
+    }
+    dropped_count += ring.dropped_count.exchange(0, std::memory_order_relaxed);
+    rate_limited_count += ring.rate_limited_count.exchange(0, std::memory_order_relaxed);
+
+    // A retired ring's thread has gone, so nothing can have been queued since
+    if (state == RING_RETIRED) ring.state.store(RING_FREE, std::memory_order_release);
+  }
+
+  if (dropped_count > 0 || rate_limited_count > 0) {
+    LOGW("Audio thread logging dropped %d message(s) and rate limited %d",
+         dropped_count, rate_limited_count);
+  }
+}
+
+void AudioLog::run() {
+
+  while (true) {
+    drain();
+    std::this_thread::sleep_for(std::chrono::milliseconds(AUDIO_LOG_DRAIN_PERIOD_MS));
+  }
+}
+
+void AudioLog::initialize() {
+  std::call_once(initialize_flag, []() { std::thread(&AudioLog::run).detach(); });
+}
+
+void AudioLog::flush() {
+  drain();
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef DEBUG_UTILS_AUDIO_LOG_H
+#define DEBUG_UTILS_AUDIO_LOG_H
+
+#include <cstdint>
+
+constexpr int32_t kAudioLogMaxArguments = 8;
+
+// A message argument, stored by value until the message is formatted
+struct AudioLogArgument {
+  enum Type : int32_t {
+    TYPE_SIGNED,
+    TYPE_UNSIGNED,
+    TYPE_DOUBLE,
+    TYPE_STRING,
+    TYPE_POINTER,
+  };
+
+  AudioLogArgument() : type(TYPE_SIGNED), int_value(0) {}
+  AudioLogArgument(int value) : type(TYPE_SIGNED), int_value(value) {}
+  AudioLogArgument(long value) : type(TYPE_SIGNED), int_value(value) {}
+  AudioLogArgument(long long value) : type(TYPE_SIGNED), int_value(value) {}
+  AudioLogArgument(unsigned int value) : type(TYPE_UNSIGNED), int_value(value) {}
+  AudioLogArgument(unsigned long value) : type(TYPE_UNSIGNED), int_value(value) {}
+  AudioLogArgument(unsigned long long value) : type(TYPE_UNSIGNED), int_value(value) {}
+  AudioLogArgument(double value) : type(TYPE_DOUBLE), double_value(value) {}
+  AudioLogArgument(const char *value) : type(TYPE_STRING), string_value(value) {}
+  AudioLogArgument(const void *value) : type(TYPE_POINTER), pointer_value(value) {}
+
+  Type type;
+  union {
+    int64_t int_value;
+    double double_value;
+    const char *string_value;
+    const void *pointer_value;
+  };
+};
+
+/**
+ * Logging which is safe to call from an audio callback. __android_log_print takes a lock and
+ * writes to a socket, either of which can block the audio thread for long enough to glitch.
+ *
+ * Instead each thread which logs gets a lock free ring of its own. A message is queued in it as
+ * the address of its format string and its arguments, by value, and a background thread formats
+ * the queued messages and passes them on to __android_log_print every few tens of milliseconds.
+ * Formatting supports the usual integer, floating point, %s and %p conversions.
+ *
+ * Each call site is rate limited to a few messages per second per thread, so a message in every
+ * callback can't flood the log, and a thread which logs faster than the background thread drains
+ * drops messages rather than wait. Both are counted, and the counts are logged with the messages.
+ *
+ * Strings are queued as pointers, so they must outlive the message: string literals and the
+ * results of AAudio_convertResultToText are fine, the contents of a buffer are not. The first
+ * message from a thread claims it a ring, which is the only time queuing a message may block.
+ */
+class AudioLog {
+
+public:
+  // Start the background thread. Messages are held in the rings until it runs.
+  static void initialize();
+
+  // Format everything queued so far now, e.g. before a command line tool exits
+  static void flush();
+
+  template <typename... Args>
+  static void log(int priority, const char *format, Args... args) {
+    static_assert(sizeof...(Args) <= kAudioLogMaxArguments, "Too many arguments to log");
+    const AudioLogArgument arguments[sizeof...(Args) + 1] = {AudioLogArgument(args)...};
+    queue(priority, format, arguments, sizeof...(Args));
+  }
+
+private:
+  static void queue(int priority, const char *format, const AudioLogArgument *arguments,
+                    int32_t argument_count);
+  static void drain();
+  static void run();
+};
+
+#endif //DEBUG_UTILS_AUDIO_LOG_H
@@ -17,6 +17,7 @@
 #ifndef __SAMPLE_ANDROID_DEBUG_H__
 #define __SAMPLE_ANDROID_DEBUG_H__
 #include <android/log.h>
+#include "audio_log.h"
 
 #if 1
 #ifndef MODULE_NAME
@@ -31,6 +32,13 @@
 #define LOGF(...) __android_log_print(ANDROID_LOG_FATAL,MODULE_NAME, __VA_ARGS__)
 
 #define ASSERT(cond, ...) if (!(cond)) {__android_log_assert(#cond, MODULE_NAME, __VA_ARGS__);}
+
+// For audio callbacks: queued without blocking and logged by a background thread, see AudioLog
+#define AUDIO_LOGV(...) AudioLog::log(ANDROID_LOG_VERBOSE, __VA_ARGS__)
+#define AUDIO_LOGD(...) AudioLog::log(ANDROID_LOG_DEBUG, __VA_ARGS__)
+#define AUDIO_LOGI(...) AudioLog::log(ANDROID_LOG_INFO, __VA_ARGS__)
+#define AUDIO_LOGW(...) AudioLog::log(ANDROID_LOG_WARN, __VA_ARGS__)
+#define AUDIO_LOGE(...) AudioLog::log(ANDROID_LOG_ERROR, __VA_ARGS__)
 #else
 
 #define LOGV(...)
@@ -41,6 +49,12 @@
 #define LOGF(...)
 #define ASSERT(cond, ...)
 
+#define AUDIO_LOGV(...)
+#define AUDIO_LOGD(...)
+#define AUDIO_LOGI(...)
+#define AUDIO_LOGW(...)
+#define AUDIO_LOGE(...)
+
 #endif
 
 #endif // __SAMPLE_ANDROID_DEBUG_H__
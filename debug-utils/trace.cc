@@ -43,8 +43,8 @@ void Trace::beginSection(const char *fmt, ...){
   if (is_tracing_supported_) {
     ATrace_beginSection(buff);
   } else {
-    LOGE("Tracing is either not initialized (call Trace::initialize()) "
-             "or not supported on this device");
+    AUDIO_LOGE("Tracing is either not initialized (call Trace::initialize()) "
+                   "or not supported on this device");
   }
 }
 
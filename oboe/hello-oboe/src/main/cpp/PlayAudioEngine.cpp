@@ -31,6 +31,9 @@ PlayAudioEngine::PlayAudioEngine() {
     // blocking. See https://developer.android.com/studio/profile/systrace-commandline.html
     Trace::initialize();
 
+    // Start the thread which logs for the data callback, so that it never blocks on the log
+    AudioLog::initialize();
+
     mSampleChannels = kAudioSampleChannels;
     createPlaybackStream();
 }
@@ -252,7 +255,7 @@ PlayAudioEngine::calculateCurrentOutputLatencyMillis(OboeStream *stream, double
         *latencyMillis = (double) (nextFramePresentationTime - nextFrameWriteTime)
                          / kNanosPerMillisecond;
     } else {
-        LOGE("Error calculating latency: %s", Oboe_convertResultToText(result));
+        AUDIO_LOGE("Error calculating latency: %s", Oboe_convertResultToText(result));
     }
 
     return result;